@@ -0,0 +1,295 @@
+/* This file is part of KCachegrind.
+   Copyright (c) 2026 The KCachegrind developers
+
+   KCachegrind is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation, version 2.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+/*
+ * Benchmark of the built-in call graph layout against 'dot'
+ *
+ * Call graphs of given sizes are generated as profile data, selected
+ * with GraphExporter as in CallGraphView, and laid out with GraphLayout
+ * and with 'dot -Tplain', the way CallGraphView runs GraphViz.
+ */
+
+#include <QBuffer>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QProcess>
+#include <QTextStream>
+#include <QVector>
+
+#include "tracedata.h"
+#include "loader.h"
+#include "config.h"
+#include "globalconfig.h"
+#include "callgraphview.h"
+#include "graphlayout.h"
+
+// as CallGraphView::nodeSize() with a font of 7x15 pixels
+#define CHAR_WIDTH  7
+#define LINE_HEIGHT 15
+#define MAX_NODEWIDTH 40
+
+void showHelp(QTextStream& out)
+{
+    out << "Usage: cglayoutbench [options] [<nodes> ...]\n\n"
+           "Times the layout of generated call graphs with <nodes>\n"
+           "functions (default: 50 500 5000).\n\n"
+           "Options:\n"
+           " -h        Show this help text\n"
+           " -r <n>    Repeat each layout <n> times, show the fastest (default 3)\n"
+           " -d <prog> GraphViz program to compare with (default dot)\n"
+           " -n        Do not run GraphViz" << endl;
+
+    exit(1);
+}
+
+/* Profile data with a call tree of <count> functions, each calling up
+ * to 3 others, and calls of random leaf functions from half of the
+ * inner functions, giving edges across the tree. The graph has no
+ * cycles: GraphExporter would follow them up to its depth limit.
+ */
+static QByteArray profileData(int count)
+{
+    QVector<QVector<int> > callees(count + 1);
+    int firstLeaf = (count + 4) / 3;
+    quint32 seed = 1;
+    for(int f = 1; f <= count; f++) {
+        for(int c = 3*f - 1; (c <= 3*f + 1) && (c <= count); c++)
+            callees[f].append(c);
+        if (callees[f].isEmpty() || (firstLeaf > count)) continue;
+
+        seed = seed * 1103515245 + 12345;
+        if ((seed >> 16) % 2) continue;
+        seed = seed * 1103515245 + 12345;
+        int leaf = firstLeaf + (seed >> 16) % (count - firstLeaf + 1);
+        if (!callees[f].contains(leaf))
+            callees[f].append(leaf);
+    }
+
+    // callees have higher numbers: inclusive costs bottom up
+    QVector<quint64> self(count + 1), incl(count + 1);
+    for(int f = count; f >= 1; f--) {
+        self[f] = 10 + (f * 7) % 90;
+        incl[f] = self[f];
+        foreach(int c, callees[f])
+            incl[f] += incl[c];
+    }
+
+    QByteArray d;
+    d += "# callgrind format\nevents: Ir\n\nfl=bench.c\n";
+    for(int f = 1; f <= count; f++) {
+        d += "fn=func" + QByteArray::number(f) + '\n';
+        d += "1 " + QByteArray::number(self[f]) + '\n';
+        foreach(int c, callees[f]) {
+            d += "cfn=func" + QByteArray::number(c) + '\n';
+            d += "calls=1 1\n";
+            d += "2 " + QByteArray::number(incl[c]) + '\n';
+        }
+    }
+    return d;
+}
+
+static QSizeF nodeSize(GraphNode* n, int detailLevel)
+{
+    QString abr = GlobalConfig::shortenSymbol(n->function()->prettyName());
+    if ((int)abr.length() < 8) abr = abr + QString(8 - abr.length(),'_');
+    int chars = qMin(abr.length() + 6, MAX_NODEWIDTH);
+
+    return QSizeF((chars + 2) * CHAR_WIDTH,
+                  8 + (1 + 2 * detailLevel) * LINE_HEIGHT);
+}
+
+// pairs of overlapping nodes in a layout result
+static int overlaps(const GraphLayoutResult& r)
+{
+    QList<QRectF> rects = r.nodeRects.values();
+    int count = 0;
+    for(int i=0; i<rects.count(); i++)
+        for(int j=i+1; j<rects.count(); j++)
+            if (rects[i].intersects(rects[j]))
+                count++;
+    return count;
+}
+
+// milliseconds with one fractional digit
+static QString ms(qint64 nsecs)
+{
+    if (nsecs < 0) return QStringLiteral("n/a");
+    return QString::number(nsecs / 1000000.0, 'f', 1);
+}
+
+/* Time of the fastest of <runs> layouts with GraphLayout. With
+ * <incremental>, the layout before gives the start order.
+ */
+static qint64 timeLayout(GraphLayout& layout, GraphExporter& exporter,
+                         GraphOptions::Layout l, TraceFunction* center,
+                         bool incremental, int runs)
+{
+    qint64 best = -1;
+    for(int run = 0; run < runs; run++) {
+        if (!incremental) layout.reset();
+        QElapsedTimer timer;
+        timer.start();
+
+        layout.clear();
+        layout.setLayout(l);
+        layout.setLabelSize(QSizeF(100, exporter.detailLevel() * 20));
+        foreach(GraphNode* n, exporter.visibleNodes())
+            layout.addNode(n, nodeSize(n, exporter.detailLevel()));
+        foreach(GraphEdge* e, exporter.visibleEdges())
+            layout.addEdge(e);
+        layout.layout(center);
+
+        qint64 t = timer.nsecsElapsed();
+        if ((best < 0) || (t < best)) best = t;
+    }
+    return best;
+}
+
+// time of 'dot -Tplain' including process start, as in CallGraphView
+static qint64 timeGraphviz(const QString& program, const QByteArray& dot,
+                           int runs)
+{
+    qint64 best = -1;
+    for(int run = 0; run < runs; run++) {
+        QElapsedTimer timer;
+        timer.start();
+
+        QProcess p;
+        p.start(program, QStringList() << QStringLiteral("-Tplain"));
+        if (!p.waitForStarted()) return -1;
+        p.write(dot);
+        p.closeWriteChannel();
+        if (!p.waitForFinished(-1) || (p.exitCode() != 0)) return -1;
+        p.readAllStandardOutput();
+
+        qint64 t = timer.nsecsElapsed();
+        if ((best < 0) || (t < best)) best = t;
+    }
+    return best;
+}
+
+int main(int argc, char** argv)
+{
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout);
+
+    Loader::initLoaders();
+    ConfigStorage::setStorage(new ConfigStorage);
+    GlobalConfig::config()->addDefaultTypes();
+
+    int runs = 3;
+    QString graphviz = QStringLiteral("dot");
+    QList<int> sizes;
+
+    QStringList list = app.arguments();
+    list.pop_front();
+    for(int arg = 0; arg<list.count(); arg++) {
+        if      (list[arg] == QLatin1String("-h")) showHelp(out);
+        else if (list[arg] == QLatin1String("-n")) graphviz.clear();
+        else if (list[arg] == QLatin1String("-r")) {
+            arg++;
+            if (arg>=list.count()) showHelp(out);
+            runs = qMax(list[arg].toInt(), 1);
+        }
+        else if (list[arg] == QLatin1String("-d")) {
+            arg++;
+            if (arg>=list.count()) showHelp(out);
+            graphviz = list[arg];
+        }
+        else if (list[arg].toInt() > 0)
+            sizes << list[arg].toInt();
+        else
+            showHelp(out);
+    }
+    if (sizes.isEmpty())
+        sizes << 50 << 500 << 5000;
+
+    out << "Times in ms, fastest of " << runs << " runs\n";
+    out << "  nodes  edges   select  layered  increm.  circular  "
+        << (graphviz.isEmpty() ? QStringLiteral("-") : graphviz)
+        << "  overlaps" << endl;
+
+    foreach(int size, sizes) {
+        QByteArray data = profileData(size);
+        QBuffer buffer(&data);
+        TraceData* d = new TraceData;
+        if (d->load(&buffer, QStringLiteral("bench.out")) == 0) {
+            out << "Loading generated data failed" << endl;
+            return 1;
+        }
+
+        TraceFunction* root = 0;
+        TraceFunctionMap::Iterator it;
+        for(it = d->functionMap().begin(); it != d->functionMap().end(); ++it)
+            if ((*it).name() == QLatin1String("func1"))
+                root = &(*it);
+        if (!root) return 1;
+
+        // show all functions
+        QElapsedTimer timer;
+        timer.start();
+        GraphExporter exporter(d, root, d->eventTypes()->realType(0),
+                               ProfileContext::Function);
+        exporter.setFuncLimit(0);
+        exporter.setCallLimit(0);
+        exporter.setMaxCalleeDepth(-1);
+        exporter.setMaxCallerDepth(0);
+        exporter.selectGraph();
+        qint64 selectTime = timer.nsecsElapsed();
+
+        GraphLayout layout;
+        qint64 layered = timeLayout(layout, exporter, GraphOptions::TopDown,
+                                    root, false, runs);
+        int overlapCount = overlaps(layout.result());
+        qint64 incremental = timeLayout(layout, exporter,
+                                        GraphOptions::TopDown, root,
+                                        true, runs);
+        overlapCount += overlaps(layout.result());
+        qint64 circular = timeLayout(layout, exporter,
+                                     GraphOptions::Circular, root,
+                                     false, runs);
+
+        qint64 dotTime = -1;
+        if (!graphviz.isEmpty()) {
+            QBuffer dot;
+            dot.open(QIODevice::WriteOnly);
+            exporter.writeDot(&dot);
+            dotTime = timeGraphviz(graphviz, dot.data(), runs);
+        }
+
+        out.setFieldWidth(7);
+        out << exporter.visibleNodes().count();
+        out << exporter.visibleEdges().count();
+        out.setFieldWidth(9);
+        out << ms(selectTime) << ms(layered) << ms(incremental);
+        out.setFieldWidth(10);
+        out << ms(circular);
+        out.setFieldWidth(3 + qMax(graphviz.length(), 1));
+        out << (graphviz.isEmpty() ? QStringLiteral("-") : ms(dotTime));
+        out.setFieldWidth(10);
+        out << overlapCount;
+        out.setFieldWidth(0);
+        out << endl;
+
+        // removes the temporary dot file
+        exporter.reset(0, 0, 0, ProfileContext::InvalidType);
+        delete d;
+    }
+
+    return 0;
+}
@@ -17,13 +17,19 @@
 */
 
 #include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QMap>
 #include <QTextStream>
 
+#include "dumpinfo.h"
 #include "tracedata.h"
 #include "loader.h"
 #include "config.h"
 #include "globalconfig.h"
 #include "logger.h"
+#include "pool.h"
+#include "profilecache.h"
 
 /*
  * Just a simple command line tool using libcore
@@ -43,12 +49,94 @@ void showHelp(QTextStream& out, bool fullHelp = true)
                " -s <ev>   Sort and show counters for event <ev>\n"
                " -c        Sort by call count\n"
                " -b        Show butterfly (callers and callees)\n"
-               " -n        Do not detect recursive cycles" << endl;
+               " -n        Do not detect recursive cycles\n"
+               " -S        Load files serially (no parallel parsing)\n"
+               " -P        Parse multiple files one after the other\n"
+               " -C        Do not use/write binary cache of profile data\n"
+               " -T        Show time needed for loading and parse throughput,\n"
+               "           and the number of cost items calculated\n"
+               " -m        Show memory taken by the loaded profile data\n"
+               " -V        Check that the loaded data is the same after a\n"
+               "           round trip through the binary cache format\n"
+               " -l        List profile data files in given directories with\n"
+               "           their metadata, without loading them" << endl;
 
     exit(1);
 }
 
 
+// costs and calls of all functions as text, for comparing loaded data
+static QStringList functionCosts(TraceData* d, const QStringList& events)
+{
+    QStringList l;
+    TraceFunctionMap::Iterator it;
+    for ( it = d->functionMap().begin(); it != d->functionMap().end(); ++it ) {
+        TraceFunction& f = *it;
+        QString s = f.name() + " (" + f.object()->name() + ")";
+        foreach(const QString& name, events) {
+            EventType* et = d->eventTypes()->type(name);
+            if (!et) {
+                s += QStringLiteral(" ?");
+                continue;
+            }
+            s += QStringLiteral(" %1/%2").arg(f.subCost(et).pretty())
+                                         .arg(f.inclusive()->subCost(et).pretty());
+        }
+        s += QStringLiteral(", called %1, %2 callees")
+             .arg(f.prettyCalledCount()).arg(f.callings().count());
+        l << s;
+    }
+    l.sort();
+    return l;
+}
+
+/* Serialize the parts of each loaded file in the binary cache format,
+ * load them into new profile data, and compare function costs.
+ * Data with recursion checks that calls into cycles are stored right.
+ */
+static bool checkCacheRoundTrip(TraceData* d, QTextStream& out)
+{
+    QStringList files;
+    QMap<QString, TracePartList> partsOfFile;
+    foreach(TracePart* part, d->parts()) {
+        if (!partsOfFile.contains(part->name())) files << part->name();
+        partsOfFile[part->name()].append(part);
+    }
+
+    QList<QByteArray> images;
+    foreach(const QString& file, files)
+        images << ProfileCache::image(d, partsOfFile[file], file);
+
+    TraceData* d2 = new TraceData(new Logger);
+    int parts = d2->addImages(files, images);
+    if (parts != d->parts().count()) {
+        out << "Cache check: " << parts << " of " << d->parts().count()
+            << " parts loaded from cache images" << endl;
+        return false;
+    }
+
+    QStringList events;
+    for(int i=0; i<d->eventTypes()->realCount(); i++)
+        events << d->eventTypes()->realType(i)->name();
+    QStringList costs = functionCosts(d, events);
+    QStringList costs2 = functionCosts(d2, events);
+
+    int differences = 0;
+    for(int i=0; i<qMax(costs.count(), costs2.count()); i++) {
+        QString s = (i < costs.count()) ? costs[i] : QString();
+        QString s2 = (i < costs2.count()) ? costs2[i] : QString();
+        if (s == s2) continue;
+        if (differences++ < 10)
+            out << "Cache check: '" << s << "' loaded as '" << s2 << "'\n";
+    }
+    out << "Cache check: " << costs.count() << " functions, "
+        << d->functionCycles().count() << " cycles, " << differences
+        << " differences" << endl;
+
+    return differences == 0;
+}
+
+
 int main(int argc, char** argv)
 {
     QCoreApplication app(argc, argv);
@@ -65,6 +153,10 @@ int main(int argc, char** argv)
     bool sortByExcl = false;
     bool sortByCount = false;
     bool showCalls = false;
+    bool showTiming = false;
+    bool listDumps = false;
+    bool showMemory = false;
+    bool checkCache = false;
     QString showEvent;
     QStringList files;
 
@@ -72,21 +164,82 @@ int main(int argc, char** argv)
         if      (list[arg] == QLatin1String("-h")) showHelp(out);
         else if (list[arg] == QLatin1String("-e")) sortByExcl = true;
         else if (list[arg] == QLatin1String("-n")) GlobalConfig::setShowCycles(false);
+        else if (list[arg] == QLatin1String("-S")) GlobalConfig::setParallelLoading(false);
+        else if (list[arg] == QLatin1String("-P")) GlobalConfig::setParallelFileLoading(false);
+        else if (list[arg] == QLatin1String("-C")) GlobalConfig::setUseProfileCache(false);
+        else if (list[arg] == QLatin1String("-T")) showTiming = true;
+        else if (list[arg] == QLatin1String("-l")) listDumps = true;
+        else if (list[arg] == QLatin1String("-m")) showMemory = true;
+        else if (list[arg] == QLatin1String("-V")) checkCache = true;
         else if (list[arg] == QLatin1String("-b")) showCalls = true;
         else if (list[arg] == QLatin1String("-c")) sortByCount = true;
         else if (list[arg] == QLatin1String("-s")) showEvent = list[++arg];
         else
             files << list[arg];
     }
+
+    if (listDumps) {
+        if (files.isEmpty()) files << QStringLiteral(".");
+        foreach(const QString& dir, files) {
+            QElapsedTimer timer;
+            timer.start();
+            DumpIndex index(dir);
+            DumpInfoList dumps = index.dumps();
+            foreach(const DumpInfo& info, dumps) {
+                out << QFileInfo(info.filename()).fileName()
+                    << ": pid " << info.processID();
+                if (info.partNumber() > 0)
+                    out << ", part " << info.partNumber();
+                if (info.threadID() > 0)
+                    out << ", thread " << info.threadID();
+                if (!info.trigger().isEmpty())
+                    out << ", " << info.trigger();
+                out << "\n  " << info.command() << "\n ";
+                QVector<quint64> totals = info.totals();
+                QStringList events = info.events();
+                for(int i=0; i<events.count(); i++)
+                    out << " " << events[i] << "="
+                        << (i < totals.count() ? QString::number(totals[i])
+                                               : QStringLiteral("?"));
+                out << "\n";
+            }
+            if (showTiming)
+                out << dumps.count() << " files listed in "
+                    << timer.elapsed() << " ms\n";
+        }
+        out << flush;
+        return 0;
+    }
+
     TraceData* d = new TraceData(new Logger);
+    QElapsedTimer timer;
+    timer.start();
     d->load(files);
 
+    if (showTiming) {
+        // use with -C to measure parsing instead of reading the cache
+        qint64 ms = timer.elapsed();
+        qint64 size = 0;
+        foreach(const QString& f, files)
+            size += QFileInfo(f).size();
+        double mb = size / (1024.0 * 1024.0);
+        out << "Loaded " << QString::number(mb, 'f', 1) << " MB in "
+            << ms << " ms";
+        if (ms > 0)
+            out << " (" << QString::number(mb * 1000.0 / ms, 'f', 1)
+                << " MB/s)";
+        out << endl;
+    }
+
     EventTypeSet* m = d->eventTypes();
     if (m->realCount() == 0) {
         out << "Error: No event types found." << endl;
         return 1;
     }
 
+    if (checkCache)
+        return checkCacheRoundTrip(d, out) ? 0 : 1;
+
     out << "\nTotals for event types:\n";
 
     EventType* et;
@@ -188,5 +341,37 @@ int main(int argc, char** argv)
         }
 
     }
+
+    if (showMemory) {
+        TraceMemoryUsage usage = d->memoryUsage();
+        out << "\nMemory usage (KB):\n";
+        for(int i=0; i<TraceMemoryUsage::CategoryCount; i++) {
+            TraceMemoryUsage::Category c = (TraceMemoryUsage::Category) i;
+            out.setFieldWidth(14);
+            out << usage.bytes(c) / 1024;
+            out.setFieldWidth(0);
+            out << "   " << TraceMemoryUsage::categoryName(c) << "\n";
+        }
+        out.setFieldWidth(14);
+        out << usage.total() / 1024;
+        out.setFieldWidth(0);
+        out << "   Total" << endl;
+
+        FixPool::Statistics fs = d->fixPool()->statistics();
+        out << "FixPool: " << fs.count << " objects with "
+            << fs.usedSize / 1024 << " KB in " << fs.chunks
+            << " chunks, allocated by " << fs.arenas << " threads" << endl;
+        if (usage.rawCostBytes() > 0)
+            out << "Event counts: " << usage.encodedCostBytes() / 1024
+                << " KB encoded, " << usage.rawCostBytes() / 1024
+                << " KB unencoded ("
+                << QString::number(100.0 * usage.encodedCostBytes() /
+                                   usage.rawCostBytes(), 'f', 1)
+                << "%)" << endl;
+    }
+
+    if (showTiming)
+        out << "\n" << CostItem::updateCount()
+            << " cost items calculated" << endl;
 }
 
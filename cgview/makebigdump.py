@@ -0,0 +1,100 @@
+#!/usr/bin/env python3
+#
+# Generate synthetic callgrind profile data of a given size, to check
+# loading of files bigger than 4 GB (see FixFile in libcore/utils.h).
+#
+# Usage: makebigdump.py [-s <size in MB>] [-f <functions>] [-r] <output file>
+#
+# The default size is 4500 MB. The file contains <functions> functions
+# calling each other in a chain, with cost lines for increasing source
+# lines. The totals are written into a "totals:" line at the end, and
+# printed at exit: they have to match the totals shown by
+#   cgview -C -T <output file>
+#
+# With -r, the last function calls the first one, which makes all
+# functions members of one recursive cycle. Use e.g.
+#   makebigdump.py -s 1 -f 50 -r cycle.out && cgview -C -V cycle.out
+# to check that data with cycles survives a round trip through the
+# binary cache format.
+#
+# Copyright (c) 2026 The KCachegrind developers
+# Released under the GPL v2, see COPYING.
+
+import argparse
+import sys
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Generate synthetic callgrind profile data")
+    parser.add_argument("-s", "--size", type=int, default=4500,
+                        help="approximate file size in MB (default 4500)")
+    parser.add_argument("-f", "--functions", type=int, default=1000,
+                        help="number of functions (default 1000)")
+    parser.add_argument("-r", "--recursive", action="store_true",
+                        help="let the last function call the first one")
+    parser.add_argument("output", help="file to write")
+    args = parser.parse_args()
+
+    size = args.size * 1024 * 1024
+    fcount = max(args.functions, 2)
+    ir_total = 0
+    dr_total = 0
+    written = 0
+
+    with open(args.output, "w") as out:
+        header = ("# callgrind format\n"
+                  "version: 1\n"
+                  "creator: makebigdump.py\n"
+                  "pid: 1\n"
+                  "cmd: makebigdump\n"
+                  "part: 1\n\n"
+                  "positions: line\n"
+                  "events: Ir Dr\n\n"
+                  "ob=(1) big.so\n"
+                  "fl=(1) big.c\n")
+        out.write(header)
+        written += len(header)
+
+        # name compression is used from the second round on, as in
+        # real dumps; every round adds cost to all functions
+        rnd = 0
+        while written < size:
+            lines = []
+            for f in range(1, fcount + 1):
+                if rnd == 0:
+                    lines.append("fn=(%d) func%d\n" % (f, f))
+                else:
+                    lines.append("fn=(%d)\n" % f)
+                base = rnd * 100
+                for i in range(20):
+                    ir = (f + i) % 97 + 1
+                    dr = (f * i) % 13
+                    lines.append("%d %d %d\n" % (base + i + 1, ir, dr))
+                    ir_total += ir
+                    dr_total += dr
+                if f < fcount or args.recursive:
+                    # call of next function in the chain, or back to
+                    # the first one for recursion
+                    callee = f + 1 if f < fcount else 1
+                    if rnd == 0:
+                        lines.append("cfn=(%d) func%d\n" % (callee, callee))
+                    else:
+                        lines.append("cfn=(%d)\n" % callee)
+                    # inclusive cost of the call, not part of the totals
+                    lines.append("calls=1 %d\n" % (base + 50))
+                    lines.append("%d 10 2\n" % (base + 21))
+            chunk = "".join(lines)
+            out.write(chunk)
+            written += len(chunk)
+            rnd += 1
+
+        out.write("\ntotals: %d %d\n" % (ir_total, dr_total))
+
+    print("%s: %d MB, Ir %d, Dr %d" %
+          (args.output, written // (1024 * 1024), ir_total, dr_total))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -22,6 +22,12 @@
 
 #include "dumpmanager.h"
 
+#include <QDir>
+#include <QFile>
+
+#include "decompressdevice.h"
+#include "tracedata.h"
+
 
 //
 // Dump
@@ -29,7 +35,12 @@
 
 Dump::Dump(QString file)
 {
-  _filename = file;
+  _info.scan(file);
+}
+
+Dump::Dump(const DumpInfo& info)
+{
+  _info = info;
 }
 
 
@@ -42,6 +53,13 @@ DumpManager* DumpManager::_self = 0;
 
 DumpManager::DumpManager()
 {
+  _index = 0;
+}
+
+DumpManager::~DumpManager()
+{
+  qDeleteAll(_dumps);
+  delete _index;
 }
 
 DumpManager* DumpManager::self()
@@ -53,14 +71,48 @@ DumpManager* DumpManager::self()
 }
 
 
-DumpList DumpManager::loadableDumps()
+DumpList DumpManager::loadableDumps(const QString& dir)
 {
+  // keep the index of the last directory to avoid rereading it
+  if (!_index || (_index->directory() != QDir(dir).absolutePath())) {
+    delete _index;
+    _index = new DumpIndex(dir);
+  }
+
   DumpList res;
+  foreach(const DumpInfo& info, _index->dumps()) {
+    Dump* dump = _current.value(info.filename(), 0);
+    if (!dump ||
+        (dump->info().size() != info.size()) ||
+        (dump->info().modified() != info.modified())) {
+      dump = new Dump(info);
+      _dumps.append(dump);
+      _current.insert(info.filename(), dump);
+    }
+    res.append(dump);
+  }
 
   return res;
 }
 
-TraceData* DumpManager::load(Dump*)
+TraceData* DumpManager::load(Dump* dump, Logger* logger)
 {
-  return 0;
+  if (!dump) return 0;
+
+  // only this file: load(QString) would take the name as prefix
+  QString name = dump->filename();
+  QIODevice* file;
+  if (DecompressDevice::decompressor(name).isEmpty())
+    file = new QFile(name);
+  else
+    file = new DecompressDevice(name);
+
+  TraceData* data = new TraceData(logger);
+  int parts = data->load(file, name);
+  delete file;
+  if (parts == 0) {
+    delete data;
+    return 0;
+  }
+  return data;
 }
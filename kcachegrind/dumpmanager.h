@@ -30,8 +30,12 @@
 
 #include <qstring.h>
 #include <qlist.h>
+#include <qhash.h>
+
+#include "dumpinfo.h"
 
 class Dump;
+class Logger;
 class TraceData;
 
 typedef QList<Dump*> DumpList;
@@ -44,17 +48,20 @@ class Dump
 {
 public:
   Dump(QString);
+  explicit Dump(const DumpInfo&);
 
-  QString filename() const { return _filename; }
+  QString filename() const { return _info.filename(); }
+  // metadata from header and totals, without loading
+  const DumpInfo& info() const { return _info; }
 
 private:
-  QString _filename;
+  DumpInfo _info;
 };
 
 
 /*
  * TODO:
- * - Everything
+ * - communication with running profiles
  *
  */
 
@@ -62,14 +69,24 @@ class DumpManager
 {
 public:
   DumpManager();
+  ~DumpManager();
 
-  DumpManager* self();
+  static DumpManager* self();
 
-  DumpList loadableDumps();
-  TraceData* load(Dump*);
+  /* dumps in <dir>, using an index of their metadata. The Dump objects
+   * are owned by the manager, and stay valid as long as it exists
+   */
+  DumpList loadableDumps(const QString& dir = QStringLiteral("."));
+  TraceData* load(Dump*, Logger*);
 
 private:
   static DumpManager* _self;
+
+  DumpIndex* _index;
+  // all dumps ever returned: older lists may still be in use
+  DumpList _dumps;
+  // file name => dump for its current version
+  QHash<QString, Dump*> _current;
 };
 
 #endif
@@ -32,6 +32,8 @@
 #include <QEventLoop>
 #include <QFile>
 #include <QFileDialog>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
 #include <QLabel>
 #include <QLineEdit>
 #include <QMenu>
@@ -41,6 +43,7 @@
 #include <QStatusBar>
 #include <QTemporaryFile>
 #include <QTimer>
+#include <QToolButton>
 #include <QUrl>
 #include <QtDBus/QDBusConnection>
 
@@ -72,6 +75,8 @@
 #include "stackselection.h"
 #include "stackbrowser.h"
 #include "tracedata.h"
+#include "decompressdevice.h"
+#include "loadthread.h"
 #include "globalguiconfig.h"
 #include "config.h"
 #include "configdlg.h"
@@ -84,11 +89,23 @@ TopLevel::TopLevel()
     QDBusConnection::sessionBus().registerObject(QStringLiteral("/KCachegrind"), this, QDBusConnection::ExportScriptableSlots);
 
     _progressBar = 0;
+    _loadThread = 0;
+    _loadShowError = false;
+    _cancelLoadButton = 0;
     _statusbar = statusBar();
     _statusLabel = new QLabel(_statusbar);
     _statusbar->addWidget(_statusLabel, 1);
     _ccProcess = 0;
 
+    // watching for new parts, see followParts()
+    _partWatcher = new QFileSystemWatcher(this);
+    _partWatchTimer = new QTimer(this);
+    _partWatchTimer->setSingleShot(true);
+    connect(_partWatcher, &QFileSystemWatcher::directoryChanged,
+            this, &TopLevel::partDirectoryChanged);
+    connect(_partWatchTimer, &QTimer::timeout,
+            this, &TopLevel::loadNewParts);
+
     _layoutCount = 1;
     _layoutCurrent = 0;
 
@@ -350,6 +367,8 @@ void TopLevel::createDocks()
 
 TopLevel::~TopLevel()
 {
+    // cancels and waits for a running load
+    delete _loadThread;
     delete _data;
 }
 
@@ -480,6 +499,17 @@ void TopLevel::createMiscActions()
                 "of the program.</p>");
     _taDump->setWhatsThis( hint );
 
+    _taFollow = actionCollection()->add<KToggleAction>( QStringLiteral("follow") );
+    _taFollow->setText( i18n( "F&ollow New Parts" ) );
+    connect(_taFollow, &QAction::triggered, this, &TopLevel::followParts);
+    hint = i18n("<b>Follow New Parts</b>"
+                "<p>This watches the directory of the profile data for "
+                "new parts, e.g. periodically dumped by a running "
+                "Callgrind, and adds them to the loaded data. "
+                "In contrast to a Reload, already loaded parts are kept, "
+                "and the current selection does not change.</p>");
+    _taFollow->setWhatsThis( hint );
+
     action = KStandardAction::open(this, SLOT(load()), actionCollection());
     hint = i18n("<b>Open Profile Data</b>"
                 "<p>This opens a profile data file, with possible multiple parts</p>");
@@ -823,7 +853,7 @@ void TopLevel::toggleCycles()
 
     if (!_data) return;
 
-    _data->invalidateDynamicCost();
+    // only invalidates costs depending on cycles
     _data->updateFunctionCycles();
 
     _stackSelection->rebuildStackList();
@@ -917,17 +947,20 @@ void TopLevel::load(const QUrl& url)
     if (url.isEmpty()) return;
 
     QString tmpFileName;
-    QTemporaryFile tmpFile;
     if (url.isLocalFile()) {
         tmpFileName = url.toLocalFile();
     }
-    else if (tmpFile.open()){
-        // network transparency
-        tmpFileName = tmpFile.fileName();
-        KIO::FileCopyJob *job = KIO::file_copy(url,
-                                               QUrl::fromLocalFile(tmpFileName));
-        KJobWidgets::setWindow(job, this);
-        job->exec();
+    else {
+        // network transparency. Loading is done in background, so the
+        // temporary copy is kept until this window is closed
+        QTemporaryFile* tmpFile = new QTemporaryFile(this);
+        if (tmpFile->open()) {
+            tmpFileName = tmpFile->fileName();
+            KIO::FileCopyJob *job = KIO::file_copy(url,
+                                                   QUrl::fromLocalFile(tmpFileName));
+            KJobWidgets::setWindow(job, this);
+            job->exec();
+        }
     }
     if (!tmpFileName.isEmpty()) {
         _openRecent->addUrl(url);
@@ -953,7 +986,7 @@ void TopLevel::load(QString file)
     if (file == QStringLiteral("."))
         showError = false;
 
-    if (_data && _data->parts().count()>0) {
+    if (_loadThread || (_data && _data->parts().count()>0)) {
 
         // In new window
         TopLevel* t = new TopLevel();
@@ -962,11 +995,8 @@ void TopLevel::load(QString file)
         return;
     }
 
-    bool loaded = openDataFile(file);
-    if (!loaded && showError)
-        KMessageBox::error(this, i18n("Could not open the file \"%1\". "
-                                      "Check it exists and you have enough "
-                                      "permissions to read it.", file));
+    // errors are shown when loading finished
+    openDataFile(file, showError);
 }
 
 
@@ -985,17 +1015,20 @@ void TopLevel::add(const QUrl &url)
     if (url.isEmpty()) return;
 
     QString tmpFileName;
-    QTemporaryFile tmpFile;
     if (url.isLocalFile()) {
         tmpFileName = url.toLocalFile();
     }
-    else if (tmpFile.open()){
-        // network transparency
-        tmpFileName = tmpFile.fileName();
-        KIO::FileCopyJob *job = KIO::file_copy(url,
-                                               QUrl::fromLocalFile(tmpFileName));
-        KJobWidgets::setWindow(job, this);
-        job->exec();
+    else {
+        // network transparency. Loading is done in background, so the
+        // temporary copy is kept until this window is closed
+        QTemporaryFile* tmpFile = new QTemporaryFile(this);
+        if (tmpFile->open()) {
+            tmpFileName = tmpFile->fileName();
+            KIO::FileCopyJob *job = KIO::file_copy(url,
+                                                   QUrl::fromLocalFile(tmpFileName));
+            KJobWidgets::setWindow(job, this);
+            job->exec();
+        }
     }
     if (!tmpFileName.isEmpty()) {
         _openRecent->addUrl(url);
@@ -1009,11 +1042,16 @@ void TopLevel::add(QString file)
 {
     if (file.isEmpty()) return;
 
-    if (_data) {
-        _data->load(file);
+    if (_loadThread) {
+        // data is not available yet
+        _addFilesDelayed << file;
+        return;
+    }
 
-        // GUI update for added data
-        configChanged();
+    // parsed in background, added to shown data when finished
+    if (_data) {
+        startLoad(new LoadThread(QStringList(file), LoadThread::AddParts),
+                  true);
         return;
     }
 
@@ -1034,15 +1072,24 @@ void TopLevel::loadDelayed(QStringList files)
     QTimer::singleShot(0, this, &TopLevel::loadTraceDelayed);
 }
 
+void TopLevel::addTraceDelayed()
+{
+    if (_addFilesDelayed.isEmpty() || _loadThread) return;
+
+    QStringList files = _addFilesDelayed;
+    _addFilesDelayed.clear();
+    foreach(const QString& file, files)
+        add(file);
+}
+
 void TopLevel::loadTraceDelayed()
 {
     if (_loadFilesDelayed.isEmpty()) return;
 
     if (_loadFilesDelayed.count()>1) {
         // FIXME: we expect all files to be local and existing
-        TraceData* d = new TraceData(this);
-        d->load(_loadFilesDelayed);
-        setData(d);
+        if (!_loadThread)
+            startLoad(new LoadThread(_loadFilesDelayed), true);
     }
     else {
         QString file = _loadFilesDelayed[0];
@@ -1070,6 +1117,77 @@ void TopLevel::reload()
     openDataFile(trace);
 }
 
+void TopLevel::followParts(bool follow)
+{
+    if (!_partWatcher->directories().isEmpty())
+        _partWatcher->removePaths(_partWatcher->directories());
+    _partWatchTimer->stop();
+
+    if (!follow || !_data) return;
+
+    QString dir = QFileInfo(_data->traceName()).absolutePath();
+    _partWatcher->addPath(dir);
+    // parts may have appeared since loading
+    loadNewParts();
+}
+
+void TopLevel::partDirectoryChanged()
+{
+    // wait for Callgrind to finish writing a dump
+    _partWatchTimer->start(1000);
+}
+
+void TopLevel::loadNewParts()
+{
+    if (!_data) return;
+
+    if (_loadThread) {
+        // try again later
+        if (!_partWatcher->directories().isEmpty())
+            _partWatchTimer->start(1000);
+        return;
+    }
+
+    // files still written are checked again later
+    bool pending;
+    QStringList files = _data->newPartFiles(&pending);
+    if (pending && !_partWatcher->directories().isEmpty())
+        _partWatchTimer->start(1000);
+
+    // parsed in background, added when finished
+    if (!files.isEmpty())
+        startLoad(new LoadThread(files, LoadThread::AddParts), false);
+}
+
+void TopLevel::partsAdded(const TracePartList& oldParts, int count)
+{
+    // an explicit selection of parts is extended by the new parts
+    if (!_activeParts.isEmpty()) {
+        foreach(TracePart* part, _data->parts())
+            if (!oldParts.contains(part))
+                _activeParts.append(part);
+
+        _partSelection->set(_activeParts);
+        _multiView->set(_activeParts);
+        _functionSelection->set(_activeParts);
+    }
+
+    // rebuild part list, keeping hidden parts
+    _partSelection->hiddenPartsChangedSlot(_hiddenParts);
+    _stackSelection->refresh();
+    updateViewsOnChange(TraceItemView::configChanged);
+
+    // as in setData(), show part dock if there are multiple parts now
+    if ((oldParts.count() < 2) && (_data->parts().count() > 1) &&
+        !_partDockShown->isChecked()) {
+        _partDock->show();
+        _partDockShown->setChecked(true);
+    }
+    updateStatusBar();
+
+    showMessage(i18np("Added %1 new part", "Added %1 new parts", count), 5000);
+}
+
 void TopLevel::exportGraph()
 {
     if (!_data || !_function) return;
@@ -1258,6 +1376,9 @@ bool TopLevel::setFunction(QString s)
     if (!_data) return false;
 
     ProfileCostArray* f = _data->search(ProfileContext::Function, s, _eventType);
+    if (!f)
+        f = _data->search(ProfileContext::Function, s, _eventType, 0,
+                          Qt::CaseInsensitive);
     if (!f) return false;
 
     return setFunction((TraceFunction*)f);
@@ -1520,6 +1641,9 @@ void TopLevel::setData(TraceData* data)
         _partDockShown->setChecked(true);
     }
 
+    // watch directory of new data
+    followParts(_taFollow->isChecked());
+
     updateStatusBar();
 }
 
@@ -2362,10 +2486,18 @@ void TopLevel::loadWarning(int line, const QString& msg)
     qWarning() << "Loading" << _filename << ":" << line << ": " << msg;
 }
 
-bool TopLevel::openDataFile(const QString& file)
+bool TopLevel::openDataFile(const QString& file, bool showError)
 {
-    TraceData* d = new TraceData(this);
-    int filesLoaded;
+    // still busy with previous file
+    if (_loadThread) return false;
+
+#ifdef Q_OS_UNIX
+    // external decompressor: runs in parallel and reports progress
+    if (!DecompressDevice::decompressor(file).isEmpty()) {
+        startLoad(new LoadThread(new DecompressDevice(file), file), showError);
+        return true;
+    }
+#endif
 
     // see whether this file is compressed, than take the direct route
     QMimeDatabase dataBase;
@@ -2376,17 +2508,169 @@ bool TopLevel::openDataFile(const QString& file)
                                         KFilterDev::compressionTypeForMimeType(mimeType));
     if (compressed &&
         (compressed->compressionType() != KCompressionDevice::None)) {
-        filesLoaded = d->load(compressed, file);
+        // the device is owned by the thread
+        startLoad(new LoadThread(compressed, file), showError);
     } else {
+        delete compressed;
         // else fallback to string based method that can also find multi-part callgrind data.
-        filesLoaded = d->load(file);
+        startLoad(new LoadThread(QStringList(file)), showError);
+    }
+    return true;
+}
+
+void TopLevel::startLoad(LoadThread* t, bool showError)
+{
+    Q_ASSERT(_loadThread == 0);
+
+    _loadThread = t;
+    _loadShowError = showError;
+
+    // signals from the loading thread are queued
+    connect(t, &LoadThread::fileStarted,
+            this, &TopLevel::loadThreadStarted);
+    connect(t, &LoadThread::fileProgress,
+            this, &TopLevel::loadThreadProgress);
+    connect(t, &LoadThread::fileWarning,
+            this, &TopLevel::loadThreadWarning);
+    connect(t, &LoadThread::fileError,
+            this, &TopLevel::loadThreadError);
+    connect(t, &LoadThread::fileFinished,
+            this, &TopLevel::loadThreadFileFinished);
+    connect(t, &QThread::finished,
+            this, &TopLevel::loadThreadFinished);
+
+    t->start();
+}
+
+void TopLevel::showLoadProgress(const QString& msg, int progress)
+{
+    if (!_statusbar) return;
+
+    if (!_progressBar) {
+        _progressBar = new QProgressBar(_statusbar);
+        _progressBar->setMaximumSize(200, _statusbar->height()-4);
+        _statusbar->addPermanentWidget(_progressBar, 1);
+        _progressBar->show();
+    }
+    if (!_cancelLoadButton) {
+        _cancelLoadButton = new QToolButton(_statusbar);
+        _cancelLoadButton->setIcon(QIcon::fromTheme(QStringLiteral("process-stop")));
+        _cancelLoadButton->setToolTip(i18n("Cancel loading"));
+        _cancelLoadButton->setAutoRaise(true);
+        connect(_cancelLoadButton, &QToolButton::clicked,
+                this, &TopLevel::cancelLoad);
+        _statusbar->addPermanentWidget(_cancelLoadButton);
+        _cancelLoadButton->show();
     }
-    if (filesLoaded > 0) {
+
+    _statusbar->showMessage(msg);
+    _progressBar->setValue(progress);
+}
+
+void TopLevel::cancelLoad()
+{
+    if (!_loadThread) return;
+
+    _loadThread->cancel();
+    if (_cancelLoadButton)
+        _cancelLoadButton->setEnabled(false);
+}
+
+void TopLevel::loadThreadStarted(const QString& filename)
+{
+    Logger::_filename = filename;
+    showLoadProgress(i18n("Loading %1", filename), 0);
+}
+
+void TopLevel::loadThreadProgress(const QString& filename, int progress,
+                                  double bytesPerSecond, int secondsLeft)
+{
+    QString msg;
+    if ((bytesPerSecond > 0) && (secondsLeft >= 0))
+        msg = i18n("Loading %1 (%2 MB/s, %3 s left)", filename,
+                   QString::number(bytesPerSecond / (1024*1024), 'f', 1),
+                   secondsLeft);
+    else
+        msg = i18n("Loading %1", filename);
+
+    showLoadProgress(msg, progress);
+}
+
+void TopLevel::loadThreadWarning(const QString& filename, int line,
+                                 const QString& msg)
+{
+    qWarning() << "Loading" << filename << ":" << line << ": " << msg;
+}
+
+void TopLevel::loadThreadError(const QString& filename, int line,
+                               const QString& msg)
+{
+    qCritical() << "Loading" << filename << ":" << line << ": " << msg;
+}
+
+void TopLevel::loadThreadFileFinished(const QString& filename,
+                                      const QString& msg)
+{
+    if (!msg.isEmpty())
+        qWarning() << "Error loading" << filename << ":" << msg;
+}
+
+void TopLevel::loadThreadFinished()
+{
+    LoadThread* t = _loadThread;
+    if (!t) return;
+    _loadThread = 0;
+
+    if (_cancelLoadButton) {
+        _statusbar->removeWidget(_cancelLoadButton);
+        delete _cancelLoadButton;
+        _cancelLoadButton = 0;
+    }
+    // reset status
+    showStatus(QString(), 0);
+
+    // finished() is emitted just before the thread terminates
+    t->wait();
+
+    // parts for the shown data
+    int added = 0;
+    if ((t->mode() == LoadThread::AddParts) && _data && !t->isCanceled()) {
+        TracePartList oldParts = _data->parts();
+        added = t->addParts(_data);
+        if (added > 0)
+            partsAdded(oldParts, added);
+    }
+
+    TraceData* d = t->takeData();
+    bool canceled = t->isCanceled();
+    QStringList files = t->files();
+    delete t;
+
+    // loading may have finished before the cancel request was seen
+    if (canceled) {
+        delete d;
+        d = 0;
+    }
+
+    // files added meanwhile
+    if (!_addFilesDelayed.isEmpty())
+        QTimer::singleShot(0, this, &TopLevel::addTraceDelayed);
+
+    if (d) {
+        // we get notifications when adding files to the data
+        d->setLogger(this);
+        // switch to the new data in one go
         setData(d);
-        return true;
-    } else {
-        return false;
+        return;
     }
+
+    if (canceled)
+        showMessage(i18n("Loading canceled"), 2000);
+    else if (_loadShowError && (added == 0))
+        KMessageBox::error(this, i18n("Could not open the file \"%1\". "
+                                      "Check it exists and you have enough "
+                                      "permissions to read it.",
+                                      files.join(QStringLiteral(", "))));
 }
 
 
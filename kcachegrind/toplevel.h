@@ -38,8 +38,11 @@
 class MultiView;
 class QLineEdit;
 class QDockWidget;
+class QFileSystemWatcher;
 class QLabel;
 class QProgressBar;
+class QTimer;
+class QToolButton;
 class QMenu;
 
 class QUrl;
@@ -49,6 +52,7 @@ class KToolBarPopupAction;
 class KStatusBar;
 
 class TraceData;
+class LoadThread;
 class KRecentFilesAction;
 class MainWidget;
 class PartSelection;
@@ -109,6 +113,9 @@ public slots:
     void loadDelayed(QStringList);
 
     void reload();
+    // add new parts appearing in the directory of the loaded data
+    void followParts(bool);
+    void loadNewParts();
     void exportGraph();
     void newWindow();
     void configure();
@@ -196,6 +203,7 @@ public slots:
     void setGroupDelayed();
     void setTraceItemDelayed();
     void loadTraceDelayed();
+    void addTraceDelayed();
     void setDirectionDelayed();
 
     // configuration has changed
@@ -209,11 +217,26 @@ public slots:
     void showStatus(const QString& msg, int progress);
     void showMessage(const QString&, int msec);
 
+    // notifications from loading in background
+    void loadThreadStarted(const QString& filename);
+    void loadThreadProgress(const QString& filename, int progress,
+                            double bytesPerSecond, int secondsLeft);
+    void loadThreadWarning(const QString& filename, int line,
+                           const QString& msg);
+    void loadThreadError(const QString& filename, int line,
+                         const QString& msg);
+    void loadThreadFileFinished(const QString& filename, const QString& msg);
+    void loadThreadFinished();
+    void cancelLoad();
+
     // for running callgrind_control in the background
     void ccReadOutput();
     void ccError(QProcess::ProcessError);
     void ccExit(int,QProcess::ExitStatus);
 
+    // new parts are loaded with a delay after a directory change
+    void partDirectoryChanged();
+
 private:
     void resetState();
     void createLayoutActions();
@@ -227,9 +250,14 @@ private:
     void restoreTraceTypes();
     void restoreTraceSettings();
     void updateViewsOnChange(int);
-    /// open @p file, might be compressed
-    /// @return true when the file could be opened, false otherwise.
-    bool openDataFile(const QString& file);
+    /// open @p file, might be compressed. Loading runs in background,
+    /// the data is shown when finished.
+    /// @return true when loading was started, false otherwise.
+    bool openDataFile(const QString& file, bool showError = false);
+    void startLoad(LoadThread*, bool showError);
+    // GUI update after adding parts to the shown data
+    void partsAdded(const TracePartList& oldParts, int count);
+    void showLoadProgress(const QString& msg, int progress);
 
     QStatusBar* _statusbar;
     QLabel* _statusLabel;
@@ -251,7 +279,7 @@ private:
     KToggleAction *_partDockShown, *_stackDockShown;
     KToggleAction *_functionDockShown, *_dumpDockShown;
     KToggleAction *_taPercentage, *_taExpanded, *_taCycles, *_taHideTemplates;
-    KToggleAction *_taDump, *_taSplit, *_taSplitDir;
+    KToggleAction *_taDump, *_taFollow, *_taSplit, *_taSplitDir;
     KToolBarPopupAction *_paForward, *_paBack, *_paUp;
 
     TraceFunction* _function;
@@ -280,6 +308,8 @@ private:
     TraceCostItem* _groupDelayed;
     CostItem* _traceItemDelayed;
     QStringList _loadFilesDelayed;
+    // files to add after loading in background finished
+    QStringList _addFilesDelayed;
     TraceItemView::Direction _directionDelayed;
 
     // for status progress display
@@ -287,12 +317,21 @@ private:
     QTime _progressStart;
     QProgressBar* _progressBar;
 
+    // background loading, at most one per window
+    LoadThread* _loadThread;
+    bool _loadShowError;
+    QToolButton* _cancelLoadButton;
+
     // toplevel configuration options
     bool _showPercentage, _showExpanded, _showCycles, _hideTemplates;
 
     // for running callgrind_control in the background
     QProcess* _ccProcess;
     QString _ccOutput;
+
+    // following new parts of the loaded data
+    QFileSystemWatcher* _partWatcher;
+    QTimer* _partWatchTimer;
 };
 
 #endif
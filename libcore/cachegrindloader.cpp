@@ -20,16 +20,368 @@
 
 #include <QIODevice>
 #include <QVector>
+#include <QList>
+#include <QHash>
+#include <QPair>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QThread>
+#include <QThreadPool>
 #include <QDebug>
 
+#include <string.h>
+
 #include "addr.h"
+#include "decompressdevice.h"
 #include "tracedata.h"
 #include "utils.h"
 #include "fixcost.h"
+#include "globalconfig.h"
 
 
 #define TRACE_LOADER 0
 
+// files bigger than 2 chunks are loaded in parallel
+#define LOADER_CHUNK_SIZE (4*1024*1024)
+// cost lines per batch given to a worker, cut at the next "fn=" line
+#define COST_BATCH_SIZE 50000
+
+
+/*
+ * Support for parallel loading of big files.
+ *
+ * The file is split into chunks at line boundaries. Worker threads
+ * tokenize the position/cost lines of a chunk into numbers, while the
+ * loader consumes the chunks in file order. It resolves names and
+ * positions and looks up the objects of the data model (which is not
+ * thread-safe), but only records the cost lines into batches, which
+ * are cut at "fn=" lines. Worker threads create the cost items of a
+ * batch as partial result: per part function and part call, a list of
+ * FixCost/FixCallCost from the thread's FixPool arena, and the maximum
+ * of call costs. The loader merges the batches in file order into the
+ * data model. Lines which could not be pre-parsed are handled by the
+ * serial parsing code.
+ */
+
+// a token of a position/cost line: [prefix]value[range rangeValue]
+struct CostToken
+{
+    char prefix; // 0, '*', '+' or '-'
+    char range;  // 0, '+', '-' or ':'
+    uint64 value, rangeValue;
+};
+
+struct ChunkLine
+{
+    const char* str;
+    int len;
+    int firstToken;
+    int tokenCount; // -1 if not pre-parsed
+};
+
+struct LoaderChunk
+{
+    const char *begin, *end;
+    QVector<ChunkLine> lines;
+    QVector<CostToken> tokens;
+    QSemaphore parsed;
+};
+
+class ChunkTokenizer: public QRunnable
+{
+public:
+    explicit ChunkTokenizer(LoaderChunk* chunk) { _chunk = chunk; }
+
+    void run() Q_DECL_OVERRIDE;
+
+private:
+    bool tokenize(FixString&);
+
+    LoaderChunk* _chunk;
+};
+
+bool ChunkTokenizer::tokenize(FixString& s)
+{
+    CostToken t;
+    char c;
+
+    while(s.first(c)) {
+        t.prefix = 0;
+        t.range = 0;
+        t.value = 0;
+        t.rangeValue = 0;
+
+        if ((c == '*') || (c == '+') || (c == '-')) {
+            s.stripFirst(c);
+            t.prefix = c;
+            if ((c != '*') && !s.stripUInt64(t.value, false)) return false;
+        }
+        else if (!s.stripUInt64(t.value, false)) return false;
+
+        if (s.first(c) && ((c == '+') || (c == '-') || (c == ':'))) {
+            s.stripFirst(c);
+            t.range = c;
+            if (!s.stripUInt64(t.rangeValue, false)) return false;
+        }
+
+        // tokens have to be separated by spaces
+        if (s.first(c) && (c != ' ')) return false;
+        s.stripSpaces();
+
+        _chunk->tokens.append(t);
+    }
+    return true;
+}
+
+void ChunkTokenizer::run()
+{
+    const char* s = _chunk->begin;
+    const char* end = _chunk->end;
+    FixString str;
+    ChunkLine l;
+    char c;
+
+    while(s < end) {
+        const char* e = (const char*) memchr(s, '\n', end - s);
+        if (!e) e = end;
+
+        l.str = s;
+        l.len = e - s;
+        // get rid of any carriage return at end
+        if ((l.len>0) && (s[l.len-1] == '\r')) l.len--;
+        l.firstToken = _chunk->tokens.size();
+        l.tokenCount = -1;
+
+        c = (l.len>0) ? *s : 0;
+        if (((c >= '0') && (c <= '9')) || (c == '*') || (c == '+') || (c == '-')) {
+            str.set(s, l.len);
+            if (tokenize(str))
+                l.tokenCount = _chunk->tokens.size() - l.firstToken;
+            else
+                _chunk->tokens.resize(l.firstToken);
+        }
+        _chunk->lines.append(l);
+
+        s = (e < end) ? e+1 : e;
+    }
+
+    _chunk->parsed.release();
+}
+
+
+// a pre-parsed cost line, with model objects looked up by the loader
+struct CostRecord
+{
+    TraceFunctionSource* source;
+    // self cost of <partFunction>, or call cost of <partCall>
+    TracePartFunction* partFunction;
+    TracePartCall* partCall;
+    PositionSpec pos;
+    SubCost callCount;
+    int firstValue, count;
+};
+
+template<class T>
+struct CostList
+{
+    CostList() { first = 0; last = 0; }
+    T *first, *last;
+};
+
+struct CostBatch
+{
+    TracePart* part;
+    FixPool* pool;
+    QVector<CostRecord> records;
+    QVector<SubCost> values;
+
+    // partial result, see CachegrindLoader::mergeCostBatch()
+    QHash<TracePartFunction*, CostList<FixCost> > costs;
+    QHash<TracePartCall*, CostList<FixCallCost> > callCosts;
+    QVector<SubCost> callMax; // by real index
+    SubCost maxCallCount;
+    QSemaphore built;
+};
+
+class CostBatchBuilder: public QRunnable
+{
+public:
+    explicit CostBatchBuilder(CostBatch* batch) { _batch = batch; }
+
+    void run() Q_DECL_OVERRIDE;
+
+private:
+    CostBatch* _batch;
+};
+
+void CostBatchBuilder::run()
+{
+    CostBatch* b = _batch;
+    EventTypeMapping* mapping = b->part->eventTypeMapping();
+
+    for(int idx=0; idx<b->records.size(); idx++) {
+        CostRecord& r = b->records[idx];
+        const SubCost* values = b->values.constData() + r.firstValue;
+
+        if (r.partFunction) {
+            FixCost* fc = new (b->pool) FixCost(b->part, b->pool, r.source,
+                                                r.pos, 0, values, r.count);
+            // prepend, as TracePartFunction::setFirstFixCost() does
+            CostList<FixCost>& l = b->costs[r.partFunction];
+            fc->setNextCostOfPartFunction(l.first);
+            if (!l.last) l.last = fc;
+            l.first = fc;
+            continue;
+        }
+
+        FixCallCost* fcc = new (b->pool) FixCallCost(b->part, b->pool,
+                                                     r.source,
+                                                     r.pos.fromLine,
+                                                     r.pos.fromAddr, 0,
+                                                     r.callCount,
+                                                     values, r.count);
+        CostList<FixCallCost>& l = b->callCosts[r.partCall];
+        fcc->setNextCostOfPartCall(l.first);
+        if (!l.last) l.last = fcc;
+        l.first = fcc;
+
+        // as FixCallCost::setMax()
+        for(int i=0; i<r.count; i++) {
+            int realIndex = mapping->realIndex(i);
+            if (b->callMax.size() <= realIndex)
+                b->callMax.resize(realIndex+1);
+            if (b->callMax[realIndex] < values[i])
+                b->callMax[realIndex] = values[i];
+        }
+        if (b->maxCallCount < r.callCount)
+            b->maxCallCount = r.callCount;
+    }
+
+    b->built.release();
+}
+
+
+/**
+ * Delivers the lines of a file to the loader, either directly
+ * from FixFile, or pre-tokenized from chunks parsed in parallel.
+ */
+class LoaderLineSource
+{
+public:
+    LoaderLineSource(FixFile& file, bool parallel);
+    ~LoaderLineSource();
+
+    /**
+     * Read next line into <line>. If it was pre-parsed, <tokens>
+     * points to <tokenCount> tokens, otherwise <tokenCount> is -1.
+     */
+    bool nextLine(FixString& line, const CostToken*& tokens, int& tokenCount);
+
+    // position in file after the line read last
+    uint64 current();
+
+private:
+    void submitChunk();
+
+    FixFile& _file;
+    bool _parallel;
+    // part of file not yet submitted for parsing
+    const char *_next, *_end;
+    // submitted chunks in file order
+    QList<LoaderChunk*> _chunks;
+    bool _firstParsed;
+    int _lineIndex;
+    uint64 _current;
+};
+
+LoaderLineSource::LoaderLineSource(FixFile& file, bool parallel)
+    : _file(file)
+{
+    _parallel = parallel;
+    _firstParsed = false;
+    _lineIndex = 0;
+    _current = 0;
+    _next = file.base();
+    _end = _next + file.len();
+
+    if (!_parallel) return;
+
+    // keep all threads busy, but do not parse too far ahead
+    int window = 2 * QThreadPool::globalInstance()->maxThreadCount();
+    while((_chunks.count() < window) && (_next < _end))
+        submitChunk();
+}
+
+LoaderLineSource::~LoaderLineSource()
+{
+    // wait for workers still accessing the chunks
+    foreach(LoaderChunk* c, _chunks) {
+        if (_firstParsed)
+            _firstParsed = false;
+        else
+            c->parsed.acquire();
+        delete c;
+    }
+}
+
+void LoaderLineSource::submitChunk()
+{
+    LoaderChunk* c = new LoaderChunk;
+
+    c->begin = _next;
+    if (_end - _next > LOADER_CHUNK_SIZE) {
+        const char* e = (const char*) memchr(_next + LOADER_CHUNK_SIZE, '\n',
+                                             _end - _next - LOADER_CHUNK_SIZE);
+        _next = e ? e+1 : _end;
+    }
+    else
+        _next = _end;
+    c->end = _next;
+
+    _chunks.append(c);
+    QThreadPool::globalInstance()->start(new ChunkTokenizer(c));
+}
+
+bool LoaderLineSource::nextLine(FixString& line,
+                                const CostToken*& tokens, int& tokenCount)
+{
+    if (!_parallel) {
+        tokenCount = -1;
+        return _file.nextLine(line);
+    }
+
+    while(!_chunks.isEmpty()) {
+        LoaderChunk* c = _chunks.first();
+        if (!_firstParsed) {
+            c->parsed.acquire();
+            _firstParsed = true;
+        }
+
+        if (_lineIndex < c->lines.size()) {
+            const ChunkLine& l = c->lines.at(_lineIndex++);
+            line.set(l.str, l.len);
+            tokens = c->tokens.constData() + l.firstToken;
+            tokenCount = l.tokenCount;
+            _current = (l.str + l.len) - _file.base();
+            return true;
+        }
+
+        // chunk done, continue with next one
+        _chunks.removeFirst();
+        delete c;
+        _firstParsed = false;
+        _lineIndex = 0;
+        if (_next < _end) submitChunk();
+    }
+    return false;
+}
+
+uint64 LoaderLineSource::current()
+{
+    return _parallel ? _current : _file.current();
+}
+
+
 /*
  * Loader for Callgrind Profile data (format based on Cachegrind format).
  * See Callgrind documentation for the file format.
@@ -52,21 +404,34 @@ private:
     enum lineType { SelfCost, CallCost, BoringJump, CondJump };
 
     bool parsePosition(FixString& s, PositionSpec& newPos);
+    bool parsePreparsedLine(const CostToken*, int count);
 
     // position setters
     void clearPosition();
     void ensureObject();
     void ensureFile();
     void ensureFunction();
-    void setObject(const QString&);
-    void setCalledObject(const QString&);
-    void setFile(const QString&);
-    void setCalledFile(const QString&);
-    void setFunction(const QString&);
-    void setCalledFunction(const QString&);
+    void setObject(FixString&);
+    void setCalledObject(FixString&);
+    void setFile(FixString&);
+    void setCalledFile(FixString&);
+    void setFunction(FixString&);
+    void setCalledFunction(FixString&);
 
     void prepareNewPart();
 
+    // parallel creation of cost items, see CostBatch
+    void addCostRecord(TracePartFunction*, TracePartCall*,
+                       const PositionSpec&, SubCost callCount);
+    void submitCostBatch();
+    void mergeCostBatch();
+    void mergeCostBatches(int keep = 0);
+
+    bool _parallel;
+    CostBatch* _costBatch;
+    // submitted batches in file order
+    QList<CostBatch*> _costBatches;
+
     QString _emptyString;
 
     // current line in file to read in
@@ -112,6 +477,10 @@ private:
     PositionSpec targetPos;
     SubCost jumpsFollowed, jumpsExecuted;
 
+    // event counts of a pre-parsed cost line
+    SubCost _values[MaxRealIndexValue];
+    int _valueCount;
+
     /** Support for compressed string format
    * This uses the following string compression model
    * for objects, files, functions:
@@ -125,12 +494,18 @@ private:
    */
     void clearCompression();
     const QString& checkUnknown(const QString& n);
-    TraceObject* compressedObject(const QString& name);
-    TraceFile* compressedFile(const QString& name);
-    TraceFunction* compressedFunction(const QString& name,
+    TraceObject* compressedObject(FixString& name);
+    TraceFile* compressedFile(FixString& name);
+    TraceFunction* compressedFunction(FixString& name,
                                       TraceFile*, TraceObject*);
+    TraceObject* internedObject(FixString& name);
+    TraceFile* internedFile(FixString& name);
+    TraceFunction* internedFunction(FixString& name,
+                                    TraceFile*, TraceObject*);
 
     QVector<TraceCostItem*> _objectVector, _fileVector, _functionVector;
+    // uncompressed names, with file/object as scope for functions
+    NameTable _objectNames, _fileNames, _functionNames;
 };
 
 
@@ -144,6 +519,8 @@ CachegrindLoader::CachegrindLoader()
     : Loader(QStringLiteral("Callgrind"),
              QObject::tr( "Import filter for Cachegrind/Callgrind generated profile data files") )
 {
+    _parallel = false;
+    _costBatch = 0;
 }
 
 bool CachegrindLoader::canLoad(QIODevice* file)
@@ -157,8 +534,9 @@ bool CachegrindLoader::canLoad(QIODevice* file)
      * - it starts with a line "# callgrind format", or
      * - if the first 2047 bytes contain either "\nevents:" or "\ncreator:"
      */
+    // only peek: the device may be sequential (e.g. decompressing)
     char buf[2048];
-    int read = file->read(buf,2047);
+    int read = file->peek(buf,2047);
     if (read < 0)
         return false;
     buf[read] = 0;
@@ -188,7 +566,7 @@ int CachegrindLoader::load(TraceData* d,
    */
     CachegrindLoader l;
 
-    l.setLogger(_logger);
+    l.setLogger(d->logger());
 
     return l.loadInternal(d, file, filename);
 }
@@ -334,6 +712,93 @@ bool CachegrindLoader::parsePosition(FixString& line,
     return true;
 }
 
+/**
+ * Same as parsePosition() for a line tokenized by a worker thread,
+ * additionally taking the event counts of the line into _values.
+ * Return false if the line needs to be parsed by the serial code,
+ * e.g. to report errors. Only on success, currentPos is updated.
+ */
+bool CachegrindLoader::parsePreparsedLine(const CostToken* t, int count)
+{
+    PositionSpec newPos = currentPos;
+
+    if (hasAddrInfo) {
+        if (count == 0) return false;
+
+        if (t->prefix == '*') {
+            newPos.fromAddr = currentPos.fromAddr;
+            newPos.toAddr = currentPos.toAddr;
+        }
+        else if (t->prefix == '+') {
+            newPos.fromAddr = currentPos.fromAddr + (uint) t->value;
+            newPos.toAddr = newPos.fromAddr;
+        }
+        else if (t->prefix == '-') {
+            newPos.fromAddr = currentPos.fromAddr - (uint) t->value;
+            newPos.toAddr = newPos.fromAddr;
+        }
+        else {
+            newPos.fromAddr = Addr(t->value);
+            newPos.toAddr = newPos.fromAddr;
+        }
+
+        if (t->range == '+')
+            newPos.toAddr = newPos.fromAddr + (uint) t->rangeValue;
+        else if (t->range != 0)
+            newPos.toAddr = Addr(t->rangeValue);
+
+        t++;
+        count--;
+    }
+
+    if (hasLineInfo) {
+        if (count == 0) return false;
+
+        if (t->prefix == '*') {
+            newPos.fromLine = currentPos.fromLine;
+            newPos.toLine   = currentPos.toLine;
+        }
+        else if (t->prefix == '+') {
+            newPos.fromLine = currentPos.fromLine + (uint) t->value;
+            newPos.toLine = newPos.fromLine;
+        }
+        else if (t->prefix == '-') {
+            // negative line numbers are reported by serial code
+            if (currentPos.fromLine < (uint) t->value) return false;
+            newPos.fromLine = currentPos.fromLine - (uint) t->value;
+            newPos.toLine = newPos.fromLine;
+        }
+        else {
+            newPos.fromLine = (uint) t->value;
+            newPos.toLine = newPos.fromLine;
+        }
+
+        if (t->range == '+')
+            newPos.toLine = newPos.fromLine + (uint) t->rangeValue;
+        else if (t->range != 0)
+            newPos.toLine = (uint) t->rangeValue;
+
+        t++;
+        count--;
+    }
+
+    // jump lines have no event counts
+    if ((nextLineType == BoringJump) || (nextLineType == CondJump)) {
+        if (count > 0) return false;
+    }
+    else if (!mapping || (count > mapping->count()))
+        return false;
+
+    for(int i=0; i<count; i++) {
+        if (t[i].prefix || t[i].range) return false;
+        _values[i] = t[i].value;
+    }
+    _valueCount = count;
+
+    currentPos = newPos;
+    return true;
+}
+
 // Support for compressed strings
 void CachegrindLoader::clearCompression()
 {
@@ -346,6 +811,10 @@ void CachegrindLoader::clearCompression()
     _objectVector.resize(100);
     _fileVector.resize(1000);
     _functionVector.resize(10000);
+
+    _objectNames.clear();
+    _fileNames.clear();
+    _functionNames.clear();
 }
 
 const QString& CachegrindLoader::checkUnknown(const QString& n)
@@ -354,21 +823,80 @@ const QString& CachegrindLoader::checkUnknown(const QString& n)
     return n;
 }
 
-TraceObject* CachegrindLoader::compressedObject(const QString& name)
+// is <name> in compressed format "(<id>) <name>" or "(<id>)" ?
+static bool isCompressed(FixString& name)
+{
+    const char* s = name.ascii();
+    return (name.len() > 1) && (s[0] == '(') && (s[1] >= '0') && (s[1] <= '9');
+}
+
+// strip "(<id>)" and following white space from a compressed name
+static bool stripCompressedIndex(FixString& name, int& index)
+{
+    char c;
+    uint i;
+
+    name.stripFirst(c);
+    if (!name.stripUInt(i, false) ||
+        !name.stripFirst(c) || (c != ')')) return false;
+    while(name.first(c) && ((c == ' ') || (c == '\t')))
+        name.stripFirst(c);
+
+    index = (int) i;
+    return true;
+}
+
+// Uncompressed names are looked up in hash tables keyed on the raw
+// bytes from the file: a QString only is created for new names
+TraceObject* CachegrindLoader::internedObject(FixString& name)
+{
+    TraceObject* o = (TraceObject*) _objectNames.find(name.ascii(),
+                                                      name.len());
+    if (!o) {
+        o = _data->object(checkUnknown(name));
+        _objectNames.insert(name.ascii(), name.len(), o);
+    }
+    return o;
+}
+
+TraceFile* CachegrindLoader::internedFile(FixString& name)
 {
-    if ((name[0] != '(') || !name[1].isDigit()) return _data->object(checkUnknown(name));
+    TraceFile* f = (TraceFile*) _fileNames.find(name.ascii(), name.len());
+    if (!f) {
+        f = _data->file(checkUnknown(name));
+        _fileNames.insert(name.ascii(), name.len(), f);
+    }
+    return f;
+}
+
+TraceFunction* CachegrindLoader::internedFunction(FixString& name,
+                                                  TraceFile* file,
+                                                  TraceObject* object)
+{
+    TraceFunction* f;
+    f = (TraceFunction*) _functionNames.find(name.ascii(), name.len(),
+                                             file, object);
+    if (!f) {
+        f = _data->function(checkUnknown(name), file, object);
+        if (f)
+            _functionNames.insert(name.ascii(), name.len(), f, file, object);
+    }
+    return f;
+}
+
+TraceObject* CachegrindLoader::compressedObject(FixString& name)
+{
+    if (!isCompressed(name)) return internedObject(name);
 
     // compressed format using _objectVector
-    int p = name.indexOf(')');
-    if (p<2) {
-        error(QStringLiteral("Invalid compressed ELF object ('%1')").arg(name));
+    int index;
+    FixString spec = name;
+    if (!stripCompressedIndex(name, index)) {
+        error(QStringLiteral("Invalid compressed ELF object ('%1')").arg(QString(spec)));
         return 0;
     }
-    int index = name.midRef(1, p-1).toInt();
     TraceObject* o = 0;
-    p++;
-    while((name.length()>p) && name.at(p).isSpace()) p++;
-    if (name.length()>p) {
+    if (!name.isEmpty()) {
         if (_objectVector.size() <= index) {
             int newSize = index * 2;
 #if TRACE_LOADER
@@ -378,14 +906,15 @@ TraceObject* CachegrindLoader::compressedObject(const QString& name)
             _objectVector.resize(newSize);
         }
 
-        QString realName = checkUnknown(name.mid(p));
         o = (TraceObject*) _objectVector.at(index);
-        if (o && (o->name() != realName)) {
-            error(QStringLiteral("Redefinition of compressed ELF object index %1 (was '%2') to %3")
-                  .arg(index).arg(o->name()).arg(realName));
+        if (o) {
+            QString realName = checkUnknown(name);
+            if (o->name() != realName)
+                error(QStringLiteral("Redefinition of compressed ELF object index %1 (was '%2') to %3")
+                      .arg(index).arg(o->name()).arg(realName));
         }
 
-        o = _data->object(realName);
+        o = internedObject(name);
         _objectVector.replace(index, o);
     }
     else {
@@ -402,21 +931,19 @@ TraceObject* CachegrindLoader::compressedObject(const QString& name)
 
 // Note: Callgrind sometimes gives different IDs for same file
 // (when references to same source file come from different ELF objects)
-TraceFile* CachegrindLoader::compressedFile(const QString& name)
+TraceFile* CachegrindLoader::compressedFile(FixString& name)
 {
-    if ((name[0] != '(') || !name[1].isDigit()) return _data->file(checkUnknown(name));
+    if (!isCompressed(name)) return internedFile(name);
 
     // compressed format using _fileVector
-    int p = name.indexOf(')');
-    if (p<2) {
-        error(QStringLiteral("Invalid compressed file ('%1')").arg(name));
+    int index;
+    FixString spec = name;
+    if (!stripCompressedIndex(name, index)) {
+        error(QStringLiteral("Invalid compressed file ('%1')").arg(QString(spec)));
         return 0;
     }
-    int index = name.midRef(1, p-1).toUInt();
     TraceFile* f = 0;
-    p++;
-    while((name.length()>p) && name.at(p).isSpace()) p++;
-    if (name.length()>p) {
+    if (!name.isEmpty()) {
         if (_fileVector.size() <= index) {
             int newSize = index * 2;
 #if TRACE_LOADER
@@ -426,14 +953,15 @@ TraceFile* CachegrindLoader::compressedFile(const QString& name)
             _fileVector.resize(newSize);
         }
 
-        QString realName = checkUnknown(name.mid(p));
         f = (TraceFile*) _fileVector.at(index);
-        if (f && (f->name() != realName)) {
-            error(QStringLiteral("Redefinition of compressed file index %1 (was '%2') to %3")
-                  .arg(index).arg(f->name()).arg(realName));
+        if (f) {
+            QString realName = checkUnknown(name);
+            if (f->name() != realName)
+                error(QStringLiteral("Redefinition of compressed file index %1 (was '%2') to %3")
+                      .arg(index).arg(f->name()).arg(realName));
         }
 
-        f = _data->file(realName);
+        f = internedFile(name);
         _fileVector.replace(index, f);
     }
     else {
@@ -450,26 +978,23 @@ TraceFile* CachegrindLoader::compressedFile(const QString& name)
 // Note: Callgrind gives different IDs even for same function
 // when parts of the function are from different source files.
 // Thus, it is no error when multiple indexes map to same function.
-TraceFunction* CachegrindLoader::compressedFunction(const QString& name,
+TraceFunction* CachegrindLoader::compressedFunction(FixString& name,
                                                     TraceFile* file,
                                                     TraceObject* object)
 {
-    if ((name[0] != '(') || !name[1].isDigit())
-        return _data->function(checkUnknown(name), file, object);
+    if (!isCompressed(name))
+        return internedFunction(name, file, object);
 
     // compressed format using _functionVector
-    int p = name.indexOf(')');
-    if (p<2) {
-        error(QStringLiteral("Invalid compressed function ('%1')").arg(name));
+    int index;
+    FixString spec = name;
+    if (!stripCompressedIndex(name, index)) {
+        error(QStringLiteral("Invalid compressed function ('%1')").arg(QString(spec)));
         return 0;
     }
 
-
-    int index = name.midRef(1, p-1).toUInt();
     TraceFunction* f = 0;
-    p++;
-    while((name.length()>p) && name.at(p).isSpace()) p++;
-    if (name.length()>p) {
+    if (!name.isEmpty()) {
         if (_functionVector.size() <= index) {
             int newSize = index * 2;
 #if TRACE_LOADER
@@ -479,14 +1004,15 @@ TraceFunction* CachegrindLoader::compressedFunction(const QString& name,
             _functionVector.resize(newSize);
         }
 
-        QString realName = checkUnknown(name.mid(p));
         f = (TraceFunction*) _functionVector.at(index);
-        if (f && (f->name() != realName)) {
-            error(QStringLiteral("Redefinition of compressed function index %1 (was '%2') to %3")
-                  .arg(index).arg(f->name()).arg(realName));
+        if (f) {
+            QString realName = checkUnknown(name);
+            if (f->name() != realName)
+                error(QStringLiteral("Redefinition of compressed function index %1 (was '%2') to %3")
+                      .arg(index).arg(f->name()).arg(realName));
         }
 
-        f = _data->function(realName, file, object);
+        f = internedFunction(name, file, object);
         _functionVector.replace(index, f);
 
 #if TRACE_LOADER
@@ -523,7 +1049,7 @@ void CachegrindLoader::ensureObject()
     currentPartObject = currentObject->partObject(_part);
 }
 
-void CachegrindLoader::setObject(const QString& name)
+void CachegrindLoader::setObject(FixString& name)
 {
     currentObject = compressedObject(name);
     if (!currentObject) {
@@ -537,7 +1063,7 @@ void CachegrindLoader::setObject(const QString& name)
     currentPartFunction = 0;
 }
 
-void CachegrindLoader::setCalledObject(const QString& name)
+void CachegrindLoader::setCalledObject(FixString& name)
 {
     currentCalledObject = compressedObject(name);
 
@@ -560,7 +1086,7 @@ void CachegrindLoader::ensureFile()
     currentPartFile = currentFile->partFile(_part);
 }
 
-void CachegrindLoader::setFile(const QString& name)
+void CachegrindLoader::setFile(FixString& name)
 {
     currentFile = compressedFile(name);
 
@@ -575,7 +1101,7 @@ void CachegrindLoader::setFile(const QString& name)
     currentPartLine = 0;
 }
 
-void CachegrindLoader::setCalledFile(const QString& name)
+void CachegrindLoader::setCalledFile(FixString& name)
 {
     currentCalledFile = compressedFile(name);
 
@@ -606,7 +1132,7 @@ void CachegrindLoader::ensureFunction()
                                                         currentPartObject);
 }
 
-void CachegrindLoader::setFunction(const QString& name)
+void CachegrindLoader::setFunction(FixString& name)
 {
     ensureFile();
     ensureObject();
@@ -632,7 +1158,7 @@ void CachegrindLoader::setFunction(const QString& name)
     currentPartLine = 0;
 }
 
-void CachegrindLoader::setCalledFunction(const QString& name)
+void CachegrindLoader::setCalledFunction(FixString& name)
 {
     // if called object/file not set, use current object/file
     if (!currentCalledObject) {
@@ -701,8 +1227,80 @@ void CachegrindLoader::clearPosition()
     mapping = 0;
 }
 
+// records a pre-parsed cost line with the event counts in _values
+void CachegrindLoader::addCostRecord(TracePartFunction* partFunction,
+                                     TracePartCall* partCall,
+                                     const PositionSpec& pos,
+                                     SubCost callCount)
+{
+    if (!_costBatch) {
+        _costBatch = new CostBatch;
+        _costBatch->part = _part;
+        _costBatch->pool = _data->fixPool();
+        _costBatch->records.reserve(COST_BATCH_SIZE);
+    }
+
+    CostRecord r;
+    r.source = currentFunctionSource;
+    r.partFunction = partFunction;
+    r.partCall = partCall;
+    r.pos = pos;
+    r.callCount = callCount;
+    r.firstValue = _costBatch->values.size();
+    r.count = _valueCount;
+    _costBatch->records.append(r);
+    for(int i=0; i<_valueCount; i++)
+        _costBatch->values.append(_values[i]);
+}
+
+void CachegrindLoader::submitCostBatch()
+{
+    if (!_costBatch) return;
+
+    _costBatches.append(_costBatch);
+    QThreadPool::globalInstance()->start(new CostBatchBuilder(_costBatch));
+    _costBatch = 0;
+}
+
+// waits for the oldest batch and links its cost items into the model
+void CachegrindLoader::mergeCostBatch()
+{
+    CostBatch* b = _costBatches.takeFirst();
+    b->built.acquire();
+
+    QHash<TracePartFunction*, CostList<FixCost> >::const_iterator it;
+    for(it = b->costs.constBegin(); it != b->costs.constEnd(); ++it) {
+        const CostList<FixCost>& l = it.value();
+        l.last->setNextCostOfPartFunction(it.key()->setFirstFixCost(l.first));
+    }
+
+    QHash<TracePartCall*, CostList<FixCallCost> >::const_iterator cit;
+    for(cit = b->callCosts.constBegin(); cit != b->callCosts.constEnd(); ++cit) {
+        const CostList<FixCallCost>& l = cit.value();
+        l.last->setNextCostOfPartCall(cit.key()->setFirstFixCallCost(l.first));
+    }
+
+    for(int i=0; i<b->callMax.size(); i++)
+        _data->callMax()->maxCost(i, b->callMax[i]);
+    _data->updateMaxCallCount(b->maxCallCount);
+
+    delete b;
+}
+
+// submits the current batch, and merges all but <keep> batches
+void CachegrindLoader::mergeCostBatches(int keep)
+{
+    if (keep == 0) submitCostBatch();
+
+    while(_costBatches.count() > keep)
+        mergeCostBatch();
+}
+
 void CachegrindLoader::prepareNewPart()
 {
+    // cost items of the current part have to be in the model
+    mergeCostBatches();
+
     if (_part) {
         // really new part needed?
         if (mapping == 0) return;
@@ -743,17 +1341,39 @@ int CachegrindLoader::loadInternal(TraceData* data,
     }
 
     int statusProgress = 0;
+    // size of decompressed data is unknown: use the compressed bytes read
+    DecompressDevice* compressed = dynamic_cast<DecompressDevice*>(device);
 
 #if USE_FIXCOST
     // FixCost Memory Pool
     FixPool* pool = _data->fixPool();
+#if TRACE_LOADER
+    // to report the effect of compact encoding of event counts
+    unsigned long long rawSize = pool->rawSize();
+    unsigned long long encodedSize = pool->encodedSize();
+#endif
 #endif
 
     _part = 0;
     partsAdded = 0;
     prepareNewPart();
 
+    _parallel = false;
+#if USE_FIXCOST
+    // only worth it for big files
+    _parallel = GlobalConfig::parallelLoading() &&
+                !file.isStreaming() &&
+                (QThread::idealThreadCount() > 1) &&
+                (file.len() > (uint64) 2 * LOADER_CHUNK_SIZE);
+#endif
+    LoaderLineSource lines(file, _parallel);
+    // keep all threads busy, but limit memory for recorded cost lines
+    int batchWindow = 2 * QThreadPool::globalInstance()->maxThreadCount();
+
     FixString line;
+    const CostToken* tokens = 0;
+    int tokenCount;
+    bool preParsed = false;
     char c;
 
     // current position
@@ -762,10 +1382,17 @@ int CachegrindLoader::loadInternal(TraceData* data,
     hasLineInfo = true;
     hasAddrInfo = false;
 
-    while (file.nextLine(line)) {
+    bool canceled = false;
+    while (lines.nextLine(line, tokens, tokenCount)) {
 
         _lineNo++;
 
+        // check regularly whether loading should be stopped
+        if (((_lineNo & 0xFFF) == 0) && loadCanceled()) {
+            canceled = true;
+            break;
+        }
+
 #if TRACE_LOADER
         qDebug() << "[CachegrindLoader] " << _filename << ":" << _lineNo
                  << " - '" << QString(line) << "'";
@@ -779,7 +1406,13 @@ int CachegrindLoader::loadInternal(TraceData* data,
             if (c == '#') continue;
 
             // parse position(s)
-            if (!parsePosition(line, currentPos)) {
+            preParsed = (tokenCount >= 0) &&
+                        parsePreparsedLine(tokens, tokenCount);
+            if (preParsed) {
+                // everything is consumed
+                line = FixString();
+            }
+            else if (!parsePosition(line, currentPos)) {
                 error(QStringLiteral("Invalid position specification '%1'").arg(line));
                 continue;
             }
@@ -815,12 +1448,26 @@ int CachegrindLoader::loadInternal(TraceData* data,
                 // fn=
                 if (line.stripPrefix("n=")) {
 
+                    // batches are cut between functions
+                    if (_costBatch &&
+                        (_costBatch->records.size() >= COST_BATCH_SIZE)) {
+                        submitCostBatch();
+                        mergeCostBatches(batchWindow);
+                    }
+
                     if (currentFile != currentFunctionFile)
                         currentFile = currentFunctionFile;
                     setFunction(line);
 
                     // on a new function, update status
-                    int progress = (int)(100.0 * file.current() / file.len() +.5);
+                    // size is unknown for some streams
+                    int progress = 0;
+                    if (file.len() > 0)
+                        progress = (int)(100.0 * lines.current() / file.len() +.5);
+                    else if (compressed && (compressed->compressedSize() > 0))
+                        progress = (int)(100.0 * compressed->compressedPos() /
+                                         compressed->compressedSize() +.5);
+                    if (progress > 100) progress = 100;
                     if (progress != statusProgress) {
                         statusProgress = progress;
 
@@ -1032,6 +1679,10 @@ int CachegrindLoader::loadInternal(TraceData* data,
                     // add to known cost types
                     if (line.isEmpty()) line = e;
                     EventType::add(new EventType(e,line,f));
+
+                    // restored on loading from the profile cache
+                    TracePart::EventDefinition def = { e, line, f };
+                    _part->addEventDefinition(def);
                     continue;
                 }
                 break;
@@ -1174,11 +1825,20 @@ int CachegrindLoader::loadInternal(TraceData* data,
         if (nextLineType == SelfCost) {
 
 #if USE_FIXCOST
-            new (pool) FixCost(_part, pool,
-                               currentFunctionSource,
-                               currentPos,
-                               currentPartFunction,
-                               line);
+            if (preParsed && _parallel)
+                addCostRecord(currentPartFunction, 0, currentPos, 0);
+            else if (preParsed)
+                new (pool) FixCost(_part, pool,
+                                   currentFunctionSource,
+                                   currentPos,
+                                   currentPartFunction,
+                                   _values, _valueCount);
+            else
+                new (pool) FixCost(_part, pool,
+                                   currentFunctionSource,
+                                   currentPos,
+                                   currentPartFunction,
+                                   line);
 #else
             if (hasAddrInfo) {
                 TracePartInstr* partInstr;
@@ -1216,15 +1876,31 @@ int CachegrindLoader::loadInternal(TraceData* data,
                                       currentCalledPartFunction);
 
 #if USE_FIXCOST
-            FixCallCost* fcc;
-            fcc = new (pool) FixCallCost(_part, pool,
-                                         currentFunctionSource,
-                                         hasLineInfo ? currentPos.fromLine : 0,
-                                         hasAddrInfo ? currentPos.fromAddr : Addr(0),
-                                         partCalling,
-                                         currentCallCount, line);
-            fcc->setMax(_data->callMax());
-            _data->updateMaxCallCount(fcc->callCount());
+            FixCallCost* fcc = 0;
+            if (preParsed && _parallel) {
+                PositionSpec pos(hasLineInfo ? currentPos.fromLine : 0, 0,
+                                 hasAddrInfo ? currentPos.fromAddr : Addr(0), Addr(0));
+                addCostRecord(0, partCalling, pos, currentCallCount);
+            }
+            else if (preParsed)
+                fcc = new (pool) FixCallCost(_part, pool,
+                                             currentFunctionSource,
+                                             hasLineInfo ? currentPos.fromLine : 0,
+                                             hasAddrInfo ? currentPos.fromAddr : Addr(0),
+                                             partCalling,
+                                             currentCallCount,
+                                             _values, _valueCount);
+            else
+                fcc = new (pool) FixCallCost(_part, pool,
+                                             currentFunctionSource,
+                                             hasLineInfo ? currentPos.fromLine : 0,
+                                             hasAddrInfo ? currentPos.fromAddr : Addr(0),
+                                             partCalling,
+                                             currentCallCount, line);
+            if (fcc) {
+                fcc->setMax(_data->callMax());
+                _data->updateMaxCallCount(fcc->callCount());
+            }
 #else
             if (hasAddrInfo) {
                 TraceInstrCall* instrCall;
@@ -1357,6 +2033,26 @@ int CachegrindLoader::loadInternal(TraceData* data,
         }
     }
 
+    // workers may still create cost items
+    mergeCostBatches();
+
+    if (canceled) {
+        // cost items already refer to the part: it gets deleted with <data>
+        data->addPart(_part);
+        loadFinished(QStringLiteral("Canceled"));
+        device->close();
+        return 0;
+    }
+
+#if USE_FIXCOST && TRACE_LOADER
+    rawSize = pool->rawSize() - rawSize;
+    encodedSize = pool->encodedSize() - encodedSize;
+    if (rawSize > 0)
+        qDebug("Event counts of %s take %llu KB instead of %llu KB (%.1f%%)",
+               qPrintable(_filename), encodedSize / 1024, rawSize / 1024,
+               100.0 * encodedSize / rawSize);
+#endif
+
     loadFinished();
 
     if (mapping) {
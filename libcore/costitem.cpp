@@ -21,6 +21,7 @@
 #include <QObject>
 
 #include "tracedata.h"
+#include "pool.h"
 
 #include <QObject>
 
@@ -102,6 +103,9 @@ void CostItem::update()
     _dirty = false;
 }
 
+// items of different profile data may be updated in different threads
+QAtomicInt CostItem::_updateCount;
+
 TracePart* CostItem::part()
 {
     return _position ? _position->part() : 0;
@@ -138,6 +142,7 @@ ProfileCostArray::ProfileCostArray(ProfileContext* context)
     _allocCount = 0;
     _count = 0;
     _cost = 0;
+    _pool = 0;
 }
 
 ProfileCostArray::ProfileCostArray()
@@ -147,11 +152,15 @@ ProfileCostArray::ProfileCostArray()
     _allocCount = 0;
     _count = 0;
     _cost = 0;
+    _pool = 0;
 }
 
 ProfileCostArray::~ProfileCostArray()
 {
-    if (_cost) delete[] _cost;
+    if (_pool)
+        _pool->release(_cost, _allocCount);
+    else
+        delete[] _cost;
 }
 
 
@@ -165,15 +174,32 @@ void ProfileCostArray::reserve(int count)
 {
     if (count <= _allocCount) return;
 
-    SubCost* newcost = new SubCost[count];
+    /* items of profile data take their cost array from the pool of
+     * the data, avoiding millions of small heap allocations */
+    CostPool* pool = _pool;
+    if (!pool) {
+        TraceData* d = data();
+        pool = d ? d->costPool() : 0;
+    }
+
+    SubCost* newcost;
+    if (pool)
+        newcost = (SubCost*) pool->allocate(count);
+    else
+        newcost = new SubCost[count];
+
     if (_cost) {
         /* first _count values are valid and have to be preserved */
         for(int i=0; i<_count; i++)
             newcost[i] = _cost[i];
-        delete[] _cost;
+        if (_pool)
+            _pool->release(_cost, _allocCount);
+        else
+            delete[] _cost;
     }
     _cost = newcost;
     _allocCount = count;
+    _pool = pool;
 }
 
 void ProfileCostArray::set(EventTypeMapping* mapping, const char* s)
@@ -226,22 +252,20 @@ void ProfileCostArray::set(EventTypeMapping* mapping, FixString & s)
 
     reserve(mapping->set()->realCount());
 
+    uint64 v[MaxRealIndexValue];
+    int n = s.stripUInt64s(v, mapping->count());
+
     if (mapping->isIdentity()) {
-        int i = 0;
-        while(i<mapping->count()) {
-            if (!s.stripUInt64(_cost[i])) break;
-            i++;
-        }
-        _count = i;
+        for(int i=0; i<n; i++)
+            _cost[i] = v[i];
+        _count = n;
     }
     else {
-        int i = 0, maxIndex = 0, index;
-        while(1) {
+        int i, maxIndex = 0, index;
+        for(i=0; i<n; i++) {
             index = mapping->realIndex(i);
             if (maxIndex<index) maxIndex=index;
-            if (index == ProfileCostArray::InvalidIndex) break;
-            if (!s.stripUInt64(_cost[index])) break;
-            i++;
+            _cost[index] = v[i];
         }
         // we have to set all costs of unused indexes till maxIndex to zero
         for(i=mapping->firstUnused(); i<=maxIndex; i=mapping->nextUnused(i))
@@ -311,31 +335,27 @@ void ProfileCostArray::addCost(EventTypeMapping* mapping, FixString & s)
     if (s.isEmpty()) return;
     reserve(mapping->set()->realCount());
 
-    SubCost v;
+    // parse all columns of the cost line in one go
+    uint64 v[MaxRealIndexValue];
+    int n = s.stripUInt64s(v, mapping->count());
+
     if (mapping->isIdentity()) {
-        int i = 0;
-        while(i<mapping->count()) {
-            if (!s.stripUInt64(v)) break;
-            if (i<_count)
-                _cost[i] += v;
-            else
-                _cost[i] = v;
-            i++;
-        }
-        if (i > _count) _count = i;
+        int i;
+        for(i=0; (i<n) && (i<_count); i++)
+            _cost[i] += v[i];
+        for(; i<n; i++)
+            _cost[i] = v[i];
+        if (n > _count) _count = n;
     }
     else {
-        int i = 0, maxIndex = 0, index;
-        while(1) {
-            if (!s.stripUInt64(v)) break;
+        int i, maxIndex = 0, index;
+        for(i=0; i<n; i++) {
             index = mapping->realIndex(i);
             if (maxIndex<index) maxIndex=index;
-            if (index == ProfileCostArray::InvalidIndex) break;
             if (index<_count)
-                _cost[index] += v;
+                _cost[index] += v[i];
             else
-                _cost[index] = v;
-            i++;
+                _cost[index] = v[i];
         }
         if (maxIndex >= _count) {
             /* we have to set all costs of unused indexes in the interval
@@ -451,6 +471,29 @@ void ProfileCostArray::addCost(ProfileCostArray* item)
 #endif
 }
 
+void ProfileCostArray::addCostDelta(ProfileCostArray* item, bool add)
+{
+    int i;
+    if (!item) return;
+
+    if (item->_dirty) item->update();
+
+    if (add) {
+        reserve(item->_count);
+        for (i = 0; (i<item->_count) && (i<_count); ++i)
+            _cost[i] += item->_cost[i];
+        for (; i<item->_count; ++i)
+            _cost[i] = item->_cost[i];
+        if (item->_count > _count) _count = item->_count;
+        return;
+    }
+
+    // the item was added before, so it has no more counters than we have
+    int count = (item->_count < _count) ? item->_count : _count;
+    for (i = 0; i<count; ++i)
+        _cost[i] -= item->_cost[i];
+}
+
 void ProfileCostArray::maxCost(ProfileCostArray* item)
 {
     int i;
@@ -19,6 +19,7 @@
 #ifndef COST_H
 #define COST_H
 
+#include <QAtomicInt>
 #include <QString>
 
 #include "subcost.h"
@@ -30,6 +31,7 @@ class EventTypeSet;
 class EventTypeMapping;
 class TracePart;
 class TraceData;
+class CostPool;
 
 /**
  * Base class for cost items.
@@ -96,6 +98,14 @@ public:
 
     CostItem* dependant() { return _dep; }
 
+    /**
+     * Number of cost recalculations done so far by all items.
+     * The difference of values taken before and after requesting costs
+     * is the number of items which had to be recalculated, e.g. after
+     * a change of active parts.
+     */
+    static int updateCount() { return _updateCount.load(); }
+
     /**
      * If this item is from a single profile data file, position
      * points to a TracePart, otherwise to a TraceData object.
@@ -120,11 +130,17 @@ protected:
      */
     virtual void update();
 
+    // to be called by update() when recalculating cost attributes
+    static void countUpdate() { _updateCount.ref(); }
+
     ProfileContext* _context;
     bool _dirty;
 
     CostItem* _position;
     CostItem* _dep;
+
+private:
+    static QAtomicInt _updateCount;
 };
 
 
@@ -161,6 +177,8 @@ public:
 
     // reserve space for cost
     void reserve(int);
+    // bytes of the allocated cost array
+    quint64 costBytes() const { return _allocCount * sizeof(SubCost); }
 
     // set costs according to the mapping order of event types
     void set(EventTypeMapping*, const char*);
@@ -171,6 +189,11 @@ public:
     // add the cost of another item
     void addCost(ProfileCostArray* item);
     void addCost(int index, SubCost value);
+    /* add the cost of another item, or subtract it if it was added
+     * before. Unlike addCost(), this does not invalidate: it keeps an
+     * already calculated cost up to date, and the caller has to update
+     * items depending on this one */
+    void addCostDelta(ProfileCostArray* item, bool add);
 
     // maximal cost
     void maxCost(EventTypeMapping*, FixString&);
@@ -200,8 +223,10 @@ private:
     SubCost subCost(int);
 
     SubCost* _cost;
-    int _count; // only _count first indexes of _cost are used
-    int _allocCount; // number of allocated subcost entries
+    // at most MaxRealIndex entries: small types keep the object size
+    short _count; // only _count first indexes of _cost are used
+    short _allocCount; // number of allocated subcost entries
+    CostPool* _pool; // pool _cost is taken from, or 0 if from the heap
 
     // cache last virtual subcost for faster access
     SubCost _cachedCost;
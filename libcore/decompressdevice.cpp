@@ -0,0 +1,183 @@
+/* This file is part of KCachegrind.
+   Copyright (c) 2026 The KCachegrind developers
+
+   KCachegrind is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation, version 2.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+/*
+ * Sequential device decompressing a file with an external tool
+ */
+
+#include "decompressdevice.h"
+
+#include <QFile>
+#include <QDebug>
+
+#ifdef Q_OS_UNIX
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+/* Pipe with both ends closed on exec: with multiple loads at once, the
+ * decompressor of another load must not inherit the write end, as the
+ * reader would not see EOF before that process terminated, too.
+ */
+static bool closeOnExecPipe(int fds[2])
+{
+#ifdef Q_OS_LINUX
+    return pipe2(fds, O_CLOEXEC) == 0;
+#else
+    if (pipe(fds) < 0) return false;
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+    return true;
+#endif
+}
+#endif
+
+
+DecompressDevice::DecompressDevice(const QString& filename)
+{
+    _filename = filename;
+    _fd = -1;
+    _inFd = -1;
+    _compressedSize = 0;
+    _pid = 0;
+}
+
+DecompressDevice::~DecompressDevice()
+{
+    close();
+}
+
+QString DecompressDevice::decompressor(const QString& filename)
+{
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly)) return QString();
+
+    QByteArray magic = file.read(6);
+    if (magic.startsWith("\x1f\x8b"))
+        return QStringLiteral("gzip");
+    if (magic.startsWith("BZh"))
+        return QStringLiteral("bzip2");
+    if (magic == QByteArray("\xfd" "7zXZ\0", 6))
+        return QStringLiteral("xz");
+
+    return QString();
+}
+
+bool DecompressDevice::open(OpenMode mode)
+{
+    if (isOpen() || (mode & WriteOnly)) return false;
+
+#ifdef Q_OS_UNIX
+    QString cmd = decompressor(_filename);
+    if (cmd.isEmpty()) return false;
+
+    QByteArray c = QFile::encodeName(cmd);
+    QByteArray f = QFile::encodeName(_filename);
+
+    /* the tool reads the compressed file from standard input: the file
+     * offset is shared with our descriptor, giving the progress
+     */
+    int in = ::open(f.constData(), O_RDONLY | O_CLOEXEC);
+    if (in < 0) return false;
+    struct stat st;
+    _compressedSize = (fstat(in, &st) == 0) ? st.st_size : 0;
+
+    int fds[2];
+    if (!closeOnExecPipe(fds)) {
+        ::close(in);
+        return false;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        ::close(in);
+        ::close(fds[0]);
+        ::close(fds[1]);
+        return false;
+    }
+    if (pid == 0) {
+        // child: decompress to pipe. Duplicates are kept on exec
+        dup2(in, 0);
+        dup2(fds[1], 1);
+        execlp(c.constData(), c.constData(), "-dc", (char*)0);
+        _exit(127);
+    }
+
+    ::close(fds[1]);
+    _fd = fds[0];
+    _inFd = in;
+    _pid = pid;
+
+    return QIODevice::open(mode);
+#else
+    Q_UNUSED(mode);
+    return false;
+#endif
+}
+
+void DecompressDevice::close()
+{
+    if (!isOpen()) return;
+
+    QIODevice::close();
+
+#ifdef Q_OS_UNIX
+    ::close(_fd);
+    _fd = -1;
+    ::close(_inFd);
+    _inFd = -1;
+
+    // decompressor gets SIGPIPE if not finished
+    int status;
+    if (waitpid((pid_t)_pid, &status, 0) == (pid_t)_pid) {
+        if (WIFEXITED(status) && (WEXITSTATUS(status) == 127))
+            qWarning() << "Could not run decompressor for" << _filename;
+    }
+    _pid = 0;
+#endif
+}
+
+qint64 DecompressDevice::compressedPos() const
+{
+#ifdef Q_OS_UNIX
+    if (_inFd < 0) return 0;
+    off_t pos = lseek(_inFd, 0, SEEK_CUR);
+    return (pos < 0) ? 0 : pos;
+#else
+    return 0;
+#endif
+}
+
+qint64 DecompressDevice::readData(char* data, qint64 maxSize)
+{
+#ifdef Q_OS_UNIX
+    while(1) {
+        ssize_t r = ::read(_fd, data, maxSize);
+        if ((r < 0) && (errno == EINTR)) continue;
+        return r;
+    }
+#else
+    Q_UNUSED(data);
+    Q_UNUSED(maxSize);
+    return -1;
+#endif
+}
@@ -0,0 +1,73 @@
+/* This file is part of KCachegrind.
+   Copyright (c) 2026 The KCachegrind developers
+
+   KCachegrind is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation, version 2.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+/*
+ * Sequential device decompressing a file with an external tool
+ */
+
+#ifndef DECOMPRESSDEVICE_H
+#define DECOMPRESSDEVICE_H
+
+#include <QIODevice>
+#include <QString>
+
+/**
+ * A read-only, sequential device delivering the decompressed content
+ * of a gzip, bzip2 or xz compressed file. Decompression is done by
+ * the respective command line tool running as separate process,
+ * connected via a pipe. Thus, decompression runs in parallel to
+ * parsing, and data never needs to be fully held in memory.
+ * The size of the decompressed data is not known in advance; for
+ * progress, the compressed bytes consumed by the tool are available.
+ *
+ * Only available on UNIX; elsewhere, open() fails.
+ */
+class DecompressDevice: public QIODevice
+{
+public:
+    explicit DecompressDevice(const QString& filename);
+    virtual ~DecompressDevice();
+
+    /**
+     * Returns the decompression command for <filename> according to
+     * its magic bytes, or an empty string if it is not compressed.
+     */
+    static QString decompressor(const QString& filename);
+
+    bool open(OpenMode mode) Q_DECL_OVERRIDE;
+    void close() Q_DECL_OVERRIDE;
+    bool isSequential() const Q_DECL_OVERRIDE { return true; }
+
+    // size of the compressed file, and bytes of it read by the tool
+    qint64 compressedSize() const { return _compressedSize; }
+    qint64 compressedPos() const;
+
+protected:
+    qint64 readData(char* data, qint64 maxSize) Q_DECL_OVERRIDE;
+    qint64 writeData(const char*, qint64) Q_DECL_OVERRIDE { return -1; }
+
+private:
+    QString _filename;
+    int _fd;
+    // compressed file, shared with the tool as its standard input
+    int _inFd;
+    qint64 _compressedSize;
+    qint64 _pid;
+};
+
+#endif // DECOMPRESSDEVICE_H
@@ -0,0 +1,307 @@
+/* This file is part of KCachegrind.
+   Copyright (c) 2026 The KCachegrind developers
+
+   KCachegrind is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation, version 2.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+/*
+ * Metadata of profile data files without loading them
+ */
+
+#include "dumpinfo.h"
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QSet>
+#include <QStandardPaths>
+#include <QDebug>
+
+#include "decompressdevice.h"
+#include "utils.h"
+
+#define TRACE_INDEX 0
+
+// header lines read at most, e.g. for many "desc:" lines
+#define SCAN_MAXHEADERLINES 1000
+// end of file searched for "summary:"/"totals:"
+#define SCAN_TAILSIZE 65536
+
+#define INDEX_MAGIC   0x4b434749 // "KCGI"
+#define INDEX_VERSION 1
+
+
+//
+// DumpInfo
+//
+
+DumpInfo::DumpInfo()
+{
+    _valid = false;
+    _size = 0;
+    _modified = 0;
+    _pid = 0;
+    _tid = 0;
+    _part = 0;
+}
+
+// does <line> belong to the data section of a profile data file?
+static bool isDataLine(FixString line)
+{
+    char c;
+    if (!line.first(c)) return false;
+    if ((c >= '0' && c <= '9') || c == '+' || c == '-' || c == '*')
+        return true;
+
+    // header lines are "<key>: <value>", data lines "<key>=<value>"
+    const char* s = line.ascii();
+    for(int i=0; i<line.len(); i++) {
+        if (s[i] == ':') return false;
+        if (s[i] == '=') return true;
+    }
+    return false;
+}
+
+static QVector<quint64> totalsFrom(FixString line)
+{
+    QVector<quint64> totals;
+    uint64 v;
+    line.stripSpaces();
+    while(line.stripUInt64(v))
+        totals.append(v);
+    return totals;
+}
+
+bool DumpInfo::scan(const QString& filename)
+{
+    *this = DumpInfo();
+
+    QFileInfo fi(filename);
+    _filename = filename;
+    _size = fi.size();
+    _modified = fi.lastModified().toMSecsSinceEpoch();
+
+    // compressed files are decompressed while reading
+    QIODevice* device;
+    if (DecompressDevice::decompressor(filename).isEmpty())
+        device = new QFile(filename);
+    else
+        device = new DecompressDevice(filename);
+
+    {
+        FixFile file(device, filename);
+        if (!file.exists()) {
+            delete device;
+            return false;
+        }
+
+        FixString line;
+        for(int lines = 0; lines < SCAN_MAXHEADERLINES; lines++) {
+            if (!file.nextLine(line)) break;
+            if (isDataLine(line)) break;
+
+            if (line.stripPrefix("cmd:")) {
+                line.stripSpaces();
+                _command = QString(line).trimmed();
+            }
+            else if (line.stripPrefix("creator:")) {
+                line.stripSpaces();
+                _creator = QString(line).trimmed();
+            }
+            else if (line.stripPrefix("pid:"))
+                _pid = QString(line).toInt();
+            else if (line.stripPrefix("thread:"))
+                _tid = QString(line).toInt();
+            else if (line.stripPrefix("part:"))
+                _part = QString(line).toInt();
+            else if (line.stripPrefix("desc:")) {
+                line.stripSurroundingSpaces();
+                if (line.stripPrefix("Trigger:")) {
+                    line.stripSurroundingSpaces();
+                    _trigger = line;
+                }
+            }
+            else if (line.stripPrefix("events:"))
+                _events = QString(line).simplified().split(QLatin1Char(' '),
+                                                           QString::SkipEmptyParts);
+            else if (line.stripPrefix("summary:") ||
+                     line.stripPrefix("totals:"))
+                _totals = totalsFrom(line);
+        }
+
+        // cachegrind/callgrind files always specify events
+        _valid = !_events.isEmpty();
+
+        // the last "summary:" or "totals:" line has the totals of the
+        // last part. With a memory mapping, jump directly to the end.
+        if (_valid && !file.isStreaming()) {
+            uint64 tail = file.len() > SCAN_TAILSIZE ?
+                              file.len() - SCAN_TAILSIZE : 0;
+            if (tail > file.current()) {
+                file.setCurrent(tail);
+                // skip partial line
+                file.nextLine(line);
+            }
+            while(file.nextLine(line)) {
+                if (line.stripPrefix("summary:") ||
+                    line.stripPrefix("totals:"))
+                    _totals = totalsFrom(line);
+            }
+        }
+    }
+    delete device;
+
+    if (TRACE_INDEX)
+        qDebug() << "DumpInfo: scanned" << filename << "valid" << _valid;
+
+    return _valid;
+}
+
+QDataStream& operator<<(QDataStream& s, const DumpInfo& i)
+{
+    s << i._valid << i._filename << i._size << i._modified
+      << i._command << i._creator << i._trigger
+      << (qint32) i._pid << (qint32) i._tid << (qint32) i._part
+      << i._events << i._totals;
+    return s;
+}
+
+QDataStream& operator>>(QDataStream& s, DumpInfo& i)
+{
+    qint32 pid, tid, part;
+    s >> i._valid >> i._filename >> i._size >> i._modified
+      >> i._command >> i._creator >> i._trigger
+      >> pid >> tid >> part
+      >> i._events >> i._totals;
+    i._pid = pid;
+    i._tid = tid;
+    i._part = part;
+    return s;
+}
+
+
+//
+// DumpIndex
+//
+
+DumpIndex::DumpIndex(const QString& dir)
+{
+    _dir = QDir(dir).absolutePath();
+    _read = false;
+    _changed = false;
+}
+
+static QString userIndexFile(const QString& dir)
+{
+    QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    if (cacheDir.isEmpty()) return QString();
+
+    QString name = dir;
+    name.replace(QLatin1Char('/'), QLatin1Char('_'));
+    return cacheDir + QStringLiteral("/index/") + name + QStringLiteral(".kcgindex");
+}
+
+DumpInfoList DumpIndex::dumps(const QString& prefix)
+{
+    if (!_read) read();
+
+    QStringList names = QDir(_dir).entryList(QStringList() << prefix + "*",
+                                             QDir::Files, QDir::Name);
+    DumpInfoList res;
+    foreach(const QString& name, names) {
+        QFileInfo fi(_dir + QLatin1Char('/') + name);
+
+        QHash<QString, DumpInfo>::ConstIterator it = _entries.constFind(name);
+        if ((it != _entries.constEnd()) &&
+            ((*it).size() == fi.size()) &&
+            ((*it).modified() == fi.lastModified().toMSecsSinceEpoch())) {
+            if ((*it).isValid()) res.append(*it);
+            continue;
+        }
+
+        // new or changed file. Also keep files which are no profile
+        // data, to not scan them again
+        DumpInfo info;
+        info.scan(fi.filePath());
+        _entries.insert(name, info);
+        _changed = true;
+        if (info.isValid()) res.append(info);
+    }
+
+    // forget entries of deleted files
+    QSet<QString> existing = names.toSet();
+    QHash<QString, DumpInfo>::Iterator it = _entries.begin();
+    while(it != _entries.end()) {
+        if (it.key().startsWith(prefix) && !existing.contains(it.key())) {
+            it = _entries.erase(it);
+            _changed = true;
+        }
+        else
+            ++it;
+    }
+
+    if (_changed && write())
+        _changed = false;
+
+    return res;
+}
+
+void DumpIndex::read()
+{
+    _read = true;
+    _entries.clear();
+
+    QString name = userIndexFile(_dir);
+    if (name.isEmpty()) return;
+
+    QFile file(name);
+    if (!file.open(QIODevice::ReadOnly)) return;
+
+    QDataStream s(&file);
+    s.setVersion(QDataStream::Qt_5_2);
+    quint32 magic, version;
+    s >> magic >> version;
+    if ((magic != INDEX_MAGIC) || (version != INDEX_VERSION)) return;
+
+    QHash<QString, DumpInfo> entries;
+    s >> entries;
+    if (s.status() != QDataStream::Ok) return;
+
+    _entries = entries;
+    if (TRACE_INDEX)
+        qDebug() << "DumpIndex: read" << entries.count()
+                 << "entries from" << name;
+}
+
+bool DumpIndex::write()
+{
+    QString name = userIndexFile(_dir);
+    if (name.isEmpty()) return false;
+    QDir().mkpath(QFileInfo(name).absolutePath());
+    QSaveFile file(name);
+    if (!file.open(QIODevice::WriteOnly)) return false;
+
+    QDataStream s(&file);
+    s.setVersion(QDataStream::Qt_5_2);
+    s << (quint32) INDEX_MAGIC << (quint32) INDEX_VERSION << _entries;
+    if (s.status() != QDataStream::Ok) {
+        file.cancelWriting();
+        return false;
+    }
+    return file.commit();
+}
@@ -0,0 +1,114 @@
+/* This file is part of KCachegrind.
+   Copyright (c) 2026 The KCachegrind developers
+
+   KCachegrind is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation, version 2.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+/*
+ * Metadata of profile data files without loading them
+ */
+
+#ifndef DUMPINFO_H
+#define DUMPINFO_H
+
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+class QDataStream;
+
+/**
+ * Metadata of a profile data file: the attributes from its header and
+ * the totals from the "summary:" or "totals:" line at its end.
+ *
+ * scan() only reads the beginning of a file and, from the memory
+ * mapping, the last lines. This is much faster than loading. For files
+ * with multiple parts, the header of the first part and the totals of
+ * the last part are used. For compressed files, totals are unknown.
+ */
+class DumpInfo
+{
+public:
+    DumpInfo();
+
+    // read metadata of <filename>, false if it is no profile data file
+    bool scan(const QString& filename);
+
+    bool isValid() const { return _valid; }
+    QString filename() const { return _filename; }
+    qint64 size() const { return _size; }
+    // modification time in ms since epoch
+    qint64 modified() const { return _modified; }
+
+    QString command() const { return _command; }
+    QString creator() const { return _creator; }
+    QString trigger() const { return _trigger; }
+    int processID() const { return _pid; }
+    int threadID() const { return _tid; }
+    int partNumber() const { return _part; }
+    QStringList events() const { return _events; }
+    // one value per event, empty if unknown
+    QVector<quint64> totals() const { return _totals; }
+
+private:
+    friend QDataStream& operator<<(QDataStream&, const DumpInfo&);
+    friend QDataStream& operator>>(QDataStream&, DumpInfo&);
+
+    bool _valid;
+    QString _filename;
+    qint64 _size, _modified;
+    QString _command, _creator, _trigger;
+    int _pid, _tid, _part;
+    QStringList _events;
+    QVector<quint64> _totals;
+};
+
+typedef QList<DumpInfo> DumpInfoList;
+
+
+/**
+ * Metadata of the profile data files in a directory.
+ *
+ * Results of DumpInfo::scan() are kept in an index file, which is
+ * stored in the user cache directory, never in the directory of the
+ * profile data files. An entry is reused as long
+ * as size and modification time of its file are the same, so listing
+ * thousands of profile data files only needs a directory listing.
+ */
+class DumpIndex
+{
+public:
+    explicit DumpIndex(const QString& dir);
+
+    QString directory() const { return _dir; }
+
+    /* metadata of profile data files whose name starts with <prefix>,
+     * sorted by name. The index file is updated if needed.
+     */
+    DumpInfoList dumps(const QString& prefix = QStringLiteral("callgrind.out"));
+
+private:
+    void read();
+    bool write();
+
+    QString _dir;
+    bool _read, _changed;
+    // file name without path => metadata
+    QHash<QString, DumpInfo> _entries;
+};
+
+#endif // DUMPINFO_H
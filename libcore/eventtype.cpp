@@ -20,6 +20,7 @@
 
 #include <QRegExp>
 #include <QDebug>
+#include <QMutex>
 
 #include "globalconfig.h"
 
@@ -28,6 +29,9 @@
 
 QList<EventType*>* EventType::_knownTypes = 0;
 
+// profile data files may be loaded concurrently, adding event types
+static QMutex knownTypesMutex;
+
 EventType::EventType(const QString& name, const QString& longName,
                      const QString& formula)
 {
@@ -42,6 +46,7 @@ EventType::EventType(const QString& name, const QString& longName,
 
     for (int i=0; i<ProfileCostArray::MaxRealIndex;i++)
         _coefficient[i] = 0;
+    _termCount = 0;
 }
 
 void EventType::setFormula(const QString& formula)
@@ -147,16 +152,30 @@ bool EventType::parseFormula()
     if (found == 0) {
         // empty formula
         _parsedFormula = QStringLiteral("0");
+        compileFormula();
         _parsed = true;
         return true;
     }
     if (matching>0) {
+        compileFormula();
         _parsed = true;
         return true;
     }
     return false;
 }
 
+void EventType::compileFormula()
+{
+    _termCount = 0;
+    for (int i=0; i<ProfileCostArray::MaxRealIndex;i++) {
+        if (_coefficient[i] == 0) continue;
+
+        _termIndex[_termCount] = i;
+        _termCoefficient[_termCount] = _coefficient[i];
+        _termCount++;
+    }
+}
+
 
 QString EventType::parsedFormula()
 {
@@ -201,12 +220,46 @@ SubCost EventType::subCost(ProfileCostArray* c)
     if (!_parsed) {
         if (!parseFormula()) return 0;
     }
+
+    // this can change c->_count
+    if (c->_dirty) c->update();
+
+    return evaluate(c);
+}
+
+SubCost EventType::evaluate(ProfileCostArray* c)
+{
     SubCost res = 0;
 
-    int rc = _set->realCount();
-    for (int i = 0;i<rc;i++)
-        if (_coefficient[i] != 0)
-            res += _coefficient[i] * c->subCost(i);
+    for (int i = 0; i<_termCount; i++)
+        if (_termIndex[i] < c->_count)
+            res += _termCoefficient[i] * c->_cost[_termIndex[i]];
+
+    return res;
+}
+
+QVector<SubCost> EventType::subCosts(const QVector<ProfileCostArray*>& items)
+{
+    QVector<SubCost> res(items.count());
+
+    bool isDerived = (_realIndex == ProfileCostArray::InvalidIndex);
+    if (isDerived && !_parsed) {
+        if (!parseFormula()) return res;
+    }
+
+    for (int i = 0; i<items.count(); i++) {
+        ProfileCostArray* c = items[i];
+        if (!c) continue;
+
+        if (c->_dirty) c->update();
+        if (isDerived)
+            res[i] = evaluate(c);
+        else if (_realIndex < c->_count)
+            res[i] = c->_cost[_realIndex];
+
+        c->_cachedType = this;
+        c->_cachedCost = res[i];
+    }
 
     return res;
 }
@@ -233,6 +286,7 @@ int EventType::histCost(ProfileCostArray* c, double total, double* hist)
 
 bool EventType::hasKnownRealType(const QString& n)
 {
+    QMutexLocker locker(&knownTypesMutex);
     if (!_knownTypes) return false;
 
     foreach (EventType* t, *_knownTypes)
@@ -244,6 +298,7 @@ bool EventType::hasKnownRealType(const QString& n)
 
 bool EventType::hasKnownDerivedType(const QString& n)
 {
+    QMutexLocker locker(&knownTypesMutex);
     if (!_knownTypes) return false;
 
     foreach (EventType* t, *_knownTypes)
@@ -255,6 +310,7 @@ bool EventType::hasKnownDerivedType(const QString& n)
 
 EventType* EventType::cloneKnownRealType(const QString& n)
 {
+    QMutexLocker locker(&knownTypesMutex);
     if (!_knownTypes) return 0;
 
     foreach (EventType* t, *_knownTypes)
@@ -269,6 +325,7 @@ EventType* EventType::cloneKnownRealType(const QString& n)
 
 EventType* EventType::cloneKnownDerivedType(const QString& n)
 {
+    QMutexLocker locker(&knownTypesMutex);
     if (!_knownTypes) return 0;
 
     foreach (EventType* t, *_knownTypes)
@@ -287,6 +344,7 @@ void EventType::add(EventType* t, bool overwriteExisting)
 
     t->setEventTypeSet(0);
 
+    QMutexLocker locker(&knownTypesMutex);
     if (!_knownTypes)
         _knownTypes = new QList<EventType*>;
 
@@ -311,6 +369,7 @@ void EventType::add(EventType* t, bool overwriteExisting)
 
 int EventType::knownTypeCount()
 {
+    QMutexLocker locker(&knownTypesMutex);
     if (!_knownTypes) return 0;
 
     return _knownTypes->count();
@@ -318,6 +377,7 @@ int EventType::knownTypeCount()
 
 bool EventType::remove(const QString& n)
 {
+    QMutexLocker locker(&knownTypesMutex);
     if (!_knownTypes) return false;
 
     foreach (EventType* t, *_knownTypes)
@@ -332,6 +392,7 @@ bool EventType::remove(const QString& n)
 
 EventType* EventType::knownType(int i)
 {
+    QMutexLocker locker(&knownTypesMutex);
     if (!_knownTypes) return 0;
     if (i<0 || i>=(int)_knownTypes->count()) return 0;
 
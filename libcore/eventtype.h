@@ -77,6 +77,11 @@ public:
     QString parsedRealFormula();
 
     SubCost subCost(ProfileCostArray*);
+    /*
+     * Costs of all <items> in one pass, also cached in the items.
+     * Use this before sorting or layouting many items.
+     */
+    QVector<SubCost> subCosts(const QVector<ProfileCostArray*>& items);
 
     /*
      * For virtual costs, returns a histogram for use with
@@ -97,12 +102,20 @@ public:
     static EventType* knownType(int);
 
 private:
+    // set terms from coefficients after parsing
+    void compileFormula();
+    // only for derived types, with up-to-date <c>
+    SubCost evaluate(ProfileCostArray* c);
 
     QString _name, _longName, _formula, _parsedFormula;
     EventTypeSet* _set;
     bool _parsed, _inParsing, _isReal;
     // index MaxRealIndex is for constant addition
     int _coefficient[MaxRealIndexValue];
+    // compiled formula: real indexes with non-zero coefficient
+    int _termCount;
+    int _termIndex[MaxRealIndexValue];
+    int _termCoefficient[MaxRealIndexValue];
     int _realIndex;
 
     static QList<EventType*>* _knownTypes;
@@ -20,6 +20,54 @@
 #include "utils.h"
 #include "addr.h"
 
+/* Event counts are stored as variable-length integers (LEB128): 7 bits
+ * per byte, with the high bit set if more bytes follow. Most counts
+ * need 1-3 bytes instead of 8. The space taken from the pool is padded
+ * to a multiple of 8 bytes, as were the SubCost arrays before.
+ */
+#define ENCODED_ALIGN 8
+
+static unsigned char* encodeCosts(FixPool* pool,
+                                  const uint64* values, int count)
+{
+    int size = 0;
+    for(int i=0; i<count; i++) {
+        uint64 v = values[i];
+        size++;
+        while(v >= 0x80) { v >>= 7; size++; }
+    }
+    size = (size + ENCODED_ALIGN - 1) & ~(ENCODED_ALIGN - 1);
+
+    unsigned char* res = (unsigned char*) pool->allocate(size);
+    if (!res) return 0;
+    pool->addEncoded(count * sizeof(SubCost), size);
+
+    unsigned char* p = res;
+    for(int i=0; i<count; i++) {
+        uint64 v = values[i];
+        while(v >= 0x80) {
+            *p++ = (unsigned char) (v | 0x80);
+            v >>= 7;
+        }
+        *p++ = (unsigned char) v;
+    }
+    return res;
+}
+
+static inline uint64 decodeCost(const unsigned char*& p)
+{
+    uint64 v = 0;
+    int shift = 0;
+    unsigned char b;
+    do {
+        b = *p++;
+        v |= (uint64)(b & 0x7f) << shift;
+        shift += 7;
+    } while(b & 0x80);
+    return v;
+}
+
+
 // FixCost
 
 FixCost::FixCost(TracePart* part, FixPool* pool,
@@ -34,16 +82,35 @@ FixCost::FixCost(TracePart* part, FixPool* pool,
     _functionSource = functionSource;
     _pos = pos;
 
-    _cost = (SubCost*) pool->reserve(sizeof(SubCost) * maxCount);
+    uint64 v[MaxRealIndexValue];
     s.stripSpaces();
-    int i = 0;
-    while(i<maxCount) {
-        if (!s.stripUInt64(_cost[i])) break;
-        i++;
-    }
-    _count = i;
+    _count = s.stripUInt64s(v, maxCount);
+
+    _cost = encodeCosts(pool, v, _count);
+    if (!_cost)
+        _count = 0;
+
+    _nextCostOfPartFunction = partFunction ?
+                                  partFunction->setFirstFixCost(this) : 0;
+}
+
+FixCost::FixCost(TracePart* part, FixPool* pool,
+                 TraceFunctionSource* functionSource,
+                 PositionSpec& pos,
+                 TracePartFunction* partFunction,
+                 const SubCost* values, int count)
+{
+    _part = part;
+    _functionSource = functionSource;
+    _pos = pos;
+
+    uint64 v[MaxRealIndexValue];
+    for(int i=0; i<count; i++)
+        v[i] = values[i];
 
-    if (!pool->allocateReserved(sizeof(SubCost) * _count))
+    _count = count;
+    _cost = encodeCosts(pool, v, _count);
+    if (!_cost)
         _count = 0;
 
     _nextCostOfPartFunction = partFunction ?
@@ -60,14 +127,23 @@ void FixCost::addTo(ProfileCostArray* c)
     EventTypeMapping* sm = _part->eventTypeMapping();
 
     int i, realIndex;
+    const unsigned char* p = _cost;
 
     c->reserve(sm->maxRealIndex(_count)+1);
     for(i=0; i<_count; i++) {
         realIndex = sm->realIndex(i);
-        c->addCost(realIndex, _cost[i]);
+        c->addCost(realIndex, decodeCost(p));
     }
 }
 
+void FixCost::costs(SubCost* values) const
+{
+    const unsigned char* p = _cost;
+
+    for(int i=0; i<_count; i++)
+        values[i] = decodeCost(p);
+}
+
 
 
 // FixCallCost
@@ -89,19 +165,39 @@ FixCallCost::FixCallCost(TracePart* part, FixPool* pool,
     _line = line;
     _addr = addr;
 
-    _cost = (SubCost*) pool->reserve(sizeof(SubCost) * (maxCount+1));
+    uint64 v[MaxRealIndexValue+1];
+    v[0] = callCount;
     s.stripSpaces();
-    int i = 0;
-    while(i<maxCount) {
-        if (!s.stripUInt64(_cost[i])) break;
-        i++;
-    }
-    _count = i;
+    _count = s.stripUInt64s(v+1, maxCount);
+
+    _cost = encodeCosts(pool, v, _count+1);
+    if (!_cost)
+        _count = 0;
+
+    _nextCostOfPartCall = partCall ? partCall->setFirstFixCallCost(this) : 0;
+}
 
-    if (!pool->allocateReserved(sizeof(SubCost) * (_count+1) ))
+FixCallCost::FixCallCost(TracePart* part, FixPool* pool,
+                         TraceFunctionSource* functionSource,
+                         unsigned int line, Addr addr,
+                         TracePartCall* partCall,
+                         SubCost callCount,
+                         const SubCost* values, int count)
+{
+    _part = part;
+    _functionSource = functionSource;
+    _line = line;
+    _addr = addr;
+
+    uint64 v[MaxRealIndexValue+1];
+    v[0] = callCount;
+    for(int i=0; i<count; i++)
+        v[i+1] = values[i];
+
+    _count = count;
+    _cost = encodeCosts(pool, v, _count+1);
+    if (!_cost)
         _count = 0;
-    else
-        _cost[_count] = callCount;
 
     _nextCostOfPartCall = partCall ? partCall->setFirstFixCallCost(this) : 0;
 }
@@ -111,32 +207,59 @@ void* FixCallCost::operator new(size_t size, FixPool* pool)
     return pool->allocate(size);
 }
 
+SubCost FixCallCost::callCount() const
+{
+    if (!_cost) return 0;
+
+    const unsigned char* p = _cost;
+    return decodeCost(p);
+}
+
+void FixCallCost::costs(SubCost* values) const
+{
+    if (!_cost) return;
+
+    const unsigned char* p = _cost;
+    decodeCost(p); // call count
+
+    for(int i=0; i<_count; i++)
+        values[i] = decodeCost(p);
+}
+
 void FixCallCost::addTo(TraceCallCost* c)
 {
+    if (!_cost) return;
+
     EventTypeMapping* sm = _part->eventTypeMapping();
 
     int i, realIndex;
+    const unsigned char* p = _cost;
+    SubCost callCount = decodeCost(p);
 
     for(i=0; i<_count; i++) {
         realIndex = sm->realIndex(i);
-        c->addCost(realIndex, _cost[i]);
+        c->addCost(realIndex, decodeCost(p));
     }
-    c->addCallCount(_cost[_count]);
+    c->addCallCount(callCount);
 
     if (0) qDebug("Adding from (addr 0x%s, ln %d): calls %s",
                   qPrintable(_addr.toString()), _line,
-                  qPrintable(_cost[_count].pretty()));
+                  qPrintable(callCount.pretty()));
 }
 
 void FixCallCost::setMax(ProfileCostArray* c)
 {
+    if (!_cost) return;
+
     EventTypeMapping* sm = _part->eventTypeMapping();
 
     int i, realIndex;
+    const unsigned char* p = _cost;
+    decodeCost(p); // call count
 
     for(i=0; i<_count; i++) {
         realIndex = sm->realIndex(i);
-        c->maxCost(realIndex, _cost[i]);
+        c->maxCost(realIndex, decodeCost(p));
     }
 }
 
@@ -165,10 +288,10 @@ FixJump::FixJump(TracePart* part, FixPool* pool,
     
     _isCondJump = isCondJump;
 
-    int size = (isCondJump ? 2 : 1) * sizeof(SubCost);
-    _cost = (SubCost*) pool->allocate(size);
-    _cost[0] = executed;
-    if (isCondJump) _cost[1] = followed;
+    uint64 v[2];
+    v[0] = executed;
+    v[1] = followed;
+    _cost = encodeCosts(pool, v, isCondJump ? 2 : 1);
 
     _nextJumpOfPartFunction = partFunction ?
                                   partFunction->setFirstFixJump(this) : 0;
@@ -179,9 +302,29 @@ void* FixJump::operator new(size_t size, FixPool* pool)
     return pool->allocate(size);
 }
 
+SubCost FixJump::executedCount() const
+{
+    if (!_cost) return 0;
+
+    const unsigned char* p = _cost;
+    return decodeCost(p);
+}
+
+SubCost FixJump::followedCount() const
+{
+    if (!_cost || !_isCondJump) return 0;
+
+    const unsigned char* p = _cost;
+    decodeCost(p); // executed count
+    return decodeCost(p);
+}
+
 void FixJump::addTo(TraceJumpCost* jc)
 {
-    jc->addExecutedCount(_cost[0]);
+    if (!_cost) return;
+
+    const unsigned char* p = _cost;
+    jc->addExecutedCount(decodeCost(p));
     if (_isCondJump)
-        jc->addFollowedCount(_cost[1]);
+        jc->addFollowedCount(decodeCost(p));
 }
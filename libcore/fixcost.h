@@ -48,7 +48,8 @@ public:
  * A class holding an unchangable cost item of an input file.
  *
  * As there can be a lot of such cost items, we use our own
- * allocator which uses FixPool
+ * allocator which uses FixPool. Event counts are stored in a compact
+ * variable-length encoding, see fixcost.cpp
  */
 class FixCost
 {
@@ -59,6 +60,12 @@ public:
             PositionSpec&,
             TracePartFunction*,
             FixString&);
+    // with event counts already parsed by the loader
+    FixCost(TracePart*, FixPool*,
+            TraceFunctionSource*,
+            PositionSpec&,
+            TracePartFunction*,
+            const SubCost*, int count);
 
     void *operator new(size_t size, FixPool*);
 
@@ -74,13 +81,19 @@ public:
     Addr addr() const { return _pos.fromAddr; }
     Addr toAddr() const { return _pos.toAddr; }
     TraceFunctionSource* functionSource() const { return _functionSource; }
+    int count() const { return _count; }
+    // decode the count() event counts into <values>
+    void costs(SubCost* values) const;
 
     FixCost* nextCostOfPartFunction() const
     { return _nextCostOfPartFunction; }
+    // for lists of costs created by a worker thread while loading
+    void setNextCostOfPartFunction(FixCost* c)
+    { _nextCostOfPartFunction = c; }
 
 private:
     int _count;
-    SubCost*  _cost;
+    unsigned char* _cost;
     PositionSpec _pos;
 
     TracePart* _part;
@@ -103,6 +116,13 @@ public:
                 Addr addr,
                 TracePartCall*,
                 SubCost, FixString&);
+    // with event counts already parsed by the loader
+    FixCallCost(TracePart*, FixPool*,
+                TraceFunctionSource*,
+                unsigned int line,
+                Addr addr,
+                TracePartCall*,
+                SubCost, const SubCost*, int count);
 
     void *operator new(size_t size, FixPool*);
 
@@ -112,15 +132,20 @@ public:
     TracePart* part() const { return _part; }
     unsigned int line() const { return _line; }
     Addr addr() const { return _addr; }
-    SubCost callCount() const { return _cost[_count]; }
+    SubCost callCount() const;
+    int count() const { return _count; }
+    // decode the count() event counts into <values>
+    void costs(SubCost* values) const;
     TraceFunctionSource* functionSource() const	{ return _functionSource; }
     FixCallCost* nextCostOfPartCall() const
     { return _nextCostOfPartCall; }
+    void setNextCostOfPartCall(FixCallCost* c)
+    { _nextCostOfPartCall = c; }
 
 private:
-    // we use 1 SubCost more than _count: _cost[_count] is the call count
+    // encoded are 1 value more than _count: the call count comes first
     int _count;
-    SubCost*  _cost;
+    unsigned char* _cost;
     unsigned int _line;
     Addr _addr;
 
@@ -159,16 +184,16 @@ public:
     Addr targetAddr() const { return _targetAddr; }
     TraceFunctionSource* targetSource() const { return _targetSource; }
     bool isCondJump() const { return _isCondJump; }
-    SubCost executedCount() const { return _cost[0]; }
-    SubCost followedCount() const
-    { return _isCondJump ? _cost[1] : SubCost(0); }
+    SubCost executedCount() const;
+    SubCost followedCount() const;
 
     FixJump* nextJumpOfPartFunction() const
     { return _nextJumpOfPartFunction; }
 
 private:
     bool _isCondJump;
-    SubCost* _cost;
+    // executed count, followed if _isCondJump
+    unsigned char* _cost;
     unsigned int _line, _targetLine;
     Addr _addr, _targetAddr;
     
@@ -40,6 +40,10 @@
 #define DEFAULT_MAXLISTCOUNT     100
 #define DEFAULT_CONTEXT          3
 #define DEFAULT_NOCOSTINSIDE     20
+#define DEFAULT_PARALLELLOADING  true
+#define DEFAULT_PARALLELFILELOADING true
+#define DEFAULT_USEPROFILECACHE  true
+#define DEFAULT_MAPMEMORYBUDGET  0
 
 
 //
@@ -136,6 +140,12 @@ GlobalConfig::GlobalConfig()
     // annotation behaviour
     _context          = DEFAULT_CONTEXT;
     _noCostInside     = DEFAULT_NOCOSTINSIDE;
+
+    // loading
+    _parallelLoading  = DEFAULT_PARALLELLOADING;
+    _parallelFileLoading = DEFAULT_PARALLELFILELOADING;
+    _useProfileCache  = DEFAULT_USEPROFILECACHE;
+    _mapMemoryBudget  = DEFAULT_MAPMEMORYBUDGET;
 }
 
 GlobalConfig::~GlobalConfig()
@@ -193,6 +203,14 @@ void GlobalConfig::saveOptions()
                             DEFAULT_NOCOSTINSIDE);
     generalConfig->setValue(QStringLiteral("HideTemplates"), _hideTemplates,
                             DEFAULT_HIDETEMPLATES);
+    generalConfig->setValue(QStringLiteral("ParallelLoading"), _parallelLoading,
+                            DEFAULT_PARALLELLOADING);
+    generalConfig->setValue(QStringLiteral("ParallelFileLoading"),
+                            _parallelFileLoading, DEFAULT_PARALLELFILELOADING);
+    generalConfig->setValue(QStringLiteral("UseProfileCache"), _useProfileCache,
+                            DEFAULT_USEPROFILECACHE);
+    generalConfig->setValue(QStringLiteral("MapMemoryBudget"), _mapMemoryBudget,
+                            DEFAULT_MAPMEMORYBUDGET);
     delete generalConfig;
 
     // store known event types
@@ -264,6 +282,14 @@ void GlobalConfig::readOptions()
                                              DEFAULT_NOCOSTINSIDE).toInt();
     _hideTemplates    = generalConfig->value(QStringLiteral("HideTemplates"),
                                              DEFAULT_HIDETEMPLATES).toBool();
+    _parallelLoading  = generalConfig->value(QStringLiteral("ParallelLoading"),
+                                             DEFAULT_PARALLELLOADING).toBool();
+    _parallelFileLoading = generalConfig->value(QStringLiteral("ParallelFileLoading"),
+                                                DEFAULT_PARALLELFILELOADING).toBool();
+    _useProfileCache  = generalConfig->value(QStringLiteral("UseProfileCache"),
+                                             DEFAULT_USEPROFILECACHE).toBool();
+    _mapMemoryBudget  = generalConfig->value(QStringLiteral("MapMemoryBudget"),
+                                             DEFAULT_MAPMEMORYBUDGET).toInt();
     delete generalConfig;
 
     // event types
@@ -388,6 +414,58 @@ double GlobalConfig::cycleCut()
     return config()->_cycleCut;
 }
 
+bool GlobalConfig::parallelLoading()
+{
+    return config()->_parallelLoading;
+}
+
+void GlobalConfig::setParallelLoading(bool s)
+{
+    GlobalConfig* c = config();
+    if (c->_parallelLoading == s) return;
+
+    c->_parallelLoading = s;
+}
+
+bool GlobalConfig::parallelFileLoading()
+{
+    return config()->_parallelFileLoading;
+}
+
+void GlobalConfig::setParallelFileLoading(bool s)
+{
+    GlobalConfig* c = config();
+    if (c->_parallelFileLoading == s) return;
+
+    c->_parallelFileLoading = s;
+}
+
+bool GlobalConfig::useProfileCache()
+{
+    return config()->_useProfileCache;
+}
+
+void GlobalConfig::setUseProfileCache(bool s)
+{
+    GlobalConfig* c = config();
+    if (c->_useProfileCache == s) return;
+
+    c->_useProfileCache = s;
+}
+
+int GlobalConfig::mapMemoryBudget()
+{
+    return config()->_mapMemoryBudget;
+}
+
+void GlobalConfig::setMapMemoryBudget(int mb)
+{
+    GlobalConfig* c = config();
+    if (c->_mapMemoryBudget == mb) return;
+
+    c->_mapMemoryBudget = mb;
+}
+
 int GlobalConfig::percentPrecision()
 {
     return config()->_percentPrecision;
@@ -90,6 +90,26 @@ public:
     // upper limit for cutting of a call in cycle detection
     static double cycleCut();
 
+    // parse big profile data files and create their cost items
+    // on multiple threads
+    static bool parallelLoading();
+    static void setParallelLoading(bool);
+    /* parse multiple profile data files at once, merged via memory
+     * images in profile cache format. On by default; peak memory
+     * does not depend on the number of files.
+     */
+    static bool parallelFileLoading();
+    static void setParallelFileLoading(bool);
+    // read/write binary caches of loaded profile data
+    static bool useProfileCache();
+    static void setUseProfileCache(bool);
+    /* memory in MB for line/instruction maps built on demand,
+     * maps of least recently used functions are freed above.
+     * 0 is no limit.
+     */
+    static int mapMemoryBudget();
+    static void setMapMemoryBudget(int);
+
     void addDefaultTypes();
 
 protected:
@@ -101,10 +121,12 @@ protected:
     QHash<QString, QStringList> _objectSourceDirs;
 
     bool _showPercentage, _showExpanded, _showCycles, _hideTemplates;
+    bool _parallelLoading, _parallelFileLoading, _useProfileCache;
     double _cycleCut;
     int _percentPrecision;
     int _maxSymbolLength, _maxSymbolCount, _maxListCount;
     int _context, _noCostInside;
+    int _mapMemoryBudget;
 
     static GlobalConfig* _config;
 };
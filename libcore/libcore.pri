@@ -13,8 +13,12 @@ NHEADERS += \
     $$PWD/utils.h \
     $$PWD/logger.h \
     $$PWD/loader.h \
+    $$PWD/loadthread.h \
     $$PWD/fixcost.h \
     $$PWD/pool.h \
+    $$PWD/profilecache.h \
+    $$PWD/decompressdevice.h \
+    $$PWD/dumpinfo.h \
     $$PWD/coverage.h \
     $$PWD/stackbrowser.h
 
@@ -27,11 +31,15 @@ SOURCES += \
     $$PWD/cachegrindloader.cpp \
     $$PWD/config.cpp \
     $$PWD/coverage.cpp \
+    $$PWD/decompressdevice.cpp \
+    $$PWD/dumpinfo.cpp \
     $$PWD/fixcost.cpp \
     $$PWD/globalconfig.cpp \
     $$PWD/loader.cpp \
+    $$PWD/loadthread.cpp \
     $$PWD/logger.cpp \
     $$PWD/pool.cpp \
+    $$PWD/profilecache.cpp \
     $$PWD/stackbrowser.cpp \
     $$PWD/tracedata.cpp \
     $$PWD/utils.cpp
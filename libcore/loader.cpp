@@ -69,9 +69,12 @@ Loader* Loader::loader(const QString& name)
 
 // factories of available loaders
 Loader* createCachegrindLoader();
+Loader* createProfileCacheLoader();
 
 void Loader::initLoaders()
 {
+    // check for binary cache first: its header is strict
+    _loaderList.append(createProfileCacheLoader());
     _loaderList.append(createCachegrindLoader());
     //_loaderList.append(GProfLoader::createLoader());
 }
@@ -119,3 +122,8 @@ void Loader::loadFinished(const QString& msg)
         _logger->loadFinished(msg);
 }
 
+bool Loader::loadCanceled()
+{
+    return _logger && _logger->isLoadCanceled();
+}
+
@@ -45,7 +45,12 @@ class Logger;
  * These are just shown as status, warnings or errors to the
  * user, but do not show real failure, as even errors can be
  * recoverable. For unablility to load a file, return 0 in
- * load().
+ * load(). If loadCanceled() returns true, loading should be
+ * stopped, returning 0.
+ *
+ * As loading can run in a separate thread, load() must not modify
+ * the loader instance: use a temporary loader object, getting
+ * the notification consumer from TraceData::logger().
  */
 
 class Loader
@@ -80,6 +85,8 @@ protected:
     void loadError(int line, const QString& msg);
     void loadWarning(int line, const QString& msg);
     void loadFinished(const QString &msg = QString());
+    // should be polled regularly while loading big files
+    bool loadCanceled();
 
 protected:
     Logger* _logger;
@@ -0,0 +1,175 @@
+/* This file is part of KCachegrind.
+   Copyright (c) 2026 The KCachegrind developers
+
+   KCachegrind is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation, version 2.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+/*
+ * Loading of profile data in a separate thread
+ */
+
+#include "loadthread.h"
+
+#include <QFileInfo>
+#include <QIODevice>
+
+#include "tracedata.h"
+
+
+//
+// LoadThread
+//
+
+LoadThread::LoadThread(const QStringList& files, Mode mode, QObject* parent)
+    : QThread(parent)
+{
+    _files = files;
+    _mode = mode;
+    _device = 0;
+    _data = 0;
+    _partsLoaded = 0;
+    _fileSize = 0;
+}
+
+LoadThread::LoadThread(QIODevice* device, const QString& filename,
+                       QObject* parent)
+    : QThread(parent)
+{
+    _files << filename;
+    _mode = NewData;
+    _device = device;
+    _data = 0;
+    _partsLoaded = 0;
+    _fileSize = 0;
+}
+
+LoadThread::~LoadThread()
+{
+    if (isRunning()) {
+        cancel();
+        wait();
+    }
+    delete _data;
+    delete _device;
+}
+
+void LoadThread::cancel()
+{
+    _canceled.fetchAndStoreOrdered(1);
+}
+
+bool LoadThread::isCanceled() const
+{
+    return _canceled.loadAcquire() != 0;
+}
+
+TraceData* LoadThread::takeData()
+{
+    Q_ASSERT(!isRunning());
+
+    TraceData* d = _data;
+    _data = 0;
+    // this object is deleted after handing over
+    if (d) d->setLogger(0);
+    return d;
+}
+
+int LoadThread::addParts(TraceData* data)
+{
+    Q_ASSERT(!isRunning());
+
+    if (!data || _images.isEmpty()) return 0;
+
+    _partsLoaded = data->addImages(_files, _images);
+    _images.clear();
+    return _partsLoaded;
+}
+
+void LoadThread::run()
+{
+    if (_mode == AddParts) {
+        // the data to add to is shown meanwhile: do not touch it
+        foreach(const QString& file, _files) {
+            if (isCanceled()) break;
+            _images.append(TraceData::parseImage(file, this));
+        }
+        if (isCanceled())
+            _images.clear();
+        return;
+    }
+
+    TraceData* d = new TraceData(this);
+
+    int parts;
+    if (_device)
+        parts = d->load(_device, _files[0]);
+    else
+        parts = d->load(_files);
+
+    if (isCanceled() || (parts == 0)) {
+        delete d;
+        d = 0;
+        parts = 0;
+    }
+
+    // only accessed by the owner after finished()
+    _data = d;
+    _partsLoaded = parts;
+}
+
+void LoadThread::loadStart(const QString& filename)
+{
+    _filename = filename;
+    // size of decompressed streams is unknown, use the compressed size
+    _fileSize = QFileInfo(filename).size();
+    _elapsed.start();
+
+    emit fileStarted(filename);
+}
+
+void LoadThread::loadProgress(int progress)
+{
+    double bytesPerSecond = 0.0;
+    int secondsLeft = -1;
+
+    qint64 ms = _elapsed.elapsed();
+    if ((ms > 0) && (progress > 0)) {
+        double done = _fileSize * progress / 100.0;
+        bytesPerSecond = done * 1000.0 / ms;
+        secondsLeft = (int)(ms * (100 - progress) / progress / 1000);
+    }
+
+    emit fileProgress(_filename, progress, bytesPerSecond, secondsLeft);
+}
+
+void LoadThread::loadWarning(int line, const QString& msg)
+{
+    emit fileWarning(_filename, line, msg);
+}
+
+void LoadThread::loadError(int line, const QString& msg)
+{
+    emit fileError(_filename, line, msg);
+}
+
+void LoadThread::loadFinished(const QString& msg)
+{
+    emit fileFinished(_filename, msg);
+}
+
+bool LoadThread::isLoadCanceled()
+{
+    return isCanceled();
+}
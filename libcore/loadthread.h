@@ -0,0 +1,121 @@
+/* This file is part of KCachegrind.
+   Copyright (c) 2026 The KCachegrind developers
+
+   KCachegrind is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation, version 2.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+/*
+ * Loading of profile data in a separate thread
+ */
+
+#ifndef LOADTHREAD_H
+#define LOADTHREAD_H
+
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QList>
+#include <QStringList>
+#include <QThread>
+
+#include "logger.h"
+
+class QIODevice;
+class TraceData;
+
+/**
+ * Loads profile data into a new TraceData object, running in a
+ * separate thread to keep a GUI responsive.
+ *
+ * The thread is the logger of the TraceData: notifications from the
+ * loaders are forwarded as signals, which get delivered in the thread
+ * of the receiver (e.g. the GUI thread). Loading can be stopped with
+ * cancel(). After QThread::finished() was emitted, the data is handed
+ * over with takeData(); it is 0 if nothing was loaded or loading was
+ * canceled. The thread is no longer the logger of handed over data:
+ * the receiver has to set its own logger before loading more into it.
+ *
+ * In mode AddParts, files are parsed for data which is shown meanwhile:
+ * they are kept as memory images, added with addParts() afterwards.
+ * Nothing is added if loading was canceled.
+ */
+class LoadThread: public QThread, public Logger
+{
+    Q_OBJECT
+
+public:
+    enum Mode { NewData, AddParts };
+
+    /* load <files>, see TraceData::load(QStringList). With AddParts,
+     * exactly the given files are parsed, see TraceData::parseImage()
+     */
+    explicit LoadThread(const QStringList& files, Mode mode = NewData,
+                        QObject* parent = 0);
+    // load from <device>, which is owned by the thread afterwards
+    LoadThread(QIODevice* device, const QString& filename,
+               QObject* parent = 0);
+    ~LoadThread();
+
+    QStringList files() const { return _files; }
+    Mode mode() const { return _mode; }
+
+    // request loading to stop as soon as possible
+    void cancel();
+    bool isCanceled() const;
+
+    // after the thread finished
+    int partsLoaded() const { return _partsLoaded; }
+    TraceData* takeData();
+    // with AddParts: add parsed parts to <data>, returns parts added
+    int addParts(TraceData* data);
+
+    // Logger interface, called in the loading thread
+    void loadStart(const QString& filename) Q_DECL_OVERRIDE;
+    void loadProgress(int progress) Q_DECL_OVERRIDE;
+    void loadWarning(int line, const QString& msg) Q_DECL_OVERRIDE;
+    void loadError(int line, const QString& msg) Q_DECL_OVERRIDE;
+    void loadFinished(const QString& msg) Q_DECL_OVERRIDE;
+    bool isLoadCanceled() Q_DECL_OVERRIDE;
+
+signals:
+    void fileStarted(const QString& filename);
+    /* <bytesPerSecond> is estimated from the progress and file size,
+     * <secondsLeft> is -1 if unknown
+     */
+    void fileProgress(const QString& filename, int progress,
+                      double bytesPerSecond, int secondsLeft);
+    void fileWarning(const QString& filename, int line, const QString& msg);
+    void fileError(const QString& filename, int line, const QString& msg);
+    void fileFinished(const QString& filename, const QString& msg);
+
+protected:
+    void run() Q_DECL_OVERRIDE;
+
+private:
+    QStringList _files;
+    Mode _mode;
+    QIODevice* _device;
+    TraceData* _data;
+    // with AddParts: images of the files parsed
+    QList<QByteArray> _images;
+    int _partsLoaded;
+    QAtomicInt _canceled;
+
+    // for rate/ETA of the file currently loaded
+    QElapsedTimer _elapsed;
+    qint64 _fileSize;
+};
+
+#endif // LOADTHREAD_H
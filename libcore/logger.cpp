@@ -67,3 +67,8 @@ void Logger::loadFinished(const QString& msg)
     else
         qDebug() << "Error loading file" << _filename << ":" << qPrintable(msg);
 }
+
+bool Logger::isLoadCanceled()
+{
+    return false;
+}
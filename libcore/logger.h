@@ -41,6 +41,10 @@ public:
     virtual void loadError(int line, const QString& msg);
     virtual void loadFinished(const QString& msg); // msg could be error
 
+    // polled by loaders: return true to stop loading as soon as possible.
+    // As with the notifications, this can be called from another thread
+    virtual bool isLoadCanceled();
+
 protected:
     QString _filename;
 
@@ -21,103 +21,240 @@
 #include <string.h>
 #include <stdlib.h>
 #include <qglobal.h>
+#include <QAtomicInt>
+#include <QThread>
+#include <QThreadStorage>
 
-// FixPool
+#if defined(Q_OS_LINUX)
+#include <sys/mman.h>
+#endif
 
+// initial size of DynPool
 #define CHUNK_SIZE 100000
 
+/* Arena of a pool used last by a thread. Pools are identified by
+ * unique ids: a new pool at the address of a deleted one must not
+ * find arenas of the deleted pool.
+ */
+struct ArenaCache
+{
+    ArenaCache() : pool(0), arena(0) {}
+    int pool;
+    void* arena;
+};
+
+static QAtomicInt poolIds;
+
+static int newPoolId()
+{
+    return poolIds.fetchAndAddRelaxed(1) + 1;
+}
+
+
+// FixPool
+
+// chunks including header, fitting into one huge page
+#define FIXPOOL_CHUNK_SIZE (2*1024*1024)
+
 struct SpaceChunk
 {
     struct SpaceChunk* next;
-    unsigned int used;
+    unsigned int used, size;
     char space[1];
 };
 
+#define FIXPOOL_CHUNK_SPACE (FIXPOOL_CHUNK_SIZE - sizeof(struct SpaceChunk))
+
+static QThreadStorage<ArenaCache> fixArenaCache;
+
+// only accessed by the owning thread, apart from statistics
+struct FixArena
+{
+    Qt::HANDLE thread;
+    struct FixArena* next;
+    struct SpaceChunk* current;
+    unsigned int reservation;
+    unsigned long long count, size, chunks, chunkSize;
+    unsigned long long rawSize, encodedSize;
+};
+
+// space for a chunk of <size> bytes, aligned to huge pages if possible
+static void* allocateChunkSpace(size_t size)
+{
+#if defined(Q_OS_LINUX) && defined(MADV_HUGEPAGE)
+    if (size >= FIXPOOL_CHUNK_SIZE) {
+        void* p;
+        if (posix_memalign(&p, FIXPOOL_CHUNK_SIZE, size) != 0) return 0;
+        // only a hint for transparent huge pages, failure is harmless
+        madvise(p, size, MADV_HUGEPAGE);
+        return p;
+    }
+#endif
+    return malloc(size);
+}
+
 FixPool::FixPool()
+    : _arenas(0), _chunks(0)
 {
-    _first = _last = 0;
-    _reservation = 0;
-    _count = 0;
-    _size = 0;
+    _id = newPoolId();
 }
 
 FixPool::~FixPool()
 {
-    struct SpaceChunk* chunk = _first, *next;
+    if (0) {
+        Statistics s = statistics();
+        qDebug("~FixPool: Had %llu objects with total size %llu in %llu chunks, %d arenas\n",
+               s.count, s.usedSize, s.chunks, s.arenas);
+    }
 
+    struct SpaceChunk* chunk = _chunks.loadAcquire(), *next;
     while(chunk) {
         next = chunk->next;
         free(chunk);
         chunk = next;
     }
 
-    if (0) qDebug("~FixPool: Had %d objects with total size %d\n",
-                  _count, _size);
+    struct FixArena* arena = _arenas.loadAcquire(), *nextArena;
+    while(arena) {
+        nextArena = arena->next;
+        delete arena;
+        arena = nextArena;
+    }
 }
 
-void* FixPool::allocate(unsigned int size)
+struct FixArena* FixPool::arena()
 {
-    if (!ensureSpace(size)) return 0;
+    ArenaCache& cache = fixArenaCache.localData();
+    if (cache.pool == _id) return (struct FixArena*) cache.arena;
+
+    Qt::HANDLE self = QThread::currentThreadId();
+    struct FixArena* a;
+    for(a = _arenas.loadAcquire(); a; a = a->next)
+        if (a->thread == self) break;
+
+    if (!a) {
+        a = new FixArena;
+        memset(a, 0, sizeof(struct FixArena));
+        a->thread = self;
+
+        // only this thread can add an arena for itself: no need to
+        // search again if another thread prepended meanwhile
+        struct FixArena* head;
+        do {
+            head = _arenas.loadAcquire();
+            a->next = head;
+        } while(!_arenas.testAndSetOrdered(head, a));
+    }
 
-    _reservation = 0;
-    void* result = _last->space + _last->used;
-    _last->used += size;
+    cache.pool = _id;
+    cache.arena = a;
+    return a;
+}
+
+struct SpaceChunk* FixPool::newChunk(struct FixArena* a, unsigned int size)
+{
+    unsigned int space = FIXPOOL_CHUNK_SPACE;
+    if (size > space) space = size;
+
+    struct SpaceChunk* chunk;
+    chunk = (struct SpaceChunk*) allocateChunkSpace(sizeof(struct SpaceChunk) +
+                                                    space);
+    if (!chunk) {
+        qFatal("ERROR: Out of memory. Sorry. KCachegrind has to terminate.\n\n"
+               "You probably tried to load a profile data file too huge for"
+               "this system. You could try loading this file on a 64-bit OS.");
+        exit(1);
+    }
+    chunk->used = 0;
+    chunk->size = space;
+
+    struct SpaceChunk* head;
+    do {
+        head = _chunks.loadAcquire();
+        chunk->next = head;
+    } while(!_chunks.testAndSetOrdered(head, chunk));
+
+    a->chunks++;
+    a->chunkSize += sizeof(struct SpaceChunk) + space;
+    return chunk;
+}
+
+void* FixPool::allocate(unsigned int size)
+{
+    struct FixArena* a = arena();
+    a->reservation = 0;
+    a->count++;
+    a->size += size;
+
+    if (size > FIXPOOL_CHUNK_SPACE) {
+        // oversized: own chunk, continue to fill the current one
+        struct SpaceChunk* chunk = newChunk(a, size);
+        chunk->used = size;
+        return chunk->space;
+    }
 
-    _count++;
-    _size += size;
+    if (!ensureSpace(a, size)) return 0;
 
+    void* result = a->current->space + a->current->used;
+    a->current->used += size;
     return result;
 }
 
 void* FixPool::reserve(unsigned int size)
 {
-    if (!ensureSpace(size)) return 0;
-    _reservation = size;
+    struct FixArena* a = arena();
+    if (!ensureSpace(a, size)) return 0;
+    a->reservation = size;
 
-    return _last->space + _last->used;
+    return a->current->space + a->current->used;
 }
 
 
 bool FixPool::allocateReserved(unsigned int size)
 {
-    if (_reservation < size) return false;
+    struct FixArena* a = arena();
+    if (a->reservation < size) return false;
 
-    _reservation = 0;
-    _last->used += size;
+    a->reservation = 0;
+    a->current->used += size;
 
-    _count++;
-    _size += size;
+    a->count++;
+    a->size += size;
 
     return true;
 }
 
-bool FixPool::ensureSpace(unsigned int size)
+void FixPool::addEncoded(unsigned int rawSize, unsigned int encodedSize)
 {
-    if (_last && _last->used + size <= CHUNK_SIZE) return true;
-
-    struct SpaceChunk* newChunk;
-
-    // we do not allow allocation sizes > CHUNK_SIZE
-    if (size > CHUNK_SIZE) return false;
+    struct FixArena* a = arena();
+    a->rawSize += rawSize;
+    a->encodedSize += encodedSize;
+}
 
-    newChunk = (struct SpaceChunk*) malloc(sizeof(struct SpaceChunk) +
-                                           CHUNK_SIZE);
-    if (!newChunk) {
-        qFatal("ERROR: Out of memory. Sorry. KCachegrind has to terminate.\n\n"
-               "You probably tried to load a profile data file too huge for"
-               "this system. You could try loading this file on a 64-bit OS.");
-        exit(1);
+FixPool::Statistics FixPool::statistics() const
+{
+    Statistics s;
+    memset(&s, 0, sizeof(Statistics));
+
+    for(struct FixArena* a = _arenas.loadAcquire(); a; a = a->next) {
+        s.count += a->count;
+        s.usedSize += a->size;
+        s.chunks += a->chunks;
+        s.allocatedSize += a->chunkSize;
+        s.rawSize += a->rawSize;
+        s.encodedSize += a->encodedSize;
+        s.arenas++;
     }
-    newChunk->next = 0;
-    newChunk->used = 0;
+    return s;
+}
 
-    if (!_last) {
-        _last = _first = newChunk;
-    }
-    else {
-        _last->next = newChunk;
-        _last = newChunk;
-    }
+bool FixPool::ensureSpace(struct FixArena* a, unsigned int size)
+{
+    if (a->current && a->current->used + size <= a->current->size)
+        return true;
+
+    // a reservation bigger than a chunk gets a chunk of its own
+    a->current = newChunk(a, size);
     return true;
 }
 
@@ -238,6 +375,144 @@ bool DynPool::ensureSpace(unsigned int size)
     return true;
 }
 
+
+// CostPool
+
+// number of 64bit values in a chunk
+#define COST_CHUNK_COUNT 16384
+
+struct CostChunk
+{
+    struct CostChunk* next;
+    quint64 space[COST_CHUNK_COUNT];
+};
+
+static QThreadStorage<ArenaCache> costArenaCache;
+
+// arrays of one thread, only accessed by this thread
+struct CostArena
+{
+    Qt::HANDLE thread;
+    struct CostArena* next;
+    struct CostChunk* chunks;
+    int used, chunkCount;
+    // lists of released arrays by size, linked via first value
+    void* released[CostPool::MaxCount+1];
+};
+
+CostPool::CostPool()
+    : _arenas(0), _taken(1)
+{
+    // the owner holds a reference until close()
+    _id = newPoolId();
+}
+
+CostPool::~CostPool()
+{
+    struct CostArena* arena = _arenas.loadAcquire(), *nextArena;
+    while(arena) {
+        struct CostChunk* chunk = arena->chunks, *next;
+        while(chunk) {
+            next = chunk->next;
+            ::free(chunk);
+            chunk = next;
+        }
+        nextArena = arena->next;
+        delete arena;
+        arena = nextArena;
+    }
+}
+
+void CostPool::close()
+{
+    if (!_taken.deref()) delete this;
+}
+
+struct CostArena* CostPool::arena()
+{
+    ArenaCache& cache = costArenaCache.localData();
+    if (cache.pool == _id) return (struct CostArena*) cache.arena;
+
+    Qt::HANDLE self = QThread::currentThreadId();
+    struct CostArena* a;
+    for(a = _arenas.loadAcquire(); a; a = a->next)
+        if (a->thread == self) break;
+
+    if (!a) {
+        a = new CostArena;
+        memset(a, 0, sizeof(struct CostArena));
+        a->thread = self;
+        a->used = COST_CHUNK_COUNT;
+
+        // see FixPool::arena()
+        struct CostArena* head;
+        do {
+            head = _arenas.loadAcquire();
+            a->next = head;
+        } while(!_arenas.testAndSetOrdered(head, a));
+    }
+
+    cache.pool = _id;
+    cache.arena = a;
+    return a;
+}
+
+void* CostPool::allocate(int count)
+{
+    Q_ASSERT((count > 0) && (count <= MaxCount));
+
+    _taken.ref();
+    struct CostArena* a = arena();
+
+    if (a->released[count]) {
+        void* result = a->released[count];
+        a->released[count] = *(void**) result;
+        return result;
+    }
+
+    if (a->used + count > COST_CHUNK_COUNT) {
+        struct CostChunk* chunk;
+        chunk = (struct CostChunk*) malloc(sizeof(struct CostChunk));
+        if (!chunk) {
+            qFatal("ERROR: Out of memory. Sorry. KCachegrind has to terminate.\n\n"
+                   "You probably tried to load a profile data file too huge for"
+                   "this system. You could try loading this file on a 64-bit OS.");
+            exit(1);
+        }
+        chunk->next = a->chunks;
+        a->chunks = chunk;
+        a->used = 0;
+        a->chunkCount++;
+    }
+
+    void* result = a->chunks->space + a->used;
+    a->used += count;
+    return result;
+}
+
+void CostPool::release(void* ptr, int count)
+{
+    if (!ptr) return;
+    Q_ASSERT((count > 0) && (count <= MaxCount));
+
+    // reused by the releasing thread, which need not be the allocating one
+    struct CostArena* a = arena();
+    *(void**) ptr = a->released[count];
+    a->released[count] = ptr;
+
+    // last array given back after the owner closed the pool
+    if (!_taken.deref()) delete this;
+}
+
+unsigned long long CostPool::allocatedSize() const
+{
+    // chunks added concurrently can be missed, fine for statistics
+    unsigned long long size = 0;
+    for(struct CostArena* a = _arenas.loadAcquire(); a; a = a->next)
+        size += (unsigned long long) a->chunkCount * sizeof(struct CostChunk);
+    return size;
+}
+
 /* Testing the DynPool
 int main()
 {
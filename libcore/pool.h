@@ -19,17 +19,28 @@
 #ifndef POOL_H
 #define POOL_H
 
+#include <QAtomicInt>
+#include <QAtomicPointer>
+
 /**
  * Pool objects: containers for many small objects.
  */
 
 struct SpaceChunk;
+struct FixArena;
+struct CostArena;
 
 /**
  * FixPool
  *
  * For objects with fixed size and life time
  * ending with that of the pool.
+ *
+ * Allocation is thread-safe: each thread takes space from its own
+ * arena of chunks, so threads never wait for each other. Chunks are
+ * big (2 MB, backed by huge pages where supported) and first touched
+ * by the allocating thread, which keeps them local to its NUMA node.
+ * Allocations bigger than a chunk get a chunk of their own.
  */
 class FixPool
 {
@@ -46,6 +57,7 @@ public:
      * Reserve space. If you call allocateReservedSpace(realsize)
      * with realSize < reserved size directly after, you
      * will get the same memory area.
+     * Reservations are per thread.
      */
     void* reserve(unsigned int size);
 
@@ -55,15 +67,50 @@ public:
      */
     bool allocateReserved(unsigned int size);
 
+    /**
+     * Statistics for compact encoded values: <rawSize> bytes were
+     * stored in <encodedSize> bytes.
+     */
+    void addEncoded(unsigned int rawSize, unsigned int encodedSize);
+
+    /**
+     * Allocation statistics, summed over all threads. Only exact if
+     * no thread allocates at the same time, e.g. after loading.
+     */
+    struct Statistics
+    {
+        // allocations, and bytes allocated
+        unsigned long long count, usedSize;
+        // chunks taken from the heap and their bytes
+        unsigned long long chunks, allocatedSize;
+        // see addEncoded()
+        unsigned long long rawSize, encodedSize;
+        // number of threads which allocated from the pool
+        int arenas;
+    };
+    Statistics statistics() const;
+
+    unsigned long long rawSize() const { return statistics().rawSize; }
+    unsigned long long encodedSize() const { return statistics().encodedSize; }
+    unsigned long long allocatedSize() const { return statistics().allocatedSize; }
+
 private:
-    /* Checks that there is enough space in the last chunk.
-     * Returns false if this is not possible.
+    // arena of the calling thread, created on first use
+    struct FixArena* arena();
+
+    // take a new chunk with at least <size> bytes
+    struct SpaceChunk* newChunk(struct FixArena*, unsigned int size);
+
+    /* Checks that there is enough space in the current chunk
+     * of the arena. Returns false if this is not possible.
      */
-    bool ensureSpace(unsigned int);
+    bool ensureSpace(struct FixArena*, unsigned int);
 
-    struct SpaceChunk *_first, *_last;
-    unsigned int _reservation;
-    int _count, _size;
+    // lock-free lists, only prepended to
+    QAtomicPointer<struct FixArena> _arenas;
+    QAtomicPointer<struct SpaceChunk> _chunks;
+    // unique id, to find the arena of a thread in a per-thread cache
+    int _id;
 };
 
 /**
@@ -94,6 +141,11 @@ public:
      */
     void free(char** ptr);
 
+    /**
+     * Bytes taken from the heap
+     */
+    unsigned long long allocatedSize() const { return _size; }
+
 private:
     /* Checks that there is enough space. If not,
      * it compactifies, possibly moving objects.
@@ -104,4 +156,64 @@ private:
     unsigned int _used, _size;
 };
 
+/**
+ * CostPool
+ *
+ * For the cost arrays of cost items: arrays of 64bit values are
+ * taken from big chunks instead of a heap allocation per item, and
+ * arrays of items created one after the other are next to each other.
+ * Released arrays are reused for requests of the same size.
+ * As with FixPool, all space is freed together with the pool.
+ *
+ * Arrays can be given back after the owner is done with the pool:
+ * instead of deleting it, the owner calls close(), and the pool is
+ * deleted as soon as all arrays are given back.
+ *
+ * Allocation and release are thread-safe without locking: as in
+ * FixPool, each thread has its own chunks and lists of released
+ * arrays. An array released by another thread than the allocating
+ * one is reused by the releasing thread.
+ */
+class CostPool
+{
+public:
+    // arrays up to this number of values are supported
+    enum { MaxCount = 256 };
+
+    CostPool();
+
+    /**
+     * To be called by the owner instead of deleting the pool
+     */
+    void close();
+
+    /**
+     * Take space for <count> 64bit values from the pool
+     */
+    void* allocate(int count);
+
+    /**
+     * Give back space of <count> values taken by allocate(count)
+     */
+    void release(void* ptr, int count);
+
+    /**
+     * Bytes of all chunks taken from the heap
+     */
+    unsigned long long allocatedSize() const;
+
+private:
+    ~CostPool();
+
+    // arena of the calling thread, created on first use
+    struct CostArena* arena();
+
+    // lock-free list, only prepended to
+    QAtomicPointer<struct CostArena> _arenas;
+    // see FixPool
+    int _id;
+    // arrays taken and not given back yet, plus one until close()
+    QAtomicInt _taken;
+};
+
 #endif // POOL_H
@@ -0,0 +1,1073 @@
+/* This file is part of KCachegrind.
+   Copyright (c) 2026 The KCachegrind developers
+
+   KCachegrind is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation, version 2.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+/*
+ * Binary cache of loaded profile data: writer and loader
+ */
+
+#include "profilecache.h"
+
+#include <QBuffer>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QVector>
+#include <QDebug>
+
+#include <algorithm>
+#include <string.h>
+
+#ifdef Q_OS_UNIX
+#include <utime.h>
+#endif
+
+#include "addr.h"
+#include "loader.h"
+#include "fixcost.h"
+#include "utils.h"
+
+
+#define TRACE_CACHE 0
+
+/*
+ * File layout (all integers in native byte order):
+ *
+ *  header:   magic "KCGCACHE", version, byte order mark,
+ *            size/mtime/hash of profile data file,
+ *            command, architecture
+ *  tables:   objects (name), files (name), functions (name, file, object)
+ *  parts:    part attributes, event definitions (name, long name,
+ *            formula) and event names,
+ *            part functions (function, file, object), and per part function
+ *            its FixCost, FixJump and calls with their FixCallCost records
+ *  trailer:  magic "KCGCEND."
+ *
+ * Strings are stored as UTF-8 with a 32bit length prefix.
+ */
+#define CACHE_MAGIC      "KCGCACHE"
+#define CACHE_END_MAGIC  "KCGCEND."
+#define CACHE_VERSION    2
+#define CACHE_BOM        0x01020304
+// bytes at start of profile data file covered by hash
+#define CACHE_HASHSIZE   65536
+#define CACHE_NOINDEX    0xffffffff
+// smaller profile data files are fast enough to parse
+#define CACHE_MINSIZE    (1024*1024)
+// header size up to the data file signature
+#define CACHE_HEADERSIZE (8 + 4 + 4 + 8 + 8 + 4)
+// total size of all caches; least recently used ones are removed
+#define CACHE_MAXTOTAL   (2048LL*1024*1024)
+
+
+/**
+ * Identification of a profile data file, stored in the cache header
+ */
+struct DataFileSignature
+{
+    quint64 size;
+    qint64 mtime;
+    quint32 hash;
+
+    bool operator==(const DataFileSignature& s) const
+    { return (size == s.size) && (mtime == s.mtime) && (hash == s.hash); }
+};
+
+static bool dataFileSignature(const QString& dataFile, DataFileSignature& s)
+{
+    QFile file(dataFile);
+    if (!file.open(QIODevice::ReadOnly)) return false;
+
+    s.size = file.size();
+    s.mtime = QFileInfo(dataFile).lastModified().toMSecsSinceEpoch();
+
+    // FNV-1a hash: the start of a callgrind file contains command and PID
+    QByteArray head = file.read(CACHE_HASHSIZE);
+    quint32 h = 2166136261u;
+    for(int i=0; i<head.size(); i++) {
+        h ^= (uchar) head.at(i);
+        h *= 16777619u;
+    }
+    s.hash = h;
+
+    return true;
+}
+
+static QString userCacheDir()
+{
+    QString dir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    if (dir.isEmpty()) return QString();
+    return dir + QStringLiteral("/profiles");
+}
+
+// named by a hash of the absolute path: paths can be longer than
+// allowed for file names
+static QString userCacheFile(const QString& dataFile)
+{
+    QString dir = userCacheDir();
+    if (dir.isEmpty()) return QString();
+
+    QByteArray path = QFileInfo(dataFile).absoluteFilePath().toUtf8();
+    QByteArray hash = QCryptographicHash::hash(path, QCryptographicHash::Sha1);
+    return dir + QLatin1Char('/') + QString::fromLatin1(hash.toHex()) +
+           QStringLiteral(".kcgcache");
+}
+
+// mark cache <name> as used, for removing least recently used ones
+static void touchCacheFile(const QString& name)
+{
+#ifdef Q_OS_UNIX
+    utime(QFile::encodeName(name).constData(), 0);
+#else
+    Q_UNUSED(name);
+#endif
+}
+
+/* Remove least recently used caches while all together take more than
+ * CACHE_MAXTOTAL bytes. The cache just written, <keep>, is never removed.
+ */
+static void removeOldCaches(const QString& keep)
+{
+    QDir dir(userCacheDir());
+    QFileInfoList caches;
+    caches = dir.entryInfoList(QStringList() << QStringLiteral("*.kcgcache"),
+                               QDir::Files, QDir::Time);
+
+    // newest first
+    qint64 total = 0;
+    foreach(const QFileInfo& fi, caches) {
+        total += fi.size();
+        if ((total <= CACHE_MAXTOTAL) ||
+            (fi.absoluteFilePath() == QFileInfo(keep).absoluteFilePath()))
+            continue;
+
+        if (TRACE_CACHE)
+            qDebug() << "ProfileCache: removing" << fi.absoluteFilePath();
+        QFile::remove(fi.absoluteFilePath());
+        total -= fi.size();
+    }
+
+    // caches of older versions, named by the path, are not used any more
+    QDir oldDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation));
+    caches = oldDir.entryInfoList(QStringList() << QStringLiteral("*.kcgcache"),
+                                  QDir::Files);
+    foreach(const QFileInfo& fi, caches)
+        QFile::remove(fi.absoluteFilePath());
+}
+
+
+/**
+ * Sequential reader for memory-mapped cache data.
+ * On reading beyond the end, ok() returns false and 0 is returned.
+ */
+class CacheReader
+{
+public:
+    CacheReader(const char* data, quint64 len)
+    { _p = data; _end = data + len; _ok = true; }
+
+    bool ok() const { return _ok; }
+    void fail() { _ok = false; }
+    bool bytes(const char*& s, quint32 len);
+    quint8 u8();
+    quint32 u32();
+    quint64 u64();
+    QString string();
+    bool skipString();
+
+private:
+    const char *_p, *_end;
+    bool _ok;
+};
+
+bool CacheReader::bytes(const char*& s, quint32 len)
+{
+    if ((quint64)(_end - _p) < len) {
+        _ok = false;
+        return false;
+    }
+    s = _p;
+    _p += len;
+    return true;
+}
+
+quint8 CacheReader::u8()
+{
+    const char* s;
+    if (!bytes(s, 1)) return 0;
+    return (quint8) *s;
+}
+
+quint32 CacheReader::u32()
+{
+    const char* s;
+    quint32 v = 0;
+    if (bytes(s, 4)) memcpy(&v, s, 4);
+    return v;
+}
+
+quint64 CacheReader::u64()
+{
+    const char* s;
+    quint64 v = 0;
+    if (bytes(s, 8)) memcpy(&v, s, 8);
+    return v;
+}
+
+QString CacheReader::string()
+{
+    const char* s;
+    quint32 len = u32();
+    if (!bytes(s, len)) return QString();
+    return QString::fromUtf8(s, len);
+}
+
+bool CacheReader::skipString()
+{
+    const char* s;
+    return bytes(s, u32());
+}
+
+
+/**
+ * Buffered writer for cache data
+ */
+class CacheWriter
+{
+public:
+    explicit CacheWriter(QIODevice* d) { _device = d; _ok = true; }
+
+    bool flush();
+    void bytes(const char* s, int len)
+    { _buf.append(s, len); if (_buf.size() > 1024*1024) flush(); }
+    void u8(quint8 v) { bytes((const char*) &v, 1); }
+    void u32(quint32 v) { bytes((const char*) &v, 4); }
+    void u64(quint64 v) { bytes((const char*) &v, 8); }
+    void string(const QString& s)
+    { QByteArray a = s.toUtf8(); u32(a.size()); bytes(a.constData(), a.size()); }
+
+private:
+    QIODevice* _device;
+    QByteArray _buf;
+    bool _ok;
+};
+
+bool CacheWriter::flush()
+{
+    if (_ok && (_device->write(_buf) != _buf.size()))
+        _ok = false;
+    _buf.clear();
+    return _ok;
+}
+
+
+/**
+ * Assigns indexes to objects, files and functions referenced
+ * by the parts to be written.
+ */
+class CacheIndex
+{
+public:
+    quint32 object(TraceObject*);
+    quint32 file(TraceFile*);
+    quint32 function(TraceFunction*);
+    quint32 partFunction(TracePartFunction* pf)
+    { return _partFunctionIndex.value(pf, CACHE_NOINDEX); }
+
+    void setPartFunctions(const TraceCostList&);
+
+    QList<TraceObject*> objects;
+    QList<TraceFile*> files;
+    QList<TraceFunction*> functions;
+
+private:
+    QHash<TraceObject*, quint32> _objectIndex;
+    QHash<TraceFile*, quint32> _fileIndex;
+    QHash<TraceFunction*, quint32> _functionIndex;
+    QHash<TracePartFunction*, quint32> _partFunctionIndex;
+};
+
+quint32 CacheIndex::object(TraceObject* o)
+{
+    if (!o) return CACHE_NOINDEX;
+
+    QHash<TraceObject*, quint32>::const_iterator it = _objectIndex.constFind(o);
+    if (it != _objectIndex.constEnd()) return it.value();
+
+    quint32 i = objects.count();
+    objects.append(o);
+    _objectIndex.insert(o, i);
+    return i;
+}
+
+quint32 CacheIndex::file(TraceFile* f)
+{
+    if (!f) return CACHE_NOINDEX;
+
+    QHash<TraceFile*, quint32>::const_iterator it = _fileIndex.constFind(f);
+    if (it != _fileIndex.constEnd()) return it.value();
+
+    quint32 i = files.count();
+    files.append(f);
+    _fileIndex.insert(f, i);
+    return i;
+}
+
+quint32 CacheIndex::function(TraceFunction* f)
+{
+    if (!f) return CACHE_NOINDEX;
+
+    QHash<TraceFunction*, quint32>::const_iterator it = _functionIndex.constFind(f);
+    if (it != _functionIndex.constEnd()) return it.value();
+
+    // function record references file and object
+    file(f->file());
+    object(f->object());
+
+    quint32 i = functions.count();
+    functions.append(f);
+    _functionIndex.insert(f, i);
+    return i;
+}
+
+void CacheIndex::setPartFunctions(const TraceCostList& l)
+{
+    _partFunctionIndex.clear();
+    quint32 i = 0;
+    foreach(ProfileCostArray* c, l)
+        _partFunctionIndex.insert((TracePartFunction*) c, i++);
+}
+
+
+// Fix* records are linked in reverse order of creation
+template<class T>
+static QVector<T*> fixList(T* first, T* (T::*next)() const)
+{
+    QVector<T*> l;
+    for(T* t = first; t; t = (t->*next)())
+        l.append(t);
+    std::reverse(l.begin(), l.end());
+    return l;
+}
+
+
+//
+// ProfileCache
+//
+
+QString ProfileCache::validCacheFile(const QString& dataFile)
+{
+    DataFileSignature sig;
+    if (!dataFileSignature(dataFile, sig)) return QString();
+
+    QString name = userCacheFile(dataFile);
+    if (name.isEmpty()) return QString();
+
+    QFile file(name);
+    if (!file.open(QIODevice::ReadOnly)) return QString();
+
+    QByteArray header = file.read(CACHE_HEADERSIZE);
+    if (header.size() < CACHE_HEADERSIZE) return QString();
+
+    CacheReader r(header.constData(), header.size());
+    const char* magic;
+    r.bytes(magic, 8);
+    if (strncmp(magic, CACHE_MAGIC, 8) != 0) return QString();
+    if (r.u32() != CACHE_VERSION) return QString();
+    if (r.u32() != CACHE_BOM) return QString();
+
+    DataFileSignature cacheSig;
+    cacheSig.size = r.u64();
+    cacheSig.mtime = (qint64) r.u64();
+    cacheSig.hash = r.u32();
+    if (!(cacheSig == sig)) {
+        if (TRACE_CACHE)
+            qDebug() << "ProfileCache: stale cache" << name;
+        return QString();
+    }
+
+    // only complete caches are valid
+    if (file.size() < CACHE_HEADERSIZE + 8) return QString();
+    file.seek(file.size() - 8);
+    if (file.read(8) != QByteArray(CACHE_END_MAGIC)) return QString();
+
+    touchCacheFile(name);
+    return name;
+}
+
+bool ProfileCache::isCacheFile(QIODevice* file)
+{
+    // only peek: other loaders check the same data afterwards
+    char buf[16];
+    if (file->peek(buf, 16) != 16) return false;
+
+    quint32 version, bom;
+    memcpy(&version, buf+8, 4);
+    memcpy(&bom, buf+12, 4);
+
+    return (strncmp(buf, CACHE_MAGIC, 8) == 0) &&
+           (version == CACHE_VERSION) && (bom == CACHE_BOM);
+}
+
+// open cache file for <dataFile> in the user cache directory
+static bool openCacheFile(QSaveFile& file, const QString& dataFile)
+{
+    QString name = userCacheFile(dataFile);
+    if (name.isEmpty()) return false;
+    QDir().mkpath(QFileInfo(name).absolutePath());
+    file.setFileName(name);
+    return file.open(QIODevice::WriteOnly);
+}
+
+// write cache data for <parts> of <data> into <w>
+static void serialize(CacheWriter& w, TraceData* data,
+                      const TracePartList& parts,
+                      const DataFileSignature& sig)
+{
+    // collect objects/files/functions referenced
+    CacheIndex index;
+    foreach(TracePart* part, parts) {
+        foreach(ProfileCostArray* c, part->deps()) {
+            TracePartFunction* pf = (TracePartFunction*) c;
+            index.function(pf->function());
+            index.file(pf->partFile() ? pf->partFile()->file() : 0);
+            index.object(pf->partObject() ? pf->partObject()->object() : 0);
+
+            for(FixCost* fc = pf->firstFixCost(); fc;
+                fc = fc->nextCostOfPartFunction())
+                index.file(fc->functionSource()->file());
+
+            for(FixJump* fj = pf->firstFixJump(); fj;
+                fj = fj->nextJumpOfPartFunction()) {
+                index.file(fj->source()->file());
+                index.function(fj->targetFunction());
+                index.file(fj->targetSource()->file());
+            }
+
+            // calls to cycle members are stored as calls to the member,
+            // cycles are detected again after loading
+            foreach(TracePartCall* pc, pf->partCallings()) {
+                index.function(pc->call()->called(true));
+                for(FixCallCost* fcc = pc->firstFixCallCost(); fcc;
+                    fcc = fcc->nextCostOfPartCall())
+                    index.file(fcc->functionSource()->file());
+            }
+        }
+    }
+
+    // header
+    w.bytes(CACHE_MAGIC, 8);
+    w.u32(CACHE_VERSION);
+    w.u32(CACHE_BOM);
+    w.u64(sig.size);
+    w.u64((quint64) sig.mtime);
+    w.u32(sig.hash);
+    w.string(data->command());
+    w.u32((quint32) data->architecture());
+
+    // tables
+    w.u32(index.objects.count());
+    foreach(TraceObject* o, index.objects)
+        w.string(o->name());
+    w.u32(index.files.count());
+    foreach(TraceFile* f, index.files)
+        w.string(f->name());
+    w.u32(index.functions.count());
+    foreach(TraceFunction* f, index.functions) {
+        w.string(f->name());
+        w.u32(index.file(f->file()));
+        w.u32(index.object(f->object()));
+    }
+
+    // parts
+    SubCost values[MaxRealIndexValue];
+    w.u32(parts.count());
+    foreach(TracePart* part, parts) {
+        w.string(part->description());
+        w.string(part->trigger());
+        w.string(part->timeframe());
+        w.string(part->version());
+        w.u32((quint32) part->partNumber());
+        w.u32((quint32) part->threadID());
+        w.u32((quint32) part->processID());
+
+        const QList<TracePart::EventDefinition>& defs = part->eventDefinitions();
+        w.u32(defs.count());
+        foreach(const TracePart::EventDefinition& def, defs) {
+            w.string(def.name);
+            w.string(def.longName);
+            w.string(def.formula);
+        }
+
+        EventTypeMapping* mapping = part->eventTypeMapping();
+        EventTypeSet* set = data->eventTypes();
+        w.u32(mapping->count());
+        for(int i=0; i<mapping->count(); i++) {
+            EventType* t = set->realType(mapping->realIndex(i));
+            w.string(t->name());
+            w.string(t->longName());
+        }
+
+        const TraceCostList& pfList = part->deps();
+        index.setPartFunctions(pfList);
+        w.u32(pfList.count());
+        foreach(ProfileCostArray* c, pfList) {
+            TracePartFunction* pf = (TracePartFunction*) c;
+            w.u32(index.function(pf->function()));
+            w.u32(index.file(pf->partFile() ? pf->partFile()->file() : 0));
+            w.u32(index.object(pf->partObject() ? pf->partObject()->object() : 0));
+        }
+
+        foreach(ProfileCostArray* c, pfList) {
+            TracePartFunction* pf = (TracePartFunction*) c;
+
+            QVector<FixCost*> costs;
+            costs = fixList(pf->firstFixCost(), &FixCost::nextCostOfPartFunction);
+            w.u32(costs.count());
+            foreach(FixCost* fc, costs) {
+                w.u32(index.file(fc->functionSource()->file()));
+                w.u32(fc->fromLine());
+                w.u32(fc->toLine());
+                w.u64(fc->fromAddr().v());
+                w.u64(fc->toAddr().v());
+                w.u32(fc->count());
+                fc->costs(values);
+                for(int i=0; i<fc->count(); i++)
+                    w.u64(values[i]);
+            }
+
+            QVector<FixJump*> jumps;
+            jumps = fixList(pf->firstFixJump(), &FixJump::nextJumpOfPartFunction);
+            w.u32(jumps.count());
+            foreach(FixJump* fj, jumps) {
+                w.u32(index.file(fj->source()->file()));
+                w.u32(fj->line());
+                w.u64(fj->addr().v());
+                w.u32(index.function(fj->targetFunction()));
+                w.u32(index.file(fj->targetSource()->file()));
+                w.u32(fj->targetLine());
+                w.u64(fj->targetAddr().v());
+                w.u8(fj->isCondJump() ? 1 : 0);
+                w.u64(fj->executedCount());
+                w.u64(fj->followedCount());
+            }
+
+            w.u32(pf->partCallings().count());
+            foreach(TracePartCall* pc, pf->partCallings()) {
+                TraceFunction* called = pc->call()->called(true);
+                w.u32(index.partFunction((TracePartFunction*)
+                                         called->findDepFromPart(part)));
+
+                QVector<FixCallCost*> callCosts;
+                callCosts = fixList(pc->firstFixCallCost(),
+                                    &FixCallCost::nextCostOfPartCall);
+                w.u32(callCosts.count());
+                foreach(FixCallCost* fcc, callCosts) {
+                    w.u32(index.file(fcc->functionSource()->file()));
+                    w.u32(fcc->line());
+                    w.u64(fcc->addr().v());
+                    w.u64(fcc->callCount());
+                    w.u32(fcc->count());
+                    fcc->costs(values);
+                    for(int i=0; i<fcc->count(); i++)
+                        w.u64(values[i]);
+                }
+            }
+        }
+    }
+
+    w.bytes(CACHE_END_MAGIC, 8);
+}
+
+bool ProfileCache::write(TraceData* data, const TracePartList& parts,
+                         const QString& dataFile)
+{
+#if !USE_FIXCOST
+    // the cache stores Fix* records
+    return false;
+#endif
+
+    DataFileSignature sig;
+    if (parts.isEmpty() || !dataFileSignature(dataFile, sig)) return false;
+    if (sig.size < CACHE_MINSIZE) return false;
+
+    QSaveFile file;
+    if (!openCacheFile(file, dataFile)) return false;
+
+    CacheWriter w(&file);
+    serialize(w, data, parts, sig);
+    if (!w.flush()) {
+        file.cancelWriting();
+        return false;
+    }
+    if (!file.commit()) return false;
+
+    removeOldCaches(file.fileName());
+    return true;
+}
+
+QByteArray ProfileCache::image(TraceData* data, const TracePartList& parts,
+                               const QString& dataFile)
+{
+#if !USE_FIXCOST
+    return QByteArray();
+#endif
+
+    DataFileSignature sig;
+    if (parts.isEmpty() || !dataFileSignature(dataFile, sig))
+        return QByteArray();
+
+    QByteArray a;
+    QBuffer buffer(&a);
+    buffer.open(QIODevice::WriteOnly);
+    CacheWriter w(&buffer);
+    serialize(w, data, parts, sig);
+    if (!w.flush()) return QByteArray();
+    buffer.close();
+
+    return a;
+}
+
+bool ProfileCache::writeImage(const QByteArray& image, const QString& dataFile)
+{
+    if (image.isEmpty()) return false;
+    if (QFileInfo(dataFile).size() < CACHE_MINSIZE) return false;
+
+    QSaveFile file;
+    if (!openCacheFile(file, dataFile)) return false;
+
+    if (file.write(image) != image.size()) {
+        file.cancelWriting();
+        return false;
+    }
+    if (!file.commit()) return false;
+
+    removeOldCaches(file.fileName());
+    return true;
+}
+
+
+/* Check the structure of cache data before anything is added to the
+ * data model: a truncated or corrupt cache would leave partly filled
+ * parts otherwise. Indexes are checked in the same way as when loading.
+ */
+static bool checkCacheData(const char* base, quint64 len)
+{
+    CacheReader r(base, len);
+    const char* s;
+
+    if (!r.bytes(s, CACHE_HEADERSIZE)) return false;
+    r.skipString();
+    r.u32();
+
+    quint32 objectCount = r.u32();
+    for(quint32 i=0; r.ok() && (i<objectCount); i++)
+        r.skipString();
+    quint32 fileCount = r.u32();
+    for(quint32 i=0; r.ok() && (i<fileCount); i++)
+        r.skipString();
+    quint32 functionCount = r.u32();
+    for(quint32 i=0; r.ok() && (i<functionCount); i++) {
+        r.skipString();
+        // functions always have a file and an object
+        if ((r.u32() >= fileCount) || (r.u32() >= objectCount))
+            return false;
+    }
+
+    quint32 partCount = r.u32();
+    for(quint32 p=0; r.ok() && (p<partCount); p++) {
+        for(int i=0; i<4; i++)
+            r.skipString();
+        r.u32(); r.u32(); r.u32();
+
+        quint32 count = r.u32();
+        for(quint32 i=0; r.ok() && (i<count); i++) {
+            r.skipString(); r.skipString(); r.skipString();
+        }
+
+        quint32 eventCount = r.u32();
+        if (eventCount > MaxRealIndexValue) return false;
+        for(quint32 i=0; r.ok() && (i<eventCount); i++) {
+            r.skipString(); r.skipString();
+        }
+
+        quint32 pfCount = r.u32();
+        for(quint32 i=0; r.ok() && (i<pfCount); i++) {
+            quint32 fn = r.u32(), fi = r.u32(), ob = r.u32();
+            if ((fn >= functionCount) || (fi >= fileCount) ||
+                ((ob >= objectCount) && (ob != CACHE_NOINDEX)))
+                return false;
+        }
+
+        for(quint32 f=0; r.ok() && (f<pfCount); f++) {
+            count = r.u32();
+            for(quint32 i=0; r.ok() && (i<count); i++) {
+                if (r.u32() >= fileCount) return false;
+                r.u32(); r.u32(); r.u64(); r.u64();
+                quint32 n = r.u32();
+                if (n > eventCount) return false;
+                r.bytes(s, 8 * n);
+            }
+
+            count = r.u32();
+            for(quint32 i=0; r.ok() && (i<count); i++) {
+                if (r.u32() >= fileCount) return false;
+                r.u32(); r.u64();
+                if (r.u32() >= functionCount) return false;
+                if (r.u32() >= fileCount) return false;
+                r.u32(); r.u64(); r.u8(); r.u64(); r.u64();
+            }
+
+            count = r.u32();
+            for(quint32 i=0; r.ok() && (i<count); i++) {
+                if (r.u32() >= pfCount) return false;
+                quint32 costCount = r.u32();
+                for(quint32 j=0; r.ok() && (j<costCount); j++) {
+                    if (r.u32() >= fileCount) return false;
+                    r.u32(); r.u64(); r.u64();
+                    quint32 n = r.u32();
+                    if (n > eventCount) return false;
+                    r.bytes(s, 8 * n);
+                }
+            }
+        }
+    }
+
+    // trailer has to follow directly
+    if (!r.bytes(s, 8) || (strncmp(s, CACHE_END_MAGIC, 8) != 0))
+        return false;
+    return r.ok() && (base + len == s + 8);
+}
+
+
+/*
+ * Loader for profile data caches
+ */
+
+class ProfileCacheLoader: public Loader
+{
+public:
+    ProfileCacheLoader();
+
+    bool canLoad(QIODevice* file) Q_DECL_OVERRIDE;
+    int  load(TraceData*, QIODevice* file, const QString& filename) Q_DECL_OVERRIDE;
+
+    // load cache data in memory
+    int loadData(TraceData*, const char* data, quint64 len,
+                 const QString& filename);
+
+private:
+    TracePart* loadPart(CacheReader&, TraceData*, const QString& filename);
+
+    QVector<TraceObject*> _objects;
+    QVector<TraceFile*> _files;
+    QVector<TraceFunction*> _functions;
+};
+
+ProfileCacheLoader::ProfileCacheLoader()
+    : Loader(QStringLiteral("Cache"),
+             QObject::tr( "Import filter for binary caches of loaded profile data") )
+{
+}
+
+bool ProfileCacheLoader::canLoad(QIODevice* file)
+{
+    if (!file) return false;
+
+    Q_ASSERT(file->isOpen());
+
+    return ProfileCache::isCacheFile(file);
+}
+
+int ProfileCacheLoader::load(TraceData* data,
+                             QIODevice* device, const QString& filename)
+{
+    /* do the loading in a new object so parallel load
+     * operations do not interfere each other.
+     */
+    ProfileCacheLoader l;
+    l.setLogger(data->logger());
+
+    l.loadStart(filename);
+
+    FixFile file(device, filename);
+    if (!file.exists()) {
+        l.loadFinished(QStringLiteral("File does not exist"));
+        return 0;
+    }
+    if (file.isStreaming()) {
+        l.loadFinished(QStringLiteral("Cache can not be mapped"));
+        return 0;
+    }
+
+    int partsAdded = l.loadData(data, file.base(), file.len(), filename);
+    device->close();
+
+    return partsAdded;
+}
+
+int ProfileCacheLoader::loadData(TraceData* data,
+                                 const char* base, quint64 len,
+                                 const QString& filename)
+{
+    ProfileCacheLoader& l = *this;
+
+    // nothing is added from a corrupt cache: the caller falls back
+    // to parsing the profile data file
+    if (!checkCacheData(base, len)) {
+        l.loadError(0, QStringLiteral("Invalid cache structure"));
+        l.loadFinished(QStringLiteral("Corrupt cache"));
+        return 0;
+    }
+
+    CacheReader r(base, len);
+
+    // skip header with data file signature, checked on lookup
+    const char* s;
+    r.bytes(s, CACHE_HEADERSIZE);
+
+    QString command = r.string();
+    if (data->command().isEmpty())
+        data->setCommand(command);
+    quint32 arch = r.u32();
+    if (arch != TraceData::ArchUnknown)
+        data->setArchitecture((TraceData::Arch) arch);
+
+    quint32 count = r.u32();
+    for(quint32 i=0; r.ok() && (i<count); i++)
+        l._objects.append(data->object(r.string()));
+    count = r.u32();
+    for(quint32 i=0; r.ok() && (i<count); i++)
+        l._files.append(data->file(r.string()));
+    count = r.u32();
+    for(quint32 i=0; r.ok() && (i<count); i++) {
+        QString name = r.string();
+        quint32 fileIndex = r.u32();
+        quint32 objectIndex = r.u32();
+        if ((fileIndex >= (quint32) l._files.count()) ||
+            (objectIndex >= (quint32) l._objects.count())) {
+            l.loadError(0, QStringLiteral("Invalid function entry in cache"));
+            l.loadFinished(QStringLiteral("Corrupt cache"));
+            return 0;
+        }
+        l._functions.append(data->function(name,
+                                           l._files[fileIndex],
+                                           l._objects[objectIndex]));
+    }
+
+    int partsAdded = 0;
+    quint32 partCount = r.u32();
+    for(quint32 i=0; r.ok() && (i<partCount); i++) {
+        if (l.loadCanceled()) {
+            l.loadFinished(QStringLiteral("Canceled"));
+            return 0;
+        }
+
+        TracePart* part = l.loadPart(r, data, filename);
+        if (!part) break;
+
+        part->invalidate();
+        part->totals()->clear();
+        part->totals()->addCost(part);
+        data->addPart(part);
+        partsAdded++;
+
+        l.loadProgress((int)(100.0 * (i+1) / partCount + .5));
+    }
+
+    l.loadFinished(r.ok() ? QString() : QStringLiteral("Corrupt cache"));
+
+    return partsAdded;
+}
+
+TracePart* ProfileCacheLoader::loadPart(CacheReader& r, TraceData* data,
+                                        const QString& filename)
+{
+    FixPool* pool = data->fixPool();
+    SubCost values[MaxRealIndexValue];
+
+    TracePart* part = new TracePart(data);
+    part->setName(filename);
+    part->setDescription(r.string());
+    part->setTrigger(r.string());
+    part->setTimeframe(r.string());
+    part->setVersion(r.string());
+    part->setPartNumber((int) r.u32());
+    part->setThreadID((int) r.u32());
+    part->setProcessID((int) r.u32());
+
+    // as with "event:" lines in profile data: known types are overwritten
+    quint32 count = r.u32();
+    for(quint32 i=0; r.ok() && (i<count); i++) {
+        TracePart::EventDefinition def;
+        def.name = r.string();
+        def.longName = r.string();
+        def.formula = r.string();
+        EventType::add(new EventType(def.name, def.longName, def.formula));
+        part->addEventDefinition(def);
+    }
+
+    QString events;
+    quint32 eventCount = r.u32();
+    for(quint32 i=0; r.ok() && (i<eventCount); i++) {
+        QString name = r.string();
+        QString longName = r.string();
+        // only add unknown event types: do not overwrite configuration
+        EventType::add(new EventType(name, longName), false);
+        events += name + QLatin1Char(' ');
+    }
+    EventTypeMapping* mapping = data->eventTypes()->createMapping(events);
+    if (!r.ok() || !mapping) {
+        delete part;
+        return 0;
+    }
+    part->setEventMapping(mapping);
+
+    int functionCount = _functions.count();
+    int fileCount = _files.count();
+
+    QVector<TracePartFunction*> partFunctions;
+    count = r.u32();
+    for(quint32 i=0; r.ok() && (i<count); i++) {
+        quint32 fn = r.u32(), fi = r.u32(), ob = r.u32();
+        if ((fn >= (quint32) functionCount) || (fi >= (quint32) fileCount)) {
+            r.fail();
+            break;
+        }
+        TracePartObject* partObject = 0;
+        if (ob < (quint32) _objects.count())
+            partObject = _objects[ob]->partObject(part);
+        partFunctions.append(_functions[fn]->partFunction(part,
+                                                          _files[fi]->partFile(part),
+                                                          partObject));
+    }
+
+    foreach(TracePartFunction* pf, partFunctions) {
+        if (!r.ok()) break;
+        TraceFunction* function = pf->function();
+
+        count = r.u32();
+        for(quint32 i=0; r.ok() && (i<count); i++) {
+            quint32 fi = r.u32();
+            PositionSpec pos;
+            pos.fromLine = r.u32();
+            pos.toLine = r.u32();
+            pos.fromAddr = Addr(r.u64());
+            pos.toAddr = Addr(r.u64());
+            int n = (int) r.u32();
+            if ((fi >= (quint32) fileCount) || (n > mapping->count())) {
+                r.fail();
+                break;
+            }
+            for(int j=0; j<n; j++)
+                values[j] = r.u64();
+            new (pool) FixCost(part, pool,
+                               function->sourceFile(_files[fi], true),
+                               pos, pf, values, n);
+        }
+
+        count = r.u32();
+        for(quint32 i=0; r.ok() && (i<count); i++) {
+            quint32 fi = r.u32();
+            uint line = r.u32();
+            Addr addr = Addr(r.u64());
+            quint32 targetFn = r.u32();
+            quint32 targetFi = r.u32();
+            uint targetLine = r.u32();
+            Addr targetAddr = Addr(r.u64());
+            bool isCond = (r.u8() != 0);
+            SubCost executed = r.u64();
+            SubCost followed = r.u64();
+            if ((fi >= (quint32) fileCount) || (targetFi >= (quint32) fileCount) ||
+                (targetFn >= (quint32) functionCount)) {
+                r.fail();
+                break;
+            }
+
+            TraceFunction* target = _functions[targetFn];
+            new (pool) FixJump(part, pool,
+                               line, addr, pf,
+                               function->sourceFile(_files[fi], true),
+                               targetLine, targetAddr, target,
+                               target->sourceFile(_files[targetFi], true),
+                               isCond, executed, followed);
+        }
+
+        count = r.u32();
+        for(quint32 i=0; r.ok() && (i<count); i++) {
+            quint32 calledIndex = r.u32();
+            if (calledIndex >= (quint32) partFunctions.count()) {
+                r.fail();
+                break;
+            }
+
+            TracePartFunction* calledPf = partFunctions[calledIndex];
+            TraceCall* calling = function->calling(calledPf->function());
+            TracePartCall* partCalling = calling->partCall(part, pf, calledPf);
+
+            quint32 costCount = r.u32();
+            for(quint32 j=0; r.ok() && (j<costCount); j++) {
+                quint32 fi = r.u32();
+                uint line = r.u32();
+                Addr addr = Addr(r.u64());
+                SubCost callCount = r.u64();
+                int n = (int) r.u32();
+                if ((fi >= (quint32) fileCount) || (n > mapping->count())) {
+                    r.fail();
+                    break;
+                }
+                for(int k=0; k<n; k++)
+                    values[k] = r.u64();
+
+                FixCallCost* fcc;
+                fcc = new (pool) FixCallCost(part, pool,
+                                             function->sourceFile(_files[fi], true),
+                                             line, addr, partCalling,
+                                             callCount, values, n);
+                fcc->setMax(data->callMax());
+                data->updateMaxCallCount(fcc->callCount());
+            }
+        }
+    }
+
+#if TRACE_CACHE
+    qDebug() << "ProfileCacheLoader: part with" << partFunctions.count()
+             << "functions from" << filename;
+#endif
+
+    return part;
+}
+
+int ProfileCache::loadImage(TraceData* data, const QByteArray& image,
+                            const QString& dataFile)
+{
+    if (image.size() < CACHE_HEADERSIZE) return 0;
+
+    // no notifications: done by the caller
+    ProfileCacheLoader l;
+    return l.loadData(data, image.constData(), image.size(), dataFile);
+}
+
+Loader* createProfileCacheLoader()
+{
+    return new ProfileCacheLoader();
+}
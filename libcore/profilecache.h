@@ -0,0 +1,78 @@
+/* This file is part of KCachegrind.
+   Copyright (c) 2026 The KCachegrind developers
+
+   KCachegrind is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation, version 2.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+/*
+ * Binary cache of loaded profile data
+ */
+
+#ifndef PROFILECACHE_H
+#define PROFILECACHE_H
+
+#include <QByteArray>
+#include <QString>
+
+#include "tracedata.h"
+
+class QIODevice;
+
+/**
+ * A binary copy of the data loaded from a profile data file.
+ * It contains string tables for objects/files/functions and the
+ * FixCost/FixCallCost/FixJump records of all parts, which allows
+ * to rebuild the data model without parsing text on reopening.
+ *
+ * The cache is written into the user cache directory, never next to
+ * the profile data file, named by a hash of the path of the profile
+ * data file. Least recently used caches are removed when all caches
+ * take more than 2 GB. It is read by a Loader memory-mapping the
+ * file, and only used as long as size, modification time and a hash
+ * of the beginning of the profile data file match. A corrupt cache
+ * is detected before anything is added, and the profile data file
+ * gets parsed instead.
+ *
+ * Data is stored in native byte order; a cache written on a machine
+ * with different endianness is regarded as invalid.
+ */
+class ProfileCache
+{
+public:
+    // name of a valid cache for <dataFile>, or empty if there is none
+    static QString validCacheFile(const QString& dataFile);
+
+    // write cache for <parts> of <data> which were loaded from <dataFile>
+    static bool write(TraceData* data, const TracePartList& parts,
+                      const QString& dataFile);
+
+    /* serialize <parts> of <data> loaded from <dataFile> into memory,
+     * in the same format as written by write()
+     */
+    static QByteArray image(TraceData* data, const TracePartList& parts,
+                            const QString& dataFile);
+    // write a memory image as cache for <dataFile>
+    static bool writeImage(const QByteArray& image, const QString& dataFile);
+    /* load parts from a memory image into <data>, returns parts added.
+     * Loading is not reported to the logger of <data>.
+     */
+    static int loadImage(TraceData* data, const QByteArray& image,
+                         const QString& dataFile);
+
+    // does <file> start with the header of a cache?
+    static bool isCacheFile(QIODevice* file);
+};
+
+#endif // PROFILECACHE_H
@@ -26,12 +26,22 @@
 #include <QDir>
 #include <QFileInfo>
 #include <QDebug>
+#include <QAtomicInt>
+#include <QDateTime>
+#include <QHash>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QSet>
+#include <QThread>
+#include <QThreadPool>
 
 #include "logger.h"
 #include "loader.h"
 #include "globalconfig.h"
 #include "utils.h"
 #include "fixcost.h"
+#include "profilecache.h"
+#include "decompressdevice.h"
 
 
 #define TRACE_DEBUG      0
@@ -136,6 +146,14 @@ void TraceCallCost::addCallCount(SubCost c)
     invalidate();
 }
 
+void TraceCallCost::addCallCountDelta(SubCost c, bool add)
+{
+    if (add)
+        _callCount += c;
+    else
+        _callCount -= c;
+}
+
 
 //---------------------------------------------------
 // TraceInclusiveCost
@@ -174,6 +192,11 @@ void TraceInclusiveCost::addInclusive(ProfileCostArray* c)
     invalidate();
 }
 
+void TraceInclusiveCost::addInclusiveDelta(ProfileCostArray* c, bool add)
+{
+    _inclusive.addCostDelta(c, add);
+}
+
 
 //---------------------------------------------------
 // TraceListCost
@@ -226,6 +249,7 @@ ProfileCostArray* TraceListCost::findDepFromPart(TracePart* part)
 void TraceListCost::update()
 {
     if (!_dirty) return;
+    countUpdate();
 
 #if TRACE_DEBUG
     qDebug("update %s (count %d)",
@@ -300,6 +324,7 @@ TraceJumpCost* TraceJumpListCost::findDepFromPart(TracePart* part)
 void TraceJumpListCost::update()
 {
     if (!_dirty) return;
+    countUpdate();
 
 #if TRACE_DEBUG
     qDebug("update %s (count %d)",
@@ -356,6 +381,13 @@ void TraceCallListCost::addDep(TraceCallCost* dep)
 #endif
 }
 
+void TraceCallListCost::clearDeps()
+{
+    _deps.clear();
+    _lastDep = 0;
+    invalidate();
+}
+
 TraceCallCost* TraceCallListCost::findDepFromPart(TracePart* part)
 {
     if (_lastDep && _lastDep->part() == part)
@@ -374,6 +406,7 @@ TraceCallCost* TraceCallListCost::findDepFromPart(TracePart* part)
 void TraceCallListCost::update()
 {
     if (!_dirty) return;
+    countUpdate();
 
 #if TRACE_DEBUG
     qDebug("update %s (count %d)",
@@ -400,6 +433,17 @@ void TraceCallListCost::update()
 #endif
 }
 
+bool TraceCallListCost::activateDep(TraceCallCost* dep, bool active)
+{
+    if (_dirty || !onlyActiveParts()) return false;
+
+    // no item depends on calls, objects, classes or files: nothing
+    // else has to be updated
+    addCostDelta(dep, active);
+    addCallCountDelta(dep->callCount(), active);
+    return true;
+}
+
 
 //---------------------------------------------------
 // TraceInclusiveListCost
@@ -452,6 +496,7 @@ TraceInclusiveCost* TraceInclusiveListCost::findDepFromPart(TracePart* part)
 void TraceInclusiveListCost::update()
 {
     if (!_dirty) return;
+    countUpdate();
 
 #if TRACE_DEBUG
     qDebug("update %s (count %d)",
@@ -474,6 +519,16 @@ void TraceInclusiveListCost::update()
 #endif
 }
 
+bool TraceInclusiveListCost::activateDep(TraceInclusiveCost* dep, bool active)
+{
+    if (_dirty || !onlyActiveParts()) return false;
+
+    // see TraceCallListCost::activateDep
+    addCostDelta(dep, active);
+    addInclusiveDelta(dep->inclusive(), active);
+    return true;
+}
+
 
 
 //---------------------------------------------------
@@ -586,6 +641,7 @@ void TracePartCall::update()
 #else
 
     if (!_dirty) return;
+    countUpdate();
 
 #if TRACE_DEBUG
     qDebug("update %s", qPrintable( fullName() ));
@@ -700,6 +756,12 @@ void TracePartFunction::addPartLine(TracePartLine* ref)
 #endif
 }
 
+void TracePartFunction::clearPartInstrsAndLines()
+{
+    _partInstr.clear();
+    _partLines.clear();
+}
+
 
 void TracePartFunction::addPartCaller(TracePartCall* ref)
 {
@@ -775,6 +837,7 @@ int TracePartFunction::callingContexts()
 void TracePartFunction::update()
 {
     if (!_dirty) return;
+    countUpdate();
 
 #if TRACE_DEBUG
     qDebug("TracePartFunction::update %s (Callers %d, Callings %d, lines %d)",
@@ -948,13 +1011,9 @@ TraceInstrJump::~TraceInstrJump()
 
 TracePartInstrJump* TraceInstrJump::partInstrJump(TracePart* part)
 {
-    static TracePartInstrJump* item = 0;
-
-    // shortcut if recently used
-    if (item &&
-        (item->instrJump()==this) &&
-        (item->part() == part)) return item;
-
+    // no static cache of the recently used item: data may be loaded
+    // in multiple threads. The current part usually is the first.
+    TracePartInstrJump* item;
     for(item = _first; item; item = item->next())
         if (item->part() == part)
             return item;
@@ -968,6 +1027,7 @@ TracePartInstrJump* TraceInstrJump::partInstrJump(TracePart* part)
 void TraceInstrJump::update()
 {
     if (!_dirty) return;
+    countUpdate();
 
     clear();
     TracePartInstrJump* item;
@@ -1179,6 +1239,18 @@ TraceLineCall* TraceCall::lineCall(TraceLine* l)
     return lcall;
 }
 
+void TraceCall::clearLineAndInstrCalls()
+{
+    // part line calls also are registered in our part calls
+    foreach(TraceCallCost* pc, _deps)
+        ((TracePartCall*)pc)->clearDeps();
+
+    qDeleteAll(_lineCalls);
+    qDeleteAll(_instrCalls);
+    _lineCalls.clear();
+    _instrCalls.clear();
+}
+
 
 void TraceCall::invalidateDynamicCost()
 {
@@ -1191,6 +1263,18 @@ void TraceCall::invalidateDynamicCost()
     invalidate();
 }
 
+void TraceCall::partActivated(TracePartCall* partCall, bool active)
+{
+    foreach(TraceLineCall* lc, _lineCalls)
+        lc->invalidate();
+
+    foreach(TraceInstrCall* ic, _instrCalls)
+        ic->invalidate();
+
+    if (!activateDep(partCall, active))
+        invalidate();
+}
+
 
 QString TraceCall::name() const
 {
@@ -1217,6 +1301,7 @@ void TraceCall::update()
     if (_caller && _caller->cycle() && _caller==_caller->cycle()) {
 
         // we have no part calls: use inclusive cost of called function
+        countUpdate();
         clear();
         if (_called)
             addCost(_called->inclusive());
@@ -1567,7 +1652,7 @@ TraceLine* TraceFunctionSource::line(uint lineno, bool createNew)
         if (!_lineMap) return 0;
         TraceLineMap::Iterator it = _lineMap->find(lineno);
         if (it == _lineMap->end()) return 0;
-        return &(it.value());
+        return &(*it);
     }
 
     if (!_lineMap) _lineMap = new TraceLineMap;
@@ -1585,9 +1670,23 @@ TraceLine* TraceFunctionSource::line(uint lineno, bool createNew)
     return &l;
 }
 
+void TraceFunctionSource::createLines(QVector<uint>& linenos)
+{
+    // line 0 is not part of the map
+    linenos.removeAll(0);
+
+    if (!_lineMap) _lineMap = new TraceLineMap;
+    TraceLine* l = _lineMap->insertKeys(linenos);
+    for(int i=0; i<linenos.count(); i++) {
+        l[i].setSourceFile(this);
+        l[i].setLineno(linenos[i]);
+    }
+}
+
 void TraceFunctionSource::update()
 {
     if (!_dirty) return;
+    countUpdate();
 
     clear();
 
@@ -1615,15 +1714,74 @@ void TraceFunctionSource::invalidateDynamicCost()
     invalidate();
 }
 
+void TraceFunctionSource::partActivated()
+{
+    if (_lineMap) {
+        TraceLineMap::Iterator lit;
+        for ( lit = _lineMap->begin();
+              lit != _lineMap->end(); ++lit )
+            (*lit).invalidate();
+    }
+
+    // not invalidate(): the cost of the function does not come from
+    // its source files, and is updated by TraceFunction::partActivated()
+    _dirty = true;
+}
+
+// jumps shown in line annotation
+static bool isShownLineJump(FixJump* fj)
+{
+    // be robust against buggy loaders
+    if (!fj->targetSource()) return false;
+
+    // do not display jumps to same or following line
+    if ((fj->line() == fj->targetLine()) ||
+        (fj->line()+1 == fj->targetLine())) return false;
+
+    return true;
+}
+
 TraceLineMap* TraceFunctionSource::lineMap()
 {
 #if USE_FIXCOST
 
-    if (_lineMapFilled) return _lineMap;
+    if (_lineMapFilled) {
+        _function->mapsUsed();
+        return _lineMap;
+    }
     _lineMapFilled = true;
     if (!_lineMap)
         _lineMap = new TraceLineMap;
 
+    /* first collect the line numbers of all items, to create the lines
+     * in one array with one sort pass
+     */
+    QVector<uint> linenos;
+    foreach(TraceInclusiveCost* ic, _function->deps()) {
+        TracePartFunction* pf = (TracePartFunction*) ic;
+
+        FixCost* fc = pf->firstFixCost();
+        for(; fc; fc = fc->nextCostOfPartFunction())
+            if (fc->functionSource() == this)
+                linenos.append(fc->line());
+
+        FixJump* fj = pf->firstFixJump();
+        for(; fj; fj = fj->nextJumpOfPartFunction()) {
+            if ((fj->source() != this) || !isShownLineJump(fj)) continue;
+            linenos.append(fj->line());
+            if (fj->targetSource() == this)
+                linenos.append(fj->targetLine());
+        }
+
+        foreach(TracePartCall* pc, pf->partCallings()) {
+            FixCallCost* fcc = pc->firstFixCallCost();
+            for(; fcc; fcc = fcc->nextCostOfPartCall())
+                if (fcc->functionSource() == this)
+                    linenos.append(fcc->line());
+        }
+    }
+    createLines(linenos);
+
     TraceLine* l = 0;
     TracePartLine* pl = 0;
     TraceLineCall* lc = 0;
@@ -1665,14 +1823,7 @@ TraceLineMap* TraceFunctionSource::lineMap()
         for(; fj; fj = fj->nextJumpOfPartFunction()) {
             if (fj->line() == 0) continue;
             if (fj->source() != this) continue;
-            if (!fj->targetSource()) {
-                // be robust against buggy loaders
-                continue;
-            }
-
-            // do not display jumps to same or following line
-            if ((fj->line() == fj->targetLine()) ||
-                (fj->line()+1 == fj->targetLine())) continue;
+            if (!isShownLineJump(fj)) continue;
 
             if (!l || l->lineno() != fj->line()) {
                 l = &(*_lineMap)[fj->line()];
@@ -1683,6 +1834,8 @@ TraceLineMap* TraceFunctionSource::lineMap()
             }
 
             to = fj->targetSource()->line(fj->targetLine(), true);
+            if (fj->targetSource()->function() != _function)
+                fj->targetSource()->function()->pinMaps();
 
             lj = l->lineJump(to, fj->isCondJump());
             plj = lj->partLineJump(fj->part());
@@ -1724,11 +1877,63 @@ TraceLineMap* TraceFunctionSource::lineMap()
         }
     }
 
+    _function->data()->mapsBuilt(_function);
+
 #endif
 
     return _lineMap;
 }
 
+// bytes of the cost arrays of a list of items
+template<class T>
+static quint64 itemCostBytes(const QList<T*>& items)
+{
+    quint64 bytes = 0;
+    foreach(T* item, items)
+        bytes += item->costBytes();
+    return bytes;
+}
+
+// estimated bytes of a line with its jumps and calls
+static quint64 lineBytes(TraceLine& l, bool costArrays)
+{
+    quint64 bytes = TraceLineMap::itemSize() +
+                    l.deps().count() * sizeof(TracePartLine);
+    foreach(TraceLineJump* lj, l.lineJumps())
+        bytes += sizeof(TraceLineJump) +
+                 lj->deps().count() * sizeof(TracePartLineJump);
+    foreach(TraceLineCall* lc, l.lineCalls()) {
+        bytes += sizeof(TraceLineCall) +
+                 lc->deps().count() * sizeof(TracePartLineCall);
+        if (costArrays)
+            bytes += lc->costBytes() + itemCostBytes(lc->deps());
+    }
+    if (costArrays)
+        bytes += l.costBytes() + itemCostBytes(l.deps());
+    return bytes;
+}
+
+quint64 TraceFunctionSource::lineMapBytes(bool costArrays) const
+{
+    if (!_lineMap) return 0;
+
+    quint64 bytes = sizeof(TraceLineMap);
+    TraceLineMap::Iterator lit;
+    for ( lit = _lineMap->begin(); lit != _lineMap->end(); ++lit )
+        bytes += lineBytes(*lit, costArrays);
+    return bytes;
+}
+
+void TraceFunctionSource::clearLineMap()
+{
+    delete _lineMap;
+    _lineMap = 0;
+    _lineMapFilled = false;
+
+    // our cost is summed up from the line map
+    invalidate();
+}
+
 
 
 //---------------------------------------------------
@@ -1806,6 +2011,8 @@ TraceFunction::TraceFunction()
 
     _instrMap = 0;
     _instrMapFilled = false;
+    _mapsPinned = false;
+    _mapUse = 0;
 }
 
 
@@ -2107,7 +2314,7 @@ TraceInstr* TraceFunction::instr(Addr addr, bool createNew)
         TraceInstrMap::Iterator it = _instrMap->find(addr);
         if (it == _instrMap->end())
             return 0;
-        return &(it.value());
+        return &(*it);
     }
 
     if (!_instrMap) _instrMap = new TraceInstrMap;
@@ -2322,21 +2529,47 @@ void TraceFunction::invalidateDynamicCost()
     invalidate();
 }
 
-void TraceFunction::update()
+void TraceFunction::partActivated(TracePartFunction* partFunction,
+                                  bool active)
 {
-    if (!_dirty) return;
+    // cost of cycles and cycle members is calculated from calls
+    bool valid = !_dirty && !_cycle;
 
-#if TRACE_DEBUG
-    qDebug("Update %s (Callers %d, sourceFiles %d, instrs %d)",
-           qPrintable(_name), _callers.count(),
-           _sourceFiles.count(), _instrMap ? _instrMap->count():0);
-#endif
+    foreach(TracePartCall* pc, partFunction->partCallings())
+        pc->call()->partActivated(pc, active);
+
+    foreach(TraceFunctionSource* sf, _sourceFiles)
+        sf->partActivated();
 
+    if (_instrMap) {
+        TraceInstrMap::Iterator iit;
+        for ( iit = _instrMap->begin();
+              iit != _instrMap->end(); ++iit )
+            (*iit).invalidate();
+    }
+
+    if (!valid) {
+        invalidate();
+        return;
+    }
+
+    // cycles depending on us are updated by TraceData::partsActivated()
+    addCostDelta(partFunction, active);
+    addInclusiveDelta(partFunction->inclusive(), active);
+}
+
+void TraceFunction::partActivationDone()
+{
+    // calls from/to us are up to date now
+    if (!_dirty) countCalls();
+}
+
+void TraceFunction::countCalls()
+{
     _calledCount    = 0;
     _callingCount    = 0;
     _calledContexts  = 0;
     _callingContexts = 0;
-    clear();
 
     // To calculate context counts, we just use first real event type (FIXME?)
     EventType* e = data() ? data()->eventTypes()->realType(0) : 0;
@@ -2353,6 +2586,21 @@ void TraceFunction::update()
             _callingContexts++;
         _callingCount += callee->callCount();
     }
+}
+
+void TraceFunction::update()
+{
+    if (!_dirty) return;
+    countUpdate();
+
+#if TRACE_DEBUG
+    qDebug("Update %s (Callers %d, sourceFiles %d, instrs %d)",
+           qPrintable(_name), _callers.count(),
+           _sourceFiles.count(), _instrMap ? _instrMap->count():0);
+#endif
+
+    clear();
+    countCalls();
 
     if (data()->inFunctionCycleUpdate() || !_cycle) {
         // usual case (no cycle member)
@@ -2412,120 +2660,62 @@ bool TraceFunction::isCycleMember()
 void TraceFunction::cycleReset()
 {
     _cycle = 0;
-    _cycleStackDown = 0;
-    _cycleLow = 0;
 }
 
-// this does not mark functions calling themself !
-void TraceFunction::cycleDFS(int d, int& pNo, TraceFunction** pTop)
-{
-    if (_cycleLow != 0) return;
-
-    // initialize with prefix order
-    pNo++;
-    int prefixNo = pNo;
-    _cycleLow = prefixNo;
 
-    // put myself on stack
-    _cycleStackDown = *pTop;
-    *pTop = this;
-
-    /* cycle cut heuristic:
-     * skip calls for cycle detection if they make less than _cycleCut
-     * percent of the cost of the function.
-     * FIXME: Which cost type to use for this heuristic ?!
-     */
-    Q_ASSERT((data() != 0) && (data()->eventTypes()->realCount()>0));
-    EventType* e = data()->eventTypes()->realType(0);
-
-    SubCost base = 0;
-    if (_callers.count()>0) {
-        foreach(TraceCall* caller, _callers)
-            if (caller->subCost(e) > base)
-                base = caller->subCost(e);
-    }
-    else base = inclusive()->subCost(e);
-
-    SubCost cutLimit = SubCost(base * GlobalConfig::cycleCut());
+TraceInstrMap* TraceFunction::instrMap()
+{
+#if USE_FIXCOST
 
-    if (0) {
-        qDebug("%s (%d) Visiting %s",
-               qPrintable(QString().fill(' ', d)),
-               pNo, qPrintable(prettyName()));
-        qDebug("%s       Cum. %s, Max Caller %s, cut limit %s",
-               qPrintable(QString().fill(' ', d)),
-               qPrintable(inclusive()->subCost(e).pretty()),
-               qPrintable(base.pretty()),
-               qPrintable(cutLimit.pretty()));
+    if (_instrMapFilled) {
+        mapsUsed();
+        return _instrMap;
     }
+    _instrMapFilled = true;
+    if (!_instrMap)
+        _instrMap = new TraceInstrMap;
 
-    foreach(TraceCall *callee, _callings) {
-        TraceFunction* called = callee->called();
-
-        // cycle cut heuristic
-        if (callee->subCost(e) < cutLimit) {
-            if (0) qDebug("%s       Cut call to %s (cum. %s)",
-                          qPrintable(QString().fill(' ', d)),
-                          qPrintable(called->prettyName()),
-                          qPrintable(callee->subCost(e).pretty()));
-
-            continue;
-        }
+    /* first collect addresses and line numbers of all items, to create
+     * instructions and lines in one array each with one sort pass
+     */
+    QVector<Addr> addrs;
+    QHash<TraceFunctionSource*, QVector<uint> > linenos;
+    foreach(TraceInclusiveCost* icost, deps()) {
+        TracePartFunction* pf = (TracePartFunction*) icost;
 
-        if (called->_cycleLow==0) {
-            // not visited yet
-            called->cycleDFS(d+1, pNo, pTop);
-            if (called->_cycleLow < _cycleLow)
-                _cycleLow = called->_cycleLow;
-        }
-        else if (called->_cycleStackDown) {
-            // backlink to same SCC (still in stack)
-            if (called->_cycleLow < _cycleLow)
-                _cycleLow = called->_cycleLow;
-
-            if (0) qDebug("%s (low %d) Back to %s",
-                          qPrintable(QString().fill(' ', d)),
-                          _cycleLow, qPrintable(called->prettyName()));
+        FixCost* fc = pf->firstFixCost();
+        for(; fc; fc = fc->nextCostOfPartFunction()) {
+            if (fc->addr() == 0) continue;
+            addrs.append(fc->addr());
+            linenos[fc->functionSource()].append(fc->line());
         }
-    }
-
-    if (prefixNo == _cycleLow) {
-        // this is the base of a SCC.
 
-        if (*pTop == this) {
-            *pTop = _cycleStackDown;
-            _cycleStackDown = 0;
+        FixJump* fj = pf->firstFixJump();
+        for(; fj; fj = fj->nextJumpOfPartFunction()) {
+            if (fj->addr() == 0) continue;
+            addrs.append(fj->addr());
+            linenos[fj->source()].append(fj->line());
+            if ((fj->targetFunction() == this) && (fj->targetAddr() != 0))
+                addrs.append(fj->targetAddr());
         }
-        else {
-            // a SCC with >1 members
-
-            TraceFunctionCycle* cycle = data()->functionCycle(this);
-            if (0) qDebug("Found Cycle %d with base %s:",
-                          cycle->cycleNo(), qPrintable(prettyName()));
-            while(*pTop) {
-                TraceFunction* top = *pTop;
-                cycle->add(top);
 
-                // remove from stack
-                *pTop = top->_cycleStackDown;
-                top->_cycleStackDown = 0;
-
-                if (0) qDebug("  %s", qPrintable(top->prettyName()));
-                if (top == this) break;
+        foreach(TracePartCall* pc, pf->partCallings()) {
+            FixCallCost* fcc = pc->firstFixCallCost();
+            for(; fcc; fcc = fcc->nextCostOfPartCall()) {
+                if (fcc->addr() == 0) continue;
+                addrs.append(fcc->addr());
+                linenos[fcc->functionSource()].append(fcc->line());
             }
         }
     }
-}
-
-
-TraceInstrMap* TraceFunction::instrMap()
-{
-#if USE_FIXCOST
-
-    if (_instrMapFilled) return _instrMap;
-    _instrMapFilled = true;
-    if (!_instrMap)
-        _instrMap = new TraceInstrMap;
+    QHash<TraceFunctionSource*, QVector<uint> >::Iterator sit;
+    for(sit = linenos.begin(); sit != linenos.end(); ++sit)
+        sit.key()->createLines(sit.value());
+    TraceInstr* created = _instrMap->insertKeys(addrs);
+    for(int n=0; n<addrs.count(); n++) {
+        created[n].setFunction(this);
+        created[n].setAddr(addrs[n]);
+    }
 
     TraceLine* l = 0;
     TraceInstr* i = 0;
@@ -2550,11 +2740,7 @@ TraceInstrMap* TraceFunction::instrMap()
 
             if (!i || i->addr() != fc->addr()) {
                 i = &(*_instrMap)[fc->addr()];
-                if (!i->isValid()) {
-                    i->setFunction(this);
-                    i->setAddr(fc->addr());
-                    i->setLine(l);
-                }
+                if (!i->line()) i->setLine(l);
                 pi = 0;
             }
             if (!pi || pi->part() != fc->part())
@@ -2575,14 +2761,12 @@ TraceInstrMap* TraceFunction::instrMap()
 
             if (!i || i->addr() != fj->addr()) {
                 i = &(*_instrMap)[fj->addr()];
-                if (!i->isValid()) {
-                    i->setFunction(this);
-                    i->setAddr(fj->addr());
-                    i->setLine(l);
-                }
+                if (!i->line()) i->setLine(l);
             }
 
             to = fj->targetFunction()->instr(fj->targetAddr(), true);
+            if (fj->targetFunction() != this)
+                fj->targetFunction()->pinMaps();
 
             ij = i->instrJump(to, fj->isCondJump());
             pij = ij->partInstrJump(fj->part());
@@ -2606,11 +2790,7 @@ TraceInstrMap* TraceFunction::instrMap()
 
                 if (!i || i->addr() != fcc->addr()) {
                     i = &(*_instrMap)[fcc->addr()];
-                    if (!i->isValid()) {
-                        i->setFunction(this);
-                        i->setAddr(fcc->addr());
-                        i->setLine(l);
-                    }
+                    if (!i->line()) i->setLine(l);
                 }
                 if (!ic || ic->call() != pc->call() || ic->instr() != i) {
                     ic = pc->call()->instrCall(i);
@@ -2628,11 +2808,74 @@ TraceInstrMap* TraceFunction::instrMap()
         }
     }
 
+    data()->mapsBuilt(this);
+
 #endif
 
     return _instrMap;
 }
 
+quint64 TraceFunction::lineMapBytes(bool costArrays) const
+{
+    quint64 bytes = 0;
+    foreach(TraceFunctionSource* sf, _sourceFiles)
+        bytes += sf->lineMapBytes(costArrays);
+    return bytes;
+}
+
+quint64 TraceFunction::instrMapBytes(bool costArrays) const
+{
+    if (!_instrMap) return 0;
+
+    quint64 bytes = sizeof(TraceInstrMap);
+    TraceInstrMap::Iterator iit;
+    for ( iit = _instrMap->begin(); iit != _instrMap->end(); ++iit ) {
+        TraceInstr& i = *iit;
+        bytes += TraceInstrMap::itemSize() +
+                 i.deps().count() * sizeof(TracePartInstr) +
+                 i.instrJumps().count() * sizeof(TraceInstrJump);
+        foreach(TraceInstrCall* ic, i.instrCalls()) {
+            bytes += sizeof(TraceInstrCall) +
+                     ic->deps().count() * sizeof(TracePartInstrCall);
+            if (costArrays)
+                bytes += ic->costBytes() + itemCostBytes(ic->deps());
+        }
+        if (costArrays)
+            bytes += i.costBytes() + itemCostBytes(i.deps());
+    }
+    return bytes;
+}
+
+void TraceFunction::mapsUsed()
+{
+    _mapUse = data()->nextMapUse();
+}
+
+bool TraceFunction::evictMaps()
+{
+#if USE_FIXCOST
+    if (_mapsPinned) return false;
+
+    // our calls and part functions refer to items of our maps
+    foreach(TraceCall* c, _callings)
+        c->clearLineAndInstrCalls();
+    foreach(TraceInclusiveCost* ic, _deps)
+        ((TracePartFunction*)ic)->clearPartInstrsAndLines();
+
+    // instructions refer to lines: always free both
+    delete _instrMap;
+    _instrMap = 0;
+    _instrMapFilled = false;
+    foreach(TraceFunctionSource* sf, _sourceFiles)
+        sf->clearLineMap();
+
+    return true;
+#else
+    // without FixCost lists, maps can not be rebuilt
+    return false;
+#endif
+}
+
 
 
 //---------------------------------------------------
@@ -3059,6 +3302,42 @@ bool TracePart::operator<(const TracePart& p2) const
 }
 
 
+//---------------------------------------------------
+// TraceMemoryUsage
+
+TraceMemoryUsage::TraceMemoryUsage()
+{
+    for(int i=0; i<CategoryCount; i++)
+        _bytes[i] = 0;
+    _rawCostBytes = 0;
+    _encodedCostBytes = 0;
+}
+
+quint64 TraceMemoryUsage::total() const
+{
+    quint64 sum = 0;
+    for(int i=0; i<CategoryCount; i++)
+        sum += _bytes[i];
+    return sum;
+}
+
+QString TraceMemoryUsage::categoryName(Category c)
+{
+    switch(c) {
+    case FixPoolChunks:  return QObject::tr("Fixed cost records (FixPool)");
+    case DynPoolChunks:  return QObject::tr("Dynamic pool (DynPool)");
+    case CostPoolChunks: return QObject::tr("Cost arrays (CostPool)");
+    case ItemMaps:       return QObject::tr("Objects, classes, files, functions");
+    case Calls:          return QObject::tr("Calls");
+    case PartItems:      return QObject::tr("Costs per part");
+    case LineMaps:       return QObject::tr("Line maps");
+    case InstrMaps:      return QObject::tr("Instruction maps");
+    default: break;
+    }
+    return QString();
+}
+
+
 //---------------------------------------------------
 // TraceData
 
@@ -3078,8 +3357,16 @@ void TraceData::init()
 
     _maxThreadID = 0;
     _maxPartNumber = 0;
-    _fixPool = 0;
+    // allocation from the FixPool is thread-safe, but lazy creation not
+    _fixPool = new FixPool();
     _dynPool = 0;
+    // allocation from the CostPool is thread-safe, too
+    _costPool = new CostPool();
+
+    _mapBytes = 0;
+    _mapUseCount = 0;
+    _functionNamesValid = false;
+    _lowerNamesValid = false;
 
     _arch = ArchUnknown;
 }
@@ -3090,6 +3377,8 @@ TraceData::~TraceData()
 
     delete _fixPool;
     delete _dynPool;
+    // items still alive, such as our own cost, give back their arrays
+    _costPool->close();
 }
 
 QString TraceData::shortTraceName() const
@@ -3103,9 +3392,6 @@ QString TraceData::shortTraceName() const
 
 FixPool* TraceData::fixPool()
 {
-    if (!_fixPool)
-        _fixPool = new FixPool();
-
     return _fixPool;
 }
 
@@ -3117,50 +3403,310 @@ DynPool* TraceData::dynPool()
     return _dynPool;
 }
 
-bool partLessThan(const TracePart* p1, const TracePart* p2)
+CostPool* TraceData::costPool()
 {
-    return *p1 < *p2;
+    return _costPool;
 }
 
-/**
- * Load a list of files.
- * If only one file is given, it is assumed to be a prefix, and all
- * existing files with that prefix are loaded.
- *
- * Returns 0 if nothing found to load
- */
-int TraceData::load(QStringList files)
+TraceMemoryUsage TraceData::memoryUsage()
 {
-    if (files.isEmpty()) return 0;
-
-    _traceName = files[0];
-    if (files.count() == 1) {
-        QFileInfo finfo(_traceName);
-        QString prefix = finfo.fileName();
-        QDir dir = finfo.dir();
-        if (finfo.isDir()) {
-            prefix = QStringLiteral("callgrind.out");
-            _traceName += QLatin1String("/callgrind.out");
-        }
+    TraceMemoryUsage usage;
 
-        files = dir.entryList(QStringList() << prefix + "*", QDir::Files);
-        QStringList::Iterator it = files.begin();
-        for (; it != files.end(); ++it ) {
-            *it = dir.path() + "/" + *it;
-        }
+    if (_fixPool) {
+        FixPool::Statistics s = _fixPool->statistics();
+        usage.add(TraceMemoryUsage::FixPoolChunks, s.allocatedSize);
+        usage.setCostEncoding(s.rawSize, s.encodedSize);
     }
+    if (_dynPool)
+        usage.add(TraceMemoryUsage::DynPoolChunks, _dynPool->allocatedSize());
+    if (_costPool)
+        usage.add(TraceMemoryUsage::CostPoolChunks, _costPool->allocatedSize());
 
-    if (files.isEmpty()) {
+    usage.add(TraceMemoryUsage::PartItems, _parts.count() * sizeof(TracePart));
+
+    TraceObjectMap::Iterator oit;
+    for ( oit = _objectMap.begin(); oit != _objectMap.end(); ++oit ) {
+        usage.add(TraceMemoryUsage::ItemMaps,
+                  sizeof(QMapNode<QString, TraceObject>) +
+                  oit.key().size() * sizeof(QChar));
+        usage.add(TraceMemoryUsage::PartItems,
+                  (*oit).deps().count() * sizeof(TracePartObject));
+    }
+
+    TraceClassMap::Iterator cit;
+    for ( cit = _classMap.begin(); cit != _classMap.end(); ++cit ) {
+        usage.add(TraceMemoryUsage::ItemMaps,
+                  sizeof(QMapNode<QString, TraceClass>) +
+                  cit.key().size() * sizeof(QChar));
+        usage.add(TraceMemoryUsage::PartItems,
+                  (*cit).deps().count() * sizeof(TracePartClass));
+    }
+
+    TraceFileMap::Iterator fiit;
+    for ( fiit = _fileMap.begin(); fiit != _fileMap.end(); ++fiit ) {
+        usage.add(TraceMemoryUsage::ItemMaps,
+                  sizeof(QMapNode<QString, TraceFile>) +
+                  fiit.key().size() * sizeof(QChar));
+        usage.add(TraceMemoryUsage::PartItems,
+                  (*fiit).deps().count() * sizeof(TracePartFile));
+    }
+
+    TraceFunctionMap::Iterator fit;
+    for ( fit = _functionMap.begin(); fit != _functionMap.end(); ++fit ) {
+        TraceFunction& f = *fit;
+        usage.add(TraceMemoryUsage::ItemMaps,
+                  sizeof(QMapNode<QString, TraceFunction>) +
+                  fit.key().size() * sizeof(QChar) +
+                  f.sourceFiles().count() * sizeof(TraceFunctionSource));
+        usage.add(TraceMemoryUsage::PartItems,
+                  f.deps().count() * sizeof(TracePartFunction));
+        foreach(TraceCall* c, f.callings())
+            usage.add(TraceMemoryUsage::Calls,
+                      sizeof(TraceCall) +
+                      c->deps().count() * sizeof(TracePartCall));
+        usage.add(TraceMemoryUsage::LineMaps, f.lineMapBytes());
+        usage.add(TraceMemoryUsage::InstrMaps, f.instrMapBytes());
+    }
+
+    return usage;
+}
+
+void TraceData::mapsBuilt(TraceFunction* f)
+{
+    // cycles are recreated on cycle detection
+    if (f->isCycle()) return;
+
+    // cost arrays of map items go back to the CostPool when evicted
+    quint64 bytes = f->lineMapBytes(true) + f->instrMapBytes(true);
+    _mapBytes = _mapBytes - _mapFunctions.value(f, 0) + bytes;
+    _mapFunctions.insert(f, bytes);
+    f->mapsUsed();
+
+    quint64 budget = (quint64) GlobalConfig::mapMemoryBudget() << 20;
+    if ((budget == 0) || (_mapBytes <= budget)) return;
+
+    // free more than needed to not evict on every map built
+    evictMaps(budget / 4 * 3);
+}
+
+class MapUseLessThan
+{
+public:
+    bool operator()(const TraceFunction* f1, const TraceFunction* f2) const
+    {
+        return f1->mapUse() < f2->mapUse();
+    }
+};
+
+// maps of this number of recently used functions are never freed, as
+// views may still show items of them
+#define MAP_KEEP_RECENT 8
+
+void TraceData::evictMaps(quint64 bytes)
+{
+    QList<TraceFunction*> functions = _mapFunctions.keys();
+    std::sort(functions.begin(), functions.end(), MapUseLessThan());
+
+    int evictable = functions.count() - MAP_KEEP_RECENT;
+    for(int i = 0; (i < evictable) && (_mapBytes > bytes); i++) {
+        TraceFunction* f = functions[i];
+        if (!f->evictMaps()) continue;
+
+        _mapBytes -= _mapFunctions.take(f);
+    }
+
+    if (0) qDebug("TraceData::evictMaps: %d functions with %llu KB of maps left",
+                  _mapFunctions.count(), _mapBytes / 1024);
+}
+
+bool partLessThan(const TracePart* p1, const TracePart* p2)
+{
+    return *p1 < *p2;
+}
+
+//
+// FileLoadJob
+//
+
+/**
+ * Parses one profile data file into a private TraceData object in a
+ * worker thread, and keeps the loaded parts as memory image in the
+ * profile cache format. Warnings and errors are recorded to be
+ * replayed when the image gets merged. <finished> is released when
+ * the job is done.
+ */
+class FileLoadJob: public QRunnable, public Logger
+{
+public:
+    FileLoadJob(const QString& file, Logger* logger, bool writeCache,
+                QSemaphore* finished);
+
+    void run() Q_DECL_OVERRIDE;
+
+    bool isFinished() const { return _finished.loadAcquire() != 0; }
+    // after the job is done
+    int parts() const { return _parts; }
+    const QByteArray& image() const { return _image; }
+    QString finishMessage() const { return _finishMessage; }
+    void replay(Logger*);
+
+    // can be queried while running
+    int progress() const { return _progress.loadAcquire(); }
+
+    // Logger interface, called in the worker thread
+    void loadStart(const QString& filename) Q_DECL_OVERRIDE;
+    void loadProgress(int progress) Q_DECL_OVERRIDE;
+    void loadWarning(int line, const QString& msg) Q_DECL_OVERRIDE;
+    void loadError(int line, const QString& msg) Q_DECL_OVERRIDE;
+    void loadFinished(const QString& msg) Q_DECL_OVERRIDE;
+    bool isLoadCanceled() Q_DECL_OVERRIDE;
+
+private:
+    struct Message {
+        bool isError;
+        int line;
+        QString msg;
+    };
+
+    void load();
+
+    QString _file;
+    // main logger, only asked for cancelation
+    Logger* _logger;
+    bool _writeCache;
+    int _parts;
+    QByteArray _image;
+    QList<Message> _messages;
+    QString _finishMessage;
+    QAtomicInt _progress;
+    QAtomicInt _finished;
+    QSemaphore* _finishedSemaphore;
+};
+
+FileLoadJob::FileLoadJob(const QString& file, Logger* logger, bool writeCache,
+                         QSemaphore* finished)
+{
+    setAutoDelete(false);
+
+    _file = file;
+    _logger = logger;
+    _writeCache = writeCache;
+    _parts = 0;
+    _finishedSemaphore = finished;
+}
+
+void FileLoadJob::run()
+{
+    load();
+
+    _finished.storeRelease(1);
+    _finishedSemaphore->release();
+}
+
+void FileLoadJob::load()
+{
+    TraceData data(this);
+
+    // compressed files are decompressed while loading
+    QIODevice* file;
+    if (DecompressDevice::decompressor(_file).isEmpty())
+        file = new QFile(_file);
+    else
+        file = new DecompressDevice(_file);
+    _parts = data.internalLoad(file, _file);
+    delete file;
+
+    if ((_parts == 0) || isLoadCanceled()) return;
+
+    _image = ProfileCache::image(&data, data.parts(), _file);
+    if (_writeCache)
+        ProfileCache::writeImage(_image, _file);
+}
+
+void FileLoadJob::replay(Logger* l)
+{
+    foreach(const Message& m, _messages) {
+        if (m.isError)
+            l->loadError(m.line, m.msg);
+        else
+            l->loadWarning(m.line, m.msg);
+    }
+}
+
+void FileLoadJob::loadStart(const QString&)
+{
+    _progress.storeRelease(0);
+}
+
+void FileLoadJob::loadProgress(int progress)
+{
+    _progress.storeRelease(progress);
+}
+
+void FileLoadJob::loadWarning(int line, const QString& msg)
+{
+    Message m = { false, line, msg };
+    _messages.append(m);
+}
+
+void FileLoadJob::loadError(int line, const QString& msg)
+{
+    Message m = { true, line, msg };
+    _messages.append(m);
+}
+
+void FileLoadJob::loadFinished(const QString& msg)
+{
+    _finishMessage = msg;
+    _progress.storeRelease(100);
+}
+
+bool FileLoadJob::isLoadCanceled()
+{
+    return _logger && _logger->isLoadCanceled();
+}
+
+
+// existing files starting with file name of <prefix>, with path
+static QStringList filesWithPrefix(const QString& prefix)
+{
+    QFileInfo finfo(prefix);
+    QDir dir = finfo.dir();
+
+    QStringList files = dir.entryList(QStringList() << finfo.fileName() + "*",
+                                      QDir::Files);
+    QStringList::Iterator it = files.begin();
+    for (; it != files.end(); ++it ) {
+        *it = dir.path() + "/" + *it;
+    }
+    return files;
+}
+
+/**
+ * Load a list of files.
+ * If only one file is given, it is assumed to be a prefix, and all
+ * existing files with that prefix are loaded.
+ *
+ * Returns 0 if nothing found to load
+ */
+int TraceData::load(QStringList files)
+{
+    if (files.isEmpty()) return 0;
+
+    _traceName = files[0];
+    if (files.count() == 1) {
+        if (QFileInfo(_traceName).isDir())
+            _traceName += QLatin1String("/callgrind.out");
+        files = filesWithPrefix(_traceName);
+    }
+
+    if (files.isEmpty()) {
         _traceName += ' ' + QObject::tr("(not found)");
         return 0;
     }
 
-    QStringList::const_iterator it;
-    int partsLoaded = 0;
-    for (it = files.constBegin(); it != files.constEnd(); ++it ) {
-        QFile file(*it);
-        partsLoaded += internalLoad(&file, *it);
-    }
+    int partsLoaded = loadFiles(files);
+    if (loadCanceled()) return 0;
     if (partsLoaded == 0) return 0;
 
     std::sort(_parts.begin(), _parts.end(), partLessThan);
@@ -3170,6 +3716,229 @@ int TraceData::load(QStringList files)
     return partsLoaded;
 }
 
+// time a new part file has to be unchanged to be taken as complete
+#define PART_STABLE_MSECS 2000
+
+QStringList TraceData::newPartFiles(bool* pending) const
+{
+    QSet<QString> loaded;
+    foreach(TracePart* part, _parts)
+        loaded.insert(QFileInfo(part->name()).absoluteFilePath());
+
+    if (pending) *pending = false;
+    QDateTime now = QDateTime::currentDateTime();
+    QStringList files;
+    foreach(const QString& file, filesWithPrefix(_traceName)) {
+        QFileInfo fi(file);
+        if (loaded.contains(fi.absoluteFilePath())) continue;
+
+        // a dump still being written would be loaded incomplete.
+        // Modification times in the future (clock skew) are ignored
+        qint64 age = fi.lastModified().msecsTo(now);
+        if ((age >= 0) && (age < PART_STABLE_MSECS)) {
+            if (pending) *pending = true;
+            continue;
+        }
+        files << file;
+    }
+    return files;
+}
+
+QByteArray TraceData::parseImage(const QString& file, Logger* logger)
+{
+    TraceData data(logger);
+    data._traceName = file;
+
+    int parts = data.loadFile(file);
+    if ((parts == 0) || (logger && logger->isLoadCanceled())) return QByteArray();
+
+    return ProfileCache::image(&data, data.parts(), file);
+}
+
+int TraceData::addImages(const QStringList& files,
+                         const QList<QByteArray>& images)
+{
+    int oldPartCount = _parts.count();
+    int oldFunctionCount = _functionMap.count();
+    int oldCallCount = callCount();
+
+    int partsLoaded = 0;
+    for(int i=0; (i<files.count()) && (i<images.count()); i++)
+        if (!images[i].isEmpty())
+            partsLoaded += ProfileCache::loadImage(this, images[i], files[i]);
+    if (partsLoaded == 0) return 0;
+
+    partsAdded(oldPartCount, oldFunctionCount, oldCallCount);
+    return partsLoaded;
+}
+
+// update after parts were appended to a list of <oldPartCount> parts
+void TraceData::partsAdded(int oldPartCount,
+                           int oldFunctionCount, int oldCallCount)
+{
+    TracePartList newParts = _parts.mid(oldPartCount);
+    std::sort(_parts.begin(), _parts.end(), partLessThan);
+
+    // new items are invalid already
+    invalidateDynamicCost(newParts);
+    if ((_functionMap.count() != oldFunctionCount) ||
+        (callCount() != oldCallCount)) {
+        // cycles may have changed
+        updateFunctionCycles();
+    }
+}
+
+// number of caller/called relations
+int TraceData::callCount() const
+{
+    int count = 0;
+    TraceFunctionMap::ConstIterator it;
+    for ( it = _functionMap.constBegin(); it != _functionMap.constEnd(); ++it )
+        count += (*it).callings().count();
+    return count;
+}
+
+// loading without a logger can not be canceled
+bool TraceData::loadCanceled() const
+{
+    return _logger && _logger->isLoadCanceled();
+}
+
+int TraceData::loadFiles(const QStringList& files)
+{
+    bool parallel = false;
+#if USE_FIXCOST
+    // files are merged via cache images
+    parallel = GlobalConfig::parallelLoading() &&
+               GlobalConfig::parallelFileLoading() &&
+               (files.count() > 1) &&
+               (QThread::idealThreadCount() > 1);
+#endif
+    if (parallel)
+        return loadFilesParallel(files);
+
+    int partsLoaded = 0;
+    foreach(const QString& file, files) {
+        partsLoaded += loadFile(file);
+        if (loadCanceled()) break;
+    }
+    return partsLoaded;
+}
+
+// add parts from one file, using and updating its cache
+int TraceData::loadFile(const QString& name)
+{
+    bool useCache = GlobalConfig::useProfileCache();
+    int parts = 0;
+
+    QString cacheFile;
+    if (useCache)
+        cacheFile = ProfileCache::validCacheFile(name);
+    if (!cacheFile.isEmpty()) {
+        QFile file(cacheFile);
+        parts = internalLoad(&file, name);
+    }
+    if (loadCanceled()) return 0;
+
+    // no valid cache: parse profile data
+    if (parts == 0) {
+        // compressed files are decompressed while loading
+        QIODevice* file;
+        if (DecompressDevice::decompressor(name).isEmpty())
+            file = new QFile(name);
+        else
+            file = new DecompressDevice(name);
+        parts = internalLoad(file, name);
+        delete file;
+        if (loadCanceled()) return 0;
+
+        if ((parts > 0) && useCache)
+            ProfileCache::write(this, _parts.mid(_parts.count() - parts), name);
+    }
+
+    return parts;
+}
+
+/* Profile data files are parsed concurrently into private TraceData
+ * objects, and merged in order of <files> as soon as they are done,
+ * so that the result is the same as with sequential loading. Parsing
+ * is limited to a few files ahead of the next one to be merged: the
+ * memory needed for images waiting to be merged does not depend on
+ * the number of files.
+ * Files with a valid cache do not need parsing and are loaded in
+ * the merge step.
+ */
+int TraceData::loadFilesParallel(const QStringList& files)
+{
+    bool useCache = GlobalConfig::useProfileCache();
+
+    // own pool: loaders use the global one for tokenizing chunks
+    QThreadPool pool;
+    pool.setMaxThreadCount(QThread::idealThreadCount());
+    int maxPending = pool.maxThreadCount();
+
+    QSemaphore finished;
+    QVector<FileLoadJob*> jobs(files.count(), 0);
+    int next = 0, pending = 0;
+    int partsLoaded = 0;
+
+    if (_logger) _logger->loadStart(_traceName);
+    for(int i=0; i<files.count(); i++) {
+        // keep the pool busy with files following the current one
+        while((next < files.count()) && (pending < maxPending)) {
+            const QString& file = files[next];
+            if (!useCache || ProfileCache::validCacheFile(file).isEmpty()) {
+                jobs[next] = new FileLoadJob(file, _logger, useCache, &finished);
+                pool.start(jobs[next]);
+                pending++;
+            }
+            next++;
+        }
+
+        FileLoadJob* job = jobs[i];
+        if (!job) {
+            // valid cache
+            partsLoaded += loadFile(files[i]);
+            if (_logger) _logger->loadStart(_traceName);
+            if (loadCanceled()) break;
+            continue;
+        }
+
+        while(!job->isFinished()) {
+            // wakes up on any finished job, or for progress
+            finished.tryAcquire(1, 100);
+            if (_logger)
+                _logger->loadProgress((100 * i + job->progress()) / files.count());
+        }
+        if (loadCanceled()) break;
+
+        if (_logger) {
+            _logger->loadStart(files[i]);
+            job->replay(_logger);
+            _logger->loadFinished(job->finishMessage());
+        }
+        int parts = 0;
+        if (!job->image().isEmpty())
+            parts = ProfileCache::loadImage(this, job->image(), files[i]);
+        // nothing is added from an invalid image: parse sequentially
+        if ((parts == 0) && (job->parts() > 0))
+            parts = loadFile(files[i]);
+        partsLoaded += parts;
+        if (_logger) _logger->loadStart(_traceName);
+
+        delete job;
+        jobs[i] = 0;
+        pending--;
+    }
+    if (_logger) _logger->loadFinished(QString());
+
+    // jobs still running after cancellation
+    pool.waitForDone();
+    qDeleteAll(jobs);
+
+    return partsLoaded;
+}
+
 int TraceData::load(QString file)
 {
     return load(QStringList(file));
@@ -3179,6 +3948,7 @@ int TraceData::load(QIODevice* file, const QString& filename)
 {
     _traceName = filename;
     int partsLoaded = internalLoad(file, filename);
+    if (loadCanceled()) return 0;
     if (partsLoaded>0) {
         invalidateDynamicCost();
         updateFunctionCycles();
@@ -3189,8 +3959,10 @@ int TraceData::load(QIODevice* file, const QString& filename)
 int TraceData::internalLoad(QIODevice* device, const QString& filename)
 {
     if (!device->open( QIODevice::ReadOnly ) ) {
-        _logger->loadStart(filename);
-        _logger->loadFinished(QString::fromLocal8Bit(strerror( errno )));
+        if (_logger) {
+            _logger->loadStart(filename);
+            _logger->loadFinished(QString::fromLocal8Bit(strerror( errno )));
+        }
         return 0;
     }
 
@@ -3199,54 +3971,106 @@ int TraceData::internalLoad(QIODevice* device, const QString& filename)
         // special case emtpy file: ignore...
         if (device->size() == 0) return 0;
 
-        _logger->loadStart(filename);
-        _logger->loadFinished(QStringLiteral("Unknown file format"));
+        if (_logger) {
+            _logger->loadStart(filename);
+            _logger->loadFinished(QStringLiteral("Unknown file format"));
+        }
         return 0;
     }
-    l->setLogger(_logger);
-
+    // loaders get the logger via logger(): loader instances are shared
     int partsLoaded = l->load(this, device, filename);
 
-    l->setLogger(0);
-
     return partsLoaded;
 }
 
 bool TraceData::activateParts(const TracePartList& l)
 {
-    bool changed = false;
+    TracePartList changed;
+    QSet<TracePart*> active = l.toSet();
 
     foreach(TracePart* part, _parts)
-        if (part->activate(l.contains(part)))
-            changed = true;
+        if (part->activate(active.contains(part)))
+            changed.append(part);
 
-    if (changed) {
-        // because active parts have changed, throw away calculated
-        // costs...
-        invalidateDynamicCost();
-        updateFunctionCycles();
-    }
+    if (changed.isEmpty()) return false;
 
-    return changed;
+    partsActivated(changed);
+    return true;
 }
 
 
 bool TraceData::activateParts(TracePartList l, bool active)
 {
-    bool changed = false;
+    TracePartList changed;
 
     foreach(TracePart* part, l) {
         if (_parts.contains(part))
             if (part->activate(active))
-                changed = true;
+                changed.append(part);
     }
 
-    if (changed) {
+    if (changed.isEmpty()) return false;
+
+    partsActivated(changed);
+    return true;
+}
+
+/* With few changed parts, only the contributions of these parts are
+ * added to/subtracted from costs already calculated: with hundreds of
+ * parts, switching between two of them then is cheap. Costs not yet
+ * calculated stay invalid and will use the new active parts. If most
+ * parts changed, throwing away calculated costs is faster.
+ */
+void TraceData::partsActivated(const TracePartList& parts)
+{
+#if USE_FIXCOST
+    if (2 * parts.count() > _parts.count()) {
         invalidateDynamicCost();
         updateFunctionCycles();
+        return;
+    }
+
+    QSet<TraceFunction*> functions;
+    foreach(TracePart* part, parts) {
+        bool active = part->isActive();
+
+        // functions with cost in a part are the dependencies of the part
+        foreach(ProfileCostArray* dep, part->deps()) {
+            TracePartFunction* pf = (TracePartFunction*) dep;
+            TraceFunction* f = pf->function();
+
+            f->partActivated(pf, active);
+            functions.insert(f);
+            // call counts of called functions change, too
+            foreach(TracePartCall* pc, pf->partCallings())
+                functions.insert(pc->call()->called(true));
+
+            if (pf->partObject() &&
+                !pf->partObject()->object()->activateDep(pf, active))
+                pf->partObject()->object()->invalidate();
+            if (pf->partClass() &&
+                !pf->partClass()->cls()->activateDep(pf, active))
+                pf->partClass()->cls()->invalidate();
+            if (pf->partFile() &&
+                !pf->partFile()->file()->activateDep(pf, active))
+                pf->partFile()->file()->invalidate();
+        }
+
+        if (!_dirty)
+            addCostDelta(part->totals(), active);
     }
 
-    return changed;
+    foreach(TraceFunction* f, functions)
+        f->partActivationDone();
+
+    // cycle detection depends on call costs
+    if (GlobalConfig::showCycles())
+        updateFunctionCycles();
+#else
+    Q_UNUSED(parts);
+    invalidateDynamicCost();
+    updateFunctionCycles();
+#endif
 }
 
 bool TraceData::activatePart(TracePart* p, bool active)
@@ -3334,6 +4158,39 @@ void TraceData::invalidateDynamicCost()
 
 }
 
+void TraceData::invalidateDynamicCost(const TracePartList& parts)
+{
+#if USE_FIXCOST
+    // functions with cost in a part are the dependencies of the part
+    QSet<TraceFunction*> functions;
+    foreach(TracePart* part, parts)
+        foreach(ProfileCostArray* dep, part->deps()) {
+            TracePartFunction* pf = (TracePartFunction*) dep;
+            functions.insert(pf->function());
+            // call counts of called functions change, too
+            foreach(TracePartCall* pc, pf->partCallings())
+                functions.insert(pc->call()->called(true));
+        }
+
+    foreach(TraceFunction* f, functions) {
+        f->invalidateDynamicCost();
+        if (f->cycle()) f->cycle()->invalidateDynamicCost();
+
+        if (f->object()) f->object()->invalidate();
+        if (f->cls()) f->cls()->invalidate();
+        if (f->file()) f->file()->invalidate();
+        // inlined code can come from other files
+        foreach(TraceFunctionSource* sf, f->sourceFiles())
+            sf->file()->invalidate();
+    }
+
+    invalidate();
+#else
+    Q_UNUSED(parts);
+    invalidateDynamicCost();
+#endif
+}
+
 
 TraceObject* TraceData::object(const QString& name)
 {
@@ -3341,6 +4198,7 @@ TraceObject* TraceData::object(const QString& name)
     if (!o.data()) {
         // was created
         o.setPosition(this);
+        _lowerNamesValid = false;
         o.setName(name);
 
 #if TRACE_DEBUG
@@ -3358,6 +4216,7 @@ TraceFile* TraceData::file(const QString& name)
     if (!f.data()) {
         // was created
         f.setPosition(this);
+        _lowerNamesValid = false;
         f.setName(name);
 
 #if TRACE_DEBUG
@@ -3397,6 +4256,7 @@ TraceClass* TraceData::cls(const QString& fnName, QString& shortName)
     if (!c.data()) {
         // was created
         c.setPosition(this);
+        _lowerNamesValid = false;
         c.setName(clsName);
 
 #if TRACE_DEBUG
@@ -3412,15 +4272,20 @@ TraceClass* TraceData::cls(const QString& fnName, QString& shortName)
 TraceFunction* TraceData::function(const QString& name,
                                    TraceFile* file, TraceObject* object)
 {
-    // strip class name
-    QString shortName;
-    TraceClass* c = cls(name, shortName);
-
-    if (!file || !object || !c) {
-        qDebug("ERROR - no file/object/class for %s ?!", qPrintable(name));
+    if (!file || !object) {
+        qDebug("ERROR - no file/object for %s ?!", qPrintable(name));
         return 0;
     }
 
+    // functions seen before are found with one hash lookup, without
+    // building the key string and splitting off the class name
+    const char* tableKey = (const char*) name.constData();
+    int tableKeyLen = name.length() * (int) sizeof(QChar);
+    TraceFunction* found;
+    found = (TraceFunction*) _functionTable.find(tableKey, tableKeyLen,
+                                                 file, object);
+    if (found) return found;
+
     // Use object name and file name as part of key, to get distinct
     // function objects for functions with same name but defined in
     // different ELF objects or different files (this is possible e.g.
@@ -3448,12 +4313,18 @@ TraceFunction* TraceData::function(const QString& name,
     TraceFunctionMap::Iterator it;
     it = _functionMap.find(key);
     if (it == _functionMap.end()) {
+        // strip class name
+        QString shortName;
+        TraceClass* c = cls(name, shortName);
+
         it = _functionMap.insert(key, TraceFunction());
         TraceFunction& f = it.value();
 
         f.setPosition(this);
         f.setName(name);
         f.setClass(c);
+        _functionNamesValid = false;
+        _lowerNamesValid = false;
         f.setObject(object);
         f.setFile(file);
         //f.setMapIterator(it);
@@ -3470,6 +4341,10 @@ TraceFunction* TraceData::function(const QString& name,
         file->addFunction(&f);
     }
 
+    // key strings of different (file, object) pairs may be equal
+    _functionTable.insert(tableKey, tableKeyLen, &(it.value()),
+                          file, object);
+
     return &(it.value());
 }
 
@@ -3514,6 +4389,7 @@ void TraceData::resetSourceDirs()
 void TraceData::update()
 {
     if (!_dirty) return;
+    countUpdate();
 
     clear();
     _totals.clear();
@@ -3527,107 +4403,132 @@ void TraceData::update()
     _dirty = false;
 }
 
-ProfileCostArray* TraceData::search(ProfileContext::Type t, QString name,
-                                    EventType* ct, ProfileCostArray* parent)
-{
-    ProfileCostArray* result = 0;
-    ProfileContext::Type pt;
-    SubCost sc, scTop = 0;
+QList<TraceCostItem*> TraceData::itemsWithName(ProfileContext::Type t,
+                                                const QString& name,
+                                                Qt::CaseSensitivity cs)
+{
+    QList<TraceCostItem*> items;
+
+    if (cs == Qt::CaseInsensitive) {
+        if (!_lowerNamesValid) {
+            _lowerNames.clear();
+            _lowerNames.reserve(_objectMap.count() + _fileMap.count() +
+                                _classMap.count() + _functionMap.count());
+            TraceObjectMap::Iterator oit;
+            for ( oit = _objectMap.begin(); oit != _objectMap.end(); ++oit )
+                _lowerNames.insert((*oit).name().toLower(), &(*oit));
+            TraceFileMap::Iterator fit;
+            for ( fit = _fileMap.begin(); fit != _fileMap.end(); ++fit )
+                _lowerNames.insert((*fit).name().toLower(), &(*fit));
+            TraceClassMap::Iterator cit;
+            for ( cit = _classMap.begin(); cit != _classMap.end(); ++cit )
+                _lowerNames.insert((*cit).name().toLower(), &(*cit));
+            TraceFunctionMap::Iterator it;
+            for ( it = _functionMap.begin(); it != _functionMap.end(); ++it )
+                _lowerNames.insert((*it).name().toLower(), &(*it));
+            _lowerNamesValid = true;
+        }
+
+        foreach(TraceCostItem* i, _lowerNames.values(name.toLower()))
+            if (i->type() == t) items.append(i);
+        return items;
+    }
 
-    pt = parent ? parent->type() : ProfileContext::InvalidType;
     switch(t) {
     case ProfileContext::Function:
     {
-        TraceFunction *f;
-        TraceFunctionMap::Iterator it;
-        for ( it = _functionMap.begin();
-              it != _functionMap.end(); ++it ) {
-            f = &(*it);
-
-            if (f->name() != name) continue;
-
-            if ((pt == ProfileContext::Class) && (parent != f->cls())) continue;
-            if ((pt == ProfileContext::File) && (parent != f->file())) continue;
-            if ((pt == ProfileContext::Object) && (parent != f->object())) continue;
-
-            if (ct) {
-                sc = f->inclusive()->subCost(ct);
-                if (sc <= scTop) continue;
-                scTop = sc;
-            }
-
-            result = f;
+        if (!_functionNamesValid) {
+            _functionNames.clear();
+            _functionNames.reserve(_functionMap.count());
+            TraceFunctionMap::Iterator it;
+            for ( it = _functionMap.begin(); it != _functionMap.end(); ++it )
+                _functionNames.insert((*it).name(), &(*it));
+            _functionNamesValid = true;
         }
+        foreach(TraceFunction* f, _functionNames.values(name))
+            items.append(f);
     }
         break;
 
     case ProfileContext::File:
     {
-        TraceFile *f;
-        TraceFileMap::Iterator it;
-        for ( it = _fileMap.begin();
-              it != _fileMap.end(); ++it ) {
-            f = &(*it);
-            if (f->name() != name) continue;
-            if (ct) {
-                sc = f->subCost(ct);
-                if (sc <= scTop) continue;
-                scTop = sc;
-            }
-            result = f;
-        }
+        TraceFileMap::Iterator it = _fileMap.find(name);
+        if (it != _fileMap.end()) items.append(&(*it));
     }
         break;
 
     case ProfileContext::Class:
     {
-        TraceClass *c;
-        TraceClassMap::Iterator it;
-        for ( it = _classMap.begin();
-              it != _classMap.end(); ++it ) {
-            c = &(*it);
-            if (c->name() != name) continue;
-            if (ct) {
-                sc = c->subCost(ct);
-                if (sc <= scTop) continue;
-                scTop = sc;
-            }
-            result = c;
-        }
+        TraceClassMap::Iterator it = _classMap.find(name);
+        if (it != _classMap.end()) items.append(&(*it));
     }
         break;
 
     case ProfileContext::Object:
     {
-        TraceObject *o;
-        TraceObjectMap::Iterator it;
-        for ( it = _objectMap.begin();
-              it != _objectMap.end(); ++it ) {
-            o = &(*it);
-            if (o->name() != name) continue;
+        TraceObjectMap::Iterator it = _objectMap.find(name);
+        if (it != _objectMap.end()) items.append(&(*it));
+    }
+        break;
+
+    default:
+        break;
+    }
+
+    return items;
+}
+
+ProfileCostArray* TraceData::search(ProfileContext::Type t, QString name,
+                                    EventType* ct, ProfileCostArray* parent,
+                                    Qt::CaseSensitivity cs)
+{
+    ProfileCostArray* result = 0;
+    ProfileContext::Type pt;
+    SubCost sc, scTop = 0;
+
+    pt = parent ? parent->type() : ProfileContext::InvalidType;
+    switch(t) {
+    case ProfileContext::Function:
+    case ProfileContext::File:
+    case ProfileContext::Class:
+    case ProfileContext::Object:
+    {
+        foreach(TraceCostItem* i, itemsWithName(t, name, cs)) {
+            if (t == ProfileContext::Function) {
+                TraceFunction* f = (TraceFunction*) i;
+                if ((pt == ProfileContext::Class) && (parent != f->cls())) continue;
+                if ((pt == ProfileContext::File) && (parent != f->file())) continue;
+                if ((pt == ProfileContext::Object) && (parent != f->object())) continue;
+            }
+
             if (ct) {
-                sc = o->subCost(ct);
+                sc = (t == ProfileContext::Function) ?
+                         ((TraceFunction*)i)->inclusive()->subCost(ct) :
+                         i->subCost(ct);
                 if (sc <= scTop) continue;
                 scTop = sc;
             }
-            result = o;
+
+            result = i;
         }
     }
         break;
 
     case ProfileContext::Instr:
         if (pt == ProfileContext::Function) {
-            TraceInstrMap* instrMap = ((TraceFunction*)parent)->instrMap();
-            if (!instrMap) break;
-
-            TraceInstr *instr;
-            TraceInstrMap::Iterator it;
-            for ( it = instrMap->begin();
-                  it != instrMap->end(); ++it ) {
-                instr = &(*it);
-                if (instr->name() != name) continue;
+            TraceFunction* f = (TraceFunction*)parent;
+            if (!f->instrMap()) break;
+
+            // names are "0x<hex address>"
+            if (!name.startsWith(QLatin1String("0x"), cs)) break;
+            Addr addr;
+            QByteArray hex = name.mid(2).toLatin1();
+            if (hex.isEmpty() || (addr.set(hex.constData()) != hex.length()))
+                break;
+
+            TraceInstr* instr = f->instr(addr, false);
+            if (instr && (instr->name().compare(name, cs) == 0))
                 result = instr;
-            }
         }
         break;
 
@@ -3640,6 +4541,11 @@ ProfileCostArray* TraceData::search(ProfileContext::Type t, QString name,
             sList.append((TraceFunctionSource*) parent);
         else break;
 
+        // names are "<file short name>:<line number>"
+        int pos = name.lastIndexOf(QLatin1Char(':'));
+        bool ok = false;
+        uint lineno = (pos < 0) ? 0 : name.mid(pos+1).toUInt(&ok);
+
         TraceLineMap* lineMap;
         TraceLine* line;
         TraceLineMap::Iterator it;
@@ -3647,10 +4553,20 @@ ProfileCostArray* TraceData::search(ProfileContext::Type t, QString name,
             lineMap = fs->lineMap();
             if (!lineMap) continue;
 
+            if (ok && (lineno > 0)) {
+                it = lineMap->find(lineno);
+                if (it == lineMap->end()) continue;
+                line = &(*it);
+                if (line->name().compare(name, cs) == 0)
+                    result = line;
+                continue;
+            }
+
+            // lines of files without name all have the same name
             for ( it = lineMap->begin();
                   it != lineMap->end(); ++it ) {
                 line = &(*it);
-                if (line->name() != name) continue;
+                if (line->name().compare(name, cs) != 0) continue;
                 result = line;
             }
         }
@@ -3684,6 +4600,16 @@ void TraceData::updateFunctionCycles()
 {
     //qDebug("Updating cycles...");
 
+    /* Only costs of cycles and of their members depend on the cycles:
+     * inclusive costs of members are calculated from calls. Instead of
+     * invalidating all costs, only former and new members are
+     * invalidated. Former members before cycle detection, as it uses
+     * inclusive costs.
+     */
+    TraceFunctionList oldMembers;
+    foreach(TraceFunctionCycle* cycle, _functionCycles)
+        oldMembers += cycle->members();
+
     // init cycle info
     foreach(TraceFunctionCycle* cycle, _functionCycles)
         cycle->init();
@@ -3692,35 +4618,116 @@ void TraceData::updateFunctionCycles()
     for ( it = _functionMap.begin(); it != _functionMap.end(); ++it )
         (*it).cycleReset();
 
+    foreach(TraceFunction* f, oldMembers)
+        f->invalidate();
+
     if (!GlobalConfig::showCycles()) return;
 
     _inFunctionCycleUpdate = true;
 
+    // compact call graph: function ids, and for each function the
+    // range in <callee> with ids of called functions
+    int count = _functionMap.count();
+    QVector<TraceFunction*> functions;
+    QHash<TraceFunction*, int> functionId;
+    functions.reserve(count);
+    functionId.reserve(count);
+    for ( it = _functionMap.begin(); it != _functionMap.end(); ++it ) {
+        functionId.insert(&(*it), functions.count());
+        functions.append(&(*it));
+    }
 
-#if 0
-    int fCount = _functionMap.size(), fNo = 0, progress=0, p;
-    QString msg = tr("Recalculating Function Cycles...");
-    if (_topLevel) _topLevel->showStatus(msg,0);
-#endif
+    /* cycle cut heuristic:
+     * skip calls for cycle detection if they make less than _cycleCut
+     * percent of the cost of the function.
+     * FIXME: Which cost type to use for this heuristic ?!
+     */
+    Q_ASSERT(eventTypes()->realCount()>0);
+    EventType* e = eventTypes()->realType(0);
+    double cycleCut = GlobalConfig::cycleCut();
+
+    QVector<int> first, callee;
+    first.reserve(count+1);
+    foreach(TraceFunction* f, functions) {
+        first.append(callee.count());
+
+        SubCost base = 0;
+        const TraceCallList& callers = f->callers(true);
+        if (callers.count()>0) {
+            foreach(TraceCall* caller, callers)
+                if (caller->subCost(e) > base)
+                    base = caller->subCost(e);
+        }
+        else base = f->inclusive()->subCost(e);
 
-    // DFS and collapse strong connected components (Tarjan)
+        SubCost cutLimit = SubCost(base * cycleCut);
+        foreach(TraceCall* call, f->callings(true)) {
+            if (call->subCost(e) < cutLimit) continue;
+            callee.append(functionId.value(call->called(true)));
+        }
+    }
+    first.append(callee.count());
+
+    /* collapse strong connected components (Tarjan).
+     * This does not mark functions calling themself!
+     * The DFS uses an explicit stack, as call chains can be very deep.
+     */
+    QVector<int> prefixNo(count, 0), low(count, 0);
+    QVector<bool> onStack(count, false);
+    QVector<int> sccStack, dfsStack, nextCall;
     int pNo = 0;
-    TraceFunction* stackTop;
-    for ( it = _functionMap.begin(); it != _functionMap.end(); ++it ) {
+    for (int root = 0; root < count; root++) {
+        if (prefixNo[root] != 0) continue;
+
+        prefixNo[root] = low[root] = ++pNo;
+        sccStack.append(root);
+        onStack[root] = true;
+        dfsStack.append(root);
+        nextCall.append(first[root]);
+
+        while(!dfsStack.isEmpty()) {
+            int f = dfsStack.last();
+            if (nextCall.last() < first[f+1]) {
+                int called = callee[nextCall.last()++];
+                if (prefixNo[called] == 0) {
+                    // not visited yet
+                    prefixNo[called] = low[called] = ++pNo;
+                    sccStack.append(called);
+                    onStack[called] = true;
+                    dfsStack.append(called);
+                    nextCall.append(first[called]);
+                }
+                else if (onStack[called] && (prefixNo[called] < low[f])) {
+                    // backlink to same SCC
+                    low[f] = prefixNo[called];
+                }
+                continue;
+            }
 
-#if 0
-        if (_topLevel) {
-            fNo++;
-            p = 100*fNo/fCount;
-            if (p> progress) {
-                progress = p;
-                _topLevel->showStatus(msg, p);
+            // all calls of f visited
+            dfsStack.removeLast();
+            nextCall.removeLast();
+            if (!dfsStack.isEmpty() && (low[f] < low[dfsStack.last()]))
+                low[dfsStack.last()] = low[f];
+
+            if (low[f] != prefixNo[f]) continue;
+
+            // f is the base of a SCC
+            if (sccStack.last() == f) {
+                sccStack.removeLast();
+                onStack[f] = false;
+                continue;
             }
-        }
-#endif
 
-        stackTop = 0;
-        (*it).cycleDFS(1, pNo, &stackTop);
+            // a SCC with >1 members
+            TraceFunctionCycle* cycle = functionCycle(functions[f]);
+            int member;
+            do {
+                member = sccStack.takeLast();
+                onStack[member] = false;
+                cycle->add(functions[member]);
+            } while(member != f);
+        }
     }
 
     // postprocess cycles
@@ -3728,8 +4735,12 @@ void TraceData::updateFunctionCycles()
         cycle->setup();
 
     _inFunctionCycleUpdate = false;
-    // we have to invalidate costs because cycles are now taken into account
-    invalidateDynamicCost();
+
+    foreach(TraceFunctionCycle* cycle, _functionCycles) {
+        cycle->invalidateDynamicCost();
+        foreach(TraceFunction* f, cycle->members())
+            f->invalidate();
+    }
 
 #if 0
     if (0) if (_topLevel) _topLevel->showStatus(QString(), 0);
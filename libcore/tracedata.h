@@ -27,7 +27,12 @@
 
 #include <qstring.h>
 #include <qstringlist.h>
+#include <qbytearray.h>
 #include <qmap.h>
+#include <qhash.h>
+#include <qvector.h>
+
+#include <algorithm>
 
 #include "costitem.h"
 #include "subcost.h"
@@ -123,6 +128,7 @@ class FixCallCost;
 class FixJump;
 class FixPool;
 class DynPool;
+class CostPool;
 class Logger;
 
 class ProfileCostArray;
@@ -191,8 +197,130 @@ typedef QMap<QString, TraceObject> TraceObjectMap;
 typedef QMap<QString, TraceClass> TraceClassMap;
 typedef QMap<QString, TraceFile> TraceFileMap;
 typedef QMap<QString, TraceFunction> TraceFunctionMap;
-typedef QMap<uint, TraceLine> TraceLineMap;
-typedef QMap<Addr, TraceInstr> TraceInstrMap;
+
+
+/**
+ * Lines of a source or instructions of a function by line number or
+ * address, iterated in key order like a QMap.
+ *
+ * Keys and item pointers are kept in sorted vectors: lookup is a binary
+ * search on contiguous keys. Items are allocated in arrays and never
+ * move. Building a map creates all items with one sort pass in one
+ * array, see insertKeys(). Items created one by one afterwards need a
+ * vector insertion. Iterators get invalid on insertion.
+ */
+template<class Key, class T>
+class TraceItemMap
+{
+public:
+    class Iterator
+    {
+    public:
+        Iterator() { _item = 0; }
+        explicit Iterator(T* const* item) { _item = item; }
+
+        T& operator*() const { return **_item; }
+        T* operator->() const { return *_item; }
+        Iterator& operator++() { ++_item; return *this; }
+        Iterator& operator--() { --_item; return *this; }
+        bool operator==(const Iterator& i) const { return _item == i._item; }
+        bool operator!=(const Iterator& i) const { return _item != i._item; }
+
+    private:
+        T* const* _item;
+    };
+    typedef Iterator ConstIterator;
+
+    TraceItemMap() {}
+    ~TraceItemMap() { foreach(T* a, _arrays) delete[] a; }
+
+    int count() const { return _items.count(); }
+    Iterator begin() const { return Iterator(_items.constData()); }
+    Iterator end() const { return Iterator(_items.constData() + _items.count()); }
+    ConstIterator constBegin() const { return begin(); }
+    ConstIterator constEnd() const { return end(); }
+
+    Iterator find(const Key& key) const
+    {
+        int i = lowerBound(key);
+        if ((i < _keys.count()) && (_keys[i] == key))
+            return Iterator(_items.constData() + i);
+        return end();
+    }
+
+    // item for <key>, default constructed if new
+    T& operator[](const Key& key)
+    {
+        int i = lowerBound(key);
+        if ((i < _keys.count()) && (_keys[i] == key)) return *_items[i];
+
+        T* item = new T[1];
+        _arrays.append(item);
+        _keys.insert(i, key);
+        _items.insert(i, item);
+        return *item;
+    }
+
+    /* Default construct items for all <keys> not in the map yet, in
+     * one array which is returned (0 if all keys exist). Afterwards,
+     * <keys> are the keys of the new items in order of the array.
+     */
+    T* insertKeys(QVector<Key>& keys)
+    {
+        std::sort(keys.begin(), keys.end());
+        int n = 0;
+        for(int i=0; i<keys.count(); i++) {
+            if ((n>0) && (keys[n-1] == keys[i])) continue;
+            if (find(keys[i]) != end()) continue;
+            keys[n++] = keys[i];
+        }
+        keys.resize(n);
+        if (n == 0) return 0;
+
+        T* array = new T[n];
+        _arrays.append(array);
+
+        // merge the sorted new keys with the existing ones
+        int count = _keys.count();
+        QVector<Key> mergedKeys(count + n);
+        QVector<T*> mergedItems(count + n);
+        int i = 0, j = 0;
+        for(int m=0; m<count+n; m++) {
+            if ((j == n) || ((i < count) && (_keys[i] < keys[j]))) {
+                mergedKeys[m] = _keys[i];
+                mergedItems[m] = _items[i++];
+            }
+            else {
+                mergedKeys[m] = keys[j];
+                mergedItems[m] = array + j++;
+            }
+        }
+        _keys = mergedKeys;
+        _items = mergedItems;
+
+        return array;
+    }
+
+    // heap bytes per item, for memory accounting
+    static int itemSize() { return sizeof(Key) + sizeof(T*) + sizeof(T); }
+
+private:
+    Q_DISABLE_COPY(TraceItemMap)
+
+    int lowerBound(const Key& key) const
+    {
+        return std::lower_bound(_keys.constBegin(), _keys.constEnd(), key)
+                - _keys.constBegin();
+    }
+
+    QVector<Key> _keys;
+    QVector<T*> _items;
+    // we are owner of the item arrays
+    QVector<T*> _arrays;
+};
+
+typedef TraceItemMap<uint, TraceLine> TraceLineMap;
+typedef TraceItemMap<Addr, TraceInstr> TraceInstrMap;
 
 
 /**
@@ -239,6 +367,8 @@ public:
     SubCost callCount();
     QString prettyCallCount();
     void addCallCount(SubCost c);
+    // see ProfileCostArray::addCostDelta()
+    void addCallCountDelta(SubCost c, bool add);
 
 protected:
     SubCost _callCount;
@@ -261,6 +391,8 @@ public:
     // additional cost metric
     ProfileCostArray* inclusive();
     void addInclusive(ProfileCostArray*);
+    // see ProfileCostArray::addCostDelta()
+    void addInclusiveDelta(ProfileCostArray*, bool add);
 
 protected:
     ProfileCostArray _inclusive;
@@ -343,6 +475,13 @@ public:
     TraceCallCostList deps() { return _deps; }
     void addDep(TraceCallCost*);
     TraceCallCost* findDepFromPart(TracePart*);
+    // forget all dependencies (without deleting them)
+    void clearDeps();
+
+    /* add/subtract cost of <dep> after its part was (de)activated.
+     * Returns false if nothing was done as we need an update anyway.
+     */
+    bool activateDep(TraceCallCost* dep, bool active);
 
 protected:
     // overwrite in subclass to change update behaviour
@@ -372,6 +511,9 @@ public:
     void addDep(TraceInclusiveCost*);
     TraceInclusiveCost* findDepFromPart(TracePart*);
 
+    // see TraceCallListCost::activateDep
+    bool activateDep(TraceInclusiveCost* dep, bool active);
+
 protected:
     // overwrite in subclass to change update behaviour
     virtual bool onlyActiveParts() { return false; }
@@ -552,6 +694,8 @@ public:
 
     void addPartInstr(TracePartInstr*);
     void addPartLine(TracePartLine*);
+    // maps of our function were freed, see TraceFunction::evictMaps()
+    void clearPartInstrsAndLines();
     void addPartCaller(TracePartCall*);
     void addPartCalling(TracePartCall*);
 
@@ -685,6 +829,15 @@ public:
     void setEventMapping(EventTypeMapping* sm) { _eventTypeMapping = sm; }
     EventTypeMapping* eventTypeMapping() { return _eventTypeMapping; }
 
+    // event type given by an "event:" line of the profile data file
+    struct EventDefinition {
+        QString name, longName, formula;
+    };
+    void addEventDefinition(const EventDefinition& d)
+    { _eventDefinitions.append(d); }
+    const QList<EventDefinition>& eventDefinitions() const
+    { return _eventDefinitions; }
+
     // returns true if something changed
     bool activate(bool);
     bool isActive() const { return _active; }
@@ -708,6 +861,8 @@ private:
 
     // event type mapping for all fix costs of this part
     EventTypeMapping* _eventTypeMapping;
+    // kept to be stored in the profile cache
+    QList<EventDefinition> _eventDefinitions;
 };
 
 
@@ -848,12 +1003,16 @@ public:
     void update() Q_DECL_OVERRIDE;
 
     void invalidateDynamicCost();
+    // the part of <partCall> was (de)activated
+    void partActivated(TracePartCall* partCall, bool active);
 
     // factories
     TracePartCall* partCall(TracePart*,
                             TracePartFunction*, TracePartFunction*);
     TraceLineCall* lineCall(TraceLine*);
     TraceInstrCall* instrCall(TraceInstr*);
+    // delete line/instr calls, e.g. when freeing maps of the caller
+    void clearLineAndInstrCalls();
 
     TraceFunction* caller(bool skipCycle=false) const;
     TraceFunction* called(bool skipCycle=false) const;
@@ -1041,11 +1200,22 @@ public:
     uint firstLineno();
     uint lastLineno();
     TraceLineMap* lineMap();
+    /* estimated bytes taken by the line map (without building it).
+     * With <costArrays>, cost arrays of the items are included, which
+     * TraceData::memoryUsage() counts as part of the CostPool.
+     */
+    quint64 lineMapBytes(bool costArrays = false) const;
+    // free the line map, it is built again on demand
+    void clearLineMap();
 
     void invalidateDynamicCost();
+    // invalidation on changed active parts, see TraceData::partsActivated()
+    void partActivated();
 
     /* factories */
     TraceLine* line(uint lineno, bool createNew = true);
+    // create lines for <linenos> at once, see TraceItemMap::insertKeys()
+    void createLines(QVector<uint>& linenos);
     TraceLineRegion* region(uint from, uint to, QString name,
                             bool createNew = true);
 
@@ -1131,6 +1301,12 @@ public:
     // this invalidate all subcosts of function depending on
     // active status of parts
     void invalidateDynamicCost();
+    /* the part of <partFunction> was (de)activated: only its cost
+     * is added/subtracted, sub costs are invalidated. Call counts are
+     * updated in partActivationDone(), after all changed parts.
+     */
+    void partActivated(TracePartFunction* partFunction, bool active);
+    void partActivationDone();
 
     void addCaller(TraceCall*);
 
@@ -1173,6 +1349,19 @@ public:
     Addr lastAddress() const;
     TraceInstrMap* instrMap();
 
+    /* Line maps of our sources and the instruction map are built on
+     * demand. For a memory budget, maps are freed again for least
+     * recently used functions, see TraceData::mapsBuilt().
+     */
+    quint64 lineMapBytes(bool costArrays = false) const;
+    quint64 instrMapBytes(bool costArrays = false) const;
+    void mapsUsed();
+    quint64 mapUse() const { return _mapUse; }
+    // maps with items referenced from maps of other functions are kept
+    void pinMaps() { _mapsPinned = true; }
+    // returns false if maps can not be freed
+    bool evictMaps();
+
     // cost metrics
     SubCost calledCount();
     SubCost callingCount();
@@ -1200,7 +1389,6 @@ public:
     bool isCycle();
     bool isCycleMember();
     void cycleReset();
-    void cycleDFS(int d, int& pNo, TraceFunction** pTop);
 
 protected:
     TraceCallList _callers; // list of calls we are called from
@@ -1209,6 +1397,7 @@ protected:
 
 private:
     bool isUniquePrefix(const QString&) const;
+    void countCalls();
     //TraceFunctionMap::Iterator _myMapIterator;
 
     TraceClass* _cls;
@@ -1218,14 +1407,12 @@ private:
     TraceFunctionSourceList _sourceFiles; // we are owner
     TraceInstrMap* _instrMap; // we are owner
     bool _instrMapFilled;
+    bool _mapsPinned;
+    quint64 _mapUse;
 
     // see TraceAssociation
     TraceAssociationList _associations;
 
-    // for cycle detection
-    int _cycleLow;
-    TraceFunction* _cycleStackDown;
-
     // cached
     SubCost _calledCount, _callingCount;
     int _calledContexts, _callingContexts;
@@ -1353,6 +1540,41 @@ private:
 };
 
 
+/**
+ * Memory taken by a TraceData, in bytes per category.
+ *
+ * Sizes of pools are the chunks taken from the heap. Other sizes are
+ * estimated from the number of items, without heap overhead. Cost
+ * arrays of all items are part of the CostPool chunks.
+ * Event counts stored in the FixPool are compactly encoded: the bytes
+ * they would take as plain SubCost values are given separately.
+ */
+class TraceMemoryUsage
+{
+public:
+    enum Category { FixPoolChunks = 0, DynPoolChunks, CostPoolChunks,
+                    ItemMaps, Calls, PartItems, LineMaps, InstrMaps,
+                    CategoryCount };
+
+    TraceMemoryUsage();
+
+    quint64 bytes(Category c) const { return _bytes[c]; }
+    void add(Category c, quint64 bytes) { _bytes[c] += bytes; }
+    quint64 total() const;
+
+    // event counts in FixPool: bytes as SubCost values, and encoded
+    quint64 rawCostBytes() const { return _rawCostBytes; }
+    quint64 encodedCostBytes() const { return _encodedCostBytes; }
+    void setCostEncoding(quint64 raw, quint64 encoded)
+    { _rawCostBytes = raw; _encodedCostBytes = encoded; }
+
+    static QString categoryName(Category);
+
+private:
+    quint64 _bytes[CategoryCount];
+    quint64 _rawCostBytes, _encodedCostBytes;
+};
+
 
 /**
  * This class holds profiling data of multiple tracefiles
@@ -1376,16 +1598,49 @@ public:
      * If a single file is given, it is assumed to be a prefix.
      *
      * This adjusts the EventTypeSet according to given cost types.
-     * Returns the number of parts loaded
+     * Returns the number of parts loaded, 0 if loading was canceled
      */
     int load(QStringList files);
     int load(QString file);
     int load(QIODevice*, const QString&);
 
-    /** returns true if something changed. These do NOT
-     * invalidate the dynamic costs on a activation change,
-     * i.e. all cost items depends on active parts.
-     * This has to be done by the caller when true is returned by
+    /**
+     * Files with the prefix of the trace name which appeared after
+     * loading, e.g. parts dumped by a running Callgrind since.
+     * Files modified within the last seconds may still be written:
+     * they are left out, and <*pending> is set to true. Ask again
+     * later for them.
+     */
+    QStringList newPartFiles(bool* pending = 0) const;
+
+    /**
+     * Parses <file> into a memory image in profile cache format, to be
+     * added to profile data with addImages(). This does not touch any
+     * existing profile data, and can be done in another thread while
+     * the data is shown. Notifications go to <logger>. The image is
+     * empty if nothing was loaded or loading was canceled.
+     */
+    static QByteArray parseImage(const QString& file, Logger* logger);
+    /**
+     * Adds the parts of <images> parsed from <files>, e.g. files from
+     * newPartFiles(). Only cost items depending on the new parts are
+     * invalidated, as long as the call graph did not change.
+     * Loading is not reported to the logger.
+     * Returns the number of parts added.
+     */
+    int addImages(const QStringList& files, const QList<QByteArray>& images);
+
+    /* consumer of notifications while loading. Without a logger,
+     * notifications are dropped and loading can not be canceled.
+     * A logger has to live as long as it is set
+     */
+    Logger* logger() const { return _logger; }
+    void setLogger(Logger* l) { _logger = l; }
+
+    /** returns true if something changed. These update the dynamic
+     * costs on a activation change, i.e. all cost items depending on
+     * active parts (see partsActivated()). activatePart() does NOT do
+     * this: it has to be done by the caller when true is returned by
      * calling invalidateDynamicCost().
      */
     bool activateParts(const TracePartList&);
@@ -1408,9 +1663,25 @@ public:
 
     EventTypeSet* eventTypes() { return &_eventTypes; }
 
-    // memory pools
+    // memory pools. Only the FixPool can be used from multiple threads
     FixPool* fixPool();
     DynPool* dynPool();
+    // for cost arrays of all items, see ProfileCostArray::reserve()
+    CostPool* costPool();
+
+    // memory taken by this profile data
+    TraceMemoryUsage memoryUsage();
+
+    /* Called by a function after building a line or instruction map.
+     * If the estimated memory of all built maps is above the budget
+     * (see GlobalConfig::mapMemoryBudget()), the maps of least
+     * recently used functions are freed.
+     */
+    void mapsBuilt(TraceFunction*);
+    // estimated bytes of maps registered with mapsBuilt()
+    quint64 mapBytes() const { return _mapBytes; }
+    // increasing use counter for LRU order of maps
+    quint64 nextMapUse() { return ++_mapUseCount; }
 
     // factories for object/file/class/function/line instances
     TraceObject* object(const QString& name);
@@ -1428,9 +1699,12 @@ public:
      *  Instr, Line, Call  => need parent of type Function
      * For Function, a parent of type Obj/File/Class can be given, but
      * is not needed.
+     * Objects, files, classes and functions are found via name indexes,
+     * instructions and lines via binary search in the maps of the parent.
      */
     ProfileCostArray* search(ProfileContext::Type, QString,
-                             EventType* ct = 0, ProfileCostArray* parent = 0);
+                             EventType* ct = 0, ProfileCostArray* parent = 0,
+                             Qt::CaseSensitivity cs = Qt::CaseSensitive);
 
     // for pretty function names without signature if unique...
     TraceFunctionMap::Iterator functionIterator(TraceFunction*);
@@ -1465,8 +1739,10 @@ public:
 
     // invalidates all cost items dependant on active state of parts
     void invalidateDynamicCost();
+    // invalidates cost items depending on given parts only
+    void invalidateDynamicCost(const TracePartList&);
 
-    // cycle detection
+    // cycle detection, invalidates costs of old and new cycle members
     void updateFunctionCycles();
     void updateObjectCycles();
     void updateClassCycles();
@@ -1474,9 +1750,27 @@ public:
     bool inFunctionCycleUpdate() { return _inFunctionCycleUpdate; }
 
 private:
+    // parses files in worker threads
+    friend class FileLoadJob;
+
     void init();
     // add profile parts from one file
     int internalLoad(QIODevice* file, const QString& filename);
+    int loadFile(const QString& filename);
+    int loadFiles(const QStringList& files);
+    int loadFilesParallel(const QStringList& files);
+    bool loadCanceled() const;
+    int callCount() const;
+    // invalidation and cycle update after adding parts
+    void partsAdded(int oldPartCount, int oldFunctionCount, int oldCallCount);
+    // adjust dynamic costs after activation change of <parts>
+    void partsActivated(const TracePartList& parts);
+    // free maps of least recently used functions down to <bytes>
+    void evictMaps(quint64 bytes);
+    // objects, files, classes or functions with <name>, for search()
+    QList<TraceCostItem*> itemsWithName(ProfileContext::Type,
+                                        const QString& name,
+                                        Qt::CaseSensitivity cs);
 
     // for notification callbacks
     Logger* _logger;
@@ -1488,6 +1782,7 @@ private:
 
     FixPool* _fixPool;
     DynPool* _dynPool;
+    CostPool* _costPool;
 
     // always the trace totals (not dependent on active parts)
     ProfileCostArray _totals;
@@ -1498,6 +1793,8 @@ private:
     TraceClassMap _classMap;
     TraceFileMap _fileMap;
     TraceFunctionMap _functionMap;
+    // (name, file, object) => function, for fast lookup in function()
+    NameTable _functionTable;
     QString _command;
     Arch _arch;
     QString _traceName;
@@ -1511,6 +1808,19 @@ private:
     TraceFunctionCycleList _functionCycles;
     int _functionCycleCount;
     bool _inFunctionCycleUpdate;
+
+    /* name indexes for search(), built on demand and invalidated when
+     * items are created. Names of objects, files and classes are the
+     * keys of their maps already.
+     */
+    QMultiHash<QString, TraceFunction*> _functionNames;
+    // lower case names of objects, files, classes and functions
+    QMultiHash<QString, TraceCostItem*> _lowerNames;
+    bool _functionNamesValid, _lowerNamesValid;
+
+    // functions with built maps => estimated bytes of maps
+    QHash<TraceFunction*, quint64> _mapFunctions;
+    quint64 _mapBytes, _mapUseCount;
 };
 
 
@@ -23,9 +23,115 @@
 #include "utils.h"
 
 #include <errno.h>
+#include <string.h>
 
 #include <QIODevice>
 #include <QFile>
+#include <QList>
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+
+// SSE2 is always there on x86_64, AVX2 is checked for at runtime
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#define FIXFILE_SIMD 1
+#include <immintrin.h>
+#else
+#define FIXFILE_SIMD 0
+#endif
+
+
+/*
+ * Fast scanning helpers for the loaders
+ */
+
+// length of line at <s>, ending with '\n' or 0, with at most <len> chars
+static uint64 lineLengthScalar(const char* s, uint64 len)
+{
+    uint64 i = 0;
+    while((i<len) && (s[i] != '\n') && (s[i] != 0)) i++;
+    return i;
+}
+
+#if FIXFILE_SIMD
+static uint64 lineLengthSSE2(const char* s, uint64 len)
+{
+    const __m128i nl = _mm_set1_epi8('\n');
+    const __m128i zero = _mm_setzero_si128();
+    uint64 i = 0;
+
+    for(; i+16 <= len; i += 16) {
+        __m128i d = _mm_loadu_si128((const __m128i*)(s+i));
+        int m = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(d, nl),
+                                               _mm_cmpeq_epi8(d, zero)));
+        if (m) return i + __builtin_ctz(m);
+    }
+    return i + lineLengthScalar(s+i, len-i);
+}
+
+__attribute__((target("avx2")))
+static uint64 lineLengthAVX2(const char* s, uint64 len)
+{
+    const __m256i nl = _mm256_set1_epi8('\n');
+    const __m256i zero = _mm256_setzero_si256();
+    uint64 i = 0;
+
+    for(; i+32 <= len; i += 32) {
+        __m256i d = _mm256_loadu_si256((const __m256i*)(s+i));
+        unsigned int m = (unsigned int)
+            _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(d, nl),
+                                                 _mm256_cmpeq_epi8(d, zero)));
+        if (m) return i + __builtin_ctz(m);
+    }
+    return i + lineLengthSSE2(s+i, len-i);
+}
+#endif
+
+typedef uint64 (*LineLengthFunc)(const char*, uint64);
+
+static LineLengthFunc selectLineLength()
+{
+#if FIXFILE_SIMD
+    if (__builtin_cpu_supports("avx2")) return lineLengthAVX2;
+    return lineLengthSSE2;
+#else
+    return lineLengthScalar;
+#endif
+}
+
+static inline uint64 lineLength(const char* s, uint64 len)
+{
+    static const LineLengthFunc f = selectLineLength();
+    return (*f)(s, len);
+}
+
+/* If the 8 chars at <s> all are decimal digits, set <v> to their value.
+ * Uses one 64-bit load instead of a loop over the digits
+ * (SWAR: SIMD within a register). Only for little endian.
+ */
+static inline bool eightDigits(const char* s, uint64& v)
+{
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+    uint64 c;
+    memcpy(&c, s, 8);
+    // upper nibble of each byte must be 3, and lower nibble below 10
+    if (((c & 0xF0F0F0F0F0F0F0F0ULL) |
+         (((c + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4))
+        != 0x3333333333333333ULL) return false;
+
+    c -= 0x3030303030303030ULL;
+    // combine neighbor digits into 2-digit, then 4-digit, then 8-digit values
+    c = (c * 10) + (c >> 8);
+    c = (((c & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32))) +
+         (((c >> 16) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32)))) >> 32;
+    v = c;
+    return true;
+#else
+    Q_UNUSED(s);
+    Q_UNUSED(v);
+    return false;
+#endif
+}
 
 
 
@@ -112,7 +218,13 @@ bool FixString::stripUInt(unsigned int& v, bool stripSpaces)
     }
     else {
         // decimal
-
+        uint64 d;
+        while((l>=8) && eightDigits(s, d)) {
+            v = 100000000*v + (unsigned int) d;
+            s += 8;
+            c = *s;
+            l -= 8;
+        }
         while(l>0) {
             if (c<'0' || c>'9') break;
             v = 10*v + (c-'0');
@@ -247,6 +359,13 @@ bool FixString::stripUInt64(uint64& v, bool stripSpaces)
     }
     else {
         // decimal
+        uint64 d;
+        while((l>=8) && eightDigits(s, d)) {
+            v = 100000000*v + d;
+            s += 8;
+            c = *s;
+            l -= 8;
+        }
         while(l>0) {
             if (c<'0' || c>'9') break;
             v = 10*v + (c-'0');
@@ -270,6 +389,54 @@ bool FixString::stripUInt64(uint64& v, bool stripSpaces)
 }
 
 
+// parse a list of space separated numbers, as found in cost lines
+int FixString::stripUInt64s(uint64* v, int max)
+{
+    const char* s = _str;
+    int l = _len;
+    int n = 0;
+    uint64 d;
+
+    while((n<max) && (l>0)) {
+        char c = *s;
+        if (c<'0' || c>'9') break;
+
+        if ((c == '0') && (l>1) && (s[1] == 'x')) {
+            // rare: hexadecimal, use the general parser
+            _str = s;
+            _len = l;
+            if (!stripUInt64(v[n])) break;
+            s = _str;
+            l = _len;
+            n++;
+            continue;
+        }
+
+        uint64 val = 0;
+        while((l>=8) && eightDigits(s, d)) {
+            val = 100000000*val + d;
+            s += 8;
+            l -= 8;
+        }
+        while((l>0) && (*s>='0') && (*s<='9')) {
+            val = 10*val + (*s-'0');
+            s++;
+            l--;
+        }
+        v[n++] = val;
+
+        while((l>0) && (*s == ' ')) {
+            s++;
+            l--;
+        }
+    }
+
+    _str = s;
+    _len = l;
+    return n;
+}
+
+
 bool FixString::stripInt64(int64& v, bool stripSpaces)
 {
     if (_len==0) {
@@ -310,7 +477,13 @@ bool FixString::stripInt64(int64& v, bool stripSpaces)
     }
     else {
         // decimal
-
+        uint64 d;
+        while((l>=8) && eightDigits(s, d)) {
+            v = 100000000*v + (int64) d;
+            s += 8;
+            c = *s;
+            l -= 8;
+        }
         while(l>0) {
             if (c<'0' || c>'9') break;
             v = 10*v + (c-'0');
@@ -335,11 +508,90 @@ bool FixString::stripInt64(int64& v, bool stripSpaces)
 
 
 
+// class FixFileReader
+
+// block size and maximal number of blocks read ahead in streaming mode
+#define FIXFILE_BLOCKSIZE  (1024*1024)
+#define FIXFILE_MAXBLOCKS  4
+
+/**
+ * Reads blocks from a device in a separate thread for FixFile.
+ * This way, decompression (in the device) and parsing of the
+ * data run in parallel.
+ */
+class FixFileReader: public QThread
+{
+public:
+    explicit FixFileReader(QIODevice* d)
+    { _device = d; _atEnd = false; _stop = false; }
+
+    // returns false on EOF
+    bool nextBlock(QByteArray& block);
+    void stop();
+
+protected:
+    void run() Q_DECL_OVERRIDE;
+
+private:
+    QIODevice* _device;
+    QMutex _mutex;
+    QWaitCondition _notEmpty, _notFull;
+    QList<QByteArray> _blocks;
+    bool _atEnd, _stop;
+};
+
+void FixFileReader::run()
+{
+    while(1) {
+        QByteArray b = _device->read(FIXFILE_BLOCKSIZE);
+
+        QMutexLocker locker(&_mutex);
+        if (b.isEmpty()) {
+            // EOF or error
+            _atEnd = true;
+            _notEmpty.wakeOne();
+            return;
+        }
+
+        while(!_stop && (_blocks.count() >= FIXFILE_MAXBLOCKS))
+            _notFull.wait(&_mutex);
+        if (_stop) return;
+
+        _blocks.append(b);
+        _notEmpty.wakeOne();
+    }
+}
+
+bool FixFileReader::nextBlock(QByteArray& block)
+{
+    QMutexLocker locker(&_mutex);
+    while(_blocks.isEmpty() && !_atEnd)
+        _notEmpty.wait(&_mutex);
+    if (_blocks.isEmpty()) return false;
+
+    block = _blocks.takeFirst();
+    _notFull.wakeOne();
+    return true;
+}
+
+void FixFileReader::stop()
+{
+    _mutex.lock();
+    _stop = true;
+    _notFull.wakeOne();
+    _mutex.unlock();
+
+    wait();
+}
+
+
 // class FixFile
 
 FixFile::FixFile(QIODevice* file, const QString& filename)
 {
     _file = file;
+    _reader = 0;
+    _streamPos = 0;
 
     if (!file) {
         _len = 0;
@@ -365,7 +617,7 @@ FixFile::FixFile(QIODevice* file, const QString& filename)
 
 #if QT_VERSION >= 0x040400
     // QFile::map was introduced with Qt 4.4
-    if (file->size() >0) {
+    if (!file->isSequential() && (file->size() >0)) {
         QFile* mappableDevice = dynamic_cast<QFile*>(file);
         if (mappableDevice) {
             addr = mappableDevice->map( 0, file->size() );
@@ -382,20 +634,29 @@ FixFile::FixFile(QIODevice* file, const QString& filename)
         if (0) qDebug("Mapped '%s'", qPrintable( _filename ));
     }
     else {
-        // try reading the data into memory instead
-        file->seek(0);
-        _data = file->readAll();
-        _base = _data.data();
-        _len  = _data.size();
+        // stream the data: memory needed does not depend on file size.
+        // Any data peeked by loader detection is still buffered in device
+        if (!file->isSequential())
+            file->seek(0);
+        _base = 0;
+        qint64 size = file->isSequential() ? 0 : file->size();
+        _len = (size > 0) ? size : 0;
+        _reader = new FixFileReader(file);
+        _reader->start();
+
+        if (0) qDebug("Streaming '%s'", qPrintable( _filename ));
     }
 
     _current     = _base;
-    _currentLeft = _len;
+    _currentLeft = _reader ? 0 : _len;
 }
 
 FixFile::~FixFile()
 {
-    // if the file was read into _data, it will be deleted automatically
+    if (_reader) {
+        _reader->stop();
+        delete _reader;
+    }
 
     if (_used_mmap && _file) {
         if (0) qDebug("Unmapping '%s'", qPrintable( _filename ));
@@ -410,28 +671,27 @@ FixFile::~FixFile()
 
 bool FixFile::nextLine(FixString& str)
 {
-    if (_currentLeft == 0) return false;
+    if (_reader) return nextStreamLine(str);
 
-    unsigned left = _currentLeft;
-    char* current = _current;
+    if (_currentLeft == 0) return false;
 
-    while(left>0) {
-        if (*current == 0 || *current == '\n') break;
-        current++;
-        left--;
-    }
+    uint64 n = lineLength(_current, _currentLeft);
+    uint64 left = _currentLeft - n;
+    char* current = _current + n;
 
     if (0) {
         char tmp[200];
-        int l = _currentLeft-left;
+        int l = (int)(_currentLeft-left);
         if (l>199) l = 199;
         strncpy(tmp, _current, l);
         tmp[l] = 0;
-        qDebug("[FixFile::nextLine] At %lu, len %u: '%s'",
-               (unsigned long) (_current - _base), _currentLeft-left, tmp);
+        qDebug("[FixFile::nextLine] At %llu, len %llu: '%s'",
+               (unsigned long long) (_current - _base),
+               (unsigned long long) (_currentLeft-left), tmp);
     }
 
-    int len =  _currentLeft-left;
+    // a single line never is bigger than 2 GB
+    int len = (int)(_currentLeft-left);
     // get rid of any carriage return at end
     if ((len>0) && (*(current-1) == '\r')) len--;
     str.set(_current, len);
@@ -446,9 +706,61 @@ bool FixFile::nextLine(FixString& str)
     return true;
 }
 
-bool FixFile::setCurrent(unsigned pos)
+
+bool FixFile::nextStreamLine(FixString& str)
+{
+    // a line split over blocks is assembled in _lineBuffer
+    bool split = false;
+    _lineBuffer.resize(0);
+
+    while(1) {
+        if (_currentLeft == 0) {
+            if (!_reader->nextBlock(_block)) {
+                if (!split) return false;
+                break;
+            }
+            _current = (char*) _block.constData();
+            _currentLeft = _block.size();
+        }
+
+        char* nl = (char*) memchr(_current, '\n', _currentLeft);
+        if (!nl) {
+            _lineBuffer.append(_current, (int)_currentLeft);
+            _streamPos += _currentLeft;
+            _currentLeft = 0;
+            split = true;
+            continue;
+        }
+
+        uint64 n = nl - _current;
+        const char* s = _current;
+        int len = (int) n;
+        if (split) {
+            _lineBuffer.append(_current, len);
+            s = _lineBuffer.constData();
+            len = _lineBuffer.size();
+        }
+        _current = nl + 1;
+        _currentLeft -= n + 1;
+        _streamPos += n + 1;
+
+        // get rid of any carriage return at end
+        if ((len>0) && (s[len-1] == '\r')) len--;
+        str.set(s, len);
+        return true;
+    }
+
+    // last line without newline at end
+    int len = _lineBuffer.size();
+    if ((len>0) && (_lineBuffer.at(len-1) == '\r')) len--;
+    str.set(_lineBuffer.constData(), len);
+    return true;
+}
+
+bool FixFile::setCurrent(uint64 pos)
 {
-    if (pos > _len) return false;
+    // no seeking in streaming mode
+    if (_reader || (pos > _len)) return false;
 
     _current = _base + pos;
     _currentLeft = _len - pos;
@@ -456,6 +768,150 @@ bool FixFile::setCurrent(unsigned pos)
 }
 
 
+// class NameTable
+
+// size of chunks for key strings
+#define NAMETABLE_CHUNK_SIZE (64*1024)
+
+NameTable::NameTable()
+{
+    _entries = 0;
+    _size = 0;
+    _count = 0;
+    _chunkPos = 0;
+    _chunkLeft = 0;
+}
+
+NameTable::~NameTable()
+{
+    clear();
+}
+
+void NameTable::clear()
+{
+    delete[] _entries;
+    _entries = 0;
+    _size = 0;
+    _count = 0;
+
+    foreach(char* c, _chunks)
+        delete[] c;
+    _chunks.clear();
+    _chunkPos = 0;
+    _chunkLeft = 0;
+}
+
+uint NameTable::hash(const char* s, int len,
+                     const void* scope1, const void* scope2)
+{
+    // FNV-1a over the name, scope pointers mixed in afterwards
+    uint h = 2166136261u;
+    for(int i=0; i<len; i++)
+        h = (h ^ (unsigned char) s[i]) * 16777619u;
+
+    quint64 p = (quint64)(quintptr) scope1 * 0x9E3779B97F4A7C15ULL;
+    p ^= (quint64)(quintptr) scope2 * 0xC2B2AE3D27D4EB4FULL;
+    h ^= (uint)(p >> 32) ^ (uint) p;
+
+    // final avalanche, as we use the lower bits as index
+    h ^= h >> 16;
+    h *= 0x85EBCA6Bu;
+    h ^= h >> 13;
+    return h;
+}
+
+NameTable::Entry* NameTable::lookup(uint h, const char* name, int len,
+                                    const void* scope1,
+                                    const void* scope2) const
+{
+    int mask = _size-1;
+    int i = h & mask;
+    while(1) {
+        Entry* e = _entries + i;
+        if (!e->value) return e;
+        if ((e->hash == h) && (e->len == len) &&
+            (e->scope1 == scope1) && (e->scope2 == scope2) &&
+            (memcmp(e->name, name, len) == 0))
+            return e;
+        i = (i+1) & mask;
+    }
+}
+
+void* NameTable::find(const char* name, int len,
+                      const void* scope1, const void* scope2) const
+{
+    if (_count == 0) return 0;
+
+    return lookup(hash(name, len, scope1, scope2),
+                  name, len, scope1, scope2)->value;
+}
+
+void NameTable::insert(const char* name, int len, void* value,
+                       const void* scope1, const void* scope2)
+{
+    Q_ASSERT(value != 0);
+
+    // keep load factor below 1/2
+    if (2*(_count+1) > _size) grow();
+
+    uint h = hash(name, len, scope1, scope2);
+    Entry* e = lookup(h, name, len, scope1, scope2);
+    if (!e->value) {
+        e->hash = h;
+        e->len = len;
+        e->name = store(name, len);
+        e->scope1 = scope1;
+        e->scope2 = scope2;
+        _count++;
+    }
+    e->value = value;
+}
+
+void NameTable::grow()
+{
+    Entry* oldEntries = _entries;
+    int oldSize = _size;
+
+    _size = oldSize ? 2*oldSize : 1024;
+    _entries = new Entry[_size];
+    memset(_entries, 0, _size * sizeof(Entry));
+
+    int mask = _size-1;
+    for(int j=0; j<oldSize; j++) {
+        Entry& e = oldEntries[j];
+        if (!e.value) continue;
+        int i = e.hash & mask;
+        while(_entries[i].value) i = (i+1) & mask;
+        _entries[i] = e;
+    }
+    delete[] oldEntries;
+}
+
+const char* NameTable::store(const char* name, int len)
+{
+    if (len == 0) return "";
+
+    if (len > _chunkLeft) {
+        int size = (len > NAMETABLE_CHUNK_SIZE/4) ? len : NAMETABLE_CHUNK_SIZE;
+        char* c = new char[size];
+        _chunks.append(c);
+        if (size == len) {
+            // big names get their own chunk
+            memcpy(c, name, len);
+            return c;
+        }
+        _chunkPos = c;
+        _chunkLeft = size;
+    }
+
+    char* res = _chunkPos;
+    memcpy(res, name, len);
+    _chunkPos += len;
+    _chunkLeft -= len;
+    return res;
+}
+
+
 #if 0
 
 // class AppendList
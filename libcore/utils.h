@@ -24,6 +24,7 @@
 #define UTILS_H
 
 #include <qstring.h>
+#include <QList>
 
 class QIODevice;
 
@@ -85,6 +86,12 @@ public:
     bool stripUInt64(uint64&, bool stripSpaces = true);
     bool stripInt64(int64&, bool stripSpaces = true);
 
+    /**
+     * Strip up to <max> space separated numbers into <v>, faster than
+     * repeated stripUInt64(). Returns the number of values stripped.
+     */
+    int stripUInt64s(uint64* v, int max);
+
     operator QString() const
     { return QString::fromLocal8Bit(_str,_len); }
 
@@ -96,7 +103,16 @@ private:
 
 /**
  * A class for fast line by line reading of a read-only ASCII file
+ *
+ * Files which can be memory-mapped are accessed directly. Otherwise
+ * (e.g. for decompressing devices), the file is read in streaming
+ * mode: a separate thread reads blocks of bounded size, which are
+ * consumed by nextLine(). Memory needed thus is independent of the
+ * file size. In streaming mode, base() and setCurrent() are not
+ * available, and len() is 0 if the size is not known in advance.
  */
+class FixFileReader;
+
 class FixFile {
 
 public:
@@ -105,21 +121,32 @@ public:
 
     /**
      * Read next line into <str>. Returns false on error or EOF.
+     * In streaming mode, <str> is valid until the next call.
      */
     bool nextLine(FixString& str);
     bool exists() { return !_openError; }
-    unsigned len() { return _len; }
-    unsigned current() { return _current - _base; }
-    bool setCurrent(unsigned pos);
+    bool isStreaming() { return _reader != 0; }
+    // sizes and offsets are 64bit: files can be bigger than 4 GB
+    uint64 len() { return _len; }
+    uint64 current() { return _reader ? _streamPos : (uint64)(_current - _base); }
+    bool setCurrent(uint64 pos);
     void rewind() { setCurrent(0); }
+    // start of the file content, valid for the lifetime of FixFile
+    const char* base() { return _base; }
 
 private:
+    bool nextStreamLine(FixString& str);
+
     char *_base, *_current;
-    QByteArray _data;
-    unsigned _len, _currentLeft;
+    uint64 _len, _currentLeft;
     bool _used_mmap, _openError;
     QIODevice* _file;
     QString _filename;
+
+    // streaming mode
+    FixFileReader* _reader;
+    QByteArray _block, _lineBuffer;
+    uint64 _streamPos;
 };
 
 
@@ -162,4 +189,55 @@ private:
 };
 
 
+/**
+ * A hash table for interning names read from profile data files.
+ *
+ * Keys are 8-bit strings, optionally scoped by up to two pointers
+ * (e.g. file and ELF object of a function). The table uses open
+ * addressing with linear probing and stores the full hash of each
+ * key, so looking up an existing name needs one hash computation
+ * and usually one compare, without creating a QString.
+ * Key strings are copied into chunks owned by the table.
+ * Values have to be non-zero.
+ */
+class NameTable {
+
+public:
+    NameTable();
+    ~NameTable();
+
+    // returns 0 if the key is not found
+    void* find(const char* name, int len,
+               const void* scope1 = 0, const void* scope2 = 0) const;
+    // sets value for the key, replacing any existing value
+    void insert(const char* name, int len, void* value,
+                const void* scope1 = 0, const void* scope2 = 0);
+
+    void clear();
+    int count() const { return _count; }
+
+private:
+    struct Entry {
+        uint hash;
+        int len;
+        const char* name;
+        const void *scope1, *scope2;
+        void* value;
+    };
+
+    static uint hash(const char*, int, const void*, const void*);
+    Entry* lookup(uint hash, const char*, int,
+                  const void*, const void*) const;
+    void grow();
+    const char* store(const char*, int);
+
+    Entry* _entries;
+    int _size, _count; // _size is 0 or a power of 2
+
+    QList<char*> _chunks;
+    char* _chunkPos;
+    int _chunkLeft;
+};
+
+
 #endif
@@ -51,6 +51,7 @@
 
 #include "config.h"
 #include "globalguiconfig.h"
+#include "graphlayout.h"
 #include "listutils.h"
 
 
@@ -68,6 +69,11 @@
 #define DEFAULT_DETAILLEVEL   1
 #define DEFAULT_LAYOUT        GraphOptions::TopDown
 #define DEFAULT_ZOOMPOS       Auto
+#define DEFAULT_USEGRAPHVIZ   true
+#define DEFAULT_PERSISTLAYOUTS false
+
+// maximal width of nodes in characters for the built-in layout
+#define MAX_NODEWIDTH 40
 
 
 // LessThen functors as helpers for sorting of graph edges
@@ -564,6 +570,9 @@ void GraphExporter::reset(TraceData*, CostItem* i, EventType* ct,
                           ProfileContext::Type gt, QString filename)
 {
     _graphCreated = false;
+    _graphSelected = false;
+    _visibleNodes.clear();
+    _visibleEdges.clear();
     _nodeMap.clear();
     _edgeMap.clear();
 
@@ -661,6 +670,107 @@ void GraphExporter::createGraph()
     }
 }
 
+/* Select the nodes and edges to be shown, according to the limits.
+ * With showSkipped(), sum-edges for skipped callers/callees are created,
+ * having only a callee or caller function.
+ * Afterwards, edges of nodes are cleared completely: visible edges are
+ * inserted again when the laid out graph is put onto the canvas.
+ */
+void GraphExporter::selectGraph()
+{
+    if (!_item)
+        return;
+    if (_graphSelected)
+        return;
+    _graphSelected = true;
+
+    if (!_graphCreated)
+        createGraph();
+
+    _visibleNodes.clear();
+    _visibleEdges.clear();
+
+    GraphNodeMap::Iterator nit;
+    for (nit = _nodeMap.begin(); nit != _nodeMap.end(); ++nit ) {
+        GraphNode& n = *nit;
+
+        if (n.incl <= _realFuncLimit)
+            continue;
+
+        _visibleNodes.append(&n);
+    }
+
+    GraphEdgeMap::Iterator eit;
+    for (eit = _edgeMap.begin(); eit != _edgeMap.end(); ++eit ) {
+        GraphEdge& e = *eit;
+
+        if (e.cost < _realCallLimit)
+            continue;
+        if (!_go->expandCycles()) {
+            // do not show inner cycle calls
+            if (e.call()->inCycle()>0)
+                continue;
+        }
+
+        GraphNode& from = _nodeMap[e.from()];
+        GraphNode& to = _nodeMap[e.to()];
+
+        e.setCallerNode(&from);
+        e.setCalleeNode(&to);
+
+        if ((from.incl <= _realFuncLimit) ||(to.incl <= _realFuncLimit))
+            continue;
+
+        // remove shown edges from n.callers/n.callees
+        from.removeEdge(&e);
+        to.removeEdge(&e);
+
+        _visibleEdges.append(&e);
+    }
+
+    if (_go->showSkipped()) {
+
+        // Create sum-edges for skipped edges
+        GraphEdge* e;
+        double costSum, countSum;
+        foreach(GraphNode* n, _visibleNodes) {
+
+            // add edge for all skipped callers if cost sum is high enough
+            costSum = n->callerCostSum();
+            countSum = n->callerCountSum();
+            if (costSum > _realCallLimit) {
+
+                QPair<TraceFunction*,TraceFunction*> p(0, n->function());
+                e = &(_edgeMap[p]);
+                e->setCallee(p.second);
+                e->cost = costSum;
+                e->count = countSum;
+                _visibleEdges.append(e);
+            }
+
+            // add edge for all skipped callees if cost sum is high enough
+            costSum = n->calleeCostSum();
+            countSum = n->calleeCountSum();
+            if (costSum > _realCallLimit) {
+
+                QPair<TraceFunction*,TraceFunction*> p(n->function(), 0);
+                e = &(_edgeMap[p]);
+                e->setCaller(p.first);
+                e->cost = costSum;
+                e->count = countSum;
+                _visibleEdges.append(e);
+            }
+        }
+    }
+
+    // clear edges here completely.
+    // Visible edges are inserted again when building the canvas
+    for (nit = _nodeMap.begin(); nit != _nodeMap.end(); ++nit ) {
+        GraphNode& n = *nit;
+        n.clearEdges();
+    }
+}
+
 
 void GraphExporter::writeDot(QIODevice* device)
 {
@@ -686,8 +796,7 @@ void GraphExporter::writeDot(QIODevice* device)
         }
     }
 
-    if (!_graphCreated)
-        createGraph();
+    selectGraph();
 
     /* Generate dot format...
      * When used for the CallGraphView (in contrast to "Export Callgraph..."),
@@ -720,16 +829,10 @@ void GraphExporter::writeDot(QIODevice* device)
     // for clustering
     QMap<TraceCostItem*,QList<GraphNode*> > nLists;
 
-    GraphNodeMap::Iterator nit;
-    for (nit = _nodeMap.begin(); nit != _nodeMap.end(); ++nit ) {
-        GraphNode& n = *nit;
-
-        if (n.incl <= _realFuncLimit)
-            continue;
-
+    foreach(GraphNode* np, _visibleNodes) {
         // for clustering: get cost item group of function
         TraceCostItem* g;
-        TraceFunction* f = n.function();
+        TraceFunction* f = np->function();
         switch (_groupType) {
         case ProfileContext::Object:
             g = f->object();
@@ -747,7 +850,7 @@ void GraphExporter::writeDot(QIODevice* device)
             g = 0;
             break;
         }
-        nLists[g].append(&n);
+        nLists[g].append(np);
     }
 
     QMap<TraceCostItem*,QList<GraphNode*> >::Iterator lit;
@@ -789,110 +892,50 @@ void GraphExporter::writeDot(QIODevice* device)
             *stream << QStringLiteral("}\n");
     }
 
-    GraphEdgeMap::Iterator eit;
-    for (eit = _edgeMap.begin(); eit != _edgeMap.end(); ++eit ) {
-        GraphEdge& e = *eit;
-
-        if (e.cost < _realCallLimit)
+    foreach(GraphEdge* e, _visibleEdges) {
+        if (!e->from()) {
+            // sum-edge for skipped callers
+            *stream << QStringLiteral("  R%1 [shape=point,label=\"\"];\n")
+                       .arg((qptrdiff)e->to(), 0, 16);
+            *stream << QStringLiteral("  R%1 -> F%2 [label=\"%3\\n%4 x\",weight=%5];\n")
+                       .arg((qptrdiff)e->to(), 0, 16)
+                       .arg((qptrdiff)e->to(), 0, 16)
+                       .arg(SubCost(e->cost).pretty())
+                       .arg(SubCost(e->count).pretty())
+                       .arg((int)log(e->cost));
             continue;
-        if (!_go->expandCycles()) {
-            // do not show inner cycle calls
-            if (e.call()->inCycle()>0)
-                continue;
         }
-
-        GraphNode& from = _nodeMap[e.from()];
-        GraphNode& to = _nodeMap[e.to()];
-
-        e.setCallerNode(&from);
-        e.setCalleeNode(&to);
-
-        if ((from.incl <= _realFuncLimit) ||(to.incl <= _realFuncLimit))
+        if (!e->to()) {
+            // sum-edge for skipped callees
+            *stream << QStringLiteral("  S%1 [shape=point,label=\"\"];\n")
+                       .arg((qptrdiff)e->from(), 0, 16);
+            *stream << QStringLiteral("  F%1 -> S%2 [label=\"%3\\n%4 x\",weight=%5];\n")
+                       .arg((qptrdiff)e->from(), 0, 16)
+                       .arg((qptrdiff)e->from(), 0, 16)
+                       .arg(SubCost(e->cost).pretty())
+                       .arg(SubCost(e->count).pretty())
+                       .arg((int)log(e->cost));
             continue;
-
-        // remove dumped edges from n.callers/n.callees
-        from.removeEdge(&e);
-        to.removeEdge(&e);
+        }
 
         *stream << QStringLiteral("  F%1 -> F%2 [weight=%3")
-                   .arg((qptrdiff)e.from(), 0, 16)
-                   .arg((qptrdiff)e.to(), 0, 16)
-                   .arg((long)log(log(e.cost)));
+                   .arg((qptrdiff)e->from(), 0, 16)
+                   .arg((qptrdiff)e->to(), 0, 16)
+                   .arg((long)log(log(e->cost)));
 
         if (_go->detailLevel() ==1) {
             *stream << QStringLiteral(",label=\"%1 (%2x)\"")
-                       .arg(SubCost(e.cost).pretty())
-                       .arg(SubCost(e.count).pretty());
+                       .arg(SubCost(e->cost).pretty())
+                       .arg(SubCost(e->count).pretty());
         }
         else if (_go->detailLevel() ==2)
             *stream << QStringLiteral(",label=\"%3\\n%4 x\"")
-                       .arg(SubCost(e.cost).pretty())
-                       .arg(SubCost(e.count).pretty());
+                       .arg(SubCost(e->cost).pretty())
+                       .arg(SubCost(e->count).pretty());
 
         *stream << QStringLiteral("];\n");
     }
 
-    if (_go->showSkipped()) {
-
-        // Create sum-edges for skipped edges
-        GraphEdge* e;
-        double costSum, countSum;
-        for (nit = _nodeMap.begin(); nit != _nodeMap.end(); ++nit ) {
-            GraphNode& n = *nit;
-            if (n.incl <= _realFuncLimit)
-                continue;
-
-            // add edge for all skipped callers if cost sum is high enough
-            costSum = n.callerCostSum();
-            countSum = n.callerCountSum();
-            if (costSum > _realCallLimit) {
-
-                QPair<TraceFunction*,TraceFunction*> p(0, n.function());
-                e = &(_edgeMap[p]);
-                e->setCallee(p.second);
-                e->cost = costSum;
-                e->count = countSum;
-
-                *stream << QStringLiteral("  R%1 [shape=point,label=\"\"];\n")
-                           .arg((qptrdiff)n.function(), 0, 16);
-                *stream << QStringLiteral("  R%1 -> F%2 [label=\"%3\\n%4 x\",weight=%5];\n")
-                           .arg((qptrdiff)n.function(), 0, 16)
-                           .arg((qptrdiff)n.function(), 0, 16)
-                           .arg(SubCost(costSum).pretty())
-                           .arg(SubCost(countSum).pretty())
-                           .arg((int)log(costSum));
-            }
-
-            // add edge for all skipped callees if cost sum is high enough
-            costSum = n.calleeCostSum();
-            countSum = n.calleeCountSum();
-            if (costSum > _realCallLimit) {
-
-                QPair<TraceFunction*,TraceFunction*> p(n.function(), 0);
-                e = &(_edgeMap[p]);
-                e->setCaller(p.first);
-                e->cost = costSum;
-                e->count = countSum;
-
-                *stream << QStringLiteral("  S%1 [shape=point,label=\"\"];\n")
-                           .arg((qptrdiff)n.function(), 0, 16);
-                *stream << QStringLiteral("  F%1 -> S%2 [label=\"%3\\n%4 x\",weight=%5];\n")
-                           .arg((qptrdiff)n.function(), 0, 16)
-                           .arg((qptrdiff)n.function(), 0, 16)
-                           .arg(SubCost(costSum).pretty())
-                           .arg(SubCost(countSum).pretty())
-                           .arg((int)log(costSum));
-            }
-        }
-    }
-
-    // clear edges here completely.
-    // Visible edges are inserted again on parsing in CallGraphView::refresh
-    for (nit = _nodeMap.begin(); nit != _nodeMap.end(); ++nit ) {
-        GraphNode& n = *nit;
-        n.clearEdges();
-    }
-
     *stream << "}\n";
 
     if (!device) {
@@ -1018,12 +1061,23 @@ void GraphExporter::buildGraph(TraceFunction* f, int depth, bool toCallees,
     // on entering a cycle, only go the FunctionCycle
     TraceCallList l = toCallees ? f->callings(false) : f->callers(false);
 
-    foreach(TraceCall* call, l) {
+    // costs of all calls for the limits in one pass
+    QVector<SubCost> callCosts(l.count());
+    if (_eventType) {
+        QVector<ProfileCostArray*> items;
+        items.reserve(l.count());
+        foreach(TraceCall* call, l)
+            items.append(call);
+        callCosts = _eventType->subCosts(items);
+    }
+
+    for (int i = 0; i < l.count(); i++) {
+        TraceCall* call = l[i];
 
         f2 = toCallees ? call->called(false) : call->caller(false);
 
         double count = call->callCount() * factor;
-        double cost = call->subCost(_eventType) * factor;
+        double cost = callCosts[i] * factor;
 
         // ignore function calls with absolute cost < 3 per call
         // No: This would skip a lot of functions e.g. with L2 cache misses
@@ -1088,7 +1142,7 @@ void GraphExporter::buildGraph(TraceFunction* f, int depth, bool toCallees,
             s = f2->cycle()->inclusive()->subCost(_eventType);
         else
             s = f2->inclusive()->subCost(_eventType);
-        SubCost v = call->subCost(_eventType);
+        SubCost v = callCosts[i];
 
         // Never recurse if s or v is 0 (can happen with bogus input)
         if ((v == 0) || (s== 0)) continue;
@@ -1544,6 +1598,10 @@ CallGraphView::CallGraphView(TraceItemView* parentView, QWidget* parent,
 
     _renderProcess = 0;
     _prevSelectedNode = 0;
+    _graphLayout = new GraphLayout;
+    _useGraphviz = DEFAULT_USEGRAPHVIZ;
+    _layoutCache = new GraphLayoutCache;
+    _layoutCache->setPersistent(DEFAULT_PERSISTLAYOUTS);
     connect(&_renderTimer, &QTimer::timeout,
             this, &CallGraphView::showRenderWarning);
 }
@@ -1552,6 +1610,8 @@ CallGraphView::~CallGraphView()
 {
     clear();
     delete _panningView;
+    delete _graphLayout;
+    delete _layoutCache;
 }
 
 QString CallGraphView::whatsThis() const
@@ -1931,6 +1991,8 @@ void CallGraphView::doUpdate(int changeType, bool)
     if (changeType & dataChanged) {
         // invalidate old selection and graph part
         _exporter.reset(_data, _activeItem, _eventType, _groupType);
+        _graphLayout->reset();
+        _layoutCache->setData(_data);
         _selectedNode = 0;
         _selectedEdge = 0;
     }
@@ -2050,6 +2112,28 @@ void CallGraphView::refresh()
 
     _selectedNode = 0;
     _selectedEdge = 0;
+    _renderTime.start();
+
+    _exporter.reset(_data, _activeItem, _eventType, _groupType);
+
+    // same graph laid out before?
+    _exporter.selectGraph();
+    // node sizes of dot depend on the costs in labels
+    _layoutKey = _layoutCache->key(&_exporter, layoutOptions(), _useGraphviz);
+    GraphLayoutResult result;
+    if (_layoutCache->find(_layoutKey, result)) {
+        showLayout(result);
+        if (GraphLayoutCache::debug())
+            qDebug("CallGraphView::refresh: %d nodes, %d edges from cache in %lld ms",
+                   _exporter.visibleNodes().count(), _exporter.visibleEdges().count(),
+                   _renderTime.elapsed());
+        return;
+    }
+
+    if (!_useGraphviz) {
+        layoutGraph();
+        return;
+    }
 
     /*
      * Call 'dot' asynchronoulsy in the background with the aim to
@@ -2092,15 +2176,45 @@ void CallGraphView::refresh()
     qDebug("CallGraphView::refresh: Starting process %p, '%s'",
            _renderProcess, qPrintable(_renderProcessCmdLine));
 
-    // _renderProcess can be set to 0 on error after start().
-    // thus, we use a local copy afterwards
+    // _renderProcess is set to 0 if starting fails, and the
+    // built-in layout is used instead
     QProcess* p = _renderProcess;
     p->start(renderProgram, renderArgs);
-    _exporter.reset(_data, _activeItem, _eventType, _groupType);
+    if (p != _renderProcess)
+        return;
     _exporter.writeDot(p);
     p->closeWriteChannel();
 }
 
+// all options changing the layout of a given set of nodes and edges
+QString CallGraphView::layoutOptions()
+{
+    QString o = QStringLiteral("%1 %2 %3 %4")
+                .arg(_useGraphviz ? QStringLiteral("dot") : QStringLiteral("builtin"))
+                .arg(layoutString(_layout))
+                .arg(_detailLevel)
+                .arg(font().toString());
+
+    // dot gets node labels with costs, edge weights and clusters
+    if (_useGraphviz) {
+        if (_eventType) o += QStringLiteral(" ") + _eventType->name();
+        if (_clusterGroups)
+            o += QStringLiteral(" cluster %1").arg(_groupType);
+    }
+
+    // circular layouts depend on the center
+    if (_layout == GraphOptions::Circular) {
+        TraceFunction* center;
+        if (_activeItem->type() == ProfileContext::Call)
+            center = ((TraceCall*)_activeItem)->caller(true);
+        else
+            center = (TraceFunction*) _activeItem;
+        o += QStringLiteral(" center ") + GraphLayoutCache::functionId(center);
+    }
+
+    return o;
+}
+
 void CallGraphView::readDotOutput()
 {
     QProcess* p = qobject_cast<QProcess*>(sender());
@@ -2127,6 +2241,15 @@ void CallGraphView::dotError()
         return;
     }
 
+    if (p->error() == QProcess::FailedToStart) {
+        qDebug("CallGraphView::dotError: '%s' not available, using built-in layout",
+               qPrintable(_renderProcessCmdLine));
+        _renderProcess->deleteLater();
+        _renderProcess = 0;
+        layoutGraph();
+        return;
+    }
+
     showRenderError(QString::fromLocal8Bit(_renderProcess->readAllStandardError()));
 
     // not interesting any longer
@@ -2151,19 +2274,11 @@ void CallGraphView::dotExited()
     _renderProcess = 0;
 
     QString line, cmd;
-    CanvasNode *rItem;
-    QGraphicsEllipseItem* eItem;
-    CanvasEdge* sItem;
-    CanvasEdgeLabel* lItem;
     QTextStream* dotStream;
     double scale = 1.0, scaleX = 1.0, scaleY = 1.0;
     double dotWidth = 0, dotHeight = 0;
-    GraphNode* activeNode = 0;
-    GraphEdge* activeEdge = 0;
+    GraphLayoutResult result;
 
-    _renderTimer.stop();
-    viewport()->setUpdatesEnabled(false);
-    clear();
     dotStream = new QTextStream(&_unparsedOutput, QIODevice::ReadOnly);
 
     // First pass to adjust coordinate scaling by node height given from dot
@@ -2214,25 +2329,11 @@ void CallGraphView::dotExited()
             dotWidth = dotWidthString.toDouble();
             dotHeight = dotHeightString.toDouble();
 
-            if (!_scene) {
+            if (!result.size.isValid()) {
                 int w = (int)(scaleX * dotWidth);
                 int h = (int)(scaleY * dotHeight);
 
-                // We use as minimum canvas size the desktop size.
-                // Otherwise, the canvas would have to be resized on widget resize.
-                _xMargin = 50;
-                if (w < QApplication::desktop()->width())
-                    _xMargin += (QApplication::desktop()->width()-w)/2;
-
-                _yMargin = 50;
-                if (h < QApplication::desktop()->height())
-                    _yMargin += (QApplication::desktop()->height()-h)/2;
-
-                _scene = new QGraphicsScene( 0.0, 0.0,
-                                             qreal(w+2*_xMargin), qreal(h+2*_yMargin));
-                // Change background color for call graph from default system color to
-                // white. It has to blend into the gradient for the selected function.
-                _scene->setBackgroundBrush(Qt::white);
+                result.size = QSizeF(w, h);
 
 #if DEBUG_GRAPH
                 qDebug() << qPrintable(_exporter.filename()) << ":" << lineno
@@ -2252,7 +2353,7 @@ void CallGraphView::dotExited()
             continue;
         }
 
-        if (_scene == 0) {
+        if (!result.size.isValid()) {
             qDebug() << "Ignoring '"<< cmd
                      << "' without 'graph' from dot ("<< _exporter.filename()
                      << ":"<< lineno << ")";
@@ -2272,8 +2373,8 @@ void CallGraphView::dotExited()
 
             GraphNode* n = _exporter.node(_exporter.toFunc(nodeName));
 
-            int xx = (int)(scaleX * x + _xMargin);
-            int yy = (int)(scaleY * (dotHeight - y)+ _yMargin);
+            int xx = (int)(scaleX * x);
+            int yy = (int)(scaleY * (dotHeight - y));
             int w = (int)(scaleX * width);
             int h = (int)(scaleY * height);
 
@@ -2288,12 +2389,11 @@ void CallGraphView::dotExited()
 
             // Unnamed nodes with collapsed edges (with 'R' and 'S')
             if (nodeName[0] == 'R'|| nodeName[0] == 'S') {
-                w = 10, h = 10;
-                eItem = new QGraphicsEllipseItem( QRectF(xx-w/2, yy-h/2, w, h) );
-                _scene->addItem(eItem);
-                eItem->setBrush(Qt::gray);
-                eItem->setZValue(1.0);
-                eItem->show();
+                TraceFunction* f = _exporter.toFunc('F' + nodeName.mid(1));
+                GraphLayoutResult::EdgeKey key(0, f);
+                if (nodeName[0] == 'S')
+                    key = GraphLayoutResult::EdgeKey(f, 0);
+                result.pointPos.insert(key, QPointF(xx, yy));
                 continue;
             }
 
@@ -2302,25 +2402,9 @@ void CallGraphView::dotExited()
                        qPrintable(nodeName));
                 continue;
             }
-            n->setVisible(true);
-
-            rItem = new CanvasNode(this, n, xx-w/2, yy-h/2, w, h);
-            // limit symbol space to a maximal number of lines depending on detail level
-            if (_detailLevel>0) rItem->setMaxLines(0, 2*_detailLevel);
-            _scene->addItem(rItem);
-            n->setCanvasNode(rItem);
-
-            if (n) {
-                if (n->function() == activeItem())
-                    activeNode = n;
-                if (n->function() == selectedItem())
-                    _selectedNode = n;
-                rItem->setSelected(n == _selectedNode);
-            }
-
-            rItem->setZValue(1.0);
-            rItem->show();
 
+            result.nodeRects.insert(n->function(),
+                                    QRectF(xx-w/2, yy-h/2, w, h));
             continue;
         }
 
@@ -2340,11 +2424,6 @@ void CallGraphView::dotExited()
                      << ")";
             continue;
         }
-        e->setVisible(true);
-        if (e->fromNode())
-            e->fromNode()->addCallee(e);
-        if (e->toNode())
-            e->toNode()->addCaller(e);
 
         if (0)
             qDebug("  Edge with %d points:", points);
@@ -2357,8 +2436,8 @@ void CallGraphView::dotExited()
             x = edgeX.toDouble();
             y = edgeY.toDouble();
 
-            int xx = (int)(scaleX * x + _xMargin);
-            int yy = (int)(scaleY * (dotHeight - y)+ _yMargin);
+            int xx = (int)(scaleX * x);
+            int yy = (int)(scaleY * (dotHeight - y));
 
             if (0)
                 qDebug("   P %d: ( %f / %f ) => ( %d / %d)", i, x, y, xx, yy);
@@ -2371,85 +2450,8 @@ void CallGraphView::dotExited()
             continue;
         }
 
-        // calls into/out of cycles are special: make them blue
-        QColor arrowColor = Qt::black;
-        TraceFunction* caller = e->fromNode() ? e->fromNode()->function() : 0;
-        TraceFunction* called = e->toNode() ? e->toNode()->function() : 0;
-        if ( (caller && (caller->cycle() == caller)) ||
-             (called && (called->cycle() == called)) ) arrowColor = Qt::blue;
-
-        sItem = new CanvasEdge(e);
-        _scene->addItem(sItem);
-        e->setCanvasEdge(sItem);
-        sItem->setControlPoints(poly);
-        // width of pen will be adjusted in CanvasEdge::paint()
-        sItem->setPen(QPen(arrowColor));
-        sItem->setZValue(0.5);
-        sItem->show();
-
-        if (e->call() == selectedItem())
-            _selectedEdge = e;
-        if (e->call() == activeItem())
-            activeEdge = e;
-        sItem->setSelected(e == _selectedEdge);
-
-        // Arrow head
-        QPoint arrowDir;
-        int indexHead = -1;
-
-        // check if head is at start of spline...
-        // this is needed because dot always gives points from top to bottom
-        CanvasNode* fromNode = e->fromNode() ? e->fromNode()->canvasNode() : 0;
-        if (fromNode) {
-            QPointF toCenter = fromNode->rect().center();
-            qreal dx0 = poly.point(0).x() - toCenter.x();
-            qreal dy0 = poly.point(0).y() - toCenter.y();
-            qreal dx1 = poly.point(points-1).x() - toCenter.x();
-            qreal dy1 = poly.point(points-1).y() - toCenter.y();
-            if (dx0*dx0+dy0*dy0 > dx1*dx1+dy1*dy1) {
-                // start of spline is nearer to call target node
-                indexHead=-1;
-                while (arrowDir.isNull() && (indexHead<points-2)) {
-                    indexHead++;
-                    arrowDir = poly.point(indexHead) - poly.point(indexHead+1);
-                }
-            }
-        }
-
-        if (arrowDir.isNull()) {
-            indexHead = points;
-            // sometimes the last spline points from dot are the same...
-            while (arrowDir.isNull() && (indexHead>1)) {
-                indexHead--;
-                arrowDir = poly.point(indexHead) - poly.point(indexHead-1);
-            }
-        }
-
-        if (!arrowDir.isNull()) {
-            // arrow around pa.point(indexHead) with direction arrowDir
-            arrowDir *= 10.0/sqrt(double(arrowDir.x()*arrowDir.x() +
-                                         arrowDir.y()*arrowDir.y()));
-
-            QPolygonF a;
-            a << QPointF(poly.point(indexHead) + arrowDir);
-            a << QPointF(poly.point(indexHead) + QPoint(arrowDir.y()/2,
-                                                        -arrowDir.x()/2));
-            a << QPointF(poly.point(indexHead) + QPoint(-arrowDir.y()/2,
-                                                        arrowDir.x()/2));
-
-            if (0)
-                qDebug("  Arrow: ( %f/%f, %f/%f, %f/%f)", a[0].x(), a[0].y(),
-                        a[1].x(), a[1].y(), a[2].x(), a[1].y());
-
-            CanvasEdgeArrow* aItem = new CanvasEdgeArrow(sItem);
-            _scene->addItem(aItem);
-            aItem->setPolygon(a);
-            aItem->setBrush(arrowColor);
-            aItem->setZValue(1.5);
-            aItem->show();
-
-            sItem->setArrow(aItem);
-        }
+        GraphLayoutResult::EdgeKey key = GraphLayoutResult::key(e);
+        result.edgePoints.insert(key, poly);
 
         if (lineStream.atEnd())
             continue;
@@ -2475,27 +2477,292 @@ void CallGraphView::dotExited()
         x = edgeX.toDouble();
         y = edgeY.toDouble();
 
-        int xx = (int)(scaleX * x + _xMargin);
-        int yy = (int)(scaleY * (dotHeight - y)+ _yMargin);
+        int xx = (int)(scaleX * x);
+        int yy = (int)(scaleY * (dotHeight - y));
 
         if (0)
             qDebug("   Label '%s': ( %f / %f ) => ( %d / %d)",
                    qPrintable(label), x, y, xx, yy);
 
-        // Fixed Dimensions for Label: 100 x 40
-        int w = 100;
-        int h = _detailLevel * 20;
-        lItem = new CanvasEdgeLabel(this, sItem, xx-w/2, yy-h/2, w, h);
-        _scene->addItem(lItem);
-        // edge labels above nodes
-        lItem->setZValue(1.5);
-        sItem->setLabel(lItem);
-        if (h>0)
-            lItem->show();
-
+        result.labelPos.insert(key, QPointF(xx, yy));
     }
     delete dotStream;
 
+    if (0) qDebug("CallGraphView::dotExited: %d nodes, %d edges laid out in %lld ms",
+                  _exporter.visibleNodes().count(), _exporter.visibleEdges().count(),
+                  _renderTime.elapsed());
+
+    // failed layouts are not cached, to try again
+    if (result.size.isValid())
+        _layoutCache->insert(_layoutKey, result);
+    showLayout(result);
+
+    delete _renderProcess;
+    _renderProcess = 0;
+}
+
+/* Layout of the graph without external tools, done synchronously.
+ * Used if "Use GraphViz" is switched off or 'dot' can not be started.
+ * Cluster groups are not supported, so dot is the default.
+ */
+void CallGraphView::layoutGraph()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    _exporter.selectGraph();
+    const QList<GraphNode*>& nodes = _exporter.visibleNodes();
+    const QList<GraphEdge*>& edges = _exporter.visibleEdges();
+
+    // the center of circular layouts, as for 'twopi'
+    TraceFunction* center = 0;
+    if (_activeItem->type() == ProfileContext::Call)
+        center = ((TraceCall*)_activeItem)->caller(true);
+    else
+        center = (TraceFunction*) _activeItem;
+
+    _graphLayout->clear();
+    _graphLayout->setLayout(_layout);
+    _graphLayout->setLabelSize(QSizeF(100, _detailLevel * 20));
+    foreach(GraphNode* n, nodes)
+        _graphLayout->addNode(n, nodeSize(n));
+    foreach(GraphEdge* e, edges)
+        _graphLayout->addEdge(e);
+    _graphLayout->layout(center);
+    qint64 layoutTime = timer.elapsed();
+
+    _layoutCache->insert(_layoutKey, _graphLayout->result());
+    showLayout(_graphLayout->result());
+
+    if (0) qDebug("CallGraphView::layoutGraph: %d nodes, %d edges laid out in %lld ms, "
+                  "total %lld ms", nodes.count(), edges.count(), layoutTime,
+                  timer.elapsed());
+}
+
+// create scene items for the visible part of the graph at given positions
+void CallGraphView::showLayout(const GraphLayoutResult& result)
+{
+    GraphNode* activeNode = 0;
+    GraphEdge* activeEdge = 0;
+
+    _renderTimer.stop();
+    viewport()->setUpdatesEnabled(false);
+    clear();
+
+    // without size, showGraph() shows an error
+    if (result.size.isValid()) {
+        createScene((int)result.size.width(), (int)result.size.height());
+        QPoint margin(_xMargin, _yMargin);
+
+        foreach(GraphNode* n, _exporter.visibleNodes()) {
+            QHash<TraceFunction*, QRectF>::ConstIterator it;
+            it = result.nodeRects.constFind(n->function());
+            if (it == result.nodeRects.constEnd())
+                continue;
+
+            addCanvasNode(n, (*it).toRect().translated(margin));
+            if (n->function() == activeItem())
+                activeNode = n;
+        }
+
+        foreach(GraphEdge* e, _exporter.visibleEdges()) {
+            GraphLayoutResult::EdgeKey key = GraphLayoutResult::key(e);
+            if (result.pointPos.contains(key))
+                addSkippedPoint(result.pointPos.value(key).toPoint() + margin);
+
+            QPolygon poly = result.edgePoints.value(key);
+            if (poly.size() < 2)
+                continue;
+
+            CanvasEdge* sItem = addCanvasEdge(e, poly.translated(margin));
+            if (e->call() == activeItem())
+                activeEdge = e;
+
+            if (result.labelPos.contains(key))
+                addCanvasEdgeLabel(sItem,
+                                   result.labelPos.value(key).toPoint() + margin);
+        }
+    }
+
+    showGraph(activeNode, activeEdge);
+}
+
+// size of a node as dot would make it for the labels from writeDot()
+QSizeF CallGraphView::nodeSize(GraphNode* n)
+{
+    QFontMetrics fm = fontMetrics();
+
+    QString abr = GlobalConfig::shortenSymbol(n->function()->prettyName());
+    if ((int)abr.length() < 8) abr = abr + QString(8 - abr.length(),'_');
+    int w = fm.width(QStringLiteral("** %1 **").arg(abr));
+    // long names are wrapped/elided in more lines
+    if (w > MAX_NODEWIDTH * fm.averageCharWidth())
+        w = MAX_NODEWIDTH * fm.averageCharWidth();
+
+    return QSizeF(w + 2 * fm.averageCharWidth(),
+                  8 + (1 + 2 * _detailLevel) * fm.height());
+}
+
+void CallGraphView::createScene(int w, int h)
+{
+    // We use as minimum canvas size the desktop size.
+    // Otherwise, the canvas would have to be resized on widget resize.
+    _xMargin = 50;
+    if (w < QApplication::desktop()->width())
+        _xMargin += (QApplication::desktop()->width()-w)/2;
+
+    _yMargin = 50;
+    if (h < QApplication::desktop()->height())
+        _yMargin += (QApplication::desktop()->height()-h)/2;
+
+    _scene = new QGraphicsScene( 0.0, 0.0,
+                                 qreal(w+2*_xMargin), qreal(h+2*_yMargin));
+    // Change background color for call graph from default system color to
+    // white. It has to blend into the gradient for the selected function.
+    _scene->setBackgroundBrush(Qt::white);
+}
+
+void CallGraphView::addSkippedPoint(const QPoint& p)
+{
+    int w = 10, h = 10;
+    QGraphicsEllipseItem* eItem;
+    eItem = new QGraphicsEllipseItem( QRectF(p.x()-w/2, p.y()-h/2, w, h) );
+    _scene->addItem(eItem);
+    eItem->setBrush(Qt::gray);
+    eItem->setZValue(1.0);
+    eItem->show();
+}
+
+CanvasNode* CallGraphView::addCanvasNode(GraphNode* n, const QRect& r)
+{
+    n->setVisible(true);
+
+    CanvasNode* rItem = new CanvasNode(this, n, r.x(), r.y(),
+                                       r.width(), r.height());
+    // limit symbol space to a maximal number of lines depending on detail level
+    if (_detailLevel>0) rItem->setMaxLines(0, 2*_detailLevel);
+    _scene->addItem(rItem);
+    n->setCanvasNode(rItem);
+
+    if (n->function() == selectedItem())
+        _selectedNode = n;
+    rItem->setSelected(n == _selectedNode);
+
+    rItem->setZValue(1.0);
+    rItem->show();
+
+    return rItem;
+}
+
+CanvasEdge* CallGraphView::addCanvasEdge(GraphEdge* e, const QPolygon& poly)
+{
+    e->setVisible(true);
+    if (e->fromNode())
+        e->fromNode()->addCallee(e);
+    if (e->toNode())
+        e->toNode()->addCaller(e);
+
+    int points = poly.size();
+
+    // calls into/out of cycles are special: make them blue
+    QColor arrowColor = Qt::black;
+    TraceFunction* caller = e->fromNode() ? e->fromNode()->function() : 0;
+    TraceFunction* called = e->toNode() ? e->toNode()->function() : 0;
+    if ( (caller && (caller->cycle() == caller)) ||
+         (called && (called->cycle() == called)) ) arrowColor = Qt::blue;
+
+    CanvasEdge* sItem = new CanvasEdge(e);
+    _scene->addItem(sItem);
+    e->setCanvasEdge(sItem);
+    sItem->setControlPoints(poly);
+    // width of pen will be adjusted in CanvasEdge::paint()
+    sItem->setPen(QPen(arrowColor));
+    sItem->setZValue(0.5);
+    sItem->show();
+
+    if (e->call() == selectedItem())
+        _selectedEdge = e;
+    sItem->setSelected(e == _selectedEdge);
+
+    // Arrow head
+    QPoint arrowDir;
+    int indexHead = -1;
+
+    // check if head is at start of spline...
+    // this is needed because dot always gives points from top to bottom
+    CanvasNode* fromNode = e->fromNode() ? e->fromNode()->canvasNode() : 0;
+    if (fromNode) {
+        QPointF toCenter = fromNode->rect().center();
+        qreal dx0 = poly.point(0).x() - toCenter.x();
+        qreal dy0 = poly.point(0).y() - toCenter.y();
+        qreal dx1 = poly.point(points-1).x() - toCenter.x();
+        qreal dy1 = poly.point(points-1).y() - toCenter.y();
+        if (dx0*dx0+dy0*dy0 > dx1*dx1+dy1*dy1) {
+            // start of spline is nearer to call target node
+            indexHead=-1;
+            while (arrowDir.isNull() && (indexHead<points-2)) {
+                indexHead++;
+                arrowDir = poly.point(indexHead) - poly.point(indexHead+1);
+            }
+        }
+    }
+
+    if (arrowDir.isNull()) {
+        indexHead = points;
+        // sometimes the last spline points from dot are the same...
+        while (arrowDir.isNull() && (indexHead>1)) {
+            indexHead--;
+            arrowDir = poly.point(indexHead) - poly.point(indexHead-1);
+        }
+    }
+
+    if (!arrowDir.isNull()) {
+        // arrow around pa.point(indexHead) with direction arrowDir
+        arrowDir *= 10.0/sqrt(double(arrowDir.x()*arrowDir.x() +
+                                     arrowDir.y()*arrowDir.y()));
+
+        QPolygonF a;
+        a << QPointF(poly.point(indexHead) + arrowDir);
+        a << QPointF(poly.point(indexHead) + QPoint(arrowDir.y()/2,
+                                                    -arrowDir.x()/2));
+        a << QPointF(poly.point(indexHead) + QPoint(-arrowDir.y()/2,
+                                                    arrowDir.x()/2));
+
+        if (0)
+            qDebug("  Arrow: ( %f/%f, %f/%f, %f/%f)", a[0].x(), a[0].y(),
+                    a[1].x(), a[1].y(), a[2].x(), a[1].y());
+
+        CanvasEdgeArrow* aItem = new CanvasEdgeArrow(sItem);
+        _scene->addItem(aItem);
+        aItem->setPolygon(a);
+        aItem->setBrush(arrowColor);
+        aItem->setZValue(1.5);
+        aItem->show();
+
+        sItem->setArrow(aItem);
+    }
+
+    return sItem;
+}
+
+void CallGraphView::addCanvasEdgeLabel(CanvasEdge* sItem, const QPoint& p)
+{
+    // Fixed Dimensions for Label: 100 x 40
+    int w = 100;
+    int h = _detailLevel * 20;
+    CanvasEdgeLabel* lItem = new CanvasEdgeLabel(this, sItem, p.x()-w/2,
+                                                 p.y()-h/2, w, h);
+    _scene->addItem(lItem);
+    // edge labels above nodes
+    lItem->setZValue(1.5);
+    sItem->setLabel(lItem);
+    if (h>0)
+        lItem->show();
+}
+
+// make the scene with laid out graph visible
+void CallGraphView::showGraph(GraphNode* activeNode, GraphEdge* activeEdge)
+{
     // for keyboard navigation
     _exporter.sortEdges();
 
@@ -2568,9 +2835,6 @@ void CallGraphView::dotExited()
 
     _scene->update();
     viewport()->setUpdatesEnabled(true);
-
-    delete _renderProcess;
-    _renderProcess = 0;
 }
 
 
@@ -2919,6 +3183,16 @@ QMenu* CallGraphView::addLayoutMenu(QMenu* menu)
     addLayoutAction(m, tr("Top to Down"), TopDown);
     addLayoutAction(m, tr("Left to Right"), LeftRight);
     addLayoutAction(m, tr("Circular"), Circular);
+    m->addSeparator();
+    // data -1/-2: not a layout, but switches of the layouter
+    QAction* a = m->addAction(tr("Use GraphViz"));
+    a->setData(-1);
+    a->setCheckable(true);
+    a->setChecked(_useGraphviz);
+    a = m->addAction(tr("Keep Layouts on Disk"));
+    a->setData(-2);
+    a->setCheckable(true);
+    a->setChecked(_layoutCache->isPersistent());
 
     connect(m, &QMenu::triggered,
             this, &CallGraphView::layoutTriggered );
@@ -2929,7 +3203,15 @@ QMenu* CallGraphView::addLayoutMenu(QMenu* menu)
 
 void CallGraphView::layoutTriggered(QAction* a)
 {
-    _layout = (Layout) a->data().toInt(0);
+    int l = a->data().toInt(0);
+    if (l == -2) {
+        _layoutCache->setPersistent(!_layoutCache->isPersistent());
+        return;
+    }
+    if (l == -1)
+        _useGraphviz = !_useGraphviz;
+    else
+        _layout = (Layout) l;
     refresh();
 }
 
@@ -3169,6 +3451,9 @@ void CallGraphView::restoreOptions(const QString& prefix, const QString& postfix
                                             layoutString(DEFAULT_LAYOUT)).toString());
     _zoomPosition = zoomPos(g->value(QStringLiteral("ZoomPosition"),
                                      zoomPosString(DEFAULT_ZOOMPOS)).toString());
+    _useGraphviz = g->value(QStringLiteral("UseGraphviz"), DEFAULT_USEGRAPHVIZ).toBool();
+    _layoutCache->setPersistent(g->value(QStringLiteral("PersistLayouts"),
+                                         DEFAULT_PERSISTLAYOUTS).toBool());
 
     delete g;
 }
@@ -3188,6 +3473,9 @@ void CallGraphView::saveOptions(const QString& prefix, const QString& postfix)
     g->setValue(QStringLiteral("Layout"), layoutString(_layout), layoutString(DEFAULT_LAYOUT));
     g->setValue(QStringLiteral("ZoomPosition"), zoomPosString(_zoomPosition),
                 zoomPosString(DEFAULT_ZOOMPOS));
+    g->setValue(QStringLiteral("UseGraphviz"), _useGraphviz, DEFAULT_USEGRAPHVIZ);
+    g->setValue(QStringLiteral("PersistLayouts"), _layoutCache->isPersistent(),
+                DEFAULT_PERSISTLAYOUTS);
 
     delete g;
 }
@@ -40,6 +40,7 @@
 #include <QResizeEvent>
 #include <QContextMenuEvent>
 #include <QMouseEvent>
+#include <QElapsedTimer>
 
 #include "treemap.h" // for DrawParams
 #include "tracedata.h"
@@ -52,6 +53,9 @@ class QIODevice;
 class CanvasNode;
 class CanvasEdge;
 class GraphEdge;
+class GraphLayout;
+class GraphLayoutCache;
+class GraphLayoutResult;
 class CallGraphView;
 
 
@@ -330,7 +334,21 @@ public:
     // Create a subgraph with given limits/maxDepths
     void createGraph();
 
-    // calls createGraph before dumping of not already created
+    // Select nodes and edges to show, calls createGraph if needed
+    void selectGraph();
+
+    // selected parts of the graph, with sum-edges for skipped calls
+    const QList<GraphNode*>& visibleNodes() const
+    {
+        return _visibleNodes;
+    }
+
+    const QList<GraphEdge*>& visibleEdges() const
+    {
+        return _visibleEdges;
+    }
+
+    // calls selectGraph before dumping
     void writeDot(QIODevice* = 0);
 
     // to map back to structures when parsing a layouted graph
@@ -358,7 +376,7 @@ private:
     ProfileContext::Type _groupType;
     QTemporaryFile* _tmpFile;
     double _realFuncLimit, _realCallLimit;
-    bool _graphCreated;
+    bool _graphCreated, _graphSelected;
 
     GraphOptions* _go;
 
@@ -368,6 +386,8 @@ private:
     // graph parts written to file
     GraphNodeMap _nodeMap;
     GraphEdgeMap _edgeMap;
+    QList<GraphNode*> _visibleNodes;
+    QList<GraphEdge*> _visibleEdges;
 };
 
 
@@ -636,6 +656,16 @@ private:
     CostItem* canShow(CostItem*) Q_DECL_OVERRIDE;
     void doUpdate(int, bool) Q_DECL_OVERRIDE;
     void refresh();
+    QString layoutOptions();
+    void layoutGraph();
+    QSizeF nodeSize(GraphNode*);
+    void createScene(int w, int h);
+    void addSkippedPoint(const QPoint&);
+    CanvasNode* addCanvasNode(GraphNode*, const QRect&);
+    CanvasEdge* addCanvasEdge(GraphEdge*, const QPolygon&);
+    void addCanvasEdgeLabel(CanvasEdge*, const QPoint&);
+    void showLayout(const GraphLayoutResult&);
+    void showGraph(GraphNode* activeNode, GraphEdge* activeEdge);
     void makeFrame(CanvasNode*, bool active);
     void clear();
     void showText(QString);
@@ -672,6 +702,15 @@ private:
     // widget options
     ZoomPosition _zoomPosition, _lastAutoPosition;
 
+    // built-in layout, or 'dot'/'twopi' from GraphViz
+    GraphLayout* _graphLayout;
+    bool _useGraphviz;
+    QElapsedTimer _renderTime;
+
+    // results of previous layouts, and key of current graph
+    GraphLayoutCache* _layoutCache;
+    QByteArray _layoutKey;
+
     // background rendering
     QProcess* _renderProcess;
     QString _renderProcessCmdLine;
@@ -523,12 +523,16 @@ void CallMapView::doUpdate(int changeType, bool)
         /* regenerates the treemap because traceitems were added/removed */
         base()->refresh();
     }
-    else if ((changeType & partsChanged) ||
-             (changeType & eventTypeChanged)) {
+    else if (changeType & partsChanged) {
         /* we need to do the draw order sorting again as the values change */
         resort();
         redraw();
     }
+    else if (changeType & eventTypeChanged) {
+        /* values of the other event type are still valid: reuse layout */
+        resort();
+        updateLayout();
+    }
     else
         redraw();
 }
@@ -544,6 +548,13 @@ QColor CallMapView::groupColor(TraceFunction* f) const
 }
 
 
+// layouts are cached per event type
+QString CallMapView::layoutKey() const
+{
+    return _eventType ? _eventType->name() : QString();
+}
+
+
 QString CallMapView::tipString(TreeMapItem* i) const
 {
     QString tip, itemTip;
@@ -606,6 +617,18 @@ DrawParams::Position CallMapItemBase::position(int i) const
     return TopRight;
 }
 
+// costs of calls shown as items, calculated in one pass
+static void calculateCosts(EventType* ct, const TraceCallList& calls)
+{
+    if (!ct) return;
+
+    QVector<ProfileCostArray*> items;
+    items.reserve(calls.count());
+    foreach(TraceCall* call, calls)
+        items.append(call);
+    ct->subCosts(items);
+}
+
 
 
 // CallMapRootItem
@@ -710,6 +733,7 @@ TreeMapItemList* CallMapRootItem::children()
 
         setSorting(-1);
         if (w->showCallers()) {
+            calculateCosts(w->eventType(), _f->callers());
             foreach(TraceCall* call, _f->callers()) {
                 // do not show calls inside of a cycle
                 if (call->inCycle()>0) continue;
@@ -721,6 +745,7 @@ TreeMapItemList* CallMapRootItem::children()
             setSum(0);
         }
         else {
+            calculateCosts(w->eventType(), _f->callings());
             foreach(TraceCall* call, _f->callings()) {
                 // do not show calls inside of a cycle
                 if (call->inCycle()>0) continue;
@@ -852,6 +877,7 @@ TreeMapItemList* CallMapCallingItem::children()
                _factor, v, s, newFactor);
 #endif
         setSorting(-1);
+        calculateCosts(ct, _c->called()->callings());
         foreach(TraceCall* call, _c->called()->callings()) {
             // do not show calls inside of a cycle
             if (call->inCycle()>0) continue;
@@ -959,6 +985,7 @@ TreeMapItemList* CallMapCallerItem::children()
 #endif
         setSorting(-1);
 
+        calculateCosts(ct, _c->caller()->callers());
         foreach(TraceCall* call, _c->caller()->callers()) {
             // do not show calls inside of a cycle
             if (call->inCycle()>0) continue;
@@ -51,6 +51,7 @@ public:
     bool showCallers() const { return _showCallers; }
     ProfileCostArray* totalCost();
     QString tipString(TreeMapItem*) const Q_DECL_OVERRIDE;
+    QString layoutKey() const Q_DECL_OVERRIDE;
     QColor groupColor(TraceFunction*) const;
 
 private slots:
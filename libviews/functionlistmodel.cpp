@@ -18,13 +18,254 @@
 
 #include "functionlistmodel.h"
 
+#include <algorithm>
+#include <iterator>
+
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QSet>
+#include <QThreadPool>
+
+#include "functionnameindex.h"
 #include "globalguiconfig.h"
 #include "listutils.h"
 
+// if more than this part of candidates is shown, all are sorted
+#define FULLSORT_RATIO 4
+// candidate lists with precalculated keys sorted in parallel chunks
+#define PARALLELSORT_MIN 100000
+
+// lists filtered in background using a trigram index of names
+#define FILTER_BACKGROUND_MIN 20000
+// names matched between checks for cancellation/passing results
+#define FILTER_BATCH          1000
+// interval for passing results to the model after the first ones
+#define FILTER_UPDATE_MS      100
+
+/* order of indexes into precalculated sort keys.
+ * Same keys are ordered by index, which gives the order of a stable sort
+ * and allows to use unstable/partial sorting.
+ */
+class CostIndexLessThan
+{
+public:
+    CostIndexLessThan(const QVector<SubCost>& costs, Qt::SortOrder order)
+        : _costs(costs.constData()) { _order = order; }
+
+    bool operator()(int left, int right) const
+    {
+        uint64 l = _costs[left].v, r = _costs[right].v;
+        if (l == r) return left < right;
+        return (_order == Qt::DescendingOrder) ? (r < l) : (l < r);
+    }
+
+private:
+    const SubCost* _costs;
+    Qt::SortOrder _order;
+};
+
+// order of indexes into candidates, for sorting by name
+class FunctionIndexLessThan
+{
+public:
+    FunctionIndexLessThan(const QList<TraceFunction*>& list,
+                          const FunctionListModel::FunctionLessThan& lessThan)
+        : _list(list), _lessThan(lessThan) {}
+
+    bool operator()(int left, int right)
+    {
+        if (_lessThan(_list[left], _list[right])) return true;
+        if (_lessThan(_list[right], _list[left])) return false;
+        return left < right;
+    }
+
+private:
+    const QList<TraceFunction*>& _list;
+    FunctionListModel::FunctionLessThan _lessThan;
+};
+
+// sorts a range of indexes in a worker thread
+class IndexSorter: public QRunnable
+{
+public:
+    IndexSorter(int* begin, int* end, const CostIndexLessThan& lessThan,
+                QSemaphore* done)
+        : _lessThan(lessThan)
+    { _begin = begin; _end = end; _done = done; }
+
+    void run() Q_DECL_OVERRIDE
+    {
+        std::sort(_begin, _end, _lessThan);
+        _done->release();
+    }
+
+private:
+    int *_begin, *_end;
+    CostIndexLessThan _lessThan;
+    QSemaphore* _done;
+};
+
+/* State of a background filter run, shared between the model and
+ * the worker thread.
+ */
+struct FunctionFilterRun
+{
+    FunctionFilterRun() { finished = false; notified = false; }
+
+    QAtomicInt canceled;
+    // released when the worker is done
+    QSemaphore done;
+
+    // results not yet taken by the model
+    QMutex mutex;
+    QVector<int> matches;
+    bool finished, notified;
+};
+
+/* Matches names of functions with the filter in a worker thread.
+ * Candidates are the functions with all trigrams of the filter, and with
+ * <useBase>, only the functions from <base> (matches of previous filter).
+ */
+class FunctionFilter: public QRunnable
+{
+public:
+    FunctionFilter(FunctionListModel* model,
+                   const QSharedPointer<FunctionFilterRun>& run,
+                   const QList<TraceFunction*>& list,
+                   const QSharedPointer<FunctionNameIndex>& index,
+                   const QString& filterString,
+                   const QVector<int>& base, bool useBase)
+        : _run(run), _list(list), _index(index), _base(base)
+    {
+        _model = model;
+        _filterString = filterString;
+        _useBase = useBase;
+    }
+
+    void run() Q_DECL_OVERRIDE;
+
+private:
+    void deliver(QVector<int>& found, bool finished);
+
+    FunctionListModel* _model;
+    QSharedPointer<FunctionFilterRun> _run;
+    QList<TraceFunction*> _list;
+    QSharedPointer<FunctionNameIndex> _index;
+    QVector<int> _base;
+    QString _filterString;
+    bool _useBase;
+};
+
+// intersection of ascending index lists
+static QVector<int> intersect(const QVector<int>& l1, const QVector<int>& l2)
+{
+    QVector<int> res;
+    std::set_intersection(l1.constBegin(), l1.constEnd(),
+                          l2.constBegin(), l2.constEnd(),
+                          std::back_inserter(res));
+    return res;
+}
+
+void FunctionFilter::run()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QVector<int> candidates;
+    bool restricted = false;
+    if (_index && _index->build(&_run->canceled))
+        restricted = _index->candidates(_filterString, candidates);
+    if (_useBase) {
+        candidates = restricted ? intersect(candidates, _base) : _base;
+        restricted = true;
+    }
+
+    QRegExp filter(_filterString, Qt::CaseInsensitive, QRegExp::Wildcard);
+    QVector<int> found;
+    int count = restricted ? candidates.count() : _list.count();
+    bool first = true;
+    for(int i=0; i<count; i++) {
+        if ((i > 0) && ((i % FILTER_BATCH) == 0)) {
+            if (_run->canceled.load()) break;
+
+            // show first results as soon as possible
+            if (!found.isEmpty() &&
+                (first || (timer.elapsed() >= FILTER_UPDATE_MS))) {
+                deliver(found, false);
+                first = false;
+                timer.restart();
+            }
+        }
+
+        int c = restricted ? candidates[i] : i;
+        if (filter.indexIn(_list[c]->name()) >= 0)
+            found.append(c);
+    }
+    deliver(found, true);
+
+    if (0)
+        qDebug("FunctionFilter: %d of %d names checked for '%s'",
+               count, _list.count(), qPrintable(_filterString));
+
+    _run->done.release();
+}
+
+void FunctionFilter::deliver(QVector<int>& found, bool finished)
+{
+    bool notify;
+    {
+        QMutexLocker locker(&_run->mutex);
+        _run->matches += found;
+        if (finished) _run->finished = true;
+        // only one pending notification
+        notify = !_run->notified;
+        _run->notified = true;
+    }
+    found.clear();
+
+    if (notify)
+        QMetaObject::invokeMethod(_model, "takeMatches", Qt::QueuedConnection);
+}
+
+/* Sort with precalculated keys: chunks are sorted in parallel by
+ * the global thread pool, and merged afterwards.
+ */
+static void parallelSort(int* begin, int* end, const CostIndexLessThan& lessThan)
+{
+    int chunks = QThreadPool::globalInstance()->maxThreadCount();
+    if ((end - begin < PARALLELSORT_MIN) || (chunks < 2)) {
+        std::sort(begin, end, lessThan);
+        return;
+    }
+
+    QVector<int*> bounds;
+    for(int i=0; i<=chunks; i++)
+        bounds.append(begin + (qint64)(end - begin) * i / chunks);
+
+    QSemaphore done;
+    for(int i=0; i<chunks; i++)
+        QThreadPool::globalInstance()->start(new IndexSorter(bounds[i],
+                                                             bounds[i+1],
+                                                             lessThan, &done));
+    done.acquire(chunks);
+
+    // merge neighboring sorted ranges
+    for(int width=1; width<chunks; width*=2)
+        for(int i=0; i+width<chunks; i+=2*width)
+            std::inplace_merge(bounds[i], bounds[i+width],
+                               bounds[qMin(i+2*width, chunks)], lessThan);
+}
+
 FunctionListModel::FunctionListModel()
     : QAbstractItemModel(0)
 {
     _maxCount = 300;
+    _sortedCount = 0;
+    _topCount = 0;
+    _skippedRow = false;
     _sortColumn = 0;
     _sortOrder = Qt::DescendingOrder;
 
@@ -36,10 +277,14 @@ FunctionListModel::FunctionListModel()
             << tr("Location");
 
     _max0 = _max1 = _max2 = 0;
+    _filterComplete = true;
+    _replacePending = false;
 }
 
 FunctionListModel::~FunctionListModel()
-{}
+{
+    stopFilter();
+}
 
 int FunctionListModel::columnCount(const QModelIndex& parent) const
 {
@@ -52,7 +297,7 @@ int FunctionListModel::rowCount(const QModelIndex& parent ) const
 
     int rowCount = _topList.count();
     // add one more row if functions are skipped
-    if (_topList.count() < _filteredList.count()) rowCount++;
+    if (_skippedRow) rowCount++;
     return rowCount;
 }
 
@@ -68,8 +313,7 @@ QVariant FunctionListModel::data(const QModelIndex &index, int role) const
     if (!index.isValid()) return QVariant();
 
     // the skipped items entry
-    if ( (_topList.count() < _filteredList.count()) &&
-         (index.row() == _topList.count()) ) {
+    if (_skippedRow && (index.row() == _topList.count())) {
         if( (role != Qt::DisplayRole) || (index.column() != 3))
             return QVariant();
 
@@ -140,7 +384,7 @@ QModelIndex FunctionListModel::index(int row, int column,
     if (!hasIndex(row, column, parent)) return QModelIndex();
 
     //the skipped items entry
-    if ( (_topList.count() < _list.count()) && (row == _topList.count()) )
+    if (_skippedRow && (row == _topList.count()))
         return createIndex(row, column);
 
     return createIndex(row, column, (void*)_topList[row]);
@@ -162,9 +406,12 @@ QModelIndex FunctionListModel::indexForFunction(TraceFunction *f, bool add)
         insertPos = std::lower_bound(_topList.begin(), _topList.end(),
                                      f, lessThan);
         row = insertPos - _topList.begin();
+        // keep sorted entries in front, for fetchMore()
+        if (row < _topCount) row = _topCount;
         beginInsertRows(QModelIndex(), row, row);
         _topList.insert(row, f);
         endInsertRows();
+        updateSkippedRow();
     }
 
     return createIndex(row, 0, (void*)f);
@@ -186,18 +433,35 @@ void FunctionListModel::sort(int column, Qt::SortOrder order)
 void FunctionListModel::setFilter(QString filterString)
 {
     if (_filterString == filterString) return;
-    _filterString = filterString;
 
+    // a filter with more characters at start or end only matches names
+    // matching the previous one, as long as no set "[...]" is split
+    QString old = _filterString;
+    bool narrow = _filterComplete && !old.isEmpty() &&
+                  !old.contains('[') && !old.contains(']') &&
+                  (filterString.startsWith(old) || filterString.endsWith(old));
+
+    _filterString = filterString;
     _filter = QRegExp(_filterString, Qt::CaseInsensitive, QRegExp::Wildcard);
-    computeFilteredList();
+    computeFilteredList(narrow);
     computeTopList();
 }
 
+void FunctionListModel::finishFilter()
+{
+    if (!_filterRun) return;
+
+    // wait for the worker, but leave the semaphore for stopFilter()
+    _filterRun->done.acquire();
+    _filterRun->done.release();
+    takeMatches();
+}
+
 void FunctionListModel::setEventType(EventType* et)
 {
     _eventType = et;
     // needed to recalculate max value entries
-    computeFilteredList();
+    computeSortKeys();
     computeTopList();
 }
 
@@ -212,6 +476,8 @@ void FunctionListModel::resetModelData(TraceData *data,
                                        TraceCostItem *group, QString filterString,
                                        EventType * eventType)
 {
+    // a background run may access functions of old data
+    stopFilter();
     _eventType = eventType;
 
     if (!group) {
@@ -268,66 +534,440 @@ void FunctionListModel::resetModelData(TraceData *data,
         }
     }
 
+    // the index is kept as long as the list does not change
+    if (_list.count() < FILTER_BACKGROUND_MIN)
+        _index.clear();
+    else if (!_index || (_index->functions() != _list))
+        _index = QSharedPointer<FunctionNameIndex>(new FunctionNameIndex(_list));
+
     _filterString = filterString;
     _filter = QRegExp(_filterString, Qt::CaseInsensitive, QRegExp::Wildcard);
 
+    // candidates of old data must not be shown while filtering
+    clearCandidates();
     computeFilteredList();
     computeTopList();
 }
 
-void FunctionListModel::computeFilteredList()
+void FunctionListModel::computeFilteredList(bool narrow)
+{
+    stopFilter();
+
+    QVector<int> base;
+    if (narrow) base = _matched;
+    int count = narrow ? base.count() : _list.count();
+
+    // short lists are filtered directly
+    if (_filterString.isEmpty() || (count < FILTER_BACKGROUND_MIN)) {
+        QVector<int> found;
+        for(int i=0; i<count; i++) {
+            int c = narrow ? base[i] : i;
+            if (!_filterString.isEmpty())
+                if (_filter.indexIn(_list[c]->name()) == -1) continue;
+            found.append(c);
+        }
+        _replacePending = true;
+        addCandidates(found);
+        _filterComplete = true;
+        return;
+    }
+
+    // previous candidates are shown until first results arrive
+    _filterComplete = false;
+    _replacePending = true;
+    _filterRun = QSharedPointer<FunctionFilterRun>(new FunctionFilterRun);
+    QThreadPool::globalInstance()->start(new FunctionFilter(this, _filterRun,
+                                                            _list, _index,
+                                                            _filterString,
+                                                            base, narrow));
+}
+
+void FunctionListModel::stopFilter()
+{
+    if (!_filterRun) return;
+
+    _filterRun->canceled.store(1);
+    _filterRun->done.acquire();
+    _filterRun.clear();
+}
+
+void FunctionListModel::takeMatches()
 {
-    FunctionLessThan lessThan0(0, Qt::AscendingOrder, _eventType);
-    FunctionLessThan lessThan1(1, Qt::AscendingOrder, _eventType);
-    FunctionLessThan lessThan2(2, Qt::AscendingOrder, _eventType);
+    if (!_filterRun) return;
+
+    QVector<int> matches;
+    bool finished;
+    {
+        QMutexLocker locker(&_filterRun->mutex);
+        matches = _filterRun->matches;
+        _filterRun->matches.clear();
+        finished = _filterRun->finished;
+        _filterRun->notified = false;
+    }
+    if (matches.isEmpty() && !finished) return;
+
+    // first results replace the previous candidates, and reset the view
+    bool replace = _replacePending;
+    int first = _filteredList.count();
+    addCandidates(matches);
+    if (finished) {
+        // the worker is done or about to be
+        stopFilter();
+        _filterComplete = true;
+    }
+    if (replace)
+        computeTopList();
+    else
+        mergeCandidates(first);
 
+    emit filterUpdated();
+}
+
+void FunctionListModel::clearCandidates()
+{
+    _replacePending = false;
+    _filteredList.clear();
+    _matched.clear();
+    _inclCosts.clear();
+    _selfCosts.clear();
+    _calledCounts.clear();
+    _max0 = _max1 = _max2 = 0;
+}
+
+/* Append functions from _list given by <indexes> to the candidates,
+ * replacing the previous ones if requested.
+ */
+void FunctionListModel::addCandidates(const QVector<int>& indexes)
+{
+    if (_replacePending) clearCandidates();
+
+    QVector<ProfileCostArray*> inclItems, selfItems;
+    inclItems.reserve(indexes.count());
+    selfItems.reserve(indexes.count());
+    foreach(int i, indexes) {
+        TraceFunction* f = _list[i];
+        _filteredList.append(f);
+        _calledCounts.append(f->calledCount());
+        inclItems.append(f->inclusive());
+        selfItems.append(f);
+    }
+    _matched += indexes;
+
+    // sort keys: inclusive and self costs of new candidates in one pass each
+    if (_eventType) {
+        _inclCosts += _eventType->subCosts(inclItems);
+        _selfCosts += _eventType->subCosts(selfItems);
+    }
+    else {
+        _inclCosts.resize(_filteredList.count());
+        _selfCosts.resize(_filteredList.count());
+    }
+
+    updateMaxEntries();
+}
+
+// sort keys for all candidates, e.g. for another event type
+void FunctionListModel::computeSortKeys()
+{
+    int count = _filteredList.count();
+    _inclCosts = QVector<SubCost>(count);
+    _selfCosts = QVector<SubCost>(count);
+    if (_eventType && (count > 0)) {
+        QVector<ProfileCostArray*> inclItems, selfItems;
+        inclItems.reserve(count);
+        selfItems.reserve(count);
+        foreach(TraceFunction* f, _filteredList) {
+            inclItems.append(f->inclusive());
+            selfItems.append(f);
+        }
+        _inclCosts = _eventType->subCosts(inclItems);
+        _selfCosts = _eventType->subCosts(selfItems);
+    }
+
+    updateMaxEntries();
+}
+
+void FunctionListModel::updateMaxEntries()
+{
     // reset max functions
     _max0 = 0;
     _max1 = 0;
     _max2 = 0;
 
-    _filteredList.clear();
-    int index = 0;
-    foreach(TraceFunction* f, _list) {
-        if (!_filterString.isEmpty())
-            if (_filter.indexIn(f->name()) == -1) continue;
+    int count = _filteredList.count();
+    if (count == 0) return;
 
-        _filteredList.append(f);
-        if (!_max0 || lessThan0(_max0, f)) { _max0 = f; }
-        if (!_max1 || lessThan1(_max1, f)) { _max1 = f; }
-        if (!_max2 || lessThan2(_max2, f)) { _max2 = f; }
-        index++;
+    int max0 = 0, max1 = 0, max2 = 0;
+    for(int i=1; i<count; i++) {
+        if (_inclCosts[max0] < _inclCosts[i]) max0 = i;
+        if (_selfCosts[max1] < _selfCosts[i]) max1 = i;
+        if (_calledCounts[max2] < _calledCounts[i]) max2 = i;
+    }
+    _max0 = _filteredList[max0];
+    _max1 = _filteredList[max1];
+    _max2 = _filteredList[max2];
+}
+
+/* Make sure that the first <count> entries of _order are sorted.
+ * Only these are sorted if they are few, by partial sorting. Otherwise,
+ * all remaining entries are sorted (in parallel if possible).
+ */
+void FunctionListModel::sortCandidates(int count)
+{
+    if (count <= _sortedCount) return;
+
+    int* begin = _order.data() + _sortedCount;
+    int* end = _order.data() + _order.count();
+    int* middle = begin + (count - _sortedCount);
+    bool partial = (count < _order.count() / FULLSORT_RATIO);
+
+    // precalculated keys for cost columns, names compared otherwise
+    const QVector<SubCost>* keys = 0;
+    if (_sortColumn == 0) keys = &_inclCosts;
+    else if (_sortColumn == 1) keys = &_selfCosts;
+    else if (_sortColumn == 2) keys = &_calledCounts;
+
+    if (keys) {
+        CostIndexLessThan lessThan(*keys, _sortOrder);
+        if (partial)
+            std::partial_sort(begin, middle, end, lessThan);
+        else
+            parallelSort(begin, end, lessThan);
+    }
+    else {
+        FunctionIndexLessThan lessThan(_filteredList,
+                                       FunctionLessThan(_sortColumn, _sortOrder,
+                                                        _eventType));
+        if (partial)
+            std::partial_sort(begin, middle, end, lessThan);
+        else
+            std::sort(begin, end, lessThan);
     }
+
+    _sortedCount = partial ? count : _order.count();
 }
 
 void FunctionListModel::computeTopList()
 {
     beginResetModel();
     _topList.clear();
-    if (_filteredList.isEmpty()) {
+    _topCount = 0;
+    _sortedCount = 0;
+    _skippedRow = false;
+
+    int count = _filteredList.count();
+    _order.resize(count);
+    for(int i=0; i<count; i++)
+        _order[i] = i;
+    if (count == 0) {
         endResetModel();
         return;
     }
 
-    FunctionLessThan lessThan(_sortColumn, _sortOrder, _eventType);
-    std::stable_sort(_filteredList.begin(), _filteredList.end(), lessThan);
+    _topCount = qMin(_maxCount, count);
+    sortCandidates(_topCount);
 
-    foreach(TraceFunction* f, _filteredList) {
+    bool shown0 = false, shown1 = false, shown2 = false;
+    for(int i=0; i<_topCount; i++) {
+        TraceFunction* f = _filteredList[_order[i]];
         _topList.append(f);
-        if (_topList.count() >= _maxCount) break;
+        if (f == _max0) shown0 = true;
+        if (f == _max1) shown1 = true;
+        if (f == _max2) shown2 = true;
     }
 
     // append max entries
     QList<TraceFunction*> maxList;
-    if (_max0 && !_topList.contains(_max0)) maxList.append(_max0);
-    if (_max1 && !_topList.contains(_max1)) maxList.append(_max1);
-    if (_max2 && !_topList.contains(_max2)) maxList.append(_max2);
+    if (!shown0) maxList.append(_max0);
+    if (!shown1 && !maxList.contains(_max1)) maxList.append(_max1);
+    if (!shown2 && !maxList.contains(_max2)) maxList.append(_max2);
+    FunctionLessThan lessThan(_sortColumn, _sortOrder, _eventType);
     std::stable_sort(maxList.begin(), maxList.end(), lessThan);
     _topList.append(maxList);
+    _skippedRow = (_topList.count() < count);
 
     endResetModel();
 }
 
+/* Merge the first <count> of the sorted indexes <top> and the unsorted
+ * indexes <added>, which gets partially sorted for this.
+ */
+template<class LessThan>
+static QVector<int> mergeSorted(const int* top, int topCount,
+                                QVector<int>& added, int count,
+                                LessThan lessThan)
+{
+    int sorted = qMin(count, added.count());
+    std::partial_sort(added.begin(), added.begin() + sorted, added.end(),
+                      lessThan);
+
+    QVector<int> res;
+    res.reserve(count);
+    int i = 0, j = 0;
+    while((res.count() < count) && ((i < topCount) || (j < sorted))) {
+        if ((j == sorted) || ((i < topCount) && lessThan(top[i], added[j])))
+            res.append(top[i++]);
+        else
+            res.append(added[j++]);
+    }
+    return res;
+}
+
+/* Show candidates from index <first> on, found by a background filter
+ * run, without resetting the model: the view keeps its scroll position
+ * and the entries fetched by fetchMore(). New candidates are inserted
+ * into the sorted entries, keeping their number. Sorted entries getting
+ * skipped by this are removed from the end.
+ */
+void FunctionListModel::mergeCandidates(int first)
+{
+    int count = _filteredList.count();
+    if (first == count) return;
+
+    QVector<int> added(count - first);
+    for(int i=first; i<count; i++)
+        added[i-first] = i;
+
+    int shown = qMin(qMax(_maxCount, _topCount), count);
+    QVector<int> top;
+    if (_sortColumn == 0)
+        top = mergeSorted(_order.constData(), _topCount, added, shown,
+                          CostIndexLessThan(_inclCosts, _sortOrder));
+    else if (_sortColumn == 1)
+        top = mergeSorted(_order.constData(), _topCount, added, shown,
+                          CostIndexLessThan(_selfCosts, _sortOrder));
+    else if (_sortColumn == 2)
+        top = mergeSorted(_order.constData(), _topCount, added, shown,
+                          CostIndexLessThan(_calledCounts, _sortOrder));
+    else
+        top = mergeSorted(_order.constData(), _topCount, added, shown,
+                          FunctionIndexLessThan(_filteredList,
+                                                FunctionLessThan(_sortColumn, _sortOrder,
+                                                                 _eventType)));
+
+    // entries kept keep their order: skipped ones are at the end
+    int kept = 0;
+    foreach(int i, top)
+        if (i < first) kept++;
+    if (kept < _topCount) {
+        beginRemoveRows(QModelIndex(), kept, _topCount-1);
+        for(int row = _topCount-1; row >= kept; row--)
+            _topList.removeAt(row);
+        _topCount = kept;
+        endRemoveRows();
+    }
+
+    // insert runs of new entries
+    int row = 0;
+    while(row < top.count()) {
+        if (top[row] < first) {
+            row++;
+            continue;
+        }
+        int end = row;
+        while((end < top.count()) && (top[end] >= first)) end++;
+        beginInsertRows(QModelIndex(), row, end-1);
+        for(int i=row; i<end; i++)
+            _topList.insert(i, _filteredList[top[i]]);
+        _topCount += end - row;
+        endInsertRows();
+        row = end;
+    }
+    Q_ASSERT(_topCount == top.count());
+
+    // sorted entries first, the others in any order
+    QVector<bool> inTop(count, false);
+    foreach(int i, top)
+        inTop[i] = true;
+    _order = top;
+    for(int i=0; i<count; i++)
+        if (!inTop[i]) _order.append(i);
+    _sortedCount = _topCount;
+
+    // max entries not shown yet, e.g. new ones, are appended
+    QList<TraceFunction*> maxList;
+    if (!_topList.contains(_max0)) maxList.append(_max0);
+    if (!_topList.contains(_max1) && !maxList.contains(_max1)) maxList.append(_max1);
+    if (!_topList.contains(_max2) && !maxList.contains(_max2)) maxList.append(_max2);
+    if (!maxList.isEmpty()) {
+        FunctionLessThan lessThan(_sortColumn, _sortOrder, _eventType);
+        std::stable_sort(maxList.begin(), maxList.end(), lessThan);
+        int row = _topList.count();
+        beginInsertRows(QModelIndex(), row, row + maxList.count()-1);
+        _topList.append(maxList);
+        endInsertRows();
+    }
+
+    updateSkippedRow();
+}
+
+void FunctionListModel::updateSkippedRow()
+{
+    int row = _topList.count();
+    bool skipped = (row < _filteredList.count());
+
+    if (skipped && !_skippedRow) {
+        beginInsertRows(QModelIndex(), row, row);
+        _skippedRow = true;
+        endInsertRows();
+    }
+    else if (!skipped && _skippedRow) {
+        beginRemoveRows(QModelIndex(), row, row);
+        _skippedRow = false;
+        endRemoveRows();
+    }
+    else if (skipped) {
+        // number of skipped functions changed
+        emit dataChanged(index(row, 0), index(row, columnCount()-1));
+    }
+}
+
+bool FunctionListModel::canFetchMore(const QModelIndex& parent) const
+{
+    if (parent.isValid()) return false;
+    return _topCount < _filteredList.count();
+}
+
+/* Called by the view when scrolling to the end: show the next
+ * <_maxCount> candidates. Entries shown out of order after the sorted
+ * ones (max entries, functions added by indexForFunction) are removed
+ * if they get part of the sorted entries.
+ */
+void FunctionListModel::fetchMore(const QModelIndex& parent)
+{
+    if (!canFetchMore(parent)) return;
+
+    int count = qMin(_topCount + _maxCount, _filteredList.count());
+    sortCandidates(count);
+
+    QList<TraceFunction*> added;
+    for(int i=_topCount; i<count; i++)
+        added.append(_filteredList[_order[i]]);
+
+    QSet<TraceFunction*> addedSet = added.toSet();
+    for(int row = _topList.count()-1; row >= _topCount; row--) {
+        if (!addedSet.contains(_topList[row])) continue;
+        beginRemoveRows(QModelIndex(), row, row);
+        _topList.removeAt(row);
+        endRemoveRows();
+    }
+
+    // with the last batch, all functions are shown: the row for skipped
+    // functions after the entries has to be removed, too
+    if ((count == _filteredList.count()) && _skippedRow) {
+        int row = _topList.count();
+        beginRemoveRows(QModelIndex(), row, row);
+        _skippedRow = false;
+        endRemoveRows();
+    }
+
+    beginInsertRows(QModelIndex(), _topCount, count-1);
+    for(int i=0; i<added.count(); i++)
+        _topList.insert(_topCount + i, added[i]);
+    _topCount = count;
+    endInsertRows();
+}
+
 QString FunctionListModel::getName(TraceFunction *f) const
 {
     return f->prettyName();
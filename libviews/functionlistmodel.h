@@ -23,10 +23,15 @@
 #include <QPixmap>
 #include <QRegExp>
 #include <QList>
+#include <QSharedPointer>
+#include <QVector>
 
 #include "tracedata.h"
 #include "subcost.h"
 
+class FunctionNameIndex;
+struct FunctionFilterRun;
+
 
 class FunctionListModel : public QAbstractItemModel
 {
@@ -54,8 +59,15 @@ public:
     int rowCount(const QModelIndex &parent = QModelIndex()) const Q_DECL_OVERRIDE;
     int columnCount(const QModelIndex &parent = QModelIndex()) const Q_DECL_OVERRIDE;
     void sort(int column, Qt::SortOrder order) Q_DECL_OVERRIDE;
+    bool canFetchMore(const QModelIndex &parent) const Q_DECL_OVERRIDE;
+    void fetchMore(const QModelIndex &parent) Q_DECL_OVERRIDE;
 
+    /* For long lists, matching the filter is done in the background,
+     * and matching functions are added while the filter runs.
+     */
     void setFilter(QString filter);
+    // wait until all matches of the filter are shown
+    void finishFilter();
     void setEventType(EventType*);
     void setMaxCount(int);
 
@@ -77,6 +89,14 @@ public:
         EventType* _eventType;
     };
 
+signals:
+    // functions matching the filter were added in the background
+    void filterUpdated();
+
+private slots:
+    // get functions found matching in background
+    void takeMatches();
+
 private:
     QString getName(TraceFunction *f) const;
     QPixmap getNamePixmap(TraceFunction  *f) const;
@@ -88,10 +108,23 @@ private:
     QString getLocation(TraceFunction *f) const;
     QString getSkippedCost(TraceFunction *f, QPixmap *pixmap) const;
 
-    // compute the list of candidates to show, ignoring order
-    void computeFilteredList();
+    /* compute the list of candidates to show, ignoring order. With
+     * <narrow>, only candidates matching the previous filter are checked
+     */
+    void computeFilteredList(bool narrow = false);
+    void stopFilter();
+    void clearCandidates();
+    void addCandidates(const QVector<int>& indexes);
+    void computeSortKeys();
+    void updateMaxEntries();
     // computes entries to show from candidates using current order
     void computeTopList();
+    // merge candidates from index <first> on into the shown entries
+    void mergeCandidates(int first);
+    // sort candidates at least up to position <count>
+    void sortCandidates(int count);
+    // add/remove/update the entry for skipped functions
+    void updateSkippedRow();
 
     QList<QVariant> _headerData;
     EventType *_eventType;
@@ -101,6 +134,25 @@ private:
     QList<TraceFunction*> _list;
     QList<TraceFunction*> _filteredList;
     QList<TraceFunction*> _topList;
+    // indexes of candidates in _list
+    QVector<int> _matched;
+
+    // trigram index over names of long lists, and current background run
+    QSharedPointer<FunctionNameIndex> _index;
+    QSharedPointer<FunctionFilterRun> _filterRun;
+    // all matches of <_filterString> are in _filteredList
+    bool _filterComplete;
+    // first background results replace the previous candidates
+    bool _replacePending;
+
+    // sort keys of candidates, calculated once per filter/event type
+    QVector<SubCost> _inclCosts, _selfCosts, _calledCounts;
+    // indexes of candidates, sorted up to <_sortedCount>.
+    // The first <_topCount> are shown in order at start of _topList
+    QVector<int> _order;
+    int _sortedCount, _topCount;
+    // is there an entry for skipped functions after <_topList>?
+    bool _skippedRow;
 
     // functions with max values at col.0/1/2 from candidate list:
     // these are always shown to have same column widths when resorting
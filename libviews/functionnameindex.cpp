@@ -0,0 +1,168 @@
+/* This file is part of KCachegrind.
+   Copyright (c) 2026 The KCachegrind developers
+
+   KCachegrind is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation, version 2.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+/*
+ * Trigram index over function names
+ */
+
+#include "functionnameindex.h"
+
+#include <algorithm>
+
+#include <QElapsedTimer>
+#include <QDebug>
+
+// functions indexed between checks for cancellation
+#define INDEX_CHECK_INTERVAL 4096
+
+
+FunctionNameIndex::FunctionNameIndex(const QList<TraceFunction*>& functions)
+{
+    _functions = functions;
+    _built = false;
+}
+
+// key for 3 lower case ASCII characters, false for others
+bool FunctionNameIndex::trigram(const QChar* s, quint32& key)
+{
+    ushort c0 = s[0].unicode(), c1 = s[1].unicode(), c2 = s[2].unicode();
+    if ((c0 >= 128) || (c1 >= 128) || (c2 >= 128)) return false;
+    key = (c0 << 14) | (c1 << 7) | c2;
+    return true;
+}
+
+bool FunctionNameIndex::build(const QAtomicInt* canceled)
+{
+    if (_built) return true;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    _postings.clear();
+    quint32 key;
+    for(int i=0; i<_functions.count(); i++) {
+        if (canceled && ((i % INDEX_CHECK_INTERVAL) == 0) &&
+            canceled->load()) {
+            _postings.clear();
+            return false;
+        }
+
+        QString name = _functions[i]->name().toLower();
+        const QChar* s = name.constData();
+        for(int j=0; j+2<name.length(); j++) {
+            if (!trigram(s+j, key)) continue;
+            QVector<int>& p = _postings[key];
+            // trigrams appearing multiple times in a name
+            if (p.isEmpty() || (p.last() != i)) p.append(i);
+        }
+    }
+    _built = true;
+
+    if (0) qDebug("FunctionNameIndex: %d trigrams of %d names indexed in %lld ms",
+                  _postings.count(), _functions.count(), timer.elapsed());
+
+    return true;
+}
+
+/* Literal parts of a pattern with QRegExp::Wildcard syntax: '*' and
+ * '?' are wildcards, "[...]" a set of characters. <ok> is set to false
+ * for sets without closing bracket, which do not give a valid pattern.
+ */
+QStringList FunctionNameIndex::literals(const QString& pattern, bool* ok)
+{
+    QStringList res;
+    QString current;
+    if (ok) *ok = true;
+
+    int i = 0, len = pattern.length();
+    while(i < len) {
+        QChar c = pattern[i];
+        if ((c != '*') && (c != '?') && (c != '[')) {
+            current += c.toLower();
+            i++;
+            continue;
+        }
+
+        if (!current.isEmpty()) res.append(current);
+        current = QString();
+        i++;
+        if (c != '[') continue;
+
+        // skip set, a ']' directly after '[' or "[^" is part of it
+        if ((i < len) && ((pattern[i] == '^') || (pattern[i] == '!'))) i++;
+        if ((i < len) && (pattern[i] == ']')) i++;
+        while((i < len) && (pattern[i] != ']')) i++;
+        if (i == len) {
+            if (ok) *ok = false;
+            return QStringList();
+        }
+        i++;
+    }
+    if (!current.isEmpty()) res.append(current);
+
+    return res;
+}
+
+// order of posting lists by length, shortest first
+static bool shorterList(const QVector<int>* l1, const QVector<int>* l2)
+{
+    return l1->count() < l2->count();
+}
+
+bool FunctionNameIndex::candidates(const QString& pattern,
+                                   QVector<int>& result) const
+{
+    result.clear();
+    if (!_built) return false;
+
+    bool ok;
+    QStringList parts = literals(pattern, &ok);
+    if (!ok) return false;
+
+    QVector<const QVector<int>*> lists;
+    quint32 key;
+    foreach(const QString& part, parts) {
+        const QChar* s = part.constData();
+        for(int j=0; j+2<part.length(); j++) {
+            if (!trigram(s+j, key)) continue;
+
+            QHash<quint32, QVector<int> >::ConstIterator it;
+            it = _postings.constFind(key);
+            // no name contains this trigram
+            if (it == _postings.constEnd()) return true;
+            lists.append(&(*it));
+        }
+    }
+    if (lists.isEmpty()) return false;
+
+    // intersect, starting with the shortest list
+    std::sort(lists.begin(), lists.end(), shorterList);
+    result = *lists[0];
+    for(int l=1; (l<lists.count()) && !result.isEmpty(); l++) {
+        const QVector<int>& other = *lists[l];
+        int count = 0, j = 0;
+        for(int i=0; i<result.count(); i++) {
+            while((j < other.count()) && (other[j] < result[i])) j++;
+            if (j == other.count()) break;
+            if (other[j] == result[i]) result[count++] = result[i];
+        }
+        result.resize(count);
+    }
+
+    return true;
+}
@@ -0,0 +1,76 @@
+/* This file is part of KCachegrind.
+   Copyright (c) 2026 The KCachegrind developers
+
+   KCachegrind is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation, version 2.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+/*
+ * Trigram index over function names
+ */
+
+#ifndef FUNCTIONNAMEINDEX_H
+#define FUNCTIONNAMEINDEX_H
+
+#include <QAtomicInt>
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include "tracedata.h"
+
+/**
+ * Index of all trigrams (3 consecutive characters) in the lower case
+ * names of a list of functions, to find candidates for a substring search
+ * with a case insensitive wildcard pattern without looking at all names.
+ *
+ * A function can only match if its name contains all trigrams of the
+ * literal parts of the pattern. Candidates still have to be checked with
+ * the pattern. Only trigrams of ASCII characters are indexed.
+ *
+ * The index is built by build(), which can be called from a worker
+ * thread, as function names do not change after loading.
+ */
+class FunctionNameIndex
+{
+public:
+    explicit FunctionNameIndex(const QList<TraceFunction*>& functions);
+
+    const QList<TraceFunction*>& functions() const { return _functions; }
+
+    /* build the index if not done yet. Returns false if aborted because
+     * <canceled> got set; the index is built again on next call.
+     */
+    bool build(const QAtomicInt* canceled = 0);
+
+    /* ascending indexes into functions() which can match <pattern>.
+     * Returns false if the pattern gives no restriction.
+     */
+    bool candidates(const QString& pattern, QVector<int>& result) const;
+
+    // literal parts of a wildcard pattern, lower case
+    static QStringList literals(const QString& pattern, bool* ok = 0);
+
+private:
+    static bool trigram(const QChar* s, quint32& key);
+
+    QList<TraceFunction*> _functions;
+    bool _built;
+    // trigram => ascending indexes of functions whose name contains it
+    QHash<quint32, QVector<int> > _postings;
+};
+
+#endif // FUNCTIONNAMEINDEX_H
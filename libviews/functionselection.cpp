@@ -181,6 +181,8 @@ FunctionSelection::FunctionSelection( TopLevelBase* top,
     // select first matching group/function on return
     connect(searchEdit, &QLineEdit::returnPressed,
             this, &FunctionSelection::searchReturnPressed);
+    connect(functionListModel, &FunctionListModel::filterUpdated,
+            this, &FunctionSelection::functionListUpdated);
     searchEdit->setMinimumWidth(50);
 
     // single click release activation
@@ -243,6 +245,7 @@ void FunctionSelection::setData(TraceData* d)
 void FunctionSelection::searchReturnPressed()
 {
     query(searchEdit->text());
+    functionListModel->finishFilter();
 
     QTreeWidgetItem* item;
     if (_groupType != ProfileContext::Function) {
@@ -811,56 +814,43 @@ void FunctionSelection::query(QString query)
     QRegExp re(query, Qt::CaseInsensitive, QRegExp::Wildcard);
     _groupSize.clear();
 
-    TraceFunction* f = 0;
-    TraceFunctionList list2;
-
-    _hc.clear(GlobalConfig::maxListCount());
-
+    // matching functions per group, only needed with a group selected.
+    // The function list does its own (background) filtering
     TraceFunctionMap::Iterator it;
     for ( it = _data->functionMap().begin();
-          it != _data->functionMap().end(); ++it ) {
-        f = &(*it);
-        if (re.indexIn(f->prettyName())>=0) {
-            if (_group) {
-                if (_groupType==ProfileContext::Object) {
-                    if (_groupSize.contains(f->object()))
-                        _groupSize[f->object()]++;
-                    else
-                        _groupSize[f->object()] = 1;
-                    if (f->object() != _group) continue;
-                }
-                else if (_groupType==ProfileContext::Class) {
-                    if (_groupSize.contains(f->cls()))
-                        _groupSize[f->cls()]++;
-                    else
-                        _groupSize[f->cls()] = 1;
-                    if (f->cls() != _group) continue;
-                }
-                else if (_groupType==ProfileContext::File) {
-                    if (_groupSize.contains(f->file()))
-                        _groupSize[f->file()]++;
-                    else
-                        _groupSize[f->file()] = 1;
-                    if (f->file() != _group) continue;
-                }
-                else if (_groupType==ProfileContext::FunctionCycle) {
-                    if (_groupSize.contains(f->cycle()))
-                        _groupSize[f->cycle()]++;
-                    else
-                        _groupSize[f->cycle()] = 1;
-                    if (f->cycle() != _group) continue;
-                }
-            }
-            _hc.addCost(f, f->inclusive()->subCost(_eventType));
+          _group && (it != _data->functionMap().end()); ++it ) {
+        TraceFunction* f = &(*it);
+        if (re.indexIn(f->prettyName()) == -1) continue;
+
+        TraceCostItem* g = 0;
+        switch(_groupType) {
+        case ProfileContext::Object:        g = f->object(); break;
+        case ProfileContext::Class:         g = f->cls(); break;
+        case ProfileContext::File:          g = f->file(); break;
+        case ProfileContext::FunctionCycle: g = f->cycle(); break;
+        default: break;
         }
+        if (!g) continue;
+
+        if (_groupSize.contains(g))
+            _groupSize[g]++;
+        else
+            _groupSize[g] = 1;
     }
     updateGroupSizes(true);
 
-    functionListModel->resetModelData(_data, _group, _searchString, _eventType);
+    functionListModel->setFilter(_searchString);
     selectFunction(dynamic_cast<TraceFunction*>(_activeItem));
     setCostColumnWidths();
 }
 
+// more functions matching the search string are in the list
+void FunctionSelection::functionListUpdated()
+{
+    selectFunction(dynamic_cast<TraceFunction*>(_activeItem), false);
+    setCostColumnWidths();
+}
+
 bool FunctionSelection::selectTopFunction()
 {
     QModelIndex i = functionListModel->index(0,0);
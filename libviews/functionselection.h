@@ -66,6 +66,7 @@ public slots:
     void searchReturnPressed();
     void searchChanged(const QString&);
     void queryDelayed();
+    void functionListUpdated();
 
     void groupTypeSelected(QAction*);
     void groupTypeSelected(int);
@@ -0,0 +1,1204 @@
+/* This file is part of KCachegrind.
+   Copyright (c) 2026 The KCachegrind developers
+
+   KCachegrind is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation, version 2.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+/*
+ * Layout of call graphs without GraphViz
+ */
+
+#include "graphlayout.h"
+
+#include <math.h>
+#include <algorithm>
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QDebug>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// space between layers and between neighbors in a layer
+#define LAYER_SPACING 40
+#define NODE_SPACING  20
+// width of dummy nodes for edges spanning layers
+#define DUMMY_WIDTH   10
+// size of points at sum-edges
+#define POINT_SIZE    10
+// extent of self-recursion loops
+#define LOOP_SIZE     30
+// part of node width used for edge ends
+#define PORT_SPREAD   .6
+
+// barycenter sweeps for crossing reduction, from scratch and
+// when starting with the order of a previous layout
+#define ORDER_SWEEPS       8
+#define INCREMENTAL_SWEEPS 2
+// sweeps pulling nodes towards their neighbors
+#define POSITION_SWEEPS    4
+
+// weights for straight edges: between dummies, to one dummy, others
+#define WEIGHT_DUMMIES 8.0
+#define WEIGHT_DUMMY   2.0
+#define WEIGHT_NODES   1.0
+
+// nodes and edges of layouts kept in memory
+#define LAYOUT_CACHE_COST   50000
+// layouts kept on disk per profile data file
+#define LAYOUT_STORE_ITEMS  100
+
+#define LAYOUT_MAGIC   0x4b43474c // "KCGL"
+#define LAYOUT_VERSION 2
+
+
+GraphLayout::GraphLayout()
+{
+    _layout = GraphOptions::TopDown;
+}
+
+void GraphLayout::reset()
+{
+    clear();
+    _result = GraphLayoutResult();
+    _prevPos.clear();
+}
+
+void GraphLayout::clear()
+{
+    _vertices.clear();
+    _links.clear();
+    _vertexOf.clear();
+    _layers.clear();
+}
+
+void GraphLayout::addNode(GraphNode* n, const QSizeF& s)
+{
+    Vertex v;
+    v.f = n->function();
+    v.link = -1;
+    v.dummy = false;
+    v.w = s.width();
+    v.h = s.height();
+    v.x = v.y = 0.0;
+    v.layer = v.pos = 0;
+
+    _vertexOf.insert(v.f, _vertices.count());
+    _vertices.append(v);
+}
+
+void GraphLayout::addEdge(GraphEdge* e)
+{
+    int from = -1, to = -1;
+    if (e->from()) {
+        from = _vertexOf.value(e->from(), -1);
+        if (from < 0) return;
+    }
+    if (e->to()) {
+        to = _vertexOf.value(e->to(), -1);
+        if (to < 0) return;
+    }
+    if ((from < 0) && (to < 0)) return;
+
+    if ((from < 0) || (to < 0)) {
+        // point as end of sum-edge
+        Vertex p;
+        p.f = 0;
+        p.link = _links.count();
+        p.dummy = false;
+        p.w = p.h = POINT_SIZE;
+        p.x = p.y = 0.0;
+        p.layer = p.pos = 0;
+
+        if (from < 0)
+            from = _vertices.count();
+        else
+            to = _vertices.count();
+        _vertices.append(p);
+    }
+
+    Link l;
+    l.edge = e;
+    l.from = from;
+    l.to = to;
+    l.reversed = false;
+    l.fromPort = l.toPort = 0.0;
+    _links.append(l);
+}
+
+void GraphLayout::layout(TraceFunction* center)
+{
+    if (_layout == GraphOptions::Circular) {
+        // positions in layers are not useful any longer
+        _prevPos.clear();
+        layoutCircular(_vertexOf.value(center, -1));
+    }
+    else {
+        // LeftRight is TopDown with width/height swapped
+        if (_layout == GraphOptions::LeftRight)
+            transpose();
+        layoutLayered();
+        if (_layout == GraphOptions::LeftRight)
+            transpose();
+    }
+    routeLoops();
+    storeResults();
+}
+
+void GraphLayout::transpose()
+{
+    for (int i = 0; i < _vertices.count(); i++) {
+        Vertex& v = _vertices[i];
+        qSwap(v.w, v.h);
+        qSwap(v.x, v.y);
+    }
+    for (int i = 0; i < _links.count(); i++) {
+        Link& l = _links[i];
+        for (int j = 0; j < l.points.count(); j++)
+            l.points[j] = QPointF(l.points[j].y(), l.points[j].x());
+        l.label = QPointF(l.label.y(), l.label.x());
+    }
+}
+
+
+//
+// Layered layout
+//
+
+void GraphLayout::layoutLayered()
+{
+    if (_vertices.isEmpty())
+        return;
+
+    removeCycles();
+    assignLayers();
+    insertDummies();
+    bool incremental = initOrder();
+    reduceCrossings(incremental ? INCREMENTAL_SWEEPS : ORDER_SWEEPS);
+    assignCoordinates();
+    routeEdges();
+
+    _prevPos.clear();
+    foreach(const Vertex& v, _vertices)
+        if (v.f) _prevPos.insert(v.f, v.x);
+}
+
+/* Reverse edges closing a cycle, found by a DFS starting at functions
+ * without callers. The DFS order is the start order inside of layers.
+ */
+void GraphLayout::removeCycles()
+{
+    int n = _vertices.count();
+    QVector<QVector<int> > out(n);
+    QVector<bool> hasIn(n, false);
+    for (int i = 0; i < _links.count(); i++) {
+        const Link& l = _links[i];
+        if (l.from == l.to) continue;
+        out[l.from].append(i);
+        hasIn[l.to] = true;
+    }
+
+    // 0: not visited, 1: on DFS stack, 2: finished
+    QVector<int> state(n, 0);
+    // vertex and next outgoing link to check
+    QVector<QPair<int, int> > stack;
+    int visited = 0;
+    for (int pass = 0; pass < 2; pass++) {
+        for (int root = 0; root < n; root++) {
+            if (state[root] != 0) continue;
+            // first pass only starts at vertices without callers
+            if ((pass == 0) && hasIn[root]) continue;
+
+            state[root] = 1;
+            _vertices[root].pos = visited++;
+            stack.append(qMakePair(root, 0));
+            while(!stack.isEmpty()) {
+                int v = stack.last().first;
+                if (stack.last().second == out[v].count()) {
+                    state[v] = 2;
+                    stack.removeLast();
+                    continue;
+                }
+                int link = out[v][stack.last().second++];
+                int w = _links[link].to;
+                if (state[w] == 1)
+                    _links[link].reversed = true;
+                else if (state[w] == 0) {
+                    state[w] = 1;
+                    _vertices[w].pos = visited++;
+                    stack.append(qMakePair(w, 0));
+                }
+            }
+        }
+    }
+}
+
+/* Longest path layering. Vertices without callers are moved down
+ * to just above their highest callee afterwards.
+ */
+void GraphLayout::assignLayers()
+{
+    int n = _vertices.count();
+    QVector<QVector<int> > preds(n), succs(n);
+    QVector<int> inDegree(n, 0);
+    foreach(const Link& l, _links) {
+        if (l.from == l.to) continue;
+        int upper = l.reversed ? l.to : l.from;
+        int lower = l.reversed ? l.from : l.to;
+        succs[upper].append(lower);
+        preds[lower].append(upper);
+        inDegree[lower]++;
+    }
+
+    QVector<int> order;
+    order.reserve(n);
+    for (int v = 0; v < n; v++) {
+        _vertices[v].layer = 0;
+        if (inDegree[v] == 0) order.append(v);
+    }
+    for (int i = 0; i < order.count(); i++) {
+        int v = order[i];
+        foreach(int w, succs[v]) {
+            _vertices[w].layer = qMax(_vertices[w].layer,
+                                      _vertices[v].layer + 1);
+            if (--inDegree[w] == 0) order.append(w);
+        }
+    }
+
+    for (int i = order.count() - 1; i >= 0; i--) {
+        int v = order[i];
+        if (!preds[v].isEmpty() || succs[v].isEmpty()) continue;
+        int layer = _vertices[succs[v][0]].layer;
+        foreach(int w, succs[v])
+            layer = qMin(layer, _vertices[w].layer);
+        _vertices[v].layer = layer - 1;
+    }
+}
+
+// split edges spanning multiple layers into chains of dummy vertices
+void GraphLayout::insertDummies()
+{
+    int maxLayer = 0;
+    foreach(const Vertex& v, _vertices)
+        maxLayer = qMax(maxLayer, v.layer);
+
+    for (int i = 0; i < _links.count(); i++) {
+        if (_links[i].from == _links[i].to) continue;
+
+        int upper = _links[i].reversed ? _links[i].to : _links[i].from;
+        int lower = _links[i].reversed ? _links[i].from : _links[i].to;
+
+        QVector<int> chain;
+        chain.append(upper);
+        for (int layer = _vertices[upper].layer + 1;
+             layer < _vertices[lower].layer; layer++) {
+            Vertex d;
+            d.f = 0;
+            d.link = i;
+            d.dummy = true;
+            d.w = DUMMY_WIDTH;
+            d.h = 0;
+            d.x = d.y = 0.0;
+            d.layer = layer;
+            // dummies start below the upper end
+            d.pos = _vertices[upper].pos;
+            chain.append(_vertices.count());
+            _vertices.append(d);
+        }
+        chain.append(lower);
+
+        for (int j = 1; j < chain.count(); j++) {
+            _vertices[chain[j-1]].succs.append(chain[j]);
+            _vertices[chain[j]].preds.append(chain[j-1]);
+        }
+        _links[i].chain = chain;
+    }
+
+    _layers.resize(maxLayer + 1);
+    for (int v = 0; v < _vertices.count(); v++)
+        _layers[_vertices[v].layer].append(v);
+}
+
+/* Start order of vertices in layers: positions of the previous layout
+ * if available, with new vertices put at the mean of known neighbors.
+ * Otherwise, the order of the DFS when breaking cycles is used.
+ * Returns true if the previous layout was used.
+ */
+bool GraphLayout::initOrder()
+{
+    int n = _vertices.count();
+    QVector<double> key(n);
+    QVector<bool> known(n, false);
+
+    bool incremental = false;
+    for (int v = 0; v < n; v++) {
+        if (!_vertices[v].f) continue;
+        QHash<TraceFunction*, double>::ConstIterator it;
+        it = _prevPos.constFind(_vertices[v].f);
+        if (it == _prevPos.constEnd()) continue;
+        key[v] = *it;
+        known[v] = true;
+        incremental = true;
+    }
+
+    if (incremental) {
+        for (int pass = 0; pass < 2; pass++) {
+            bool down = (pass == 0);
+            for (int i = 0; i < _layers.count(); i++) {
+                int layer = down ? i : _layers.count() - 1 - i;
+                foreach(int v, _layers[layer]) {
+                    if (known[v]) continue;
+                    const QVector<int>& nb = down ? _vertices[v].preds
+                                                  : _vertices[v].succs;
+                    double sum = 0.0;
+                    int count = 0;
+                    foreach(int w, nb)
+                        if (known[w]) { sum += key[w]; count++; }
+                    if (count == 0) continue;
+                    key[v] = sum / count;
+                    known[v] = true;
+                }
+            }
+        }
+
+        // remaining ones at the end
+        double maxKey = 0.0;
+        for (int v = 0; v < n; v++)
+            if (known[v]) maxKey = qMax(maxKey, key[v]);
+        for (int v = 0; v < n; v++)
+            if (!known[v]) key[v] = maxKey + 1.0 + _vertices[v].pos;
+    }
+    else {
+        for (int v = 0; v < n; v++)
+            key[v] = _vertices[v].pos;
+    }
+
+    for (int layer = 0; layer < _layers.count(); layer++) {
+        QVector<int>& l = _layers[layer];
+        QVector<QPair<double, int> > sorted;
+        sorted.reserve(l.count());
+        foreach(int v, l)
+            sorted.append(qMakePair(key[v], v));
+        std::sort(sorted.begin(), sorted.end());
+        for (int i = 0; i < l.count(); i++) {
+            l[i] = sorted[i].second;
+            _vertices[l[i]].pos = i;
+        }
+    }
+
+    return incremental;
+}
+
+// sort a layer by the barycenter of neighbors in the layer above/below
+void GraphLayout::orderLayer(int layer, bool byPreds)
+{
+    QVector<int>& l = _layers[layer];
+    QVector<QPair<double, int> > sorted;
+    sorted.reserve(l.count());
+    for (int i = 0; i < l.count(); i++) {
+        const Vertex& v = _vertices[l[i]];
+        const QVector<int>& nb = byPreds ? v.preds : v.succs;
+        double bary = i;
+        if (!nb.isEmpty()) {
+            double sum = 0.0;
+            foreach(int w, nb)
+                sum += _vertices[w].pos;
+            bary = sum / nb.count();
+        }
+        // ties are kept in current order
+        sorted.append(qMakePair(bary, i));
+    }
+    std::sort(sorted.begin(), sorted.end());
+
+    QVector<int> old = l;
+    for (int i = 0; i < l.count(); i++) {
+        l[i] = old[sorted[i].second];
+        _vertices[l[i]].pos = i;
+    }
+}
+
+// number of crossings between edges from <layer> to the layer below
+int GraphLayout::crossings(int layer) const
+{
+    QVector<QPair<int, int> > edges;
+    foreach(int v, _layers[layer])
+        foreach(int w, _vertices[v].succs)
+            edges.append(qMakePair(_vertices[v].pos, _vertices[w].pos));
+    std::sort(edges.begin(), edges.end());
+
+    // count inversions of lower ends, using a Fenwick tree
+    int size = _layers[layer + 1].count();
+    QVector<int> tree(size + 1, 0);
+    int count = 0;
+    for (int i = 0; i < edges.count(); i++) {
+        int p = edges[i].second + 1;
+        int notAbove = 0;
+        for (int j = p; j > 0; j -= j & -j)
+            notAbove += tree[j];
+        count += i - notAbove;
+        for (int j = p; j <= size; j += j & -j)
+            tree[j]++;
+    }
+    return count;
+}
+
+int GraphLayout::crossings() const
+{
+    int count = 0;
+    for (int layer = 0; layer + 1 < _layers.count(); layer++)
+        count += crossings(layer);
+    return count;
+}
+
+void GraphLayout::reduceCrossings(int sweeps)
+{
+    int best = crossings();
+    QVector<QVector<int> > bestLayers = _layers;
+
+    for (int i = 0; (i < sweeps) && (best > 0); i++) {
+        if ((i % 2) == 0) {
+            for (int layer = 1; layer < _layers.count(); layer++)
+                orderLayer(layer, true);
+        }
+        else {
+            for (int layer = _layers.count() - 2; layer >= 0; layer--)
+                orderLayer(layer, false);
+        }
+
+        int c = crossings();
+        if (c < best) {
+            best = c;
+            bestLayers = _layers;
+        }
+    }
+
+    _layers = bestLayers;
+    for (int layer = 0; layer < _layers.count(); layer++)
+        for (int i = 0; i < _layers[layer].count(); i++)
+            _vertices[_layers[layer][i]].pos = i;
+}
+
+/* Move vertices of a layer as near as possible to the weighted mean
+ * of their neighbors, keeping order and spacing.
+ * This is an isotonic regression: with x_i = v_i + P_i, where P_i is
+ * the position when packing the layer, the v_i have to be monotonic.
+ * Adjacent blocks violating this are merged ("pool adjacent violators").
+ */
+void GraphLayout::placeLayer(int layer, bool usePreds, bool useSuccs)
+{
+    const QVector<int>& l = _layers[layer];
+    int n = l.count();
+    if (n == 0) return;
+
+    struct Block {
+        int first;
+        double weight, sum;
+    };
+    QVector<Block> blocks;
+    QVector<double> packed(n);
+
+    for (int i = 0; i < n; i++) {
+        const Vertex& v = _vertices[l[i]];
+        if (i == 0)
+            packed[i] = 0.0;
+        else {
+            const Vertex& prev = _vertices[l[i-1]];
+            packed[i] = packed[i-1] + (prev.w + v.w) / 2 + NODE_SPACING;
+        }
+
+        double weight = 0.0, sum = 0.0;
+        for (int dir = 0; dir < 2; dir++) {
+            if ((dir == 0) && !usePreds) continue;
+            if ((dir == 1) && !useSuccs) continue;
+            foreach(int w, (dir == 0) ? v.preds : v.succs) {
+                const Vertex& nb = _vertices[w];
+                double ew = WEIGHT_NODES;
+                if (v.dummy && nb.dummy)
+                    ew = WEIGHT_DUMMIES;
+                else if (v.dummy || nb.dummy)
+                    ew = WEIGHT_DUMMY;
+                weight += ew;
+                sum += ew * nb.x;
+            }
+        }
+        double desired = v.x;
+        if (weight > 0.0)
+            desired = sum / weight;
+        else
+            // without neighbors, only keep current position if possible
+            weight = .01;
+
+        Block b;
+        b.first = i;
+        b.weight = weight;
+        b.sum = weight * (desired - packed[i]);
+        while (!blocks.isEmpty() &&
+               (blocks.last().sum / blocks.last().weight >= b.sum / b.weight)) {
+            b.first = blocks.last().first;
+            b.weight += blocks.last().weight;
+            b.sum += blocks.last().sum;
+            blocks.removeLast();
+        }
+        blocks.append(b);
+    }
+
+    for (int b = 0; b < blocks.count(); b++) {
+        int end = (b + 1 < blocks.count()) ? blocks[b+1].first : n;
+        double v = blocks[b].sum / blocks[b].weight;
+        for (int i = blocks[b].first; i < end; i++)
+            _vertices[l[i]].x = v + packed[i];
+    }
+}
+
+void GraphLayout::assignCoordinates()
+{
+    // start with packed layers centered at 0
+    for (int layer = 0; layer < _layers.count(); layer++) {
+        const QVector<int>& l = _layers[layer];
+        double width = 0.0;
+        foreach(int v, l)
+            width += _vertices[v].w + NODE_SPACING;
+        double x = -width / 2;
+        foreach(int v, l) {
+            _vertices[v].x = x + _vertices[v].w / 2;
+            x += _vertices[v].w + NODE_SPACING;
+        }
+    }
+
+    for (int i = 0; i < POSITION_SWEEPS; i++) {
+        if ((i % 2) == 0) {
+            for (int layer = 1; layer < _layers.count(); layer++)
+                placeLayer(layer, true, false);
+        }
+        else {
+            for (int layer = _layers.count() - 2; layer >= 0; layer--)
+                placeLayer(layer, false, true);
+        }
+    }
+    // balance between callers and callees
+    for (int layer = 0; layer < _layers.count(); layer++)
+        placeLayer(layer, true, true);
+
+    // edge labels need space between layers
+    double gap = LAYER_SPACING;
+    if (_layout == GraphOptions::LeftRight)
+        gap += _labelSize.width();
+    else
+        gap += _labelSize.height();
+
+    double y = 0.0;
+    for (int layer = 0; layer < _layers.count(); layer++) {
+        double h = 0.0;
+        foreach(int v, _layers[layer])
+            h = qMax(h, _vertices[v].h);
+        foreach(int v, _layers[layer])
+            _vertices[v].y = y + h / 2;
+        y += h + gap;
+    }
+}
+
+/* Edges are bezier curves through the dummies, leaving/entering nodes
+ * vertically. Edge ends are spread over the node side, ordered by the
+ * position of the next vertex to avoid crossings at nodes.
+ */
+void GraphLayout::routeEdges()
+{
+    int n = _vertices.count();
+    QVector<QVector<QPair<double, int> > > lowerEnds(n), upperEnds(n);
+    for (int i = 0; i < _links.count(); i++) {
+        const QVector<int>& chain = _links[i].chain;
+        if (chain.isEmpty()) continue;
+        int upper = chain.first(), lower = chain.last();
+        lowerEnds[upper].append(qMakePair(_vertices[chain[1]].x, i));
+        upperEnds[lower].append(qMakePair(_vertices[chain[chain.count()-2]].x, i));
+    }
+    for (int v = 0; v < n; v++) {
+        // points and dummies have all edge ends in the center
+        if (!_vertices[v].f) continue;
+        double spread = _vertices[v].w * PORT_SPREAD;
+
+        std::sort(lowerEnds[v].begin(), lowerEnds[v].end());
+        int count = lowerEnds[v].count();
+        for (int j = 0; j < count; j++) {
+            Link& l = _links[lowerEnds[v][j].second];
+            double port = ((j + 1.0) / (count + 1) - .5) * spread;
+            if (l.reversed) l.toPort = port; else l.fromPort = port;
+        }
+
+        std::sort(upperEnds[v].begin(), upperEnds[v].end());
+        count = upperEnds[v].count();
+        for (int j = 0; j < count; j++) {
+            Link& l = _links[upperEnds[v][j].second];
+            double port = ((j + 1.0) / (count + 1) - .5) * spread;
+            if (l.reversed) l.fromPort = port; else l.toPort = port;
+        }
+    }
+
+    for (int i = 0; i < _links.count(); i++) {
+        Link& l = _links[i];
+        if (l.chain.isEmpty()) continue;
+
+        const Vertex& upper = _vertices[l.chain.first()];
+        const Vertex& lower = _vertices[l.chain.last()];
+        double upperPort = l.reversed ? l.toPort : l.fromPort;
+        double lowerPort = l.reversed ? l.fromPort : l.toPort;
+
+        QVector<QPointF> p;
+        p.append(QPointF(upper.x + upperPort, upper.y + upper.h / 2));
+        for (int j = 1; j < l.chain.count() - 1; j++) {
+            const Vertex& d = _vertices[l.chain[j]];
+            p.append(QPointF(d.x, d.y));
+        }
+        p.append(QPointF(lower.x + lowerPort, lower.y - lower.h / 2));
+
+        l.points.clear();
+        l.points.append(p[0]);
+        for (int j = 0; j + 1 < p.count(); j++) {
+            double dy = (p[j+1].y() - p[j].y()) / 2;
+            l.points.append(QPointF(p[j].x(), p[j].y() + dy));
+            l.points.append(QPointF(p[j+1].x(), p[j+1].y() - dy));
+            l.points.append(p[j+1]);
+        }
+        // splines go from caller to callee
+        if (l.reversed)
+            std::reverse(l.points.begin(), l.points.end());
+
+        if (p.count() > 2)
+            l.label = p[(p.count() - 1) / 2];
+        else
+            l.label = (p[0] + p[1]) / 2;
+    }
+}
+
+
+//
+// Circular layout
+//
+
+/* Functions are put on rings around the center, with the ring given
+ * by the distance in the call graph. On a ring, functions are sorted
+ * by the angle of the function they were reached from.
+ */
+void GraphLayout::layoutCircular(int center)
+{
+    int n = _vertices.count();
+    if (n == 0) return;
+    if (center < 0) center = 0;
+
+    // neighbors, with callees marked by 1
+    QVector<QVector<QPair<int, int> > > adj(n);
+    foreach(const Link& l, _links) {
+        if (l.from == l.to) continue;
+        adj[l.from].append(qMakePair(l.to, 1));
+        adj[l.to].append(qMakePair(l.from, 0));
+    }
+
+    QVector<int> ring(n, -1), parent(n, -1), side(n, 0);
+    QVector<QVector<int> > rings;
+    QVector<int> queue;
+    queue.append(center);
+    ring[center] = 0;
+    for (int i = 0; i < queue.count(); i++) {
+        int v = queue[i];
+        if (ring[v] == rings.count()) rings.append(QVector<int>());
+        rings[ring[v]].append(v);
+        typedef QPair<int, int> Neighbor;
+        foreach(const Neighbor& nb, adj[v]) {
+            if (ring[nb.first] >= 0) continue;
+            ring[nb.first] = ring[v] + 1;
+            parent[nb.first] = v;
+            side[nb.first] = nb.second;
+            queue.append(nb.first);
+        }
+    }
+    // not connected to the center: outermost ring
+    QVector<int> unconnected;
+    for (int v = 0; v < n; v++)
+        if (ring[v] < 0) unconnected.append(v);
+    if (!unconnected.isEmpty())
+        rings.append(unconnected);
+
+    QVector<double> angle(n, 0.0);
+    _vertices[center].x = _vertices[center].y = 0.0;
+    double radius = 0.0;
+    double extent = sqrt(_vertices[center].w * _vertices[center].w +
+                         _vertices[center].h * _vertices[center].h) / 2;
+    double gap = LAYER_SPACING + _labelSize.width() / 2;
+
+    for (int r = 1; r < rings.count(); r++) {
+        QVector<QPair<double, int> > sorted;
+        foreach(int v, rings[r]) {
+            double a = (parent[v] >= 0) ? angle[parent[v]] : 0.0;
+            // callers before callees of the same function
+            sorted.append(qMakePair(a + side[v] * 1e-6, v));
+        }
+        std::sort(sorted.begin(), sorted.end());
+
+        double ringExtent = 0.0, circumference = 0.0;
+        QVector<double> diag(sorted.count());
+        for (int i = 0; i < sorted.count(); i++) {
+            const Vertex& v = _vertices[sorted[i].second];
+            diag[i] = sqrt(v.w * v.w + v.h * v.h);
+            ringExtent = qMax(ringExtent, diag[i] / 2);
+            circumference += diag[i] + NODE_SPACING;
+        }
+        radius = qMax(radius + extent + ringExtent + gap,
+                      circumference / (2 * M_PI));
+        extent = ringExtent;
+
+        // angles proportional to sizes, rotated towards parents
+        QVector<double> a(sorted.count());
+        double arc = 0.0, sx = 0.0, sy = 0.0;
+        for (int i = 0; i < sorted.count(); i++) {
+            a[i] = (arc + (diag[i] + NODE_SPACING) / 2) / circumference * 2 * M_PI;
+            arc += diag[i] + NODE_SPACING;
+            int p = parent[sorted[i].second];
+            if (p < 0) continue;
+            sx += cos(angle[p] - a[i]);
+            sy += sin(angle[p] - a[i]);
+        }
+        double shift = ((sx != 0.0) || (sy != 0.0)) ? atan2(sy, sx) : 0.0;
+        for (int i = 0; i < sorted.count(); i++) {
+            Vertex& v = _vertices[sorted[i].second];
+            angle[sorted[i].second] = a[i] + shift;
+            v.x = radius * cos(a[i] + shift);
+            v.y = radius * sin(a[i] + shift);
+        }
+    }
+
+    // straight edges between node borders
+    for (int i = 0; i < _links.count(); i++) {
+        Link& l = _links[i];
+        if (l.from == l.to) continue;
+
+        QPointF c1(_vertices[l.from].x, _vertices[l.from].y);
+        QPointF c2(_vertices[l.to].x, _vertices[l.to].y);
+        QPointF p1 = borderPoint(l.from, c2);
+        QPointF p2 = borderPoint(l.to, c1);
+
+        l.points.clear();
+        l.points << p1 << p1 + (p2 - p1) / 3 << p1 + (p2 - p1) * 2 / 3 << p2;
+        l.label = (p1 + p2) / 2;
+    }
+}
+
+// point on the border of a vertex on the line from center to <towards>
+QPointF GraphLayout::borderPoint(int vertex, const QPointF& towards) const
+{
+    const Vertex& v = _vertices[vertex];
+    QPointF c(v.x, v.y);
+    QPointF d = towards - c;
+    if ((d.x() == 0.0) && (d.y() == 0.0)) return c;
+
+    double t = 1.0;
+    if (d.x() != 0.0) t = qMin(t, v.w / 2 / fabs(d.x()));
+    if (d.y() != 0.0) t = qMin(t, v.h / 2 / fabs(d.y()));
+    return c + d * t;
+}
+
+
+//
+// Common
+//
+
+QRectF GraphLayout::vertexRect(int vertex) const
+{
+    const Vertex& v = _vertices[vertex];
+    return QRectF(v.x - v.w / 2, v.y - v.h / 2, v.w, v.h);
+}
+
+// self-recursion loops on the right side of nodes
+void GraphLayout::routeLoops()
+{
+    for (int i = 0; i < _links.count(); i++) {
+        Link& l = _links[i];
+        if (l.from != l.to) continue;
+
+        QRectF r = vertexRect(l.from);
+        double d = r.height() / 4;
+        QPointF p1(r.right(), r.center().y() - d);
+        QPointF p2(r.right(), r.center().y() + d);
+
+        l.points.clear();
+        l.points << p1 << p1 + QPointF(LOOP_SIZE, -d)
+                 << p2 + QPointF(LOOP_SIZE, d) << p2;
+        l.label = QPointF(r.right() + LOOP_SIZE, r.center().y());
+    }
+}
+
+void GraphLayout::storeResults()
+{
+    // labels right of vertical edges, above of others
+    QPointF labelOffset;
+    if (_layout == GraphOptions::TopDown)
+        labelOffset = QPointF(_labelSize.width() / 2 + 4, 0);
+    else
+        labelOffset = QPointF(0, -(_labelSize.height() / 2 + 2));
+
+    QRectF bb;
+    for (int v = 0; v < _vertices.count(); v++)
+        if (!_vertices[v].dummy)
+            bb |= vertexRect(v);
+    for (int i = 0; i < _links.count(); i++) {
+        Link& l = _links[i];
+        l.label += labelOffset;
+        bb |= l.points.boundingRect();
+        if (!_labelSize.isEmpty()) {
+            QRectF r(QPointF(), _labelSize);
+            r.moveCenter(l.label);
+            bb |= r;
+        }
+    }
+
+    QPointF d = -bb.topLeft();
+    _result = GraphLayoutResult();
+    _result.size = bb.size();
+
+    foreach(const Vertex& v, _vertices)
+        if (v.f) _result.nodeRects.insert(v.f, QRectF(v.x - v.w / 2 + d.x(),
+                                                      v.y - v.h / 2 + d.y(),
+                                                      v.w, v.h));
+    foreach(const Link& l, _links) {
+        GraphLayoutResult::EdgeKey key = GraphLayoutResult::key(l.edge);
+        _result.edgePoints.insert(key, l.points.translated(d).toPolygon());
+        _result.labelPos.insert(key, l.label + d);
+
+        int p = !l.edge->from() ? l.from : !l.edge->to() ? l.to : -1;
+        if (p >= 0)
+            _result.pointPos.insert(key, QPointF(_vertices[p].x,
+                                                 _vertices[p].y) + d);
+    }
+
+    if (0)
+        qDebug() << "GraphLayout: laid out" << _vertexOf.count() << "nodes,"
+                 << _links.count() << "edges," << _layers.count()
+                 << "layers, size" << _result.size;
+}
+
+
+//
+// GraphLayoutCache
+//
+
+GraphLayoutCache::GraphLayoutCache()
+    : _cache(LAYOUT_CACHE_COST)
+{
+    _persistent = false;
+    _loaded = false;
+    _changed = false;
+    _data = 0;
+    _hits = _diskHits = _misses = 0;
+}
+
+GraphLayoutCache::~GraphLayoutCache()
+{
+    save();
+}
+
+// one file per profile data file in the user cache directory
+static QString layoutFile(const QString& traceName)
+{
+    QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    if (cacheDir.isEmpty() || traceName.isEmpty()) return QString();
+
+    QByteArray hash = QCryptographicHash::hash(traceName.toUtf8(),
+                                               QCryptographicHash::Sha1);
+    return cacheDir + QStringLiteral("/callgraph/") +
+           QString::fromLatin1(hash.toHex()) + QStringLiteral(".kcglayout");
+}
+
+void GraphLayoutCache::setData(TraceData* d)
+{
+    save();
+
+    // pointers to functions get invalid
+    _cache.clear();
+    _functions.clear();
+    _ids.clear();
+
+    // results on disk are loaded again when needed: the file could
+    // have been reloaded with changes
+    _stored.clear();
+    _storedOrder.clear();
+    _loaded = false;
+    _changed = false;
+
+    _data = d;
+    _traceName = d ? QFileInfo(d->traceName()).absoluteFilePath() : QString();
+    _filename = layoutFile(_traceName);
+}
+
+QString GraphLayoutCache::functionId(TraceFunction* f)
+{
+    // as key in TraceData::function(), with full names: functions in
+    // files or objects of same name in different directories differ
+    QString id = f->name();
+    if (f->file()) id += QLatin1Char('\n') + f->file()->name();
+    if (f->object()) id += QLatin1Char('\n') + f->object()->name();
+    return id;
+}
+
+QString GraphLayoutCache::id(TraceFunction* f) const
+{
+    if (!f) return QString();
+    QHash<TraceFunction*, QString>::ConstIterator it = _ids.constFind(f);
+    if (it != _ids.constEnd()) return *it;
+    return functionId(f);
+}
+
+QByteArray GraphLayoutCache::key(GraphExporter* e, const QString& options,
+                                 bool labelCosts)
+{
+    _functions.clear();
+    _ids.clear();
+
+    // independent from order of nodes/edges in the exporter
+    QStringList nodes, edges;
+    foreach(GraphNode* n, e->visibleNodes()) {
+        QString fid = functionId(n->function());
+        _functions.insert(fid, n->function());
+        _ids.insert(n->function(), fid);
+        // as shown in labels written by GraphExporter::writeDot()
+        if (labelCosts)
+            fid += QLatin1Char('\t') + SubCost(n->incl).pretty();
+        nodes.append(fid);
+    }
+    foreach(GraphEdge* ge, e->visibleEdges()) {
+        QString eid = id(ge->from()) + QLatin1Char('\t') + id(ge->to());
+        if (labelCosts)
+            eid += QLatin1Char('\t') + SubCost(ge->cost).pretty() +
+                   QLatin1Char('\t') + SubCost(ge->count).pretty();
+        edges.append(eid);
+    }
+    std::sort(nodes.begin(), nodes.end());
+    std::sort(edges.begin(), edges.end());
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(options.toUtf8());
+    hash.addData(QByteArrayLiteral("\nnodes\n"));
+    foreach(const QString& s, nodes)
+        hash.addData((s + QLatin1Char('\f')).toUtf8());
+    hash.addData(QByteArrayLiteral("\nedges\n"));
+    foreach(const QString& s, edges)
+        hash.addData((s + QLatin1Char('\f')).toUtf8());
+
+    return hash.result();
+}
+
+bool GraphLayoutCache::debug()
+{
+    static bool d = qEnvironmentVariableIsSet("KCACHEGRIND_DEBUG_LAYOUTCACHE");
+    return d;
+}
+
+bool GraphLayoutCache::find(const QByteArray& key, GraphLayoutResult& result)
+{
+    GraphLayoutResult* r = _cache.object(key);
+    if (r) {
+        _hits++;
+        result = *r;
+    }
+    else if (_persistent) {
+        if (!_loaded) load();
+
+        QHash<QByteArray, StoredResult>::ConstIterator it = _stored.constFind(key);
+        if ((it != _stored.constEnd()) && fromStored(*it, result)) {
+            _diskHits++;
+            _cache.insert(key, new GraphLayoutResult(result),
+                          result.nodeRects.count() + result.edgePoints.count());
+            // recently used
+            _storedOrder.removeOne(key);
+            _storedOrder.append(key);
+            _changed = true;
+            r = &result;
+        }
+    }
+    if (!r) _misses++;
+
+    if (debug())
+        qDebug("GraphLayoutCache: %s (%d hits, %d from disk, %d misses)",
+               r ? "hit" : "miss", _hits, _diskHits, _misses);
+
+    return r != 0;
+}
+
+void GraphLayoutCache::insert(const QByteArray& key, const GraphLayoutResult& r)
+{
+    // not cached if too large
+    _cache.insert(key, new GraphLayoutResult(r),
+                  r.nodeRects.count() + r.edgePoints.count());
+
+    if (!_persistent || _filename.isEmpty()) return;
+    if (!_loaded) load();
+
+    _stored.insert(key, toStored(r));
+    _storedOrder.removeOne(key);
+    _storedOrder.append(key);
+    while(_storedOrder.count() > LAYOUT_STORE_ITEMS)
+        _stored.remove(_storedOrder.takeFirst());
+    _changed = true;
+}
+
+GraphLayoutCache::StoredResult GraphLayoutCache::toStored(const GraphLayoutResult& r) const
+{
+    StoredResult s;
+    s.size = r.size;
+
+    QHash<TraceFunction*, QRectF>::ConstIterator nit;
+    for(nit = r.nodeRects.constBegin(); nit != r.nodeRects.constEnd(); ++nit)
+        s.nodeRects.insert(id(nit.key()), *nit);
+
+    QHash<GraphLayoutResult::EdgeKey, QPolygon>::ConstIterator eit;
+    for(eit = r.edgePoints.constBegin(); eit != r.edgePoints.constEnd(); ++eit)
+        s.edgePoints.insert(EdgeId(id(eit.key().first), id(eit.key().second)), *eit);
+
+    QHash<GraphLayoutResult::EdgeKey, QPointF>::ConstIterator pit;
+    for(pit = r.labelPos.constBegin(); pit != r.labelPos.constEnd(); ++pit)
+        s.labelPos.insert(EdgeId(id(pit.key().first), id(pit.key().second)), *pit);
+    for(pit = r.pointPos.constBegin(); pit != r.pointPos.constEnd(); ++pit)
+        s.pointPos.insert(EdgeId(id(pit.key().first), id(pit.key().second)), *pit);
+
+    return s;
+}
+
+// false if a function of the stored result is not in the current graph
+bool GraphLayoutCache::fromStored(const StoredResult& s, GraphLayoutResult& r) const
+{
+    r = GraphLayoutResult();
+    r.size = s.size;
+
+    QHash<QString, QRectF>::ConstIterator nit;
+    for(nit = s.nodeRects.constBegin(); nit != s.nodeRects.constEnd(); ++nit) {
+        TraceFunction* f = _functions.value(nit.key());
+        if (!f) return false;
+        r.nodeRects.insert(f, *nit);
+    }
+
+    // empty id for missing caller/callee of sum-edges
+    QHash<EdgeId, QPolygon>::ConstIterator eit;
+    for(eit = s.edgePoints.constBegin(); eit != s.edgePoints.constEnd(); ++eit) {
+        TraceFunction* from = _functions.value(eit.key().first);
+        TraceFunction* to = _functions.value(eit.key().second);
+        if (!from && !to) return false;
+        GraphLayoutResult::EdgeKey key(from, to);
+        r.edgePoints.insert(key, *eit);
+
+        QHash<EdgeId, QPointF>::ConstIterator pit;
+        pit = s.labelPos.constFind(eit.key());
+        if (pit != s.labelPos.constEnd()) r.labelPos.insert(key, *pit);
+        pit = s.pointPos.constFind(eit.key());
+        if (pit != s.pointPos.constEnd()) r.pointPos.insert(key, *pit);
+    }
+
+    return true;
+}
+
+QDataStream& operator<<(QDataStream& s, const GraphLayoutCache::StoredResult& r)
+{
+    s << r.size << r.nodeRects << r.edgePoints << r.labelPos << r.pointPos;
+    return s;
+}
+
+QDataStream& operator>>(QDataStream& s, GraphLayoutCache::StoredResult& r)
+{
+    s >> r.size >> r.nodeRects >> r.edgePoints >> r.labelPos >> r.pointPos;
+    return s;
+}
+
+/* Hash of name, size and modification time of the files the parts of
+ * the profile data were loaded from. The trace name can be a prefix of
+ * multiple part files, and is not a file itself.
+ */
+static QByteArray traceStamp(TraceData* d)
+{
+    if (!d) return QByteArray();
+
+    QStringList files;
+    foreach(TracePart* part, d->parts())
+        files.append(part->name());
+    std::sort(files.begin(), files.end());
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    for(int i=0; i<files.count(); i++) {
+        // a file can contain multiple parts
+        if ((i>0) && (files[i] == files[i-1])) continue;
+
+        QFileInfo fi(files[i]);
+        hash.addData(QStringLiteral("%1 %2 %3\n")
+                     .arg(fi.absoluteFilePath()).arg(fi.size())
+                     .arg(fi.lastModified().toMSecsSinceEpoch()).toUtf8());
+    }
+    return hash.result();
+}
+
+void GraphLayoutCache::load()
+{
+    _loaded = true;
+    if (_filename.isEmpty()) return;
+
+    QFile file(_filename);
+    if (!file.open(QIODevice::ReadOnly)) return;
+
+    QDataStream s(&file);
+    s.setVersion(QDataStream::Qt_5_2);
+    quint32 magic, version;
+    QByteArray stamp;
+    s >> magic >> version;
+    if ((magic != LAYOUT_MAGIC) || (version != LAYOUT_VERSION)) return;
+
+    // results of older profile data with same name are useless
+    s >> stamp;
+    if (stamp != traceStamp(_data)) return;
+
+    QList<QByteArray> order;
+    QHash<QByteArray, StoredResult> stored;
+    s >> order >> stored;
+    if (s.status() != QDataStream::Ok) return;
+
+    _stored = stored;
+    _storedOrder = order;
+
+    if (0)
+        qDebug() << "GraphLayoutCache: read" << stored.count()
+                 << "layouts from" << _filename;
+}
+
+void GraphLayoutCache::save()
+{
+    if (!_persistent || !_changed || _filename.isEmpty()) return;
+    _changed = false;
+
+    QDir().mkpath(QFileInfo(_filename).absolutePath());
+    QSaveFile file(_filename);
+    if (!file.open(QIODevice::WriteOnly)) return;
+
+    QDataStream s(&file);
+    s.setVersion(QDataStream::Qt_5_2);
+    s << (quint32) LAYOUT_MAGIC << (quint32) LAYOUT_VERSION
+      << traceStamp(_data) << _storedOrder << _stored;
+    if (s.status() != QDataStream::Ok) {
+        file.cancelWriting();
+        return;
+    }
+    file.commit();
+}
@@ -0,0 +1,243 @@
+/* This file is part of KCachegrind.
+   Copyright (c) 2026 The KCachegrind developers
+
+   KCachegrind is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation, version 2.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+/*
+ * Layout of call graphs without GraphViz
+ */
+
+#ifndef GRAPHLAYOUT_H
+#define GRAPHLAYOUT_H
+
+#include <QByteArray>
+#include <QCache>
+#include <QHash>
+#include <QList>
+#include <QPair>
+#include <QPointF>
+#include <QPolygon>
+#include <QPolygonF>
+#include <QRectF>
+#include <QSizeF>
+#include <QString>
+#include <QVector>
+
+#include "callgraphview.h"
+
+class QDataStream;
+
+/**
+ * Positions of a laid out call graph, from the built-in layout or
+ * parsed from 'dot' output. (0,0) is the top left corner.
+ */
+class GraphLayoutResult
+{
+public:
+    typedef QPair<TraceFunction*, TraceFunction*> EdgeKey;
+
+    static EdgeKey key(GraphEdge* e)
+    {
+        return EdgeKey(e->from(), e->to());
+    }
+
+    // invalid if layouting failed
+    QSizeF size;
+    QHash<TraceFunction*, QRectF> nodeRects;
+    // control points of bezier curves from caller to callee
+    QHash<EdgeKey, QPolygon> edgePoints;
+    // centers of edge labels, and of points at sum-edges
+    QHash<EdgeKey, QPointF> labelPos, pointPos;
+};
+
+/**
+ * Layout of the call graph shown in CallGraphView, done in-process
+ * as alternative to running 'dot'/'twopi' from GraphViz.
+ *
+ * For TopDown and LeftRight, a layered (Sugiyama style) layout is done:
+ * cycles are broken by reversing edges, nodes are assigned to layers,
+ * edges spanning multiple layers get dummy nodes, the order inside of
+ * layers is improved by barycenter sweeps to reduce edge crossings,
+ * and nodes are pulled towards their neighbors for coordinates.
+ * For Circular, nodes are put on rings around the center function.
+ *
+ * Positions of functions shown in the previous layout give the start
+ * order of nodes in layers. This keeps the drawing stable and needs
+ * less sweeps. Results of same graphs are reused via GraphLayoutCache.
+ */
+class GraphLayout
+{
+public:
+    GraphLayout();
+
+    // forget the previous layout, e.g. on new profile data
+    void reset();
+
+    // start with a new graph
+    void clear();
+    void setLayout(GraphOptions::Layout l) { _layout = l; }
+    // space needed for edge labels
+    void setLabelSize(const QSizeF& s) { _labelSize = s; }
+    void addNode(GraphNode*, const QSizeF&);
+    // sum-edges without caller/callee get a point as end
+    void addEdge(GraphEdge*);
+
+    // <center> is the function in the middle of circular layouts
+    void layout(TraceFunction* center = 0);
+
+    const GraphLayoutResult& result() const { return _result; }
+
+private:
+    struct Vertex {
+        TraceFunction* f;   // 0 for dummies and points
+        int link;           // link of dummy or point, -1 for functions
+        bool dummy;
+        double w, h;
+        double x, y;        // center
+        int layer, pos;
+        QVector<int> preds, succs;
+    };
+
+    struct Link {
+        GraphEdge* edge;
+        int from, to;       // vertices of caller and callee
+        bool reversed;      // to break a cycle
+        QVector<int> chain; // vertices from upper to lower layer
+        double fromPort, toPort;
+        QPolygonF points;
+        QPointF label;
+    };
+
+    // layered layout
+    void layoutLayered();
+    void removeCycles();
+    void assignLayers();
+    void insertDummies();
+    bool initOrder();
+    void reduceCrossings(int sweeps);
+    void orderLayer(int layer, bool byPreds);
+    int crossings(int layer) const;
+    int crossings() const;
+    void assignCoordinates();
+    void placeLayer(int layer, bool usePreds, bool useSuccs);
+    void routeEdges();
+    void transpose();
+
+    void layoutCircular(int center);
+    QPointF borderPoint(int vertex, const QPointF& towards) const;
+    void routeLoops();
+    QRectF vertexRect(int vertex) const;
+    void storeResults();
+
+    GraphOptions::Layout _layout;
+    QSizeF _labelSize;
+
+    // graph of current layout
+    QVector<Vertex> _vertices;
+    QVector<Link> _links;
+    QHash<TraceFunction*, int> _vertexOf;
+    QVector<QVector<int> > _layers;
+
+    GraphLayoutResult _result;
+
+    // position of functions in layers of previous layout
+    QHash<TraceFunction*, double> _prevPos;
+};
+
+
+/**
+ * Bounded LRU cache of layout results, to show graphs seen before
+ * (e.g. when going back/forward in history) without layouting.
+ *
+ * The key is a hash of the nodes and edges selected by a GraphExporter,
+ * together with the graph options changing the layout. For layouts by
+ * 'dot', the key includes the costs shown in node and edge labels, as
+ * they change the size of nodes. Functions are identified by name, full
+ * file name and ELF object, so that results optionally can be kept on
+ * disk, with one file per profile data in the user cache directory.
+ * Stored results are used as long as the loaded files did not change.
+ */
+class GraphLayoutCache
+{
+public:
+    GraphLayoutCache();
+    ~GraphLayoutCache();
+
+    // results are for this profile data; writes results of previous one
+    void setData(TraceData*);
+    void setPersistent(bool p) { _persistent = p; }
+    bool isPersistent() const { return _persistent; }
+
+    // function identification independent of the loaded data
+    static QString functionId(TraceFunction*);
+
+    /* key for the graph selected by <e>, with options for the layout.
+     * With <labelCosts>, costs shown in labels are part of the key.
+     */
+    QByteArray key(GraphExporter* e, const QString& options,
+                   bool labelCosts = false);
+    bool find(const QByteArray& key, GraphLayoutResult&);
+    void insert(const QByteArray& key, const GraphLayoutResult&);
+
+    // write results to disk if persistent
+    void save();
+
+    // lookups since creation, found in memory or on disk, or not found
+    int hits() const { return _hits; }
+    int diskHits() const { return _diskHits; }
+    int misses() const { return _misses; }
+
+    /* true if lookups should be logged with qDebug, switched on by
+     * setting KCACHEGRIND_DEBUG_LAYOUTCACHE in the environment
+     */
+    static bool debug();
+
+private:
+    typedef QPair<QString, QString> EdgeId;
+
+    // result with functions given by id, for persistence
+    struct StoredResult {
+        QSizeF size;
+        QHash<QString, QRectF> nodeRects;
+        QHash<EdgeId, QPolygon> edgePoints;
+        QHash<EdgeId, QPointF> labelPos, pointPos;
+    };
+
+    QString id(TraceFunction*) const;
+    bool fromStored(const StoredResult&, GraphLayoutResult&) const;
+    StoredResult toStored(const GraphLayoutResult&) const;
+    void load();
+
+    friend QDataStream& operator<<(QDataStream&, const StoredResult&);
+    friend QDataStream& operator>>(QDataStream&, StoredResult&);
+
+    QCache<QByteArray, GraphLayoutResult> _cache;
+
+    // ids of functions in last key()
+    QHash<QString, TraceFunction*> _functions;
+    QHash<TraceFunction*, QString> _ids;
+
+    bool _persistent, _loaded, _changed;
+    TraceData* _data;
+    QString _traceName, _filename;
+    QHash<QByteArray, StoredResult> _stored;
+    // to drop oldest stored results first
+    QList<QByteArray> _storedOrder;
+
+    int _hits, _diskHits, _misses;
+};
+
+#endif // GRAPHLAYOUT_H
@@ -7,12 +7,14 @@ NHEADERS += \
     $$PWD/toplevelbase.h \
     $$PWD/partselection.h \
     $$PWD/functionlistmodel.h \
+    $$PWD/functionnameindex.h \
     $$PWD/functionselection.h \
     $$PWD/listutils.h \
     $$PWD/stackselection.h \
     $$PWD/multiview.h \
     $$PWD/tabview.h \
     $$PWD/callgraphview.h \
+    $$PWD/graphlayout.h \
     $$PWD/treemap.h \
     $$PWD/callitem.h \
     $$PWD/callview.h \
@@ -34,6 +36,7 @@ NHEADERS += \
 SOURCES += \
     $$PWD/globalguiconfig.cpp \
     $$PWD/callgraphview.cpp \
+    $$PWD/graphlayout.cpp \
     $$PWD/callitem.cpp \
     $$PWD/callmapview.cpp \
     $$PWD/callview.cpp \
@@ -43,6 +46,7 @@ SOURCES += \
     $$PWD/eventtypeitem.cpp \
     $$PWD/eventtypeview.cpp \
     $$PWD/functionlistmodel.cpp \
+    $$PWD/functionnameindex.cpp \
     $$PWD/functionselection.cpp \
     $$PWD/instritem.cpp \
     $$PWD/instrview.cpp \
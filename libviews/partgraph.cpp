@@ -65,8 +65,13 @@ void PartAreaWidget::setEventType(EventType* ct)
 {
     _eventType = ct;
 
-    // this resizes items
-    base()->redraw();
+    // this resizes items, reusing a layout done for this type before
+    updateLayout();
+}
+
+QString PartAreaWidget::layoutKey() const
+{
+    return _eventType ? _eventType->name() : QString();
 }
 
 void PartAreaWidget::setVisualization(VisualizationMode m)
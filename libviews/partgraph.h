@@ -55,6 +55,7 @@ public:
 
     QColor groupColor(TraceFunction*) const;
     QString tipString(TreeMapItem*) const Q_DECL_OVERRIDE;
+    QString layoutKey() const Q_DECL_OVERRIDE;
 
     void changeHidden(const TracePartList& list);
     bool isHidden(TracePart*) const;
@@ -27,6 +27,8 @@
 #include <QVBoxLayout>
 #include <QAction>
 #include <QMenu>
+#include <QHelpEvent>
+#include <QToolTip>
 
 #include "toplevelbase.h"
 #include "partgraph.h"
@@ -77,6 +79,7 @@ PartSelection::PartSelection( TopLevelBase* top,
     _rangeLabel->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Preferred);
     vboxLayout->addWidget(_rangeLabel);
     _rangeLabel->setText(tr("(no trace parts)"));
+    _rangeLabel->installEventFilter(this);
     _showInfo    = true; // label is currently shown
 
     _diagramMode = DEFAULT_DIAGRAMMODE;
@@ -222,7 +225,9 @@ void PartSelection::doUpdate(int changeType, bool)
     if (changeType & partsChanged)
         selectParts(_partList);
 
-    _partAreaWidget->redraw();
+    // on event type change only, setEventType() updated the layout
+    if (changeType != eventTypeChanged)
+        _partAreaWidget->redraw();
     fillInfo();
 }
 
@@ -591,7 +596,31 @@ void PartSelection::fillInfo()
             info += ", Cachegrind " + part->version();
     }
 
-
     _rangeLabel->setText(info);
 }
 
+QString PartSelection::memoryInfo()
+{
+    TraceMemoryUsage usage = _data->memoryUsage();
+
+    QStringList lines;
+    lines << tr("Memory %1 MB").arg(usage.total() / 1048576.0, 0, 'f', 1);
+    for(int n=0; n<TraceMemoryUsage::CategoryCount; n++) {
+        TraceMemoryUsage::Category c = (TraceMemoryUsage::Category) n;
+        lines << tr("%1: %2 KB").arg(TraceMemoryUsage::categoryName(c))
+                                 .arg(usage.bytes(c) / 1024);
+    }
+    return lines.join(QLatin1Char('\n'));
+}
+
+bool PartSelection::eventFilter(QObject* o, QEvent* e)
+{
+    // memory usage walks over all items: only calculate when asked for
+    if ((o == _rangeLabel) && (e->type() == QEvent::ToolTip) && _data) {
+        QHelpEvent* he = (QHelpEvent*) e;
+        QToolTip::showText(he->globalPos(), memoryInfo(), _rangeLabel);
+        return true;
+    }
+    return QWidget::eventFilter(o, e);
+}
+
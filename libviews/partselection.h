@@ -65,6 +65,9 @@ public slots:
     void hiddenPartsChangedSlot(const TracePartList& list);
     void showInfo(bool);
 
+protected:
+    bool eventFilter(QObject*, QEvent*) Q_DECL_OVERRIDE;
+
 private:
     // reimplementations of TraceItemView
     CostItem* canShow(CostItem*) Q_DECL_OVERRIDE;
@@ -73,6 +76,7 @@ private:
     // helper for doUpdate
     void selectParts(const TracePartList& list);
     void fillInfo();
+    QString memoryInfo();
 
     bool _showInfo;
     bool _diagramMode;
@@ -39,12 +39,20 @@
 #include <QToolTip>
 #include <QStylePainter>
 #include <QStyleOptionFocusRect>
+#include <QRunnable>
 
 
 // set this to 1 to enable debug output
 #define DEBUG_DRAWING 0
 #define MAX_FIELD 12
 
+// drawing operations of all layouts in the layout cache
+#define LAYOUT_CACHE_OPS 500000
+// while resizing, only draw levels up to this depth ...
+#define COARSE_DEPTH 2
+// ... until size did not change for this time (ms)
+#define RESIZE_DELAY 200
+
 
 //
 // StoredDrawParams
@@ -1211,6 +1219,22 @@ TreeMapWidget::TreeMapWidget(TreeMapItem* base,
     _pressed = 0;
     _lastOver = 0;
     _needsRefresh = _base;
+    _needsRepaint = false;
+    _recordDrawOps = false;
+    _coarseLayout = false;
+    _layoutCache.setMaxCost(LAYOUT_CACHE_OPS);
+
+    _resizeTimer.setSingleShot(true);
+    _resizeTimer.setInterval(RESIZE_DELAY);
+    connect(&_resizeTimer, &QTimer::timeout,
+            this, &TreeMapWidget::resizeDone);
+
+    // one worker: levels are laid out one after the other
+    _layoutPool.setMaxThreadCount(1);
+    _layoutJob = 0;
+    _nextLayoutJob = 0;
+    _layoutGeneration = 0;
+    _layoutDepth = -1;
 
     setAttribute(Qt::WA_NoSystemBackground, true);
     setFocusPolicy(Qt::StrongFocus);
@@ -1218,6 +1242,10 @@ TreeMapWidget::TreeMapWidget(TreeMapItem* base,
 
 TreeMapWidget::~TreeMapWidget()
 {
+    abortLayout();
+    _layoutPool.waitForDone();
+    delete _layoutJob;
+
     delete _base;
 }
 
@@ -1231,7 +1259,7 @@ void TreeMapWidget::setSplitMode(TreeMapItem::SplitMode m)
     if (_splitMode == m) return;
 
     _splitMode = m;
-    redraw();
+    updateLayout();
 }
 
 TreeMapItem::SplitMode TreeMapWidget::splitMode() const
@@ -1279,7 +1307,8 @@ void TreeMapWidget::setShadingEnabled(bool s)
     if (_shading == s) return;
 
     _shading = s;
-    redraw();
+    // only changes drawing, not the layout
+    redrawState();
 }
 
 void TreeMapWidget::drawFrame(int d, bool b)
@@ -1287,7 +1316,8 @@ void TreeMapWidget::drawFrame(int d, bool b)
     if ((d<0) || (d>=4) || (_drawFrame[d]==b)) return;
 
     _drawFrame[d] = b;
-    redraw();
+    // only changes drawing, not the layout
+    redrawState();
 }
 
 void TreeMapWidget::setTransparent(int d, bool b)
@@ -1295,7 +1325,8 @@ void TreeMapWidget::setTransparent(int d, bool b)
     if ((d<0) || (d>=4) || (_transparent[d]==b)) return;
 
     _transparent[d] = b;
-    redraw();
+    // only changes drawing, not the layout
+    redrawState();
 }
 
 void TreeMapWidget::setAllowRotation(bool enable)
@@ -1529,12 +1560,12 @@ void TreeMapWidget::deletingItem(TreeMapItem* i)
     if (_pressed == i) _pressed = 0;
     if (_lastOver == i) _lastOver = 0;
 
-    // do not redraw a deleted item
-    if (_needsRefresh == i) {
-        // we can safely redraw the parent, as deleting order is
-        // from child to parent; i.e. i->parent() is existing.
-        _needsRefresh = i->parent();
-    }
+    // recorded drawing operations and the layout in progress
+    // may refer to the item
+    abortLayout();
+    _drawOps.clear();
+    _layoutCache.clear();
+    _needsRefresh = _base;
 }
 
 
@@ -1656,7 +1687,7 @@ void TreeMapWidget::setSelected(TreeMapItem* item, bool selected)
     if (_selectionMode == Single)
         emit selectionChanged(item);
     emit selectionChanged();
-    redraw(changed);
+    redrawState();
 
     if (0) qDebug() << (selected ? "S":"Des") << "elected Item "
                     << (item ? item->path(0).join(QString()) : QStringLiteral("(null)"))
@@ -1670,7 +1701,7 @@ void TreeMapWidget::setMarked(int markNo, bool redrawWidget)
     if ((_markNo == 0) && (markNo == 0)) return;
 
     _markNo = markNo;
-    if (!clearSelection() && redrawWidget) redraw();
+    if (!clearSelection() && redrawWidget) redrawState();
 }
 
 /* Returns all items which appear only in one of the given lists */
@@ -1733,7 +1764,7 @@ bool TreeMapWidget::clearSelection(TreeMapItem* parent)
 
     TreeMapItem* changed = diff(old, _selection).commonParent();
     if (changed) {
-        changed->redraw();
+        redrawState();
         emit selectionChanged();
     }
     return (changed != 0);
@@ -1765,15 +1796,14 @@ void TreeMapWidget::setCurrent(TreeMapItem* i, bool kbd)
                         << ") - mark removed";
 
         // always complete redraw needed to remove mark
-        redraw();
+        redrawState();
 
         if (old == _current) return;
     }
     else {
         if (old == _current) return;
 
-        if (old) old->redraw();
-        if (i) i->redraw();
+        redrawState();
     }
 
     //qDebug() << "Current Item " << (i ? qPrintable(i->path()) : "(null)");
@@ -1795,7 +1825,7 @@ void TreeMapWidget::setRangeSelection(TreeMapItem* i1,
     if (_selectionMode == Single)
         emit selectionChanged(i2);
     emit selectionChanged();
-    redraw(changed);
+    redrawState();
 }
 
 TreeMapItem* TreeMapWidget::setTmpRangeSelection(TreeMapItem* i1,
@@ -1907,7 +1937,7 @@ void TreeMapWidget::mousePressEvent( QMouseEvent* e )
     setCurrent(_pressed);
 
     if (changed)
-        redraw(changed);
+        redrawState();
 
     if (e->button() == Qt::RightButton) {
 
@@ -1964,7 +1994,7 @@ void TreeMapWidget::mouseMoveEvent( QMouseEvent* e )
     _lastOver = over;
 
     if (changed)
-        redraw(changed);
+        redrawState();
 }
 
 void TreeMapWidget::mouseReleaseEvent( QMouseEvent* )
@@ -1979,7 +2009,7 @@ void TreeMapWidget::mouseReleaseEvent( QMouseEvent* )
         TreeMapItem* changed = diff(_tmpSelection, _selection).commonParent();
         _tmpSelection = _selection;
         if (changed)
-            redraw(changed);
+            redrawState();
     }
     else {
         if (! (_tmpSelection == _selection)) {
@@ -2055,7 +2085,7 @@ void TreeMapWidget::keyPressEvent( QKeyEvent* e )
             TreeMapItem* changed = diff(_tmpSelection, _selection).commonParent();
             _tmpSelection = _selection;
             if (changed)
-                redraw(changed);
+                redrawState();
         }
         _pressed = 0;
         _lastOver = 0;
@@ -2200,36 +2230,42 @@ void TreeMapWidget::drawTreeMap()
     // no need to draw if hidden
     if (!isVisible()) return;
 
-    if (_pixmap.size() != size())
+    if (_pixmap.size() != size()) {
+        // on resizing, a full layout is done after resizing stopped
+        if (!_pixmap.isNull()) {
+            _coarseLayout = true;
+            _resizeTimer.start();
+        }
         _needsRefresh = _base;
+    }
 
-    if (_needsRefresh) {
+    if (_needsRefresh || _needsRepaint) {
 
         if (DEBUG_DRAWING)
-            qDebug() << "Redrawing " << _needsRefresh->path(0).join(QStringLiteral("/"));
+            qDebug() << (_needsRefresh ? "Redrawing" : "Repainting");
 
-        if (_needsRefresh == _base) {
-            // redraw whole widget
+        if (_pixmap.size() != size())
             _pixmap = QPixmap(size());
-            _pixmap.fill(palette().color(backgroundRole()));
-        }
+        _pixmap.fill(palette().color(backgroundRole()));
+
         QPainter p(&_pixmap);
-        if (_needsRefresh == _base) {
-            p.setPen(Qt::black);
-            p.drawRect(QRect(2, 2, QWidget::width()-5, QWidget::height()-5));
-            _base->setItemRect(QRect(3, 3, QWidget::width()-6, QWidget::height()-6));
-        }
-        else {
-            // only subitem
-            if (!_needsRefresh->itemRect().isValid()) return;
-        }
+        p.setPen(Qt::black);
+        p.drawRect(QRect(2, 2, QWidget::width()-5, QWidget::height()-5));
 
         // reset cached font object; it could have been changed
         _font = font();
         _fontHeight = fontMetrics().height();
 
-        drawItems(&p, _needsRefresh);
+        if (_needsRefresh && !restoreLayout())
+            startLayout(&p);
+        else {
+            // cached layouts are full ones
+            if (_needsRefresh) _coarseLayout = false;
+            replayDrawOps(&p);
+        }
+
         _needsRefresh = 0;
+        _needsRepaint = false;
     }
 
     QPainter p(this);
@@ -2246,18 +2282,515 @@ void TreeMapWidget::drawTreeMap()
     }
 }
 
+// split direction of items with split mode <m> at depth <d> in <r>
+static bool horizontalSplit(TreeMapItem::SplitMode m, int d, const QRect& r)
+{
+    switch(m) {
+    case TreeMapItem::HAlternate:
+        return (d%2)==1;
+    case TreeMapItem::VAlternate:
+        return (d%2)==0;
+    case TreeMapItem::Horizontal:
+        return true;
+    case TreeMapItem::Vertical:
+        return false;
+    default:
+        return r.width() > r.height();
+    }
+    return false;
+}
+
+/* Children of an item to be laid out into <rect>, with their values
+ * taken by TreeMapWidget::prepareItem() in the GUI thread. The worker
+ * thread does not access items: it only reads values and sets the
+ * results.
+ */
+struct TreeMapLayoutTask
+{
+    // only used in the GUI thread, children in order of layout
+    TreeMapItem* item;
+    QVector<TreeMapItem*> children;
+
+    QRect rect;
+    double sum;
+    QVector<double> values;
+    QVector<bool> alwaysBest;
+    TreeMapItem::SplitMode splitMode;
+    int depth;
+    bool noSorting;
+
+    // results: null rects for children not to be drawn,
+    // areas filled with a pattern, and separator lines
+    QVector<QRect> childRects;
+    QVector<QRect> fills;
+    QVector<QLine> separators;
+};
+
+/* Lays out the children of the items of one level in the worker
+ * thread, and calls TreeMapWidget::layoutJobDone() when done.
+ */
+class TreeMapLayoutJob: public QRunnable
+{
+public:
+    TreeMapLayoutJob(TreeMapWidget* w, int generation,
+                     int visibleWidth, int minimalArea, bool separators);
+
+    void run() Q_DECL_OVERRIDE;
+
+    QVector<TreeMapLayoutTask> tasks;
+    int generation;
+
+private:
+    void layout(TreeMapLayoutTask& t);
+    // returns false if rect gets to small
+    bool layoutArray(TreeMapLayoutTask& t, const QRect& r, double sum,
+                     int idx, int len);
+    bool tooSmall(const QRect& r) const;
+
+    TreeMapWidget* _widget;
+    int _visibleWidth, _minimalArea;
+    bool _separators;
+};
+
+TreeMapLayoutJob::TreeMapLayoutJob(TreeMapWidget* w, int generation,
+                                   int visibleWidth, int minimalArea,
+                                   bool separators)
+{
+    this->generation = generation;
+    _widget = w;
+    _visibleWidth = visibleWidth;
+    _minimalArea = minimalArea;
+    _separators = separators;
+
+    // the widget takes the results and deletes the job
+    setAutoDelete(false);
+}
+
+void TreeMapLayoutJob::run()
+{
+    for(int i=0; i<tasks.size(); i++)
+        layout(tasks[i]);
+
+    // the widget waits for running jobs on destruction
+    QMetaObject::invokeMethod(_widget, "layoutJobDone", Qt::QueuedConnection);
+}
+
+bool TreeMapLayoutJob::tooSmall(const QRect& r) const
+{
+    return ((r.height() < _visibleWidth) && (r.width() < _visibleWidth)) ||
+            ((_minimalArea > 0) && (r.width() * r.height() < _minimalArea));
+}
+
+void TreeMapLayoutJob::layout(TreeMapLayoutTask& t)
+{
+    t.childRects = QVector<QRect>(t.values.size());
+
+    if ((t.splitMode != TreeMapItem::Columns) &&
+        (t.splitMode != TreeMapItem::Rows)) {
+        layoutArray(t, t.rect, t.sum, 0, t.values.size());
+        return;
+    }
+
+    // we always split horizontally into columns, vertically into rows
+    bool columns = (t.splitMode == TreeMapItem::Columns);
+    QRect r = t.rect;
+    double user_sum = t.sum;
+    int idx = 0;
+    int len = t.values.size();
+    bool drawDetails = true;
+
+    while (len>0 && user_sum>0) {
+        int firstIdx = idx;
+        double valSum = 0;
+        int lenLeft = len;
+        int lines = columns ?
+                        (int)(sqrt((double)len * r.width()/r.height())+.5) :
+                        (int)(sqrt((double)len * r.height()/r.width())+.5);
+        if (lines==0) lines = 1; //should never be needed
+
+        while (lenLeft>0 && ((double)valSum*(len-lenLeft) <
+                             (double)len*user_sum/lines/lines)) {
+            valSum += t.values[idx];
+            idx++;
+            lenLeft--;
+        }
+
+        int nextPos;
+        QRect firstRect;
+        if (columns) {
+            nextPos = (int)((double)r.width() * valSum / user_sum);
+            firstRect = QRect(r.x(), r.y(), nextPos, r.height());
+        }
+        else {
+            nextPos = (int)((double)r.height() * valSum / user_sum);
+            firstRect = QRect(r.x(), r.y(), r.width(), nextPos);
+        }
+
+        if (nextPos < _visibleWidth) {
+            if (t.noSorting) {
+                // fill current rect with hash pattern
+                t.fills.append(firstRect);
+            }
+            else {
+                // fill rest with hash pattern
+                t.fills.append(r);
+                break;
+            }
+        }
+        else
+            drawDetails = layoutArray(t, firstRect, valSum,
+                                      firstIdx, len-lenLeft);
+
+        if (columns)
+            r.setRect(r.x()+nextPos, r.y(), r.width()-nextPos, r.height());
+        else
+            r.setRect(r.x(), r.y()+nextPos, r.width(), r.height()-nextPos);
+        user_sum -= valSum;
+        len = lenLeft;
+
+        if (!drawDetails) {
+            if (t.noSorting)
+                drawDetails = true;
+            else {
+                t.fills.append(r);
+                break;
+            }
+        }
+    }
+}
+
+bool TreeMapLayoutJob::layoutArray(TreeMapLayoutTask& t, const QRect& r,
+                                   double user_sum, int idx, int len)
+{
+    if (user_sum == 0) return false;
+
+    static const bool b2t = true;
+
+    // stop recursive bisection for small rectangles
+    if (tooSmall(r)) {
+        t.fills.append(r);
+        return false;
+    }
+
+    if (len>2 && (t.splitMode == TreeMapItem::Bisection)) {
+
+        int firstIdx = idx;
+        double valSum = 0;
+        int lenLeft = len;
+        while (lenLeft>len/2) {
+            valSum += t.values[idx];
+            idx++;
+            lenLeft--;
+        }
+
+        // first half...
+        bool drawOn;
+        QRect secondRect;
+
+        if (r.width() > r.height()) {
+            int halfPos = (int)((double)r.width() * valSum / user_sum);
+            QRect firstRect = QRect(r.x(), r.y(), halfPos, r.height());
+            drawOn = layoutArray(t, firstRect, valSum, firstIdx, len-lenLeft);
+            secondRect.setRect(r.x()+halfPos, r.y(), r.width()-halfPos, r.height());
+        }
+        else {
+            int halfPos = (int)((double)r.height() * valSum / user_sum);
+            QRect firstRect = QRect(r.x(), r.y(), r.width(), halfPos);
+            drawOn = layoutArray(t, firstRect, valSum, firstIdx, len-lenLeft);
+            secondRect.setRect(r.x(), r.y()+halfPos, r.width(), r.height()-halfPos);
+        }
+
+        // if no sorting, do not stop drawing
+        if (t.noSorting) drawOn = true;
+
+        // second half
+        if (drawOn)
+            drawOn = layoutArray(t, secondRect, user_sum - valSum,
+                                 idx, lenLeft);
+        else
+            t.fills.append(secondRect);
+
+        return drawOn;
+    }
+
+    bool hor = horizontalSplit(t.splitMode, t.depth, r);
+
+    QRect fullRect = r;
+    while (len>0) {
+        if (user_sum <= 0) {
+            idx++;
+            len--;
+            continue;
+        }
+
+        // stop drawing for small rectangles
+        if (tooSmall(fullRect)) {
+            t.fills.append(fullRect);
+            return false;
+        }
+
+        if (t.alwaysBest[idx])
+            hor = fullRect.width() > fullRect.height();
+
+        int lastPos = hor ? fullRect.width() : fullRect.height();
+        double val = t.values[idx];
+        int nextPos = (user_sum <= 0.0) ? 0: (int)(lastPos * val / user_sum +.5);
+        if (nextPos>lastPos) nextPos = lastPos;
+
+        if (!t.noSorting && (nextPos < _visibleWidth)) {
+            t.fills.append(fullRect);
+            return false;
+        }
+
+        QRect currRect = fullRect;
+
+        if (hor)
+            currRect.setWidth(nextPos);
+        else {
+            if (b2t)
+                currRect.setRect(fullRect.x(), fullRect.bottom()-nextPos+1, fullRect.width(), nextPos);
+            else
+                currRect.setHeight(nextPos);
+        }
+
+        // do not draw very small rectangles:
+        if (nextPos >= _visibleWidth)
+            t.childRects[idx] = currRect;
+        else
+            t.fills.append(currRect);
+
+        // separator
+        if (_separators && (nextPos<lastPos)) {
+            if (hor) {
+                if (fullRect.top() <= fullRect.bottom())
+                    t.separators.append(QLine(fullRect.x() + nextPos, fullRect.top(), fullRect.x() + nextPos, fullRect.bottom()));
+            }
+            else {
+                if (fullRect.left() <= fullRect.right())
+                    t.separators.append(QLine(fullRect.left(), fullRect.y() + nextPos, fullRect.right(), fullRect.y() + nextPos));
+            }
+            nextPos++;
+        }
+
+        if (hor)
+            fullRect.setRect(fullRect.x() + nextPos, fullRect.y(),
+                             lastPos - nextPos, fullRect.height());
+        else {
+            if (b2t)
+                fullRect.setRect(fullRect.x(), fullRect.y(),
+                                 fullRect.width(), lastPos-nextPos);
+            else
+                fullRect.setRect(fullRect.x(), fullRect.y() + nextPos,
+                                 fullRect.width(), lastPos-nextPos);
+        }
+
+        user_sum -= val;
+        idx++;
+        len--;
+    }
+
+    return true;
+}
+
+/* Starts a layout of all items, drawing them and recording the drawing
+ * operations. The base item is drawn here, further levels when the
+ * areas of their items are calculated, see layoutJobDone(). Layouts
+ * for the full drawing depth are cached.
+ */
+void TreeMapWidget::startLayout(QPainter* p)
+{
+    abortLayout();
+
+    _base->setItemRect(QRect(3, 3, QWidget::width()-6, QWidget::height()-6));
+
+    _layoutDepth = _maxDrawingDepth;
+    if (_coarseLayout &&
+        ((_maxDrawingDepth < 0) || (_maxDrawingDepth > COARSE_DEPTH)))
+        _layoutDepth = COARSE_DEPTH;
+
+    TreeMapLayoutJob* job = new TreeMapLayoutJob(this, _layoutGeneration,
+                                                 _visibleWidth, _minimalArea,
+                                                 _drawSeparators);
+    _drawOps.clear();
+    _recordDrawOps = true;
+    prepareItem(p, _base, job);
+    _recordDrawOps = false;
+
+    if (!job->tasks.isEmpty()) {
+        runLayoutJob(job);
+        return;
+    }
+    delete job;
+    if (_layoutDepth == _maxDrawingDepth)
+        storeLayout();
+}
+
+void TreeMapWidget::runLayoutJob(TreeMapLayoutJob* job)
+{
+    if (_layoutJob) {
+        // job of an aborted layout still running
+        delete _nextLayoutJob;
+        _nextLayoutJob = job;
+        return;
+    }
+    _layoutJob = job;
+    _layoutPool.start(job);
+}
+
+// results of jobs running or waiting are dropped
+void TreeMapWidget::abortLayout()
+{
+    _layoutGeneration++;
+    delete _nextLayoutJob;
+    _nextLayoutJob = 0;
+}
+
+// draws the children laid out by the finished job as next level
+void TreeMapWidget::layoutJobDone()
+{
+    TreeMapLayoutJob* job = _layoutJob;
+    _layoutJob = 0;
+    if (!job) return;
+
+    if (job->generation != _layoutGeneration) {
+        delete job;
+        if (_nextLayoutJob) {
+            job = _nextLayoutJob;
+            _nextLayoutJob = 0;
+            runLayoutJob(job);
+        }
+        return;
+    }
+
+    int generation = _layoutGeneration;
+    TreeMapLayoutJob* next = new TreeMapLayoutJob(this, generation,
+                                                  _visibleWidth, _minimalArea,
+                                                  _drawSeparators);
+    QPainter p(&_pixmap);
+    _recordDrawOps = true;
+    foreach(const TreeMapLayoutTask& t, job->tasks) {
+        foreach(const QRect& r, t.fills) {
+            fillArea(&p, r);
+            t.item->addFreeRect(r);
+        }
+        foreach(const QLine& l, t.separators)
+            drawSeparator(&p, l);
+
+        for(int i=0; i<t.children.size(); i++) {
+            if (t.childRects[i].isNull()) continue;
+
+            t.children[i]->setItemRect(t.childRects[i]);
+            prepareItem(&p, t.children[i], next);
+            // items were deleted
+            if (_layoutGeneration != generation) break;
+        }
+        if (_layoutGeneration != generation) break;
+    }
+    _recordDrawOps = false;
+    p.end();
+    delete job;
+
+    if (_layoutGeneration != generation) {
+        delete next;
+        return;
+    }
+    update();
+
+    if (!next->tasks.isEmpty()) {
+        runLayoutJob(next);
+        return;
+    }
+    delete next;
+    if (_layoutDepth == _maxDrawingDepth)
+        storeLayout();
+}
+
+void TreeMapWidget::replayDrawOps(QPainter* p)
+{
+    foreach(const DrawOp& op, _drawOps) {
+        switch(op.type) {
+        case DrawOp::Back:
+            drawItem(p, op.item);
+            break;
+        case DrawOp::Fields:
+            drawFields(p, op.item, op.rect, op.rotated, op.fields);
+            break;
+        case DrawOp::Fill:
+            fillArea(p, op.rect);
+            break;
+        case DrawOp::Separator:
+            drawSeparator(p, op.line);
+            break;
+        }
+    }
+}
+
+QString TreeMapWidget::layoutCacheKey() const
+{
+    return QStringLiteral("%1x%2 %3 %4")
+            .arg(QWidget::width()).arg(QWidget::height())
+            .arg(_splitMode).arg(layoutKey());
+}
+
+void TreeMapWidget::storeLayout()
+{
+    Layout* l = new Layout;
+    l->ops = _drawOps;
+    foreach(const DrawOp& op, _drawOps) {
+        if (op.type != DrawOp::Back) continue;
+
+        ItemAreas a;
+        a.item = op.item;
+        a.rect = op.item->itemRect();
+        a.freeRects = op.item->freeRects();
+        l->areas.append(a);
+    }
+    _layoutCache.insert(layoutCacheKey(), l, l->ops.count());
+}
+
+// returns false if there is no cached layout for current size and key
+bool TreeMapWidget::restoreLayout()
+{
+    Layout* l = _layoutCache.object(layoutCacheKey());
+    if (!l) return false;
+
+    abortLayout();
+
+    // items drawn in the current layout may not be drawn in the cached one
+    foreach(const DrawOp& op, _drawOps)
+        if (op.type == DrawOp::Back)
+            op.item->clearItemRect();
+
+    foreach(const ItemAreas& a, l->areas) {
+        a.item->setItemRect(a.rect);
+        a.item->clearFreeRects();
+        foreach(const QRect& r, a.freeRects)
+            a.item->addFreeRect(r);
+    }
+    _drawOps = l->ops;
+
+    if (DEBUG_DRAWING)
+        qDebug() << "Using cached layout" << layoutCacheKey();
+
+    return true;
+}
+
+void TreeMapWidget::resizeDone()
+{
+    if (!_coarseLayout) return;
 
+    _coarseLayout = false;
+    _needsRefresh = _base;
+    update();
+}
 
 void TreeMapWidget::redraw(TreeMapItem* i)
 {
     if (!i) return;
 
-    if (!_needsRefresh)
-        _needsRefresh = i;
-    else {
-        if (!i->isChildOf(_needsRefresh))
-            _needsRefresh = _needsRefresh->commonParent(i);
-    }
+    // cached layouts have old values
+    _layoutCache.clear();
+    _needsRefresh = _base;
 
     if (isVisible()) {
         // delayed drawing if we have multiple redraw requests
@@ -2265,9 +2798,28 @@ void TreeMapWidget::redraw(TreeMapItem* i)
     }
 }
 
+void TreeMapWidget::updateLayout()
+{
+    _needsRefresh = _base;
+    if (isVisible()) update();
+}
+
+void TreeMapWidget::redrawState()
+{
+    _needsRepaint = true;
+    if (isVisible()) update();
+}
+
 void TreeMapWidget::drawItem(QPainter* p,
                              TreeMapItem* item)
 {
+    if (_recordDrawOps) {
+        DrawOp op;
+        op.type = DrawOp::Back;
+        op.item = item;
+        _drawOps.append(op);
+    }
+
     bool isSelected = false;
 
     if (_markNo>0) {
@@ -2299,33 +2851,81 @@ void TreeMapWidget::drawItem(QPainter* p,
     d.drawBack(p, item);
 }
 
+/* Draws visible text fields of <item> into <r>, returns the space left.
+ * With ForcedFields/UnforcedFields, only fields with/without forced
+ * drawing are drawn.
+ */
+QRect TreeMapWidget::drawFields(QPainter* p, TreeMapItem* item,
+                                const QRect& r, bool rotated,
+                                FieldSet fields)
+{
+    if (_recordDrawOps) {
+        DrawOp op;
+        op.type = DrawOp::Fields;
+        op.item = item;
+        op.rect = r;
+        op.fields = fields;
+        op.rotated = rotated;
+        _drawOps.append(op);
+    }
 
-bool TreeMapWidget::horizontal(TreeMapItem* i, const QRect& r)
+    RectDrawing d(r);
+    item->setRotated(rotated);
+    for (int no=0;no<(int)_attr.size();no++) {
+        if (!fieldVisible(no)) continue;
+        if ((fields == ForcedFields) && !fieldForced(no)) continue;
+        if ((fields == UnforcedFields) && fieldForced(no)) continue;
+        d.drawField(p, no, item);
+    }
+    return d.remainingRect(item);
+}
+
+void TreeMapWidget::drawSeparator(QPainter* p, const QLine& l)
 {
-    switch(i->splitMode()) {
-    case TreeMapItem::HAlternate:
-        return (i->depth()%2)==1;
-    case TreeMapItem::VAlternate:
-        return (i->depth()%2)==0;
-    case TreeMapItem::Horizontal:
-        return true;
-    case TreeMapItem::Vertical:
-        return false;
-    default:
-        return r.width() > r.height();
+    if (_recordDrawOps) {
+        DrawOp op;
+        op.type = DrawOp::Separator;
+        op.item = 0;
+        op.line = l;
+        _drawOps.append(op);
     }
-    return false;
+
+    p->setPen(Qt::black);
+    p->drawLine(l);
+}
+
+// fills area with a pattern
+void TreeMapWidget::fillArea(QPainter* p, const QRect& r)
+{
+    if (_recordDrawOps) {
+        DrawOp op;
+        op.type = DrawOp::Fill;
+        op.item = 0;
+        op.rect = r;
+        _drawOps.append(op);
+    }
+
+    p->setBrush(Qt::Dense4Pattern);
+    p->setPen(Qt::NoPen);
+    p->drawRect(QRect(r.x(), r.y(), r.width()-1, r.height()-1));
+}
+
+
+bool TreeMapWidget::horizontal(TreeMapItem* i, const QRect& r)
+{
+    return horizontalSplit(i->splitMode(), i->depth(), r);
 }
 
 
 /**
- * Draw TreeMapItems recursive, starting from item
+ * Draws <item> with its text fields, and adds the layout of its
+ * children to <job> if they are to be drawn
  */
-void TreeMapWidget::drawItems(QPainter* p,
-                              TreeMapItem* item)
+void TreeMapWidget::prepareItem(QPainter* p, TreeMapItem* item,
+                                TreeMapLayoutJob* job)
 {
     if (DEBUG_DRAWING)
-        qDebug() << "+drawItems(" << item->path(0).join(QStringLiteral("/")) << ", "
+        qDebug() << "+prepareItem(" << item->path(0).join(QStringLiteral("/")) << ", "
                  << item->itemRect().x() << "/" << item->itemRect().y()
                  << "-" << item->itemRect().width() << "x"
                  << item->itemRect().height() << "), Val " << item->value()
@@ -2353,7 +2953,7 @@ void TreeMapWidget::drawItems(QPainter* p,
 
     // stop drawing if maximum depth is reached
     if (!stopDrawing &&
-        (_maxDrawingDepth>=0 && item->depth()>=_maxDrawingDepth))
+        (_layoutDepth>=0 && item->depth()>=_layoutDepth))
         stopDrawing = true;
 
     // stop drawing if stopAtText is reached
@@ -2386,19 +2986,13 @@ void TreeMapWidget::drawItems(QPainter* p,
         // if we have space for text...
         if ((r.height() < _fontHeight) || (r.width() < _fontHeight)) return;
 
-        RectDrawing d(r);
         // draw text fields rotated to split direction
         bool rotate = !horizontal(item, r);
         if (_allowRotation) rotate = (r.height() > r.width());
-        item->setRotated(rotate);
-        for (int no=0;no<(int)_attr.size();no++) {
-            if (!fieldVisible(no)) continue;
-            d.drawField(p, no, item);
-        }
-        r = d.remainingRect(item);
+        drawFields(p, item, r, rotate, AllFields);
 
         if (DEBUG_DRAWING)
-            qDebug() << "-drawItems(" << item->path(0).join(QStringLiteral("/")) << ")";
+            qDebug() << "-prepareItem(" << item->path(0).join(QStringLiteral("/")) << ")";
         return;
     }
 
@@ -2421,17 +3015,10 @@ void TreeMapWidget::drawItems(QPainter* p,
     // if we have space for text...
     if ((r.height() >= _fontHeight) && (r.width() >= _fontHeight)) {
 
-        RectDrawing d(r);
         // draw text fields rotated to split direction
         bool rotate = !horizontal(item, r);
         if (_allowRotation) rotate = (r.height() > r.width());
-        item->setRotated(rotate);
-        for (int no=0;no<(int)_attr.size();no++) {
-            if (!fieldVisible(no)) continue;
-            if (!fieldForced(no)) continue;
-            d.drawField(p, no, item);
-        }
-        r = d.remainingRect(item);
+        r = drawFields(p, item, r, rotate, ForcedFields);
     }
 
     if (orig.x() == r.x()) {
@@ -2491,16 +3078,9 @@ void TreeMapWidget::drawItems(QPainter* p,
                         << "/" << sr.height() << ", self " << self << "/"
                         << user_sum;
 
-        if ((sr.height() >= _fontHeight) && (sr.width() >= _fontHeight)) {
-
-            RectDrawing d(sr);
-            item->setRotated(_allowRotation && (r.height() > r.width()));
-            for (int no=0;no<(int)_attr.size();no++) {
-                if (!fieldVisible(no)) continue;
-                if (fieldForced(no)) continue;
-                d.drawField(p, no, item);
-            }
-        }
+        if ((sr.height() >= _fontHeight) && (sr.width() >= _fontHeight))
+            drawFields(p, item, sr, _allowRotation && (r.height() > r.width()),
+                       UnforcedFields);
 
         user_sum -= self;
     }
@@ -2511,331 +3091,28 @@ void TreeMapWidget::drawItems(QPainter* p,
         goBack = false;
     }
 
-    int idx = goBack ? (list->size()-1) : 0;
-
-    if (item->splitMode() == TreeMapItem::Columns) {
-        int len = list->count();
-        bool drawDetails = true;
-
-        while (len>0 && user_sum>0) {
-            int firstIdx = idx;
-            double valSum = 0;
-            int lenLeft = len;
-            int columns = (int)(sqrt((double)len * r.width()/r.height())+.5);
-            if (columns==0) columns = 1; //should never be needed
-
-            while (lenLeft>0 && ((double)valSum*(len-lenLeft) <
-                                 (double)len*user_sum/columns/columns)) {
-                valSum += list->at(idx)->value();
-                if (goBack) --idx; else ++idx;
-                lenLeft--;
-            }
-
-            // we always split horizontally
-            int nextPos = (int)((double)r.width() * valSum / user_sum);
-            QRect firstRect = QRect(r.x(), r.y(), nextPos, r.height());
-
-            if (nextPos < _visibleWidth) {
-                if (item->sorting(0) == -1) {
-                    // fill current rect with hash pattern
-                    drawFill(item, p, firstRect);
-                }
-                else {
-                    // fill rest with hash pattern
-                    drawFill(item, p, r, list, firstIdx, len, goBack);
-                    break;
-                }
-            }
-            else {
-                drawDetails = drawItemArray(p, item, firstRect,
-                                            valSum, list, firstIdx, len-lenLeft, goBack);
-            }
-            r.setRect(r.x()+nextPos, r.y(), r.width()-nextPos, r.height());
-            user_sum -= valSum;
-            len = lenLeft;
-
-            if (!drawDetails) {
-                if (item->sorting(0) == -1)
-                    drawDetails = true;
-                else {
-                    drawFill(item, p, r, list, idx, len, goBack);
-                    break;
-                }
-            }
-        }
-    }
-    else if (item->splitMode() == TreeMapItem::Rows) {
-        int len = list->count();
-        bool drawDetails = true;
-
-        while (len>0 && user_sum>0) {
-            int firstIdx = idx;
-            double valSum = 0;
-            int lenLeft = len;
-            int rows = (int)(sqrt((double)len * r.height()/r.width())+.5);
-            if (rows==0) rows = 1; //should never be needed
-
-            while (lenLeft>0 && ((double)valSum*(len-lenLeft) <
-                                 (double)len*user_sum/rows/rows)) {
-                valSum += list->at(idx)->value();
-                if (goBack) --idx; else ++idx;
-                lenLeft--;
-            }
-
-            // we always split horizontally
-            int nextPos = (int)((double)r.height() * valSum / user_sum);
-            QRect firstRect = QRect(r.x(), r.y(), r.width(), nextPos);
-
-            if (nextPos < _visibleWidth) {
-                if (item->sorting(0) == -1) {
-                    drawFill(item, p, firstRect);
-                }
-                else {
-                    drawFill(item, p, r, list, firstIdx, len, goBack);
-                    break;
-                }
-            }
-            else {
-                drawDetails = drawItemArray(p, item, firstRect,
-                                            valSum, list, firstIdx, len-lenLeft, goBack);
-            }
-            r.setRect(r.x(), r.y()+nextPos, r.width(), r.height()-nextPos);
-            user_sum -= valSum;
-            len = lenLeft;
-
-            if (!drawDetails) {
-                if (item->sorting(0) == -1)
-                    drawDetails = true;
-                else {
-                    drawFill(item, p, r, list, idx, len, goBack);
-                    break;
-                }
-            }
-        }
-    }
-    else
-        drawItemArray(p, item, r, user_sum, list, idx, list->count(), goBack);
-
-    if (DEBUG_DRAWING)
-        qDebug() << "-drawItems(" << item->path(0).join(QStringLiteral("/")) << ")";
-}
-
-// fills area with a pattern if to small to draw children
-void TreeMapWidget::drawFill(TreeMapItem* i, QPainter* p, const QRect& r)
-{
-    p->setBrush(Qt::Dense4Pattern);
-    p->setPen(Qt::NoPen);
-    p->drawRect(QRect(r.x(), r.y(), r.width()-1, r.height()-1));
-    i->addFreeRect(r);
-}
-
-// fills area with a pattern if to small to draw children
-void TreeMapWidget::drawFill(TreeMapItem* i, QPainter* p, const QRect& r,
-                             TreeMapItemList* list, int idx, int len, bool goBack)
-{
-    if (DEBUG_DRAWING)
-        qDebug() << "  +drawFill(" << r.x() << "/" << r.y()
-                 << "-" << r.width() << "x" << r.height()
-                 << ", len " << len << ")";
-
-    p->setBrush(Qt::Dense4Pattern);
-    p->setPen(Qt::NoPen);
-    p->drawRect(QRect(r.x(), r.y(), r.width()-1, r.height()-1));
-    i->addFreeRect(r);
-
-    // reset rects
-    while (len>0 && (i=list->value(idx))) {
-
-        if (DEBUG_DRAWING)
-            qDebug() << "   Reset Rect " << i->path(0).join(QStringLiteral("/"));
+    // children are drawn when their areas are calculated
+    TreeMapLayoutTask t;
+    t.item = item;
+    t.rect = r;
+    t.sum = user_sum;
+    t.splitMode = item->splitMode();
+    t.depth = item->depth();
+    t.noSorting = (item->sorting(0) == -1);
 
+    int idx = goBack ? (list->size()-1) : 0;
+    for(int n=0; n<list->size(); n++) {
+        TreeMapItem* i = list->at(idx);
         i->clearItemRect();
+        t.children.append(i);
+        t.values.append(i->value());
+        t.alwaysBest.append(i->splitMode() == TreeMapItem::AlwaysBest);
         if (goBack) --idx; else ++idx;
-        len--;
-    }
-    if (DEBUG_DRAWING)
-        qDebug() << "  -drawFill(" << r.x() << "/" << r.y()
-                 << "-" << r.width() << "x" << r.height()
-                 << ", len " << len << ")";
-}
-
-// returns false if rect gets to small
-bool TreeMapWidget::drawItemArray(QPainter* p, TreeMapItem* item,
-                                  const QRect& r, double user_sum,
-                                  TreeMapItemList* list, int idx, int len,
-                                  bool goBack)
-{
-    if (user_sum == 0) return false;
-
-    static bool b2t = true;
-
-    // stop recursive bisection for small rectangles
-    if (((r.height() < _visibleWidth) &&
-         (r.width() < _visibleWidth)) ||
-        ((_minimalArea > 0) &&
-         (r.width() * r.height() < _minimalArea))) {
-
-        drawFill(item, p, r, list, idx, len, goBack);
-        return false;
-    }
-
-    if (DEBUG_DRAWING)
-        qDebug() << " +drawItemArray(" << item->path(0).join(QStringLiteral("/"))
-                 << ", " << r.x() << "/" << r.y() << "-" << r.width()
-                 << "x" << r.height() << ")";
-
-    if (len>2 && (item->splitMode() == TreeMapItem::Bisection)) {
-
-        int firstIdx = idx;
-        double valSum = 0;
-        int lenLeft = len;
-        //while (lenLeft>0 && valSum<user_sum/2) {
-        while (lenLeft>len/2) {
-            valSum += list->at(idx)->value();
-            if (goBack) --idx; else ++idx;
-            lenLeft--;
-        }
-
-        // draw first half...
-        bool drawOn;
-        QRect secondRect;
-
-        if (r.width() > r.height()) {
-            int halfPos = (int)((double)r.width() * valSum / user_sum);
-            QRect firstRect = QRect(r.x(), r.y(), halfPos, r.height());
-            drawOn = drawItemArray(p, item, firstRect,
-                                   valSum, list, firstIdx, len-lenLeft, goBack);
-            secondRect.setRect(r.x()+halfPos, r.y(), r.width()-halfPos, r.height());
-        }
-        else {
-            int halfPos = (int)((double)r.height() * valSum / user_sum);
-            QRect firstRect = QRect(r.x(), r.y(), r.width(), halfPos);
-            drawOn = drawItemArray(p, item, firstRect,
-                                   valSum, list, firstIdx, len-lenLeft, goBack);
-            secondRect.setRect(r.x(), r.y()+halfPos, r.width(), r.height()-halfPos);
-        }
-
-        // if no sorting, do not stop drawing
-        if (item->sorting(0) == -1) drawOn = true;
-
-        // second half
-        if (drawOn)
-            drawOn = drawItemArray(p, item, secondRect, user_sum - valSum,
-                                   list, idx, lenLeft, goBack);
-        else {
-            drawFill(item, p, secondRect, list, idx, len, goBack);
-        }
-
-        if (DEBUG_DRAWING)
-            qDebug() << " -drawItemArray(" << item->path(0).join(QStringLiteral("/"))
-                     << ")";
-
-        return drawOn;
-    }
-
-    bool hor = horizontal(item,r);
-
-    TreeMapItem* i;
-    QRect fullRect = r;
-    while (len>0) {
-        i = list->at(idx);
-        if (user_sum <= 0) {
-
-            if (DEBUG_DRAWING)
-                qDebug() << "drawItemArray: Reset " << i->path(0).join(QStringLiteral("/"));
-
-            i->clearItemRect();
-            if (goBack) --idx; else ++idx;
-            len--;
-            continue;
-        }
-
-        // stop drawing for small rectangles
-        if (((fullRect.height() < _visibleWidth) &&
-             (fullRect.width() < _visibleWidth)) ||
-            ((_minimalArea > 0) &&
-             (fullRect.width() * fullRect.height() < _minimalArea))) {
-
-            drawFill(item, p, fullRect, list, idx, len, goBack);
-            if (DEBUG_DRAWING)
-                qDebug() << " -drawItemArray(" << item->path(0).join(QStringLiteral("/"))
-                         << "): Stop";
-            return false;
-        }
-
-        if (i->splitMode() == TreeMapItem::AlwaysBest)
-            hor = fullRect.width() > fullRect.height();
-
-        int lastPos = hor ? fullRect.width() : fullRect.height();
-        double val = i->value();
-        int nextPos = (user_sum <= 0.0) ? 0: (int)(lastPos * val / user_sum +.5);
-        if (nextPos>lastPos) nextPos = lastPos;
-
-        if ((item->sorting(0) != -1) && (nextPos < _visibleWidth)) {
-            drawFill(item, p, fullRect, list, idx, len, goBack);
-            if (DEBUG_DRAWING)
-                qDebug() << " -drawItemArray(" << item->path(0).join(QStringLiteral("/"))
-                         << "): Stop";
-            return false;
-        }
-
-        QRect currRect = fullRect;
-
-        if (hor)
-            currRect.setWidth(nextPos);
-        else {
-            if (b2t)
-                currRect.setRect(fullRect.x(), fullRect.bottom()-nextPos+1, fullRect.width(), nextPos);
-            else
-                currRect.setHeight(nextPos);
-        }
-
-        // do not draw very small rectangles:
-        if (nextPos >= _visibleWidth) {
-            i->setItemRect(currRect);
-            drawItems(p, i);
-        }
-        else {
-            i->clearItemRect();
-            drawFill(item, p, currRect);
-        }
-
-        // draw Separator
-        if (_drawSeparators && (nextPos<lastPos)) {
-            p->setPen(Qt::black);
-            if (hor) {
-                if (fullRect.top() <= fullRect.bottom())
-                    p->drawLine(fullRect.x() + nextPos, fullRect.top(), fullRect.x() + nextPos, fullRect.bottom());
-            }
-            else {
-                if (fullRect.left() <= fullRect.right())
-                    p->drawLine(fullRect.left(), fullRect.y() + nextPos, fullRect.right(), fullRect.y() + nextPos);
-            }
-            nextPos++;
-        }
-
-        if (hor)
-            fullRect.setRect(fullRect.x() + nextPos, fullRect.y(),
-                             lastPos - nextPos, fullRect.height());
-        else {
-            if (b2t)
-                fullRect.setRect(fullRect.x(), fullRect.y(),
-                                 fullRect.width(), lastPos-nextPos);
-            else
-                fullRect.setRect(fullRect.x(), fullRect.y() + nextPos,
-                                 fullRect.width(), lastPos-nextPos);
-        }
-
-        user_sum -= val;
-        if (goBack) --idx; else ++idx;
-        len--;
     }
+    job->tasks.append(t);
 
     if (DEBUG_DRAWING)
-        qDebug() << " -drawItemArray(" << item->path(0).join(QStringLiteral("/"))
-                 << "): Continue";
-
-    return true;
+        qDebug() << "-prepareItem(" << item->path(0).join(QStringLiteral("/")) << ")";
 }
 
 
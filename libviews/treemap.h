@@ -34,7 +34,12 @@
 #include <QWidget>
 #include <QPixmap>
 #include <QColor>
+#include <QCache>
+#include <QLine>
 #include <QStringList>
+#include <QTimer>
+#include <QThreadPool>
+#include <QVector>
 #include <QPaintEvent>
 #include <QKeyEvent>
 #include <QContextMenuEvent>
@@ -44,6 +49,7 @@ class QMenu;
 class TreeMapWidget;
 class TreeMapItem;
 class TreeMapItemList;
+class TreeMapLayoutJob;
 
 
 /**
@@ -392,6 +398,14 @@ private:
 /**
  * Class for visualization of a metric of hierarchically
  * nested items as 2D areas.
+ *
+ * Layout is done level by level: the GUI thread draws the items of
+ * a level into the back buffer and takes the values of their children,
+ * as children() and value() may calculate lazily from data which is
+ * not thread-safe. The areas of the children are calculated in a
+ * worker thread, and the next level is drawn when they are done, so
+ * the map is shown coarse to fine. Layouts are recorded and cached,
+ * see updateLayout().
  */
 class TreeMapWidget: public QWidget
 {
@@ -629,10 +643,25 @@ public:
     /**
      * Redraws an item with all children.
      * This takes changed values(), sums(), colors() and text() into account.
+     * As drawing is recorded for the whole widget, this always does a new
+     * layout of all items, and forgets cached layouts.
      */
     void redraw(TreeMapItem*);
     void redraw() { redraw(_base); }
 
+    /**
+     * Identifies the values of items for the layout cache, e.g. the
+     * shown event type. A layout done for the same size, split mode
+     * and key is reused by updateLayout() instead of a new layout.
+     */
+    virtual QString layoutKey() const { return QString(); }
+
+    /**
+     * Redraws all items after a change of layoutKey(), reusing a cached
+     * layout if there is one for the new key.
+     */
+    void updateLayout();
+
     /**
      * Resort all TreeMapItems. See TreeMapItem::resort().
      */
@@ -647,6 +676,10 @@ public:
 protected slots:
     void splitActivated(QAction*);
 
+private slots:
+    void resizeDone();
+    void layoutJobDone();
+
 signals:
     void selectionChanged();
     void selectionChanged(TreeMapItem*);
@@ -682,14 +715,53 @@ private:
                                       TreeMapItem* i2, bool selected);
     bool isTmpSelected(TreeMapItem* i);
 
+    // text fields drawn by drawFields()
+    enum FieldSet { AllFields, ForcedFields, UnforcedFields };
+
+    /* A drawing operation recorded while doing a layout. Redrawing for
+     * changed selection or marking only replays these operations,
+     * without calling children() or value() of items.
+     */
+    struct DrawOp {
+        enum Type { Back, Fields, Fill, Separator };
+        Type type;
+        TreeMapItem* item;
+        QRect rect;
+        QLine line;
+        FieldSet fields;
+        bool rotated;
+    };
+
+    // areas of an item drawn in a layout
+    struct ItemAreas {
+        TreeMapItem* item;
+        QRect rect;
+        QList<QRect> freeRects;
+    };
+
+    // cached layout
+    struct Layout {
+        QVector<DrawOp> ops;
+        QVector<ItemAreas> areas;
+    };
+
+    // redraw with changed selection/marking, keeping the layout
+    void redrawState();
+    void startLayout(QPainter*);
+    void prepareItem(QPainter*, TreeMapItem*, TreeMapLayoutJob*);
+    void runLayoutJob(TreeMapLayoutJob*);
+    void abortLayout();
+    void replayDrawOps(QPainter*);
+    QString layoutCacheKey() const;
+    void storeLayout();
+    bool restoreLayout();
+
     void drawItem(QPainter* p, TreeMapItem*);
-    void drawItems(QPainter* p, TreeMapItem*);
+    QRect drawFields(QPainter* p, TreeMapItem*, const QRect& r,
+                     bool rotated, FieldSet fields);
+    void drawSeparator(QPainter* p, const QLine& l);
+    void fillArea(QPainter* p, const QRect& r);
     bool horizontal(TreeMapItem* i, const QRect& r);
-    void drawFill(TreeMapItem*,QPainter* p, const QRect& r);
-    void drawFill(TreeMapItem*,QPainter* p, const QRect& r,
-                  TreeMapItemList* list, int idx, int len, bool goBack);
-    bool drawItemArray(QPainter* p, TreeMapItem*, const QRect& r, double,
-                       TreeMapItemList* list, int idx, int len, bool);
     bool resizeAttr(int);
 
     void addSplitAction(QMenu*, const QString&, int);
@@ -727,6 +799,22 @@ private:
 
     // back buffer pixmap
     QPixmap _pixmap;
+
+    // drawing operations of the layout in the back buffer
+    QVector<DrawOp> _drawOps;
+    bool _recordDrawOps, _needsRepaint;
+    // layouts for other sizes/keys, cost is the number of operations
+    QCache<QString, Layout> _layoutCache;
+
+    // while resizing, only upper levels are laid out
+    bool _coarseLayout;
+    QTimer _resizeTimer;
+
+    // layout in progress: the job running in the worker thread, and the
+    // job waiting for it, as a job of an aborted layout keeps running
+    QThreadPool _layoutPool;
+    TreeMapLayoutJob *_layoutJob, *_nextLayoutJob;
+    int _layoutGeneration, _layoutDepth;
 };
 
 #endif
@@ -36,11 +36,14 @@
 #include <QProgressBar>
 #include <QFile>
 #include <QFileDialog>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
 #include <QEventLoop>
 #include <QToolBar>
 #include <QComboBox>
 #include <QMessageBox>
 #include <QStatusBar>
+#include <QToolButton>
 #include <QWhatsThis>
 
 #ifdef QT_DBUS_SUPPORT
@@ -52,6 +55,7 @@
 #include "stackselection.h"
 #include "stackbrowser.h"
 #include "tracedata.h"
+#include "loadthread.h"
 #include "config.h"
 #include "globalguiconfig.h"
 #include "multiview.h"
@@ -67,10 +71,22 @@ QCGTopLevel::QCGTopLevel()
 #endif
 
     _progressBar = 0;
+    _loadThread = 0;
+    _loadAddToRecentFiles = false;
+    _cancelLoadButton = 0;
     _statusbar = statusBar();
     _statusLabel = new QLabel(_statusbar);
     _statusbar->addWidget(_statusLabel, 1);
 
+    // watching for new parts, see followParts()
+    _partWatcher = new QFileSystemWatcher(this);
+    _partWatchTimer = new QTimer(this);
+    _partWatchTimer->setSingleShot(true);
+    connect(_partWatcher, &QFileSystemWatcher::directoryChanged,
+            this, &QCGTopLevel::partDirectoryChanged);
+    connect(_partWatchTimer, &QTimer::timeout,
+            this, &QCGTopLevel::loadNewParts);
+
     _layoutCount = 1;
     _layoutCurrent = 0;
 
@@ -109,6 +125,8 @@ QCGTopLevel::QCGTopLevel()
 
 QCGTopLevel::~QCGTopLevel()
 {
+    // cancels and waits for a running load
+    delete _loadThread;
     delete _data;
 }
 
@@ -357,6 +375,20 @@ void QCGTopLevel::createActions()
     _addAction->setStatusTip(tr("Add profile data to current window"));
     connect(_addAction, SIGNAL(triggered(bool)), SLOT(add()));
 
+    _followToggleAction = new QAction(tr("F&ollow New Parts"), this);
+    _followToggleAction->setCheckable(true);
+    _followToggleAction->setStatusTip(tr("Add new parts appearing in the "
+                                         "directory of the profile data"));
+    hint = tr("<b>Follow New Parts</b>"
+              "<p>This watches the directory of the profile data for "
+              "new parts, e.g. periodically dumped by a running "
+              "Callgrind, and adds them to the loaded data. "
+              "Already loaded parts are kept, and the current "
+              "selection does not change.</p>");
+    _followToggleAction->setWhatsThis(hint);
+    connect(_followToggleAction, &QAction::triggered,
+            this, &QCGTopLevel::followParts);
+
     _exportAction = new QAction(tr("Export Graph"), this);
     _exportAction->setStatusTip(tr("Generate GraphViz file 'callgraph.dot'"));
     connect(_exportAction, &QAction::triggered, this, &QCGTopLevel::exportGraph);
@@ -575,6 +607,7 @@ void QCGTopLevel::createMenu()
     fileMenu->addAction(_openAction);
     fileMenu->addAction(_recentFilesMenuAction);
     fileMenu->addAction(_addAction);
+    fileMenu->addAction(_followToggleAction);
     fileMenu->addSeparator();
     fileMenu->addAction(_exportAction);
     fileMenu->addSeparator();
@@ -765,7 +798,7 @@ void QCGTopLevel::toggleCycles()
 
     if (!_data) return;
 
-    _data->invalidateDynamicCost();
+    // only invalidates costs depending on cycles
     _data->updateFunctionCycles();
 
     _partSelection->notifyChange(TraceItemView::configChanged);
@@ -804,7 +837,7 @@ void QCGTopLevel::load(QStringList files, bool addToRecentFiles)
     if (files.isEmpty()) return;
     _lastFile = files[0];
 
-    if (_data && _data->parts().count()>0) {
+    if (_loadThread || (_data && _data->parts().count()>0)) {
 
         // In new window
         QCGTopLevel* t = new QCGTopLevel();
@@ -813,28 +846,8 @@ void QCGTopLevel::load(QStringList files, bool addToRecentFiles)
         return;
     }
 
-    // this constructor enables progress bar callbacks
-    TraceData* d = new TraceData(this);
-    int filesLoaded = d->load(files);
-    if (filesLoaded >0)
-        setData(d);
-
-    if (!addToRecentFiles) return;
-
-    // add to recent file list in config
-    QStringList recentFiles;
-    ConfigGroup* generalConfig = ConfigStorage::group(QStringLiteral("GeneralSettings"));
-    recentFiles = generalConfig->value(QStringLiteral("RecentFiles"),
-                                       QStringList()).toStringList();
-    foreach(const QString& file, files) {
-        recentFiles.removeAll(file);
-        if (filesLoaded >0)
-            recentFiles.prepend(file);
-        if (recentFiles.count() >5)
-            recentFiles.removeLast();
-    }
-    generalConfig->setValue(QStringLiteral("RecentFiles"), recentFiles);
-    delete generalConfig;
+    // data is shown and recent files are updated when loading finished
+    startLoad(new LoadThread(files), addToRecentFiles);
 }
 
 
@@ -854,19 +867,50 @@ void QCGTopLevel::add(QStringList files)
     if (files.isEmpty()) return;
     _lastFile = files[0];
 
-    if (_data) {
-        _data->load(files);
-
-        // GUI update for added data
-        configChanged();
+    if (_loadThread) {
+        // data is not available yet
+        _addFilesDelayed << files;
         return;
     }
 
-    // this constructor enables progress bar callbacks
-    TraceData* d = new TraceData(this);
-    int filesLoaded = d->load(files);
-    if (filesLoaded >0)
-        setData(d);
+    // parsed in background, added to shown data when finished
+    if (_data)
+        startLoad(new LoadThread(files, LoadThread::AddParts), false);
+    else
+        startLoad(new LoadThread(files), false);
+}
+
+void QCGTopLevel::addFilesDelayed()
+{
+    if (_addFilesDelayed.isEmpty() || _loadThread) return;
+
+    QStringList files = _addFilesDelayed;
+    _addFilesDelayed.clear();
+    add(files);
+}
+
+void QCGTopLevel::startLoad(LoadThread* t, bool addToRecentFiles)
+{
+    Q_ASSERT(_loadThread == 0);
+
+    _loadThread = t;
+    _loadAddToRecentFiles = addToRecentFiles;
+
+    // signals from the loading thread are queued
+    connect(t, &LoadThread::fileStarted,
+            this, &QCGTopLevel::loadThreadStarted);
+    connect(t, &LoadThread::fileProgress,
+            this, &QCGTopLevel::loadThreadProgress);
+    connect(t, &LoadThread::fileWarning,
+            this, &QCGTopLevel::loadThreadWarning);
+    connect(t, &LoadThread::fileError,
+            this, &QCGTopLevel::loadThreadError);
+    connect(t, &LoadThread::fileFinished,
+            this, &QCGTopLevel::loadThreadFileFinished);
+    connect(t, &QThread::finished,
+            this, &QCGTopLevel::loadThreadFinished);
+
+    t->start();
 }
 
 void QCGTopLevel::loadDelayed(QString file, bool addToRecentFiles)
@@ -894,6 +938,76 @@ void QCGTopLevel::loadFilesDelayed()
 }
 
 
+void QCGTopLevel::followParts(bool follow)
+{
+    if (!_partWatcher->directories().isEmpty())
+        _partWatcher->removePaths(_partWatcher->directories());
+    _partWatchTimer->stop();
+
+    if (!follow || !_data) return;
+
+    QString dir = QFileInfo(_data->traceName()).absolutePath();
+    _partWatcher->addPath(dir);
+    // parts may have appeared since loading
+    loadNewParts();
+}
+
+void QCGTopLevel::partDirectoryChanged()
+{
+    // wait for Callgrind to finish writing a dump
+    _partWatchTimer->start(1000);
+}
+
+void QCGTopLevel::loadNewParts()
+{
+    if (!_data) return;
+
+    if (_loadThread) {
+        // try again later
+        if (!_partWatcher->directories().isEmpty())
+            _partWatchTimer->start(1000);
+        return;
+    }
+
+    // files still written are checked again later
+    bool pending;
+    QStringList files = _data->newPartFiles(&pending);
+    if (pending && !_partWatcher->directories().isEmpty())
+        _partWatchTimer->start(1000);
+
+    // parsed in background, added when finished
+    if (!files.isEmpty())
+        startLoad(new LoadThread(files, LoadThread::AddParts), false);
+}
+
+void QCGTopLevel::partsAdded(const TracePartList& oldParts, int count)
+{
+    // an explicit selection of parts is extended by the new parts
+    if (!_activeParts.isEmpty()) {
+        foreach(TracePart* part, _data->parts())
+            if (!oldParts.contains(part))
+                _activeParts.append(part);
+
+        _partSelection->set(_activeParts);
+        _functionSelection->set(_activeParts);
+        _multiView->set(_activeParts);
+    }
+
+    // rebuild part list, keeping hidden parts
+    _partSelection->hiddenPartsChangedSlot(_hiddenParts);
+    _partSelection->notifyChange(TraceItemView::configChanged);
+    _stackSelection->refresh();
+    _functionSelection->notifyChange(TraceItemView::configChanged);
+    _multiView->notifyChange(TraceItemView::configChanged);
+
+    // as in setData(), show part dock if there are multiple parts now
+    if ((oldParts.count() < 2) && (_data->parts().count() > 1))
+        _partDock->show();
+    updateStatusBar();
+
+    showMessage(tr("Added %n new part(s)", "", count), 5000);
+}
+
 void QCGTopLevel::exportGraph()
 {
     if (!_data || !_function) return;
@@ -1077,6 +1191,9 @@ bool QCGTopLevel::setFunction(QString s)
     if (!_data) return false;
 
     ProfileCostArray* f = _data->search(ProfileContext::Function, s, _eventType);
+    if (!f)
+        f = _data->search(ProfileContext::Function, s, _eventType, 0,
+                          Qt::CaseInsensitive);
     if (!f) return false;
 
     return setFunction((TraceFunction*)f);
@@ -1322,6 +1439,9 @@ void QCGTopLevel::setData(TraceData* data)
     else
         _partDock->show();
 
+    // watch directory of new data
+    followParts(_followToggleAction->isChecked());
+
     updateStatusBar();
 }
 
@@ -2046,6 +2166,149 @@ void QCGTopLevel::showStatus(const QString& msg, int progress)
     qApp->processEvents(QEventLoop::ExcludeUserInputEvents);
 }
 
+void QCGTopLevel::showLoadProgress(const QString& msg, int progress)
+{
+    if (!_statusbar) return;
+
+    if (!_progressBar) {
+        _progressBar = new QProgressBar(_statusbar);
+        _progressBar->setMaximumSize(200, _statusbar->height()-4);
+        _statusbar->addPermanentWidget(_progressBar, 1);
+        _progressBar->show();
+    }
+    if (!_cancelLoadButton) {
+        _cancelLoadButton = new QToolButton(_statusbar);
+        _cancelLoadButton->setIcon(QIcon::fromTheme(QStringLiteral("process-stop")));
+        _cancelLoadButton->setText(tr("Cancel"));
+        _cancelLoadButton->setToolTip(tr("Cancel loading"));
+        _cancelLoadButton->setAutoRaise(true);
+        connect(_cancelLoadButton, &QToolButton::clicked,
+                this, &QCGTopLevel::cancelLoad);
+        _statusbar->addPermanentWidget(_cancelLoadButton);
+        _cancelLoadButton->show();
+    }
+
+    _statusbar->showMessage(msg);
+    _progressBar->setValue(progress);
+}
+
+void QCGTopLevel::cancelLoad()
+{
+    if (!_loadThread) return;
+
+    _loadThread->cancel();
+    if (_cancelLoadButton)
+        _cancelLoadButton->setEnabled(false);
+}
+
+void QCGTopLevel::loadThreadStarted(const QString& filename)
+{
+    Logger::_filename = filename;
+    showLoadProgress(tr("Loading %1").arg(filename), 0);
+}
+
+void QCGTopLevel::loadThreadProgress(const QString& filename, int progress,
+                                     double bytesPerSecond, int secondsLeft)
+{
+    QString msg;
+    if ((bytesPerSecond > 0) && (secondsLeft >= 0))
+        msg = tr("Loading %1 (%2 MB/s, %3 s left)").arg(filename)
+              .arg(bytesPerSecond / (1024*1024), 0, 'f', 1)
+              .arg(secondsLeft);
+    else
+        msg = tr("Loading %1").arg(filename);
+
+    showLoadProgress(msg, progress);
+}
+
+void QCGTopLevel::loadThreadWarning(const QString& filename, int line,
+                                    const QString& msg)
+{
+    qWarning() << "Loading" << filename
+               << ":" << line << ": " << msg;
+}
+
+void QCGTopLevel::loadThreadError(const QString& filename, int line,
+                                  const QString& msg)
+{
+    qCritical() << "Loading" << filename
+                << ":" << line << ": " << msg;
+}
+
+void QCGTopLevel::loadThreadFileFinished(const QString& filename,
+                                         const QString& msg)
+{
+    if (!msg.isEmpty())
+        qWarning() << "Error loading" << filename << ":" << msg;
+}
+
+void QCGTopLevel::loadThreadFinished()
+{
+    LoadThread* t = _loadThread;
+    if (!t) return;
+    _loadThread = 0;
+
+    if (_cancelLoadButton) {
+        _statusbar->removeWidget(_cancelLoadButton);
+        delete _cancelLoadButton;
+        _cancelLoadButton = 0;
+    }
+    // reset status
+    showStatus(QString(), 0);
+
+    // finished() is emitted just before the thread terminates
+    t->wait();
+
+    // parts for the shown data
+    if ((t->mode() == LoadThread::AddParts) && _data && !t->isCanceled()) {
+        TracePartList oldParts = _data->parts();
+        int count = t->addParts(_data);
+        if (count > 0)
+            partsAdded(oldParts, count);
+    }
+
+    TraceData* d = t->takeData();
+    bool canceled = t->isCanceled();
+    QStringList files = t->files();
+    delete t;
+
+    // loading may have finished before the cancel request was seen
+    if (canceled) {
+        delete d;
+        d = 0;
+    }
+
+    // files added meanwhile
+    if (!_addFilesDelayed.isEmpty())
+        QTimer::singleShot(0, this, &QCGTopLevel::addFilesDelayed);
+
+    if (d) {
+        // we get notifications when adding files to the data
+        d->setLogger(this);
+        // switch to the new data in one go
+        setData(d);
+    }
+    else if (canceled)
+        showMessage(tr("Loading canceled"), 2000);
+
+    if (!_loadAddToRecentFiles || canceled) return;
+
+    // add to recent file list in config
+    QStringList recentFiles;
+    ConfigGroup* generalConfig = ConfigStorage::group(QStringLiteral("GeneralSettings"));
+    recentFiles = generalConfig->value(QStringLiteral("RecentFiles"),
+                                       QStringList()).toStringList();
+    foreach(const QString& file, files) {
+        recentFiles.removeAll(file);
+        if (d)
+            recentFiles.prepend(file);
+        if (recentFiles.count() >5)
+            recentFiles.removeLast();
+    }
+    generalConfig->setValue(QStringLiteral("RecentFiles"), recentFiles);
+    delete generalConfig;
+}
+
 void QCGTopLevel::loadStart(const QString& filename)
 {
     showStatus(QStringLiteral("Loading %1").arg(filename), 0);
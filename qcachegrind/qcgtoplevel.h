@@ -36,12 +36,16 @@
 
 class MultiView;
 class QDockWidget;
+class QFileSystemWatcher;
 class QLabel;
 class QComboBox;
 class QProgressBar;
+class QTimer;
+class QToolButton;
 class QMenu;
 
 class TraceData;
+class LoadThread;
 class MainWidget;
 class PartSelection;
 class FunctionSelection;
@@ -94,6 +98,9 @@ public slots:
     void loadDelayed(QString file, bool addToRecentFiles = true);
     void loadDelayed(QStringList files, bool addToRecentFiles = true);
 
+    // add new parts appearing in the directory of the loaded data
+    void followParts(bool);
+    void loadNewParts();
     void exportGraph();
     void newWindow();
     void configure(QString page = QString());
@@ -177,6 +184,7 @@ public slots:
     void setGroupDelayed();
     void setTraceItemDelayed();
     void loadFilesDelayed();
+    void addFilesDelayed();
     void setDirectionDelayed();
 
     // configuration has changed
@@ -188,6 +196,21 @@ public slots:
     void showStatus(const QString& msg, int progress);
     void showMessage(const QString&, int msec);
 
+    // notifications from loading in background
+    void loadThreadStarted(const QString& filename);
+    void loadThreadProgress(const QString& filename, int progress,
+                            double bytesPerSecond, int secondsLeft);
+    void loadThreadWarning(const QString& filename, int line,
+                           const QString& msg);
+    void loadThreadError(const QString& filename, int line,
+                         const QString& msg);
+    void loadThreadFileFinished(const QString& filename, const QString& msg);
+    void loadThreadFinished();
+    void cancelLoad();
+
+    // new parts are loaded with a delay after a directory change
+    void partDirectoryChanged();
+
 private:
     void resetState();
     void createLayoutActions();
@@ -201,6 +224,10 @@ private:
     QString traceKey();
     void restoreTraceTypes();
     void restoreTraceSettings();
+    void startLoad(LoadThread*, bool addToRecentFiles);
+    // GUI update after adding parts to the shown data
+    void partsAdded(const TracePartList& oldParts, int count);
+    void showLoadProgress(const QString& msg, int progress);
 
     QStatusBar* _statusbar;
     QLabel* _statusLabel;
@@ -208,6 +235,11 @@ private:
     QTime _progressStart;
     QProgressBar* _progressBar;
 
+    // background loading, at most one per window
+    LoadThread* _loadThread;
+    bool _loadAddToRecentFiles;
+    QToolButton* _cancelLoadButton;
+
     MultiView* _multiView;
     Qt::Orientation _spOrientation;
     bool _twoMainWidgets;
@@ -220,6 +252,7 @@ private:
     // menu/toolbar actions
     QAction *_newAction, *_openAction, *_addAction, *_reloadAction;
     QAction *_exportAction, *_dumpToggleAction, *_exitAction;
+    QAction *_followToggleAction;
     QAction *_sidebarMenuAction, *_recentFilesMenuAction;
     QAction *_cyclesToggleAction, *_percentageToggleAction;
     QAction *_expandedToggleAction, *_hideTemplatesToggleAction;
@@ -262,7 +295,13 @@ private:
     CostItem* _traceItemDelayed;
     QStringList _loadFilesDelayed;
     bool _addToRecentFiles;
+    // files to add after loading in background finished
+    QStringList _addFilesDelayed;
     TraceItemView::Direction _directionDelayed;
+
+    // following new parts of the loaded data
+    QFileSystemWatcher* _partWatcher;
+    QTimer* _partWatchTimer;
 };
 
 #endif // QCGTOPLEVEL_H